@@ -248,6 +248,31 @@ void MEM_use_lockfree_allocator(void);
  * NOTE: The switch between allocator types can only happen before any allocation did happen. */
 void MEM_use_guarded_allocator(void);
 
+/* Reuse freed small blocks of the lock-free allocator from a per-thread cache, instead of always
+ * returning them to the system allocator. This reduces contention in the system allocator when
+ * many threads allocate and free small blocks concurrently.
+ *
+ * Blocks allocated while the cache is enabled can still be freed when it's disabled, and the other
+ * way around. Has no effect for the guarded allocator and in builds with address sanitizer.
+ *
+ * Every thread that frees blocks may keep 1-2 MB of them cached until it exits, so this is off by
+ * default. Disabling only frees the cache of the calling thread. */
+void MEM_use_thread_cache(bool use);
+
+/* Collect allocation statistics per tag (the string passed to the allocation functions) and per
+ * thread: the number of allocations, allocated bytes, peak usage and a histogram of the lifetime
+ * of blocks. Only blocks allocated with the guarded allocator are profiled, because the lock-free
+ * allocator doesn't store tags.
+ *
+ * Tags are identified by the pointer of their string, so while profiling they must be static
+ * strings (such as literals or `__func__`), not temporary buffers. */
+void MEM_profile_enable(bool enable);
+bool MEM_profile_is_enabled(void);
+/* Clear the collected statistics, except for the memory used by blocks still allocated. */
+void MEM_profile_reset(void);
+/* Get the collected statistics as JSON, the result should be freed with #MEM_freeN. */
+char *MEM_profile_json(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -115,6 +115,9 @@ typedef struct MemHead {
   short pad1;
   /* if non-zero aligned allocation was used and alignment is stored here. */
   short alignment;
+  /* Allocation profiling, null unless profiling was enabled when the block was allocated. */
+  MemProfileTag *profile_tag;
+  uint64_t profile_time;
 #ifdef DEBUG_MEMCOUNTER
   int _count;
 #endif
@@ -423,6 +426,8 @@ static void make_memhead_header(MemHead *memh, size_t len, const char *str)
   memh->pad1 = 0;
   memh->alignment = 0;
   memh->tag2 = MEMTAG2;
+  memh->profile_tag = NULL;
+  memh->profile_time = 0;
 
 #ifdef DEBUG_MEMDUPLINAME
   memh->need_free_name = 0;
@@ -445,6 +450,10 @@ static void make_memhead_header(MemHead *memh, size_t len, const char *str)
   }
   peak_mem = mem_in_use > peak_mem ? mem_in_use : peak_mem;
   mem_unlock_thread();
+
+  if (UNLIKELY(mem_profile_is_enabled())) {
+    memh->profile_tag = mem_profile_block_alloc(str, len, &memh->profile_time);
+  }
 }
 
 void *MEM_guarded_mallocN(size_t len, const char *str)
@@ -1043,6 +1052,10 @@ static void rem_memblock(MemHead *memh)
   atomic_sub_and_fetch_u(&totblock, 1);
   atomic_sub_and_fetch_z(&mem_in_use, memh->len);
 
+  if (UNLIKELY(memh->profile_tag)) {
+    mem_profile_block_free(memh->profile_tag, memh->len, memh->profile_time);
+  }
+
 #ifdef DEBUG_MEMDUPLINAME
   if (memh->need_free_name)
     free((char *)memh->name);
@@ -118,6 +118,41 @@ size_t memory_usage_current(void);
 size_t memory_usage_peak(void);
 void memory_usage_peak_reset(void);
 
+/* Thread cache of small blocks for the lock-free allocator, see `mallocn_thread_cache.cc`.
+ * Blocks up to 256 bytes use size classes in steps of 16 bytes, larger blocks steps of 64. */
+#define MEM_THREAD_CACHE_MAX_LEN 1024
+#define MEM_THREAD_CACHE_CLASS_NUM (256 / 16 + (MEM_THREAD_CACHE_MAX_LEN - 256) / 64)
+
+MEM_INLINE int mem_thread_cache_class_index(size_t len)
+{
+  if (len <= 256) {
+    return len == 0 ? 0 : (int)((len - 1) / 16);
+  }
+  return 256 / 16 + (int)((len - 256 - 1) / 64);
+}
+
+MEM_INLINE size_t mem_thread_cache_class_len(int class_index)
+{
+  if (class_index < 256 / 16) {
+    return (size_t)(class_index + 1) * 16;
+  }
+  return 256 + (size_t)(class_index - 256 / 16 + 1) * 64;
+}
+
+bool mem_thread_cache_enabled(void);
+/** Get a cached block of the size class, or null if there is none. */
+void *mem_thread_cache_pop(int class_index);
+/** Add the block to the cache of the current thread, returns false if the cache is full. */
+bool mem_thread_cache_push(void *ptr, int class_index);
+
+/* Allocation profiling for the guarded allocator, see `mallocn_profile.cc`. */
+typedef struct MemProfileTag MemProfileTag;
+
+bool mem_profile_is_enabled(void);
+/** Register an allocation, returns the tag to pass to #mem_profile_block_free. */
+MemProfileTag *mem_profile_block_alloc(const char *name, size_t len, uint64_t *r_time);
+void mem_profile_block_free(MemProfileTag *tag, size_t len, uint64_t time);
+
 /**
  * Clear the listbase of allocated memory blocks.
  *
@@ -44,13 +44,18 @@ static void (*error_callback)(const char *) = NULL;
 
 enum {
   MEMHEAD_ALIGN_FLAG = 1,
+  /** The block has the size of its thread cache size class and can be reused for any block of
+   * that class, see #MEM_use_thread_cache. */
+  MEMHEAD_THREAD_CACHE_FLAG = 2,
 };
 
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned *)ptr) - 1)
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t)MEMHEAD_ALIGN_FLAG)
-#define MEMHEAD_LEN(memhead) ((memhead)->len & ~((size_t)(MEMHEAD_ALIGN_FLAG)))
+#define MEMHEAD_IS_THREAD_CACHED(memhead) ((memhead)->len & (size_t)MEMHEAD_THREAD_CACHE_FLAG)
+#define MEMHEAD_LEN(memhead) \
+  ((memhead)->len & ~((size_t)(MEMHEAD_ALIGN_FLAG | MEMHEAD_THREAD_CACHE_FLAG)))
 
 #ifdef __GNUC__
 __attribute__((format(printf, 1, 2)))
@@ -71,6 +76,24 @@ print_error(const char *str, ...)
   }
 }
 
+/**
+ * Allocate a block with room for the size class of \a len from the thread cache, or from the
+ * system allocator when there is no cached block.
+ */
+static MemHead *memhead_thread_cache_alloc(size_t len, bool clear)
+{
+  const int class_index = mem_thread_cache_class_index(len);
+  MemHead *memh = (MemHead *)mem_thread_cache_pop(class_index);
+  if (memh) {
+    if (clear) {
+      memset(memh + 1, 0, len);
+    }
+    return memh;
+  }
+  const size_t alloc_len = mem_thread_cache_class_len(class_index) + sizeof(MemHead);
+  return (MemHead *)(clear ? calloc(1, alloc_len) : malloc(alloc_len));
+}
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
   if (LIKELY(vmemh)) {
@@ -106,6 +129,13 @@ void MEM_lockfree_freeN(void *vmemh)
     MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
     aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
   }
+  else if (MEMHEAD_IS_THREAD_CACHED(memh)) {
+    if (!(mem_thread_cache_enabled() &&
+          mem_thread_cache_push(memh, mem_thread_cache_class_index(len))))
+    {
+      free(memh);
+    }
+  }
   else {
     free(memh);
   }
@@ -210,13 +240,20 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
 void *MEM_lockfree_callocN(size_t len, const char *str)
 {
   MemHead *memh;
+  size_t flags = 0;
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  if (len <= MEM_THREAD_CACHE_MAX_LEN && mem_thread_cache_enabled()) {
+    memh = memhead_thread_cache_alloc(len, true);
+    flags = (size_t)MEMHEAD_THREAD_CACHE_FLAG;
+  }
+  else {
+    memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  }
 
   if (LIKELY(memh)) {
-    memh->len = len;
+    memh->len = len | flags;
     memory_usage_block_alloc(len);
 
     return PTR_FROM_MEMHEAD(memh);
@@ -249,13 +286,20 @@ void *MEM_lockfree_calloc_arrayN(size_t len, size_t size, const char *str)
 void *MEM_lockfree_mallocN(size_t len, const char *str)
 {
   MemHead *memh;
+  size_t flags = 0;
 
 #ifdef WITH_MEM_VALGRIND
   const size_t len_unaligned = len;
 #endif
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)malloc(len + sizeof(MemHead));
+  if (len <= MEM_THREAD_CACHE_MAX_LEN && mem_thread_cache_enabled()) {
+    memh = memhead_thread_cache_alloc(len, false);
+    flags = (size_t)MEMHEAD_THREAD_CACHE_FLAG;
+  }
+  else {
+    memh = (MemHead *)malloc(len + sizeof(MemHead));
+  }
 
   if (LIKELY(memh)) {
 
@@ -273,7 +317,7 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 #endif /* WITH_MEM_VALGRIND */
     }
 
-    memh->len = len;
+    memh->len = len | flags;
     memory_usage_block_alloc(len);
 
     return PTR_FROM_MEMHEAD(memh);
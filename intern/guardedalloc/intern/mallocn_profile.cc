@@ -0,0 +1,405 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup intern_mem
+ *
+ * Allocation statistics per tag and per thread for the guarded allocator. The tag is the string
+ * passed to the allocation functions, which is already stored in every block.
+ *
+ * Every thread counts its allocations and frees in its own table, so that threads don't contend
+ * on a global lock. The tables are merged when the statistics are requested. Only the memory in
+ * use and its peak are shared between threads, as atomic counters.
+ *
+ * Tags are looked up by the pointer of their string, which therefore has to stay valid and keep
+ * its contents for as long as the profile exists. That's the case for the string literals passed
+ * to the allocation functions. Tags with equal strings but different pointers are still combined.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+#include "mallocn_intern.h"
+
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+/**
+ * Number of buckets of the lifetime histograms. The first bucket counts blocks freed within a
+ * microsecond, bucket `i` blocks that lived less than `2^i` microseconds, and the last bucket all
+ * blocks that lived longer.
+ */
+static constexpr int lifetime_buckets_num = 32;
+
+/** Shared by all threads, one for every distinct tag string. */
+struct MemProfileTag {
+  std::string name;
+  std::atomic<int64_t> bytes_in_use = 0;
+  std::atomic<int64_t> peak_bytes_in_use = 0;
+};
+
+namespace {
+
+/** Statistics of one tag, counted by a single thread. */
+struct TagStats {
+  int64_t allocations = 0;
+  int64_t frees = 0;
+  int64_t bytes_allocated = 0;
+  std::array<int64_t, lifetime_buckets_num> lifetime_histogram = {};
+};
+
+struct ThreadProfile {
+  int thread_index;
+  /** Only accessed by the owning thread. */
+  std::unordered_map<const char *, MemProfileTag *> tag_by_name_ptr;
+  /**
+   * Only modified by the owning thread, but read when the statistics are requested. The lock is
+   * therefore almost never contended.
+   */
+  std::mutex mutex;
+  std::unordered_map<const MemProfileTag *, TagStats> stats;
+};
+
+struct Profile {
+  /** Protects the lists of tags and threads, not their contents. */
+  std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<MemProfileTag>> tags;
+  /** Kept after their thread exited, so that the statistics of all threads can be reported. */
+  std::vector<std::unique_ptr<ThreadProfile>> threads;
+  std::atomic<int64_t> bytes_in_use = 0;
+  std::atomic<int64_t> peak_bytes_in_use = 0;
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+}  // namespace
+
+static std::atomic<bool> profile_enabled = false;
+
+/**
+ * Never destructed, because blocks keep pointers to the tags and may still be freed during the
+ * destruction of static variables.
+ */
+static Profile &get_profile()
+{
+  static Profile *profile = new Profile();
+  return *profile;
+}
+
+/**
+ * The thread local is only a pointer, so that it can still be used while the destructors of other
+ * thread local variables free memory. The data itself is owned by the #Profile.
+ */
+static ThreadProfile &get_thread_profile(Profile &profile)
+{
+  static thread_local ThreadProfile *thread_profile = nullptr;
+  if (UNLIKELY(thread_profile == nullptr)) {
+    std::unique_ptr<ThreadProfile> new_profile = std::make_unique<ThreadProfile>();
+    thread_profile = new_profile.get();
+    std::lock_guard lock{profile.mutex};
+    new_profile->thread_index = int(profile.threads.size());
+    profile.threads.push_back(std::move(new_profile));
+  }
+  return *thread_profile;
+}
+
+static uint64_t time_in_microseconds(const Profile &profile)
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - profile.start_time)
+                      .count());
+}
+
+static int lifetime_bucket(uint64_t lifetime)
+{
+  int bucket = 0;
+  while (lifetime > 0 && bucket < lifetime_buckets_num - 1) {
+    lifetime >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void atomic_max(std::atomic<int64_t> &value, const int64_t new_value)
+{
+  int64_t old_value = value.load(std::memory_order_relaxed);
+  while (old_value < new_value &&
+         !value.compare_exchange_weak(old_value, new_value, std::memory_order_relaxed))
+  {
+  }
+}
+
+static MemProfileTag &ensure_tag(Profile &profile, ThreadProfile &thread_profile, const char *name)
+{
+  const auto found = thread_profile.tag_by_name_ptr.find(name);
+  if (found != thread_profile.tag_by_name_ptr.end()) {
+    return *found->second;
+  }
+  MemProfileTag *tag_ptr;
+  {
+    std::lock_guard lock{profile.mutex};
+    std::unique_ptr<MemProfileTag> &tag = profile.tags[name];
+    if (!tag) {
+      tag = std::make_unique<MemProfileTag>();
+      tag->name = name;
+    }
+    tag_ptr = tag.get();
+  }
+  thread_profile.tag_by_name_ptr.emplace(name, tag_ptr);
+  return *tag_ptr;
+}
+
+bool mem_profile_is_enabled(void)
+{
+  return profile_enabled.load(std::memory_order_relaxed);
+}
+
+MemProfileTag *mem_profile_block_alloc(const char *name, const size_t len, uint64_t *r_time)
+{
+  Profile &profile = get_profile();
+  ThreadProfile &thread_profile = get_thread_profile(profile);
+  MemProfileTag &tag = ensure_tag(profile, thread_profile, name ? name : "");
+  {
+    std::lock_guard lock{thread_profile.mutex};
+    TagStats &stats = thread_profile.stats[&tag];
+    stats.allocations++;
+    stats.bytes_allocated += int64_t(len);
+  }
+
+  atomic_max(tag.peak_bytes_in_use,
+             tag.bytes_in_use.fetch_add(int64_t(len), std::memory_order_relaxed) + int64_t(len));
+  atomic_max(
+      profile.peak_bytes_in_use,
+      profile.bytes_in_use.fetch_add(int64_t(len), std::memory_order_relaxed) + int64_t(len));
+
+  *r_time = time_in_microseconds(profile);
+  return &tag;
+}
+
+void mem_profile_block_free(MemProfileTag *tag, const size_t len, const uint64_t time)
+{
+  Profile &profile = get_profile();
+  ThreadProfile &thread_profile = get_thread_profile(profile);
+  const uint64_t lifetime = time_in_microseconds(profile) - time;
+  {
+    /* Counted by the freeing thread, which may not be the one that allocated the block. */
+    std::lock_guard lock{thread_profile.mutex};
+    TagStats &stats = thread_profile.stats[tag];
+    stats.frees++;
+    stats.lifetime_histogram[size_t(lifetime_bucket(lifetime))]++;
+  }
+  tag->bytes_in_use.fetch_sub(int64_t(len), std::memory_order_relaxed);
+  profile.bytes_in_use.fetch_sub(int64_t(len), std::memory_order_relaxed);
+}
+
+void MEM_profile_enable(const bool enable)
+{
+  if (enable) {
+    /* Make sure the profile exists before the first block references it. */
+    get_profile();
+  }
+  profile_enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool MEM_profile_is_enabled(void)
+{
+  return mem_profile_is_enabled();
+}
+
+void MEM_profile_reset(void)
+{
+  Profile &profile = get_profile();
+  std::lock_guard lock{profile.mutex};
+  for (std::unique_ptr<ThreadProfile> &thread_profile : profile.threads) {
+    std::lock_guard thread_lock{thread_profile->mutex};
+    thread_profile->stats.clear();
+  }
+  /* Tags can't be removed because they are still referenced by allocated blocks. */
+  for (auto &item : profile.tags) {
+    MemProfileTag &tag = *item.second;
+    tag.peak_bytes_in_use.store(tag.bytes_in_use.load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+  }
+  profile.peak_bytes_in_use.store(profile.bytes_in_use.load(std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+}
+
+static void json_append_string(std::string &json, const std::string &str)
+{
+  json += '"';
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        json += "\\\"";
+        break;
+      case '\\':
+        json += "\\\\";
+        break;
+      case '\n':
+        json += "\\n";
+        break;
+      case '\t':
+        json += "\\t";
+        break;
+      default:
+        if (uint8_t(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", uint(uint8_t(c)));
+          json += buf;
+        }
+        else {
+          json += c;
+        }
+        break;
+    }
+  }
+  json += '"';
+}
+
+namespace {
+
+struct ThreadStats {
+  int64_t allocations = 0;
+  int64_t bytes = 0;
+};
+
+/** Statistics of a tag, merged from all threads. */
+struct MergedTag {
+  const MemProfileTag *tag;
+  TagStats stats;
+  /** Allocations done by every thread, by thread index. */
+  std::map<int, ThreadStats> threads;
+};
+
+}  // namespace
+
+static std::string profile_to_json(const Profile &profile)
+{
+  std::unordered_map<const MemProfileTag *, MergedTag> merged_tags;
+  std::map<int, ThreadStats> threads;
+  for (const std::unique_ptr<ThreadProfile> &thread_profile : profile.threads) {
+    std::lock_guard lock{thread_profile->mutex};
+    for (const auto &item : thread_profile->stats) {
+      const TagStats &stats = item.second;
+      MergedTag &merged = merged_tags[item.first];
+      merged.tag = item.first;
+      merged.stats.allocations += stats.allocations;
+      merged.stats.frees += stats.frees;
+      merged.stats.bytes_allocated += stats.bytes_allocated;
+      for (int i = 0; i < lifetime_buckets_num; i++) {
+        merged.stats.lifetime_histogram[size_t(i)] += stats.lifetime_histogram[size_t(i)];
+      }
+      if (stats.allocations > 0) {
+        ThreadStats &thread_stats = merged.threads[thread_profile->thread_index];
+        thread_stats.allocations += stats.allocations;
+        thread_stats.bytes += stats.bytes_allocated;
+        threads[thread_profile->thread_index].allocations += stats.allocations;
+        threads[thread_profile->thread_index].bytes += stats.bytes_allocated;
+      }
+    }
+  }
+  /* Tags of blocks allocated before the last reset. */
+  for (const auto &item : profile.tags) {
+    const MemProfileTag &tag = *item.second;
+    if (tag.bytes_in_use.load(std::memory_order_relaxed) != 0) {
+      merged_tags[&tag].tag = &tag;
+    }
+  }
+
+  std::vector<const MergedTag *> tags;
+  for (const auto &item : merged_tags) {
+    const MergedTag &merged = item.second;
+    if (merged.stats.allocations == 0 &&
+        merged.tag->bytes_in_use.load(std::memory_order_relaxed) == 0)
+    {
+      continue;
+    }
+    tags.push_back(&merged);
+  }
+  /* Subsystems that allocate the most memory first, those are most interesting. */
+  std::sort(tags.begin(), tags.end(), [](const MergedTag *a, const MergedTag *b) {
+    if (a->stats.bytes_allocated != b->stats.bytes_allocated) {
+      return a->stats.bytes_allocated > b->stats.bytes_allocated;
+    }
+    return a->tag->name < b->tag->name;
+  });
+
+  std::string json;
+  json += "{\n";
+  json += "  \"duration_us\": " + std::to_string(time_in_microseconds(profile)) + ",\n";
+  json += "  \"bytes_in_use\": " + std::to_string(profile.bytes_in_use.load()) + ",\n";
+  json += "  \"peak_bytes_in_use\": " + std::to_string(profile.peak_bytes_in_use.load()) +
+          ",\n";
+  json += "  \"lifetime_histogram_upper_bounds_us\": [";
+  for (int i = 0; i < lifetime_buckets_num - 1; i++) {
+    json += std::to_string(uint64_t(1) << i) + ", ";
+  }
+  json += "null],\n";
+
+  json += "  \"threads\": [";
+  bool first = true;
+  for (const auto &item : threads) {
+    json += first ? "\n" : ",\n";
+    first = false;
+    json += "    {\"thread\": " + std::to_string(item.first) +
+            ", \"allocations\": " + std::to_string(item.second.allocations) +
+            ", \"bytes\": " + std::to_string(item.second.bytes) + "}";
+  }
+  json += "\n  ],\n";
+
+  json += "  \"tags\": [";
+  first = true;
+  for (const MergedTag *merged : tags) {
+    const MemProfileTag &tag = *merged->tag;
+    const TagStats &stats = merged->stats;
+    json += first ? "\n" : ",\n";
+    first = false;
+    json += "    {\"name\": ";
+    json_append_string(json, tag.name);
+    json += ", \"allocations\": " + std::to_string(stats.allocations);
+    json += ", \"frees\": " + std::to_string(stats.frees);
+    json += ", \"bytes_allocated\": " + std::to_string(stats.bytes_allocated);
+    json += ", \"bytes_in_use\": " + std::to_string(tag.bytes_in_use.load());
+    json += ", \"peak_bytes_in_use\": " + std::to_string(tag.peak_bytes_in_use.load());
+    json += ", \"lifetime_histogram\": [";
+    for (int i = 0; i < lifetime_buckets_num; i++) {
+      json += (i == 0 ? "" : ", ") + std::to_string(stats.lifetime_histogram[size_t(i)]);
+    }
+    json += "], \"threads\": {";
+    bool first_thread = true;
+    for (const auto &item : merged->threads) {
+      json += first_thread ? "" : ", ";
+      first_thread = false;
+      json += "\"" + std::to_string(item.first) +
+              "\": {\"allocations\": " + std::to_string(item.second.allocations) +
+              ", \"bytes\": " + std::to_string(item.second.bytes) + "}";
+    }
+    json += "}}";
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
+
+char *MEM_profile_json(void)
+{
+  Profile &profile = get_profile();
+  std::string json;
+  {
+    std::lock_guard lock{profile.mutex};
+    json = profile_to_json(profile);
+  }
+  /* Allocate after unlocking, the allocation itself may be profiled. */
+  char *result = static_cast<char *>(MEM_mallocN(json.size() + 1, __func__));
+  memcpy(result, json.c_str(), json.size() + 1);
+  return result;
+}
@@ -0,0 +1,142 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup intern_mem
+ *
+ * Per-thread caches of freed small blocks for the lock-free allocator. Blocks are grouped by size
+ * class, so that any cached block of a class can be reused for an allocation of that class
+ * without going through the system allocator, which avoids contention on its global state when
+ * many threads allocate and free small blocks.
+ *
+ * Blocks freed on another thread than the one that allocated them end up in the cache of the
+ * freeing thread. Each list has a limited size, once it's full blocks are freed directly.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <type_traits>
+
+#include "MEM_guardedalloc.h"
+#include "mallocn_intern.h"
+
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+namespace {
+
+/** Upper limit for the memory of all blocks in one list of a thread cache. */
+constexpr size_t list_max_bytes = 32 * 1024;
+/** Lists of larger classes may still keep a few blocks. */
+constexpr int list_min_blocks = 8;
+
+struct CachedBlock {
+  CachedBlock *next;
+};
+
+/**
+ * Trivially destructible, so that it stays accessible while the destructors of other thread local
+ * variables run. Those may still free memory after #ThreadCacheCleanup cleared the cache.
+ */
+struct alignas(128) ThreadCache {
+  CachedBlock *lists[MEM_THREAD_CACHE_CLASS_NUM];
+  int lists_len[MEM_THREAD_CACHE_CLASS_NUM];
+  /** The #ThreadCacheCleanup of the thread has been constructed. */
+  bool cleanup_registered;
+  /** The thread is exiting and the cache has been cleared, it must not be used anymore. */
+  bool exited;
+
+  void clear()
+  {
+    for (int i = 0; i < MEM_THREAD_CACHE_CLASS_NUM; i++) {
+      CachedBlock *block = this->lists[i];
+      while (block) {
+        CachedBlock *next = block->next;
+        free(block);
+        block = next;
+      }
+      this->lists[i] = nullptr;
+      this->lists_len[i] = 0;
+    }
+  }
+};
+
+static_assert(std::is_trivially_destructible_v<ThreadCache>);
+
+thread_local ThreadCache thread_cache = {};
+
+/** Frees the cached blocks when the thread exits. */
+struct ThreadCacheCleanup {
+  ~ThreadCacheCleanup()
+  {
+    thread_cache.clear();
+    thread_cache.exited = true;
+  }
+};
+
+}  // namespace
+
+static std::atomic<bool> use_thread_cache = false;
+
+static int list_max_len(const int class_index)
+{
+  const size_t block_size = mem_thread_cache_class_len(class_index);
+  return std::max(list_min_blocks, int(list_max_bytes / block_size));
+}
+
+bool mem_thread_cache_enabled(void)
+{
+#ifdef WITH_ASAN
+  /* Reusing blocks would hide use-after-free errors. */
+  return false;
+#else
+  return use_thread_cache.load(std::memory_order_relaxed);
+#endif
+}
+
+void *mem_thread_cache_pop(const int class_index)
+{
+  ThreadCache &cache = thread_cache;
+  /* Blocks are only added after the cleanup has been registered, and none are left once the
+   * thread exited, so the lists don't have to be checked for that. */
+  CachedBlock *block = cache.lists[class_index];
+  if (block == nullptr) {
+    return nullptr;
+  }
+  cache.lists[class_index] = block->next;
+  cache.lists_len[class_index]--;
+  return block;
+}
+
+bool mem_thread_cache_push(void *ptr, const int class_index)
+{
+  ThreadCache &cache = thread_cache;
+  if (UNLIKELY(cache.exited)) {
+    return false;
+  }
+  if (UNLIKELY(!cache.cleanup_registered)) {
+    /* Constructing the thread local variable registers its destructor for this thread. */
+    static thread_local ThreadCacheCleanup cleanup;
+    (void)cleanup;
+    cache.cleanup_registered = true;
+  }
+  if (cache.lists_len[class_index] >= list_max_len(class_index)) {
+    return false;
+  }
+  CachedBlock *block = static_cast<CachedBlock *>(ptr);
+  block->next = cache.lists[class_index];
+  cache.lists[class_index] = block;
+  cache.lists_len[class_index]++;
+  return true;
+}
+
+void MEM_use_thread_cache(const bool use)
+{
+  use_thread_cache.store(use, std::memory_order_relaxed);
+  if (!use) {
+    /* Only the cache of the calling thread can be freed, other threads free their cached blocks
+     * when they exit. */
+    thread_cache.clear();
+  }
+}
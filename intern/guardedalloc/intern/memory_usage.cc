@@ -40,7 +40,8 @@ struct alignas(128) Local {
   /**
    * Number of bytes. This can be negative when e.g. one thread allocates a lot of memory, and
    * another frees it. It has to be an atomic, because it may be accessed by other threads when the
-   * total memory usage is counted.
+   * total memory usage is counted. Only the owning thread modifies it though, so it's updated
+   * with a plain load and store instead of a more expensive atomic read-modify-write operation.
    */
   std::atomic<int64_t> mem_in_use = 0;
   /**
@@ -121,6 +122,14 @@ static Global &get_global()
   return *get_global_ptr();
 }
 
+/**
+ * Add to a counter that is only ever modified by the current thread, see #Local::mem_in_use.
+ */
+static void local_counter_add(std::atomic<int64_t> &counter, const int64_t value)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
 static Local &get_local_data()
 {
   static thread_local Local local;
@@ -193,8 +202,8 @@ void memory_usage_block_alloc(const size_t size)
      * cases, because each thread has these counters on a separate cache line. It may only cause
      * synchronization if another thread is computing the total current memory usage at the same
      * time, which is very rare compared to doing allocations. */
-    local.blocks_num.fetch_add(1, std::memory_order_relaxed);
-    local.mem_in_use.fetch_add(int64_t(size), std::memory_order_relaxed);
+    local_counter_add(local.blocks_num, 1);
+    local_counter_add(local.mem_in_use, int64_t(size));
 
     /* If a certain amount of new memory has been allocated, update the peak. */
     if (local.mem_in_use - local.mem_in_use_during_peak_update > peak_update_threshold) {
@@ -215,8 +224,8 @@ void memory_usage_block_free(const size_t size)
     /* Decrease local memory counts. See comment in #memory_usage_block_alloc for details regarding
      * thread synchronization. */
     Local &local = get_local_data();
-    local.mem_in_use.fetch_sub(int64_t(size), std::memory_order_relaxed);
-    local.blocks_num.fetch_sub(1, std::memory_order_relaxed);
+    local_counter_add(local.mem_in_use, -int64_t(size));
+    local_counter_add(local.blocks_num, -1);
   }
   else {
     Global &global = get_global();
@@ -0,0 +1,145 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+#include "guardedalloc_test_base.h"
+
+namespace {
+
+class ProfileTest : public GuardedAllocatorTest {
+ protected:
+  void SetUp() override
+  {
+    GuardedAllocatorTest::SetUp();
+    MEM_profile_enable(true);
+    MEM_profile_reset();
+  }
+
+  void TearDown() override
+  {
+    MEM_profile_enable(false);
+  }
+};
+
+std::string profile_json()
+{
+  char *json = MEM_profile_json();
+  std::string result = json;
+  MEM_freeN(json);
+  return result;
+}
+
+/** Get the JSON of the tag with the given name, or an empty string. */
+std::string tag_json(const std::string &json, const std::string &name)
+{
+  const size_t start = json.find("{\"name\": \"" + name + "\"");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return json.substr(start, json.find("}}", start) + 2 - start);
+}
+
+}  // namespace
+
+TEST_F(ProfileTest, Counts)
+{
+  std::vector<void *> blocks;
+  for (int i = 0; i < 10; i++) {
+    blocks.push_back(MEM_mallocN(100, "profile_test_a"));
+  }
+  /* The same tag with another pointer. Tags have to stay valid, like string literals. */
+  static const char name_a[] = "profile_test_a";
+  blocks.push_back(MEM_mallocN(100, name_a));
+  void *block_b = MEM_callocN(1000, "profile_test_b");
+  for (int i = 0; i < 4; i++) {
+    MEM_freeN(blocks[size_t(i)]);
+  }
+
+  std::string json = tag_json(profile_json(), "profile_test_a");
+  EXPECT_NE(json.find("\"allocations\": 11,"), std::string::npos);
+  EXPECT_NE(json.find("\"frees\": 4,"), std::string::npos);
+  EXPECT_NE(json.find("\"bytes_allocated\": 1100,"), std::string::npos);
+  EXPECT_NE(json.find("\"bytes_in_use\": 700,"), std::string::npos);
+  EXPECT_NE(json.find("\"peak_bytes_in_use\": 1100,"), std::string::npos);
+
+  json = tag_json(profile_json(), "profile_test_b");
+  EXPECT_NE(json.find("\"allocations\": 1,"), std::string::npos);
+  EXPECT_NE(json.find("\"bytes_in_use\": 1000,"), std::string::npos);
+
+  for (int i = 4; i < 11; i++) {
+    MEM_freeN(blocks[size_t(i)]);
+  }
+  MEM_freeN(block_b);
+
+  MEM_profile_reset();
+  json = tag_json(profile_json(), "profile_test_a");
+  EXPECT_EQ(json, "");
+}
+
+TEST_F(ProfileTest, Threads)
+{
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < 3; thread++) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 5; i++) {
+        MEM_freeN(MEM_mallocN(16, "profile_test_threads"));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  const std::string json = tag_json(profile_json(), "profile_test_threads");
+  EXPECT_NE(json.find("\"allocations\": 15,"), std::string::npos);
+  EXPECT_NE(json.find("\"frees\": 15,"), std::string::npos);
+  /* Every thread is listed with its allocations. */
+  size_t threads_found = 0;
+  for (size_t pos = json.find("{\"allocations\": 5, \"bytes\": 80}"); pos != std::string::npos;
+       pos = json.find("{\"allocations\": 5, \"bytes\": 80}", pos + 1))
+  {
+    threads_found++;
+  }
+  EXPECT_EQ(threads_found, size_t(3));
+}
+
+TEST_F(ProfileTest, FreeOnOtherThread)
+{
+  std::vector<void *> blocks;
+  std::thread thread([&]() {
+    for (int i = 0; i < 8; i++) {
+      blocks.push_back(MEM_mallocN(32, "profile_test_other_thread"));
+    }
+  });
+  thread.join();
+  for (void *block : blocks) {
+    MEM_freeN(block);
+  }
+
+  /* The counts of both threads are combined. */
+  const std::string json = tag_json(profile_json(), "profile_test_other_thread");
+  EXPECT_NE(json.find("\"allocations\": 8,"), std::string::npos);
+  EXPECT_NE(json.find("\"frees\": 8,"), std::string::npos);
+  EXPECT_NE(json.find("\"bytes_in_use\": 0,"), std::string::npos);
+  EXPECT_NE(json.find("\"peak_bytes_in_use\": 256,"), std::string::npos);
+  /* Only the allocating thread is listed. */
+  const std::string threads_json = json.substr(json.find("\"threads\""));
+  EXPECT_NE(threads_json.find("{\"allocations\": 8, \"bytes\": 256}}"), std::string::npos);
+  EXPECT_EQ(threads_json.find("}, "), std::string::npos);
+}
+
+TEST_F(ProfileTest, Disabled)
+{
+  MEM_profile_enable(false);
+  void *block = MEM_mallocN(16, "profile_test_disabled");
+  MEM_profile_enable(true);
+  MEM_freeN(block);
+  EXPECT_EQ(tag_json(profile_json(), "profile_test_disabled"), "");
+}
@@ -0,0 +1,154 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+#include "guardedalloc_test_base.h"
+
+namespace {
+
+class ThreadCacheTest : public LockFreeAllocatorTest {
+ protected:
+  void SetUp() override
+  {
+    LockFreeAllocatorTest::SetUp();
+    MEM_use_thread_cache(true);
+  }
+
+  void TearDown() override
+  {
+    MEM_use_thread_cache(false);
+  }
+};
+
+}  // namespace
+
+TEST_F(ThreadCacheTest, AllocN_len)
+{
+  const size_t blocks_num = MEM_get_memory_blocks_in_use();
+  const size_t mem_in_use = MEM_get_memory_in_use();
+  for (const size_t len : {0, 1, 4, 15, 16, 17, 100, 256, 257, 1000, 1024, 1025, 5000}) {
+    void *ptr = MEM_mallocN(len, __func__);
+    memset(ptr, 1, len);
+    EXPECT_EQ(MEM_allocN_len(ptr), (len + 3) & ~size_t(3));
+    MEM_freeN(ptr);
+  }
+  EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_num);
+  EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+}
+
+TEST_F(ThreadCacheTest, CallocReused)
+{
+  for (int i = 0; i < 10; i++) {
+    char *ptr = static_cast<char *>(MEM_mallocN(208, __func__));
+    memset(ptr, 255, 208);
+    MEM_freeN(ptr);
+    /* A smaller block of the same size class (193 to 208 bytes) gets the freed block back. */
+    char *ptr_reused = static_cast<char *>(MEM_callocN(196, __func__));
+    EXPECT_EQ(ptr_reused, ptr);
+    for (int j = 0; j < 196; j++) {
+      EXPECT_EQ(ptr_reused[j], 0);
+    }
+    MEM_freeN(ptr_reused);
+  }
+}
+
+TEST_F(ThreadCacheTest, Realloc)
+{
+  int *ptr = static_cast<int *>(MEM_mallocN(sizeof(int) * 4, __func__));
+  for (int i = 0; i < 4; i++) {
+    ptr[i] = i;
+  }
+  ptr = static_cast<int *>(MEM_recallocN(ptr, sizeof(int) * 100));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(ptr[i], i < 4 ? i : 0);
+  }
+  ptr = static_cast<int *>(MEM_reallocN(ptr, sizeof(int) * 1000));
+  EXPECT_EQ(ptr[3], 3);
+  MEM_freeN(ptr);
+}
+
+TEST_F(ThreadCacheTest, Toggle)
+{
+  const size_t blocks_num = MEM_get_memory_blocks_in_use();
+  void *cached = MEM_mallocN(64, __func__);
+  MEM_use_thread_cache(false);
+  void *uncached = MEM_mallocN(64, __func__);
+  MEM_freeN(cached);
+  MEM_use_thread_cache(true);
+  MEM_freeN(uncached);
+  EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_num);
+}
+
+TEST_F(ThreadCacheTest, FreeOnOtherThread)
+{
+  const size_t blocks_num = MEM_get_memory_blocks_in_use();
+  const size_t mem_in_use = MEM_get_memory_in_use();
+
+  constexpr int threads_num = 4;
+  constexpr int blocks_per_thread = 10000;
+  std::vector<std::vector<void *>> blocks(threads_num);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < threads_num; thread++) {
+    threads.emplace_back([&, thread]() {
+      for (int i = 0; i < blocks_per_thread; i++) {
+        const size_t len = size_t(i % 1100);
+        void *ptr = MEM_mallocN(len, __func__);
+        memset(ptr, thread, len);
+        blocks[thread].push_back(ptr);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  /* Free the blocks allocated by other threads. */
+  for (int thread = 0; thread < threads_num; thread++) {
+    threads.emplace_back([&, thread]() {
+      for (void *ptr : blocks[(thread + 1) % threads_num]) {
+        MEM_freeN(ptr);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_num);
+  EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+}
+
+namespace {
+
+/** Frees a block when the thread exits, after the thread cache was cleared. */
+struct FreeOnThreadExit {
+  void *ptr = nullptr;
+  ~FreeOnThreadExit()
+  {
+    MEM_freeN(ptr);
+  }
+};
+
+}  // namespace
+
+TEST_F(ThreadCacheTest, FreeOnThreadExit)
+{
+  const size_t blocks_num = MEM_get_memory_blocks_in_use();
+  std::thread thread([]() {
+    void *ptr = MEM_mallocN(64, __func__);
+    /* Constructed before the first block is cached, so it's destructed after the cache. */
+    static thread_local FreeOnThreadExit free_on_exit;
+    free_on_exit.ptr = ptr;
+    MEM_freeN(MEM_mallocN(64, __func__));
+  });
+  thread.join();
+  EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_num);
+}
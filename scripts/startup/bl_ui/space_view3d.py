@@ -4925,6 +4925,10 @@ class VIEW3D_MT_edit_mesh_clean(Menu):
         layout.operator("mesh.remove_doubles")
         layout.operator("mesh.fill_holes")
 
+        layout.separator()
+
+        layout.operator("mesh.pack_elements")
+
         layout.template_node_operator_asset_menu_items(catalog_path="Mesh/Clean Up")
 
 
@@ -68,6 +68,11 @@ bool BKE_appdir_folder_documents(char *dir) ATTR_NONNULL(1) ATTR_WARN_UNUSED_RES
  * if the `blender` folder exists. It does check if the parent of the path exists.
  */
 bool BKE_appdir_folder_caches(char *r_path, size_t r_path_maxncpy) ATTR_NONNULL(1);
+/**
+ * Use \a path as the cache directory returned by #BKE_appdir_folder_caches on all platforms,
+ * e.g. to keep tests out of the user's cache. Null restores the user cache directory.
+ */
+void BKE_appdir_folder_caches_override_set(const char *path);
 /**
  * Get a folder out of the \a folder_id presets for paths.
  *
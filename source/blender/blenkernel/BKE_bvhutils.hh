@@ -206,6 +206,17 @@ void free_bvhtree_from_editmesh(BVHTreeFromEditMesh *data);
  */
 void free_bvhtree_from_mesh(BVHTreeFromMesh *data);
 
+/**
+ * Find the nearest element of the tree for every position, using the default nearest callback
+ * of the tree type. Consecutive positions are traversed together, so coherent positions are
+ * fastest (see #BLI_bvhtree_find_nearest_batch).
+ *
+ * \param nearest: The index and distance have to be initialized and limit the search.
+ */
+void bvhtree_from_mesh_find_nearest_batch(const BVHTreeFromMesh &data,
+                                          blender::Span<blender::float3> positions,
+                                          blender::MutableSpan<BVHTreeNearest> nearest);
+
 /**
  * Math functions used by callbacks
  */
@@ -240,7 +251,23 @@ void free_bvhtree_from_pointcloud(BVHTreeFromPointCloud *data);
 
 bool bvhcache_has_tree(const BVHCache *bvh_cache, const BVHTree *tree);
 BVHCache *bvhcache_init();
+/**
+ * Tag the cached trees as outdated after the positions of the mesh changed (but not its topology).
+ * Trees that support it are refit on their next use instead of being rebuilt, others are freed.
+ */
+void bvhcache_tag_positions_changed(BVHCache *bvh_cache);
 /**
  * Frees a BVH-cache.
  */
 void bvhcache_free(BVHCache *bvh_cache);
+/**
+ * Frees a BVH-cache, but moves the trees that can be refit to \a stash first, where meshes with
+ * the same topology can take them (see #MeshRuntime::bvh_tree_stash). Trees of types that are
+ * stashed already are freed.
+ */
+void bvhcache_free_to_stash(BVHCache *bvh_cache, BVHCache *stash);
+/**
+ * Free the trees in \a stash which weren't taken since the last call, and mark the others as
+ * unused. Called once per evaluation, so trees nothing refits anymore aren't kept around.
+ */
+void bvhcache_stash_release_unused(BVHCache *stash);
@@ -45,6 +45,11 @@ enum {
    * data-blocks.
    */
   IDTYPE_FLAGS_NO_MEMFILE_UNDO = 1 << 5,
+  /**
+   * Indicates that the #IDTypeInfo.blend_write callback only accesses data owned by the given ID,
+   * so that several IDs of this type can be written to a file from different threads.
+   */
+  IDTYPE_FLAGS_PARALLEL_BLEND_WRITE = 1 << 6,
 };
 
 struct IDCacheKey {
@@ -39,6 +39,11 @@ void BKE_lattice_vert_coords_apply_with_mat4(Lattice *lt,
                                              const float (*vert_coords)[3],
                                              const float mat[4][4]);
 void BKE_lattice_vert_coords_apply(Lattice *lt, const float (*vert_coords)[3]);
+/**
+ * Make the points of the lattice mutable, they may be shared with copies of the lattice.
+ * Must be called before changing #Lattice::def in place.
+ */
+BPoint *BKE_lattice_points_for_write(Lattice *lt);
 void BKE_lattice_modifiers_calc(Depsgraph *depsgraph, Scene *scene, Object *ob);
 
 MDeformVert *BKE_lattice_deform_verts_get(const Object *oblatt);
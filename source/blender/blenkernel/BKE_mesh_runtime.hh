@@ -41,6 +41,12 @@ void BKE_mesh_runtime_clear_geometry(Mesh *mesh);
  */
 void BKE_mesh_runtime_clear_cache(Mesh *mesh);
 
+/**
+ * Free the BVH trees kept for meshes with the same topology that no mesh took since the last call
+ * (see #MeshRuntime::bvh_tree_stash). Called once per evaluation of the mesh.
+ */
+void BKE_mesh_runtime_release_unused_bvh_trees(Mesh *mesh);
+
 /* NOTE: the functions below are defined in DerivedMesh.cc, and are intended to be moved
  * to a more suitable location when that file is removed.
  * They should also be renamed to use conventions from BKE, not old DerivedMesh.cc.
@@ -131,6 +131,14 @@ struct MeshRuntime {
 
   /** Cache for BVH trees generated for the mesh. Defined in 'BKE_bvhutil.c' */
   BVHCache *bvh_cache = nullptr;
+  /**
+   * BVH trees which are not used by a mesh anymore, shared between meshes with the same topology.
+   * Evaluated meshes are new copies after every evaluation. When they are freed, their trees are
+   * kept here, so that the next copy can refit them to its positions instead of building new
+   * trees. See #bvhcache_free_to_stash. Trees that the next evaluation doesn't take are freed,
+   * see #BKE_mesh_runtime_release_unused_bvh_trees.
+   */
+  SharedCache<std::shared_ptr<BVHCache>> bvh_tree_stash;
 
   /** Cache of non-manifold boundary data for Shrink-wrap Target Project. */
   std::unique_ptr<ShrinkwrapBoundaryData> shrinkwrap_data;
@@ -48,6 +48,7 @@ struct PackedFile *BKE_packedfile_duplicate(const struct PackedFile *pf_src);
 struct PackedFile *BKE_packedfile_new(struct ReportList *reports,
                                       const char *filepath_rel,
                                       const char *basepath);
+/** Takes ownership of \a mem, which must be allocated with #MEM_mallocN. */
 struct PackedFile *BKE_packedfile_new_from_memory(void *mem, int memlen);
 
 /**
@@ -1453,6 +1453,10 @@ void makeDerivedMesh(Depsgraph *depsgraph,
     BKE_sculpt_update_object_before_eval(ob);
   }
 
+  /* The previous evaluated mesh was freed above and may have kept its BVH trees for this
+   * evaluation. Trees that the previous evaluation didn't take are not needed anymore. */
+  BKE_mesh_runtime_release_unused_bvh_trees(static_cast<Mesh *>(ob->data));
+
   /* NOTE: Access the `edit_mesh` after freeing the derived caches, so that `ob->data` is restored
    * to the pre-evaluated state. This is because the evaluated state is not necessarily sharing the
    * `edit_mesh` pointer with the input. For example, if the object is first evaluated in the
@@ -71,6 +71,8 @@ static struct {
   char temp_dirname_base[FILE_MAX];
   /** Volatile temporary directory (owned by Blender, removed on exit). */
   char temp_dirname_session[FILE_MAX];
+  /** Used instead of the user cache directory when set, see #BKE_appdir_folder_caches. */
+  char caches_dirname_override[FILE_MAX];
 } g_app{};
 
 /** \} */
@@ -205,6 +207,11 @@ bool BKE_appdir_folder_caches(char *path, const size_t path_maxncpy)
 {
   path[0] = '\0';
 
+  if (g_app.caches_dirname_override[0]) {
+    BLI_path_join(path, path_maxncpy, g_app.caches_dirname_override, SEP_STR);
+    return true;
+  }
+
   const char *caches_root_path = GHOST_getUserSpecialDir(GHOST_kUserSpecialDirCaches);
   if (caches_root_path == nullptr || !BLI_is_dir(caches_root_path)) {
     caches_root_path = BKE_tempdir_base();
@@ -225,6 +232,16 @@ bool BKE_appdir_folder_caches(char *path, const size_t path_maxncpy)
   return true;
 }
 
+void BKE_appdir_folder_caches_override_set(const char *path)
+{
+  if (path) {
+    STRNCPY(g_app.caches_dirname_override, path);
+  }
+  else {
+    g_app.caches_dirname_override[0] = '\0';
+  }
+}
+
 bool BKE_appdir_font_folder_default(char *dir, size_t dir_maxncpy)
 {
   char test_dir[FILE_MAXDIR];
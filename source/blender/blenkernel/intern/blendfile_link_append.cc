@@ -189,7 +189,7 @@ static BlendHandle *link_append_context_library_blohandle_ensure(
                                                &lib_context->bf_reports);
     }
     else {
-      blo_handle = BLO_blendhandle_from_file(libname, &lib_context->bf_reports);
+      blo_handle = BLO_blendhandle_from_file_indexed(libname, &lib_context->bf_reports, true);
     }
     lib_context->blo_handle = blo_handle;
     lib_context->blo_handle_is_owned = true;
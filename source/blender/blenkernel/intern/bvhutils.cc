@@ -20,6 +20,7 @@
 #include "BLI_math_vector.h"
 #include "BLI_span.hh"
 #include "BLI_task.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
@@ -46,9 +47,30 @@ using blender::VArray;
 
 struct BVHCacheItem {
   bool is_filled;
+  /**
+   * Positions changed but the topology didn't, so the tree can be refit on the next use instead
+   * of being rebuilt. Only used for types supported by #bvhtree_refit_from_mesh.
+   */
+  bool positions_dirty;
+  /**
+   * #BLI_bvhtree_get_surface_area_cost after balancing the tree, computed before the first refit
+   * (negative until then), so trees that are never refit don't pay for it.
+   */
+  float build_cost;
+  /**
+   * Only used for items in a stash, see #bvhcache_stash_release_unused: the tree wasn't taken
+   * since the last release and is freed by the next one.
+   */
+  bool stash_unused;
   BVHTree *tree;
 };
 
+/**
+ * Rebuild a refit tree when its cost grew by more than this factor since it was built,
+ * queries on it would become slower than the rebuild.
+ */
+#define BVHCACHE_REFIT_MAX_COST_FACTOR 2.0f
+
 struct BVHCache {
   BVHCacheItem items[BVHTREE_MAX_ITEM];
   ThreadMutex mutex;
@@ -85,7 +107,7 @@ static bool bvhcache_find(BVHCache **bvh_cache_p,
   }
   BVHCache *bvh_cache = *bvh_cache_p;
 
-  if (bvh_cache->items[type].is_filled) {
+  if (bvh_cache->items[type].is_filled && !bvh_cache->items[type].positions_dirty) {
     *r_tree = bvh_cache->items[type].tree;
     return true;
   }
@@ -142,6 +164,30 @@ static void bvhcache_insert(BVHCache *bvh_cache, BVHTree *tree, BVHCacheType typ
   BLI_assert(!item->is_filled);
   item->tree = tree;
   item->is_filled = true;
+  item->positions_dirty = false;
+  item->build_cost = -1.0f;
+}
+
+static bool bvhcache_type_supports_refit(const BVHCacheType type)
+{
+  return ELEM(type, BVHTREE_FROM_VERTS, BVHTREE_FROM_EDGES, BVHTREE_FROM_CORNER_TRIS);
+}
+
+void bvhcache_tag_positions_changed(BVHCache *bvh_cache)
+{
+  for (int index = 0; index < BVHTREE_MAX_ITEM; index++) {
+    BVHCacheItem *item = &bvh_cache->items[index];
+    if (!item->is_filled) {
+      continue;
+    }
+    if (bvhcache_type_supports_refit(BVHCacheType(index)) && item->tree != nullptr) {
+      item->positions_dirty = true;
+      continue;
+    }
+    BLI_bvhtree_free(item->tree);
+    item->tree = nullptr;
+    item->is_filled = false;
+  }
 }
 
 void bvhcache_free(BVHCache *bvh_cache)
@@ -155,6 +201,75 @@ void bvhcache_free(BVHCache *bvh_cache)
   MEM_freeN(bvh_cache);
 }
 
+void bvhcache_free_to_stash(BVHCache *bvh_cache, BVHCache *stash)
+{
+  BLI_mutex_lock(&stash->mutex);
+  for (int index = 0; index < BVHTREE_MAX_ITEM; index++) {
+    BVHCacheItem *item = &bvh_cache->items[index];
+    BVHCacheItem *stash_item = &stash->items[index];
+    if (item->tree == nullptr || !bvhcache_type_supports_refit(BVHCacheType(index)) ||
+        stash_item->is_filled)
+    {
+      continue;
+    }
+    /* The build cost is kept, it's still computed lazily from the bounds the tree was built with
+     * when it wasn't refit yet. */
+    *stash_item = *item;
+    stash_item->positions_dirty = true;
+    stash_item->stash_unused = false;
+    item->tree = nullptr;
+  }
+  BLI_mutex_unlock(&stash->mutex);
+  bvhcache_free(bvh_cache);
+}
+
+void bvhcache_stash_release_unused(BVHCache *stash)
+{
+  BLI_mutex_lock(&stash->mutex);
+  for (int index = 0; index < BVHTREE_MAX_ITEM; index++) {
+    BVHCacheItem *item = &stash->items[index];
+    if (!item->is_filled) {
+      continue;
+    }
+    if (item->stash_unused) {
+      BLI_bvhtree_free(item->tree);
+      *item = {};
+    }
+    else {
+      item->stash_unused = true;
+    }
+  }
+  BLI_mutex_unlock(&stash->mutex);
+}
+
+/**
+ * Move a tree of the given type from \a stash to the cache, when the cache doesn't have one yet.
+ * It's fit to the positions of another mesh, so it's refit on use.
+ * Must be called with the cache locked.
+ */
+static void bvhcache_take_from_stash(BVHCache *bvh_cache,
+                                     BVHCache *stash,
+                                     const BVHCacheType bvh_cache_type)
+{
+  BVHCacheItem *item = &bvh_cache->items[bvh_cache_type];
+  if (item->is_filled) {
+    return;
+  }
+  BLI_mutex_lock(&stash->mutex);
+  BVHCacheItem *stash_item = &stash->items[bvh_cache_type];
+  if (stash_item->is_filled) {
+    *item = *stash_item;
+    item->stash_unused = false;
+    *stash_item = {};
+  }
+  BLI_mutex_unlock(&stash->mutex);
+}
+
+struct BVHTreeBalanceData {
+  BVHTree *tree;
+  int flag;
+};
+
 /**
  * BVH-tree balancing inside a mutex lock must be run in isolation. Balancing
  * is multithreaded, and we do not want the current thread to start another task
@@ -162,17 +277,23 @@ void bvhcache_free(BVHCache *bvh_cache)
  */
 static void bvhtree_balance_isolated(void *userdata)
 {
-  BLI_bvhtree_balance((BVHTree *)userdata);
+  const BVHTreeBalanceData *data = static_cast<const BVHTreeBalanceData *>(userdata);
+  BLI_bvhtree_balance_ex(data->tree, data->flag);
 }
 
-static void bvhtree_balance(BVHTree *tree, const bool isolate)
+/**
+ * \param flag: #BVH_BALANCE_SAH is used for triangle trees, which are mostly used for ray-casts
+ * where a better tree is worth the extra build time.
+ */
+static void bvhtree_balance(BVHTree *tree, const bool isolate, const int flag = 0)
 {
   if (tree) {
     if (isolate) {
-      BLI_task_isolate(bvhtree_balance_isolated, tree);
+      BVHTreeBalanceData data = {tree, flag};
+      BLI_task_isolate(bvhtree_balance_isolated, &data);
     }
     else {
-      BLI_bvhtree_balance(tree);
+      BLI_bvhtree_balance_ex(tree, flag);
     }
   }
 }
@@ -1035,7 +1156,7 @@ BVHTree *bvhtree_from_editmesh_looptris_ex(BVHTreeFromEditMesh *data,
   BVHTree *tree = bvhtree_from_editmesh_corner_tris_create_tree(
       epsilon, tree_type, axis, em, corner_tris_mask, corner_tris_num_active);
 
-  bvhtree_balance(tree, false);
+  bvhtree_balance(tree, false, BVH_BALANCE_SAH);
 
   if (data) {
     bvhtree_from_editmesh_setup_data(tree, BVHTREE_FROM_EM_LOOPTRIS, data);
@@ -1068,7 +1189,7 @@ BVHTree *bvhtree_from_mesh_corner_tris_ex(BVHTreeFromMesh *data,
                                                             corner_tris_mask,
                                                             corner_tris_num_active);
 
-  bvhtree_balance(tree, false);
+  bvhtree_balance(tree, false, BVH_BALANCE_SAH);
 
   if (data) {
     /* Setup BVHTreeFromMesh */
@@ -1117,6 +1238,122 @@ static BitVector<> corner_tris_no_hidden_map_get(const blender::OffsetIndices<in
   return corner_tris_mask;
 }
 
+/**
+ * Update the leafs of a cached tree after the mesh positions changed, in the order they were
+ * inserted by the `*_create_tree` functions, then refit the branches.
+ *
+ * \return False when the tree doesn't match the mesh anymore and has to be rebuilt.
+ */
+static bool bvhtree_refit_from_mesh(BVHTree *tree,
+                                    const BVHCacheType bvh_cache_type,
+                                    const Span<float3> positions,
+                                    const Span<blender::int2> edges,
+                                    const Span<int> corner_verts,
+                                    const Span<int3> corner_tris)
+{
+  using namespace blender;
+  switch (bvh_cache_type) {
+    case BVHTREE_FROM_VERTS: {
+      if (BLI_bvhtree_get_len(tree) != positions.size()) {
+        return false;
+      }
+      threading::parallel_for(positions.index_range(), 4096, [&](const IndexRange range) {
+        for (const int i : range) {
+          BLI_bvhtree_update_node(tree, i, positions[i], nullptr, 1);
+        }
+      });
+      break;
+    }
+    case BVHTREE_FROM_EDGES: {
+      if (BLI_bvhtree_get_len(tree) != edges.size()) {
+        return false;
+      }
+      threading::parallel_for(edges.index_range(), 4096, [&](const IndexRange range) {
+        for (const int i : range) {
+          float co[2][3];
+          copy_v3_v3(co[0], positions[edges[i][0]]);
+          copy_v3_v3(co[1], positions[edges[i][1]]);
+          BLI_bvhtree_update_node(tree, i, co[0], nullptr, 2);
+        }
+      });
+      break;
+    }
+    case BVHTREE_FROM_CORNER_TRIS: {
+      if (BLI_bvhtree_get_len(tree) != corner_tris.size()) {
+        return false;
+      }
+      threading::parallel_for(corner_tris.index_range(), 4096, [&](const IndexRange range) {
+        for (const int i : range) {
+          float co[3][3];
+          copy_v3_v3(co[0], positions[corner_verts[corner_tris[i][0]]]);
+          copy_v3_v3(co[1], positions[corner_verts[corner_tris[i][1]]]);
+          copy_v3_v3(co[2], positions[corner_verts[corner_tris[i][2]]]);
+          BLI_bvhtree_update_node(tree, i, co[0], nullptr, 3);
+        }
+      });
+      break;
+    }
+    default:
+      return false;
+  }
+
+  BLI_bvhtree_update_tree(tree);
+  return true;
+}
+
+/**
+ * Refit the cached tree of a type tagged with #bvhcache_tag_positions_changed, or remove it from
+ * the cache when refitting isn't possible or degraded the tree too much.
+ * Must be called with the cache locked.
+ *
+ * \return True when the refit tree can be used.
+ */
+static bool bvhcache_refit(BVHCache *bvh_cache,
+                           const BVHCacheType bvh_cache_type,
+                           const Mesh &mesh,
+                           const Span<int3> corner_tris,
+                           const bool isolate)
+{
+  BVHCacheItem *item = &bvh_cache->items[bvh_cache_type];
+  if (!(item->is_filled && item->positions_dirty)) {
+    return false;
+  }
+
+  bool refit = false;
+  auto refit_fn = [&]() {
+    if (item->build_cost < 0.0f) {
+      /* The bounds are still the ones the tree was built with. */
+      item->build_cost = BLI_bvhtree_get_surface_area_cost(item->tree);
+    }
+    refit = bvhtree_refit_from_mesh(item->tree,
+                                    bvh_cache_type,
+                                    mesh.vert_positions(),
+                                    mesh.edges(),
+                                    mesh.corner_verts(),
+                                    corner_tris);
+  };
+  /* Same as balancing, refitting is multithreaded and runs inside the cache lock. */
+  if (isolate) {
+    blender::threading::isolate_task(refit_fn);
+  }
+  else {
+    refit_fn();
+  }
+
+  if (refit && BLI_bvhtree_get_surface_area_cost(item->tree) <=
+                   item->build_cost * BVHCACHE_REFIT_MAX_COST_FACTOR)
+  {
+    item->positions_dirty = false;
+    return true;
+  }
+
+  BLI_bvhtree_free(item->tree);
+  item->tree = nullptr;
+  item->is_filled = false;
+  item->positions_dirty = false;
+  return false;
+}
+
 BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
                                    const Mesh *mesh,
                                    const BVHCacheType bvh_cache_type,
@@ -1156,6 +1393,20 @@ BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
     return data->tree;
   }
 
+  /* A mesh with the same topology was freed, refit its tree to the positions of this mesh. */
+  if (bvhcache_type_supports_refit(bvh_cache_type) && mesh->runtime->bvh_tree_stash.is_cached()) {
+    bvhcache_take_from_stash(
+        *bvh_cache_p, mesh->runtime->bvh_tree_stash.data().get(), bvh_cache_type);
+  }
+
+  /* Only the positions changed since the tree was built, try refitting it. */
+  if (bvhcache_refit(*bvh_cache_p, bvh_cache_type, *mesh, corner_tris, lock_started)) {
+    data->tree = (*bvh_cache_p)->items[bvh_cache_type].tree;
+    data->cached = true;
+    bvhcache_unlock(*bvh_cache_p, lock_started);
+    return data->tree;
+  }
+
   /* Create BVHTree. */
 
   switch (bvh_cache_type) {
@@ -1218,7 +1469,9 @@ BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
       break;
   }
 
-  bvhtree_balance(data->tree, lock_started);
+  const bool is_corner_tris = ELEM(
+      bvh_cache_type, BVHTREE_FROM_CORNER_TRIS, BVHTREE_FROM_CORNER_TRIS_NO_HIDDEN);
+  bvhtree_balance(data->tree, lock_started, is_corner_tris ? BVH_BALANCE_SAH : 0);
 
   /* Save on cache for later use */
   // printf("BVHTree built and saved on cache\n");
@@ -1355,6 +1608,30 @@ void free_bvhtree_from_mesh(BVHTreeFromMesh *data)
   *data = {};
 }
 
+void bvhtree_from_mesh_find_nearest_batch(const BVHTreeFromMesh &data,
+                                          const blender::Span<blender::float3> positions,
+                                          blender::MutableSpan<BVHTreeNearest> nearest)
+{
+  using namespace blender;
+  if (data.nearest_callback == nullptr) {
+    /* Vertex trees: the nearest point on the bounds of a leaf is the vertex itself. */
+    BLI_bvhtree_find_nearest_batch(data.tree,
+                                   reinterpret_cast<const float(*)[3]>(positions.data()),
+                                   nearest.data(),
+                                   int(positions.size()),
+                                   nullptr,
+                                   nullptr);
+    return;
+  }
+  BLI_bvhtree_find_nearest_batch_cpp(
+      *data.tree,
+      positions,
+      nearest,
+      [&](const int index, const float3 &co, BVHTreeNearest &r_nearest) {
+        data.nearest_callback(const_cast<BVHTreeFromMesh *>(&data), index, co, &r_nearest);
+      });
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
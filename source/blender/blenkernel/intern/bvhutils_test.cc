@@ -0,0 +1,195 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+
+#include "BLI_array.hh"
+#include "BLI_math_vector.hh"
+#include "BLI_rand.hh"
+
+#include "BKE_bvhutils.hh"
+#include "BKE_idtype.hh"
+#include "BKE_lib_id.hh"
+#include "BKE_mesh.hh"
+#include "BKE_mesh_runtime.hh"
+#include "BKE_mesh_types.hh"
+
+#include "DNA_mesh_types.h"
+
+namespace blender::bke::tests {
+
+class BVHUtilsTest : public ::testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+};
+
+/** A grid of vertices without edges or faces. */
+static Mesh *create_point_grid_mesh(const int size)
+{
+  Mesh *mesh = BKE_mesh_new_nomain(size * size, 0, 0, 0);
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      positions[y * size + x] = float3(float(x), float(y), float((x * y) % 3));
+    }
+  }
+  return mesh;
+}
+
+TEST_F(BVHUtilsTest, SampleNearestMeshPoints)
+{
+  Mesh *mesh = create_point_grid_mesh(20);
+  const Span<float3> positions = mesh->vert_positions();
+
+  /* Vertex trees have no nearest point callback. */
+  BVHTreeFromMesh tree_data;
+  BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_VERTS, 2);
+  ASSERT_NE(tree_data.tree, nullptr);
+  EXPECT_EQ(tree_data.nearest_callback, nullptr);
+
+  RandomNumberGenerator rng(42);
+  Array<float3> samples(1000);
+  Array<BVHTreeNearest> nearest(samples.size());
+  for (const int i : samples.index_range()) {
+    samples[i] = float3(rng.get_float(), rng.get_float(), rng.get_float()) * 22.0f - 1.0f;
+    nearest[i].index = -1;
+    nearest[i].dist_sq = FLT_MAX;
+  }
+  bvhtree_from_mesh_find_nearest_batch(tree_data, samples, nearest);
+
+  for (const int i : samples.index_range()) {
+    float expected_dist_sq = FLT_MAX;
+    for (const float3 &position : positions) {
+      expected_dist_sq = std::min(expected_dist_sq, math::distance_squared(samples[i], position));
+    }
+    ASSERT_TRUE(positions.index_range().contains(nearest[i].index));
+    /* The bounds of the leafs are slightly larger than the vertices. */
+    EXPECT_NEAR(math::distance_squared(samples[i], positions[nearest[i].index]),
+                expected_dist_sq,
+                1e-4f);
+    EXPECT_NEAR(nearest[i].dist_sq, expected_dist_sq, 1e-4f);
+    EXPECT_V3_NEAR(nearest[i].co, positions[nearest[i].index], 1e-5f);
+  }
+
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh);
+}
+
+static void expect_nearest_vertices(const BVHTreeFromMesh &tree_data, const Span<float3> positions)
+{
+  for (const int i : positions.index_range()) {
+    BVHTreeNearest nearest;
+    nearest.index = -1;
+    nearest.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree_data.tree, positions[i], &nearest, nullptr, nullptr);
+    EXPECT_EQ(nearest.index, i);
+  }
+}
+
+TEST_F(BVHUtilsTest, RefitAfterPositionsChanged)
+{
+  Mesh *mesh = create_point_grid_mesh(40);
+
+  BVHTreeFromMesh tree_data;
+  const BVHTree *tree = BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_VERTS, 2);
+  free_bvhtree_from_mesh(&tree_data);
+
+  /* Moving all positions coherently only refits the cached tree. */
+  for (float3 &position : mesh->vert_positions_for_write()) {
+    position = position * 2.0f + float3(1.0f, 0.0f, 0.5f);
+  }
+  mesh->tag_positions_changed();
+  EXPECT_EQ(BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_VERTS, 2), tree);
+  expect_nearest_vertices(tree_data, mesh->vert_positions());
+  free_bvhtree_from_mesh(&tree_data);
+
+  /* Scrambling the positions degrades the refit tree, so it's rebuilt. Either way the queries
+   * have to find the new positions. */
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  std::reverse(positions.begin(), positions.end());
+  mesh->tag_positions_changed();
+  BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_VERTS, 2);
+  expect_nearest_vertices(tree_data, mesh->vert_positions());
+  free_bvhtree_from_mesh(&tree_data);
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(BVHUtilsTest, RefitTreeOfPreviousEvaluation)
+{
+  Mesh *mesh_orig = create_point_grid_mesh(40);
+
+  /* Evaluated meshes are new copies of the original mesh, with moved positions in every frame. */
+  auto evaluate_frame = [&](const float frame) {
+    Mesh *mesh_eval = BKE_mesh_copy_for_eval(mesh_orig);
+    for (float3 &position : mesh_eval->vert_positions_for_write()) {
+      position += float3(frame, 0.0f, frame * 0.5f);
+    }
+    mesh_eval->tag_positions_changed();
+    return mesh_eval;
+  };
+
+  Mesh *mesh_eval = evaluate_frame(1.0f);
+  BVHTreeFromMesh tree_data;
+  const BVHTree *tree = BKE_bvhtree_from_mesh_get(&tree_data, mesh_eval, BVHTREE_FROM_VERTS, 2);
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh_eval);
+
+  /* The tree is kept for other meshes with the same topology. */
+  const BVHCache *stash = mesh_orig->runtime->bvh_tree_stash.data().get();
+  EXPECT_TRUE(bvhcache_has_tree(stash, tree));
+
+  /* The next frame takes the tree and refits it instead of building a new one. */
+  BKE_mesh_runtime_release_unused_bvh_trees(mesh_orig);
+  mesh_eval = evaluate_frame(2.0f);
+  EXPECT_EQ(BKE_bvhtree_from_mesh_get(&tree_data, mesh_eval, BVHTREE_FROM_VERTS, 2), tree);
+  EXPECT_FALSE(bvhcache_has_tree(stash, tree));
+  EXPECT_TRUE(bvhcache_has_tree(mesh_eval->runtime->bvh_cache, tree));
+  expect_nearest_vertices(tree_data, mesh_eval->vert_positions());
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh_eval);
+
+  /* Changing the topology of the original mesh stops sharing the trees. */
+  mesh_orig->tag_topology_changed();
+  mesh_eval = evaluate_frame(3.0f);
+  EXPECT_NE(BKE_bvhtree_from_mesh_get(&tree_data, mesh_eval, BVHTREE_FROM_VERTS, 2), tree);
+  expect_nearest_vertices(tree_data, mesh_eval->vert_positions());
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh_eval);
+
+  BKE_id_free(nullptr, mesh_orig);
+}
+
+TEST_F(BVHUtilsTest, ReleaseUnusedStashedTrees)
+{
+  Mesh *mesh_orig = create_point_grid_mesh(20);
+
+  Mesh *mesh_eval = BKE_mesh_copy_for_eval(mesh_orig);
+  BVHTreeFromMesh tree_data;
+  const BVHTree *tree = BKE_bvhtree_from_mesh_get(&tree_data, mesh_eval, BVHTREE_FROM_VERTS, 2);
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh_eval);
+
+  const BVHCache *stash = mesh_orig->runtime->bvh_tree_stash.data().get();
+  EXPECT_TRUE(bvhcache_has_tree(stash, tree));
+
+  /* The evaluation after the tree was stashed can still take it. */
+  BKE_mesh_runtime_release_unused_bvh_trees(mesh_orig);
+  EXPECT_TRUE(bvhcache_has_tree(stash, tree));
+
+  /* When that evaluation didn't take it, nothing uses the tree anymore. */
+  mesh_eval = BKE_mesh_copy_for_eval(mesh_orig);
+  BKE_id_free(nullptr, mesh_eval);
+  BKE_mesh_runtime_release_unused_bvh_trees(mesh_orig);
+  EXPECT_FALSE(bvhcache_has_tree(stash, tree));
+
+  BKE_id_free(nullptr, mesh_orig);
+}
+
+}  // namespace blender::bke::tests
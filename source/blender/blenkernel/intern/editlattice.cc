@@ -15,6 +15,7 @@
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
 
+#include "BLI_implicit_sharing.hh"
 #include "BLI_listbase.h"
 #include "BLI_math_vector.h"
 
@@ -30,9 +31,7 @@ void BKE_editlattice_free(Object *ob)
   if (lt->editlatt) {
     Lattice *editlt = lt->editlatt->latt;
 
-    if (editlt->def) {
-      MEM_freeN(editlt->def);
-    }
+    blender::implicit_sharing::free_shared_data(&editlt->def, &editlt->def_sharing_info);
     if (editlt->dvert) {
       BKE_defvert_array_free(editlt->dvert, editlt->pntsu * editlt->pntsv * editlt->pntsw);
     }
@@ -56,7 +55,13 @@ void BKE_editlattice_make(Object *obedit)
   }
   lt->editlatt = static_cast<EditLatt *>(MEM_callocN(sizeof(EditLatt), "editlatt"));
   lt->editlatt->latt = static_cast<Lattice *>(MEM_dupallocN(lt));
+  /* The edit lattice is changed in place, so it doesn't share the points. */
   lt->editlatt->latt->def = static_cast<BPoint *>(MEM_dupallocN(lt->def));
+  lt->editlatt->latt->def_sharing_info = nullptr;
+  if (lt->def) {
+    lt->editlatt->latt->def_sharing_info = blender::implicit_sharing::info_for_mem_free(
+        lt->editlatt->latt->def);
+  }
 
   if (lt->dvert) {
     int tot = lt->pntsu * lt->pntsv * lt->pntsw;
@@ -81,9 +86,10 @@ void BKE_editlattice_load(Object *obedit)
   lt = static_cast<Lattice *>(obedit->data);
   editlt = lt->editlatt->latt;
 
-  MEM_freeN(lt->def);
+  blender::implicit_sharing::free_shared_data(&lt->def, &lt->def_sharing_info);
 
   lt->def = static_cast<BPoint *>(MEM_dupallocN(editlt->def));
+  lt->def_sharing_info = blender::implicit_sharing::info_for_mem_free(lt->def);
 
   lt->flag = editlt->flag;
 
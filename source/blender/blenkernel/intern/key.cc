@@ -1613,7 +1613,8 @@ float *BKE_key_evaluate_object_ex(
       case ID_LT: {
         Lattice *lattice = (Lattice *)obdata;
         const int totpoint = min_ii(tot, lattice->pntsu * lattice->pntsv * lattice->pntsw);
-        keyblock_data_convert_to_lattice((const float(*)[3])out, lattice->def, totpoint);
+        keyblock_data_convert_to_lattice(
+            (const float(*)[3])out, BKE_lattice_points_for_write(lattice), totpoint);
         break;
       }
       case ID_CU_LEGACY: {
@@ -2008,7 +2009,7 @@ static void keyblock_data_convert_to_lattice(const float (*fp)[3],
 
 void BKE_keyblock_convert_to_lattice(const KeyBlock *kb, Lattice *lt)
 {
-  BPoint *bp = lt->def;
+  BPoint *bp = BKE_lattice_points_for_write(lt);
   const float(*fp)[3] = static_cast<const float(*)[3]>(kb->data);
   const int tot = min_ii(kb->totelem, lt->pntsu * lt->pntsv * lt->pntsw);
 
@@ -14,6 +14,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_bitmap.h"
+#include "BLI_implicit_sharing.hh"
 #include "BLI_listbase.h"
 #include "BLI_math_matrix.h"
 #include "BLI_math_vector.h"
@@ -58,6 +59,7 @@ static void lattice_init_data(ID *id)
   MEMCPY_STRUCT_AFTER(lattice, DNA_struct_default_get(Lattice), id);
 
   lattice->def = static_cast<BPoint *>(MEM_callocN(sizeof(BPoint), "lattvert")); /* temporary */
+  lattice->def_sharing_info = blender::implicit_sharing::info_for_mem_free(lattice->def);
   BKE_lattice_resize(lattice, 2, 2, 2, nullptr); /* creates a uniform lattice */
 }
 
@@ -66,7 +68,10 @@ static void lattice_copy_data(Main *bmain, ID *id_dst, const ID *id_src, const i
   Lattice *lattice_dst = (Lattice *)id_dst;
   const Lattice *lattice_src = (const Lattice *)id_src;
 
-  lattice_dst->def = static_cast<BPoint *>(MEM_dupallocN(lattice_src->def));
+  blender::implicit_sharing::copy_shared_pointer(lattice_src->def,
+                                                 lattice_src->def_sharing_info,
+                                                 &lattice_dst->def,
+                                                 &lattice_dst->def_sharing_info);
 
   if (lattice_src->key && (flag & LIB_ID_COPY_SHAPEKEY)) {
     BKE_id_copy_ex(bmain, &lattice_src->key->id, (ID **)&lattice_dst->key, flag);
@@ -95,7 +100,7 @@ static void lattice_free_data(ID *id)
 
   BLI_freelistN(&lattice->vertex_group_names);
 
-  MEM_SAFE_FREE(lattice->def);
+  blender::implicit_sharing::free_shared_data(&lattice->def, &lattice->def_sharing_info);
   if (lattice->dvert) {
     BKE_defvert_array_free(lattice->dvert, lattice->pntsu * lattice->pntsv * lattice->pntsw);
     lattice->dvert = nullptr;
@@ -103,9 +108,7 @@ static void lattice_free_data(ID *id)
   if (lattice->editlatt) {
     Lattice *editlt = lattice->editlatt->latt;
 
-    if (editlt->def) {
-      MEM_freeN(editlt->def);
-    }
+    blender::implicit_sharing::free_shared_data(&editlt->def, &editlt->def_sharing_info);
     if (editlt->dvert) {
       BKE_defvert_array_free(editlt->dvert, lattice->pntsu * lattice->pntsv * lattice->pntsw);
     }
@@ -135,6 +138,7 @@ static void lattice_blend_write(BlendWriter *writer, ID *id, const void *id_addr
   /* Clean up, important in undo case to reduce false detection of changed datablocks. */
   lt->editlatt = nullptr;
   lt->batch_cache = nullptr;
+  lt->def_sharing_info = nullptr;
 
   /* write LibData */
   BLO_write_id_struct(writer, Lattice, id_address, &lt->id);
@@ -151,6 +155,9 @@ static void lattice_blend_read_data(BlendDataReader *reader, ID *id)
 {
   Lattice *lt = (Lattice *)id;
   BLO_read_data_address(reader, &lt->def);
+  if (lt->def) {
+    lt->def_sharing_info = blender::implicit_sharing::info_for_mem_free(lt->def);
+  }
 
   BLO_read_data_address(reader, &lt->dvert);
   BKE_defvert_blend_read(reader, lt->pntsu * lt->pntsv * lt->pntsw, lt->dvert);
@@ -365,9 +372,10 @@ void BKE_lattice_resize(Lattice *lt, int uNew, int vNew, int wNew, Object *ltOb)
   lt->pntsw = wNew;
 
   lt->actbp = LT_ACTBP_NONE;
-  MEM_freeN(lt->def);
+  blender::implicit_sharing::free_shared_data(&lt->def, &lt->def_sharing_info);
   lt->def = static_cast<BPoint *>(
       MEM_callocN(lt->pntsu * lt->pntsv * lt->pntsw * sizeof(BPoint), "lattice bp"));
+  lt->def_sharing_info = blender::implicit_sharing::info_for_mem_free(lt->def);
 
   bp = lt->def;
 
@@ -399,7 +407,7 @@ void outside_lattice(Lattice *lt)
   float fac1, du = 0.0, dv = 0.0, dw = 0.0;
 
   if (lt->flag & LT_OUTSIDE) {
-    bp = lt->def;
+    bp = BKE_lattice_points_for_write(lt);
 
     if (lt->pntsu > 1) {
       du = 1.0f / float(lt->pntsu - 1);
@@ -459,7 +467,7 @@ void outside_lattice(Lattice *lt)
     }
   }
   else {
-    bp = lt->def;
+    bp = BKE_lattice_points_for_write(lt);
 
     for (w = 0; w < lt->pntsw; w++) {
       for (v = 0; v < lt->pntsv; v++) {
@@ -493,19 +501,28 @@ void BKE_lattice_vert_coords_apply_with_mat4(Lattice *lt,
                                              const float mat[4][4])
 {
   int i, numVerts = lt->pntsu * lt->pntsv * lt->pntsw;
+  BPoint *points = BKE_lattice_points_for_write(lt);
   for (i = 0; i < numVerts; i++) {
-    mul_v3_m4v3(lt->def[i].vec, mat, vert_coords[i]);
+    mul_v3_m4v3(points[i].vec, mat, vert_coords[i]);
   }
 }
 
 void BKE_lattice_vert_coords_apply(Lattice *lt, const float (*vert_coords)[3])
 {
   const int vert_len = lt->pntsu * lt->pntsv * lt->pntsw;
+  BPoint *points = BKE_lattice_points_for_write(lt);
   for (int i = 0; i < vert_len; i++) {
-    copy_v3_v3(lt->def[i].vec, vert_coords[i]);
+    copy_v3_v3(points[i].vec, vert_coords[i]);
   }
 }
 
+BPoint *BKE_lattice_points_for_write(Lattice *lt)
+{
+  blender::implicit_sharing::make_trivial_data_mutable(
+      &lt->def, &lt->def_sharing_info, lt->pntsu * lt->pntsv * lt->pntsw);
+  return lt->def;
+}
+
 void BKE_lattice_modifiers_calc(Depsgraph *depsgraph, Scene *scene, Object *ob)
 {
   BKE_object_free_derived_caches(ob);
@@ -629,7 +646,7 @@ std::optional<blender::Bounds<blender::float3>> BKE_lattice_minmax(const Lattice
 
 void BKE_lattice_transform(Lattice *lt, const float mat[4][4], bool do_keys)
 {
-  BPoint *bp = lt->def;
+  BPoint *bp = BKE_lattice_points_for_write(lt);
   int i = lt->pntsu * lt->pntsv * lt->pntsw;
 
   while (i--) {
@@ -654,8 +671,9 @@ void BKE_lattice_translate(Lattice *lt, const float offset[3], bool do_keys)
   numVerts = lt->pntsu * lt->pntsv * lt->pntsw;
 
   if (lt->def) {
+    BPoint *points = BKE_lattice_points_for_write(lt);
     for (i = 0; i < numVerts; i++) {
-      add_v3_v3(lt->def[i].vec, offset);
+      add_v3_v3(points[i].vec, offset);
     }
   }
 
@@ -55,6 +55,33 @@ static void free_bvh_cache(MeshRuntime &mesh_runtime)
   }
 }
 
+/**
+ * Keep the trees that can be refit for other meshes with the same topology, see
+ * #MeshRuntime::bvh_tree_stash. Only valid when the topology didn't change since the trees were
+ * built. Without other meshes sharing the stash, nothing could take the trees and they are freed.
+ */
+static void free_bvh_cache_to_stash(MeshRuntime &mesh_runtime)
+{
+  if (!mesh_runtime.bvh_tree_stash.is_shared()) {
+    free_bvh_cache(mesh_runtime);
+    return;
+  }
+  if (mesh_runtime.bvh_cache) {
+    mesh_runtime.bvh_tree_stash.ensure([](std::shared_ptr<BVHCache> &stash) {
+      stash = std::shared_ptr<BVHCache>(bvhcache_init(), bvhcache_free);
+    });
+    bvhcache_free_to_stash(mesh_runtime.bvh_cache, mesh_runtime.bvh_tree_stash.data().get());
+    mesh_runtime.bvh_cache = nullptr;
+  }
+}
+
+static void tag_bvh_cache_positions_changed(MeshRuntime &mesh_runtime)
+{
+  if (mesh_runtime.bvh_cache) {
+    bvhcache_tag_positions_changed(mesh_runtime.bvh_cache);
+  }
+}
+
 static void free_batch_cache(MeshRuntime &mesh_runtime)
 {
   if (mesh_runtime.batch_cache) {
@@ -68,7 +95,7 @@ MeshRuntime::MeshRuntime() = default;
 MeshRuntime::~MeshRuntime()
 {
   free_mesh_eval(*this);
-  free_bvh_cache(*this);
+  free_bvh_cache_to_stash(*this);
   free_batch_cache(*this);
 }
 
@@ -286,10 +313,18 @@ void BKE_mesh_runtime_clear_cache(Mesh *mesh)
   BKE_mesh_runtime_clear_geometry(mesh);
 }
 
+void BKE_mesh_runtime_release_unused_bvh_trees(Mesh *mesh)
+{
+  if (mesh->runtime->bvh_tree_stash.is_cached()) {
+    bvhcache_stash_release_unused(mesh->runtime->bvh_tree_stash.data().get());
+  }
+}
+
 void BKE_mesh_runtime_clear_geometry(Mesh *mesh)
 {
   /* Tagging shared caches dirty will free the allocated data if there is only one user. */
   free_bvh_cache(*mesh->runtime);
+  mesh->runtime->bvh_tree_stash.tag_dirty();
   mesh->runtime->subdiv_ccg.reset();
   mesh->runtime->bounds_cache.tag_dirty();
   mesh->runtime->vert_to_face_offset_cache.tag_dirty();
@@ -314,6 +349,7 @@ void Mesh::tag_edges_split()
 {
   /* Triangulation didn't change because vertex positions and loop vertex indices didn't change. */
   free_bvh_cache(*this->runtime);
+  this->runtime->bvh_tree_stash.tag_dirty();
   this->runtime->vert_normals_cache.tag_dirty();
   this->runtime->subdiv_ccg.reset();
   this->runtime->vert_to_face_offset_cache.tag_dirty();
@@ -367,7 +403,7 @@ void Mesh::tag_positions_changed()
 
 void Mesh::tag_positions_changed_no_normals()
 {
-  free_bvh_cache(*this->runtime);
+  tag_bvh_cache_positions_changed(*this->runtime);
   this->runtime->corner_tris_cache.tag_dirty();
   this->runtime->bounds_cache.tag_dirty();
 }
@@ -375,7 +411,7 @@ void Mesh::tag_positions_changed_no_normals()
 void Mesh::tag_positions_changed_uniformly()
 {
   /* The normals and triangulation didn't change, since all verts moved by the same amount. */
-  free_bvh_cache(*this->runtime);
+  tag_bvh_cache_positions_changed(*this->runtime);
   this->runtime->bounds_cache.tag_dirty();
 }
 
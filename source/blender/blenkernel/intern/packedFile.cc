@@ -26,6 +26,7 @@
 #include "DNA_volume_types.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_implicit_sharing.hh"
 #include "BLI_utildefines.h"
 
 #include "BKE_image.h"
@@ -149,7 +150,12 @@ void BKE_packedfile_free(PackedFile *pf)
   if (pf) {
     BLI_assert(pf->data != nullptr);
 
-    MEM_SAFE_FREE(pf->data);
+    if (pf->sharing_info) {
+      blender::implicit_sharing::free_shared_data(&pf->data, &pf->sharing_info);
+    }
+    else {
+      MEM_SAFE_FREE(pf->data);
+    }
     MEM_freeN(pf);
   }
   else {
@@ -165,7 +171,16 @@ PackedFile *BKE_packedfile_duplicate(const PackedFile *pf_src)
   PackedFile *pf_dst;
 
   pf_dst = static_cast<PackedFile *>(MEM_dupallocN(pf_src));
-  pf_dst->data = MEM_dupallocN(pf_src->data);
+  if (pf_src->sharing_info) {
+    /* The data is never modified, so it is shared with the copy instead of duplicating
+     * potentially big packed images, fonts and sounds for every copy of their IDs. */
+    blender::implicit_sharing::copy_shared_pointer(
+        pf_src->data, pf_src->sharing_info, &pf_dst->data, &pf_dst->sharing_info);
+  }
+  else {
+    pf_dst->data = MEM_dupallocN(pf_src->data);
+    pf_dst->sharing_info = blender::implicit_sharing::info_for_mem_free(pf_dst->data);
+  }
 
   return pf_dst;
 }
@@ -177,6 +192,7 @@ PackedFile *BKE_packedfile_new_from_memory(void *mem, int memlen)
   PackedFile *pf = static_cast<PackedFile *>(MEM_callocN(sizeof(*pf), "PackedFile"));
   pf->data = mem;
   pf->size = memlen;
+  pf->sharing_info = blender::implicit_sharing::info_for_mem_free(mem);
 
   return pf;
 }
@@ -885,7 +901,9 @@ void BKE_packedfile_blend_write(BlendWriter *writer, PackedFile *pf)
   if (pf == nullptr) {
     return;
   }
-  BLO_write_struct(writer, PackedFile, pf);
+  PackedFile pf_copy = *pf;
+  pf_copy.sharing_info = nullptr;
+  BLO_write_struct_at_address(writer, PackedFile, pf, &pf_copy);
   BLO_write_raw(writer, pf->size, pf->data);
 }
 
@@ -903,5 +921,9 @@ void BKE_packedfile_blend_read(BlendDataReader *reader, PackedFile **pf_p)
      * the whole code assumes this is not possible. See #70315. */
     printf("%s: nullptr packedfile data, cleaning up...\n", __func__);
     MEM_SAFE_FREE(pf);
+    return;
   }
+  /* The sharing info is always written as null, see #BKE_packedfile_blend_write. */
+  BLI_assert(pf->sharing_info == nullptr);
+  pf->sharing_info = blender::implicit_sharing::info_for_mem_free(pf->data);
 }
@@ -0,0 +1,69 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ * \brief Multi-threaded search of duplicate points, shared by the spatial search structures.
+ *
+ * The duplicate search of #BLI_kdtree_3d_calc_duplicates_fast goes over the points one after
+ * another, and merges all points within range of a point which was not merged itself. Gathering
+ * the points within range of every point (the candidates) in parallel, and only resolving them in
+ * order afterwards, gives the same result: a candidate is only skipped once it was merged, and
+ * merged points never become candidates again.
+ */
+
+#include "BLI_compiler_attrs.h"
+#include "BLI_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** State of the search of a single point, passed to #DuplicatesGatherFn. */
+typedef struct DuplicatesSearch DuplicatesSearch;
+
+/**
+ * Return the index of the point stored as \a item in the search structure, which is the index
+ * into the `duplicates` array.
+ */
+typedef int (*DuplicatesItemIndexFn)(const void *userdata, int item);
+/**
+ * Call #BLI_duplicates_search_add for the indices of all points within range of the point stored
+ * as \a item. The point itself may be added as well.
+ */
+typedef void (*DuplicatesGatherFn)(const void *userdata, int item, DuplicatesSearch *search);
+
+/**
+ * Add a point within range of the searched point. Points which can not be merged are ignored.
+ */
+void BLI_duplicates_search_add(DuplicatesSearch *search, int index) ATTR_NONNULL(1);
+
+/**
+ * Multi-threaded search for duplicates, see #BLI_kdtree_3d_calc_duplicates_fast for the meaning
+ * of \a duplicates and the number of merges written to \a r_found.
+ *
+ * \param items_num: The number of points in the search structure. They are gathered in chunks of
+ * consecutive items, so items close to each other in space should be close in this order too.
+ * \param order: The items in the order the points are merged, entries set to -1 are skipped.
+ * When null, the points are merged in item order.
+ *
+ * \return False when the search was not done: when there are too few points to benefit from
+ * threading, or when there are too many candidates to store them all because the range is large
+ * compared to the distance between the points. \a duplicates is not changed in that case, and the
+ * caller is expected to do the search on a single thread.
+ */
+bool BLI_calc_duplicates_parallel(int items_num,
+                                  const int *order,
+                                  int order_len,
+                                  DuplicatesItemIndexFn item_index_fn,
+                                  DuplicatesGatherFn gather_fn,
+                                  const void *userdata,
+                                  int *duplicates,
+                                  int *r_found) ATTR_NONNULL(4, 5, 7, 8);
+
+#ifdef __cplusplus
+}
+#endif
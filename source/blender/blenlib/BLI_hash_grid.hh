@@ -0,0 +1,150 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A uniform grid for finding points within a fixed distance of each other. Only cells containing
+ * points are stored, by grouping the points by a hash of their cell. Building the grid is a
+ * parallel counting sort, so it scales linearly with the number of points, unlike a KD-tree.
+ */
+
+#include "BLI_array.hh"
+#include "BLI_index_mask_fwd.hh"
+#include "BLI_math_vector.hh"
+#include "BLI_offset_indices.hh"
+
+namespace blender {
+
+class PointHashGrid {
+ private:
+  /** Cell coordinates are clamped to this range to avoid integer overflow. */
+  static constexpr int max_cell_coord = 1 << 21;
+
+  float3 origin_ = float3(0.0f);
+  float cell_size_ = 1.0f;
+  float cell_size_inv_ = 1.0f;
+  /** The number of buckets minus one, used to compute the bucket of a cell hash. */
+  uint64_t buckets_mask_ = 0;
+  /** Groups of points with the same cell hash. The number of buckets is a power of two. */
+  Array<int> bucket_offsets_data_;
+  /** Indices of the points in bucket order, sorted by index within each bucket. */
+  Array<int> sorted_indices_;
+  /** Positions in the same order as #sorted_indices_, for better locality while searching. */
+  Array<float3> sorted_positions_;
+
+ public:
+  PointHashGrid() = default;
+  /**
+   * \param cell_size: The range of the searches the grid is optimized for. Larger searches visit
+   * more cells. The cell size may be increased for very small values, to keep the number of
+   * cells across the bounds of the points below #max_cell_coord.
+   */
+  PointHashGrid(Span<float3> positions, const IndexMask &mask, float cell_size);
+
+  float cell_size() const
+  {
+    return cell_size_;
+  }
+
+  /** Indices of the points in the order they are stored in the grid. */
+  Span<int> sorted_indices() const
+  {
+    return sorted_indices_;
+  }
+
+  Span<float3> sorted_positions() const
+  {
+    return sorted_positions_;
+  }
+
+  /**
+   * Call \a fn with the index, position and squared distance of every point within \a range of
+   * \a position.
+   */
+  template<typename Fn>
+  void foreach_point_in_range(const float3 &position, float range, const Fn &fn) const;
+
+  /**
+   * Find points within \a range of each other, see #BLI_kdtree_3d_calc_duplicates_fast with
+   * `use_index_order` enabled for the meaning of \a duplicates and the return value.
+   * Points are searched in the order of their indices, so the result doesn't depend on the
+   * layout of the grid.
+   *
+   * \param duplicates: Indexed by point index, large enough for all points in the grid.
+   */
+  int calc_duplicates(float range, MutableSpan<int> duplicates) const;
+
+ private:
+  OffsetIndices<int> bucket_offsets() const
+  {
+    return bucket_offsets_data_.as_span();
+  }
+
+  int3 cell_coord(const float3 &position) const
+  {
+    const float3 co = (position - origin_) * cell_size_inv_;
+    /* Written so that NaN coordinates end up in the first cell. */
+    return int3(int(std::min(float(max_cell_coord), std::max(0.0f, co.x))),
+                int(std::min(float(max_cell_coord), std::max(0.0f, co.y))),
+                int(std::min(float(max_cell_coord), std::max(0.0f, co.z))));
+  }
+
+  int bucket_index(const int3 &cell) const
+  {
+    return int(cell.hash() & buckets_mask_);
+  }
+};
+
+template<typename Fn>
+inline void PointHashGrid::foreach_point_in_range(const float3 &position,
+                                                  const float range,
+                                                  const Fn &fn) const
+{
+  if (sorted_indices_.is_empty()) {
+    return;
+  }
+  const OffsetIndices<int> buckets = this->bucket_offsets();
+  const float range_sq = range * range;
+  const int3 cell_min = this->cell_coord(position - float3(range));
+  const int3 cell_max = this->cell_coord(position + float3(range));
+  const int3 cells_num = cell_max - cell_min + 1;
+  if (int64_t(cells_num.x) * int64_t(cells_num.y) * int64_t(cells_num.z) >=
+      int64_t(sorted_indices_.size()))
+  {
+    /* The range is large compared to the cell size, checking all points is faster. */
+    for (const int i : sorted_positions_.index_range()) {
+      const float3 &co = sorted_positions_[i];
+      const float dist_sq = math::distance_squared(position, co);
+      if (dist_sq <= range_sq) {
+        fn(sorted_indices_[i], co, dist_sq);
+      }
+    }
+    return;
+  }
+  int3 cell;
+  for (cell.z = cell_min.z; cell.z <= cell_max.z; cell.z++) {
+    for (cell.y = cell_min.y; cell.y <= cell_max.y; cell.y++) {
+      for (cell.x = cell_min.x; cell.x <= cell_max.x; cell.x++) {
+        for (const int i : buckets[this->bucket_index(cell)]) {
+          const float3 &co = sorted_positions_[i];
+          const float dist_sq = math::distance_squared(position, co);
+          /* Written so that NaN distances are skipped. */
+          if (!(dist_sq <= range_sq)) {
+            continue;
+          }
+          /* Other cells can share the bucket, only report each point once. */
+          if (this->cell_coord(co) != cell) {
+            continue;
+          }
+          fn(sorted_indices_[i], co, dist_sq);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace blender
@@ -80,6 +80,11 @@ enum {
    * pair once, rather than twice in different order as usual. */
   BVH_OVERLAP_SELF = (1 << 2),
 };
+enum {
+  /* Choose the split axis of branches using the surface area heuristic,
+   * slower to build but gives faster ray-casts on uneven geometry (only for axis 6, 8, 14, 26). */
+  BVH_BALANCE_SAH = (1 << 0),
+};
 enum {
   /* Use a priority queue to process nodes in the optimal order (for slow callbacks) */
   BVH_NEAREST_OPTIMAL_ORDER = (1 << 0),
@@ -107,6 +112,34 @@ typedef void (*BVHTree_RayCastCallback)(void *userdata,
                                         const BVHTreeRay *ray,
                                         BVHTreeRayHit *hit);
 
+/**
+ * Callback for batched nearest point queries, called once per leaf for all points of a packet
+ * that may be closer to it than their current nearest result.
+ *
+ * \param co, nearest: The points of the packet and their results.
+ * \param co_indices: Indices into \a co and \a nearest of the points to test.
+ */
+typedef void (*BVHTree_NearestPointBatchCallback)(void *userdata,
+                                                  int index,
+                                                  const float (*co)[3],
+                                                  BVHTreeNearest *nearest,
+                                                  const int *co_indices,
+                                                  int co_indices_num);
+
+/**
+ * Callback for batched ray-casts, called once per leaf for all rays of a packet reaching its
+ * bounds. Must update the hits in the same way as #BVHTree_RayCastCallback.
+ *
+ * \param rays, hits: The rays of the packet and their hits.
+ * \param ray_indices: Indices into \a rays and \a hits of the rays to test.
+ */
+typedef void (*BVHTree_RayCastBatchCallback)(void *userdata,
+                                             int index,
+                                             const BVHTreeRay *rays,
+                                             BVHTreeRayHit *hits,
+                                             const int *ray_indices,
+                                             int ray_indices_num);
+
 /**
  * Callback to check if 2 nodes overlap (use thread if intersection results need to be stored).
  */
@@ -157,6 +190,10 @@ void BLI_bvhtree_free(BVHTree *tree);
  */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
 void BLI_bvhtree_balance(BVHTree *tree);
+/**
+ * \param flag: #BVH_BALANCE_SAH.
+ */
+void BLI_bvhtree_balance_ex(BVHTree *tree, int flag);
 
 /**
  * Update: first update points/nodes, then call update_tree to refit the bounding volumes.
@@ -213,6 +250,15 @@ int *BLI_bvhtree_intersect_plane(const BVHTree *tree, float plane[4], uint *r_in
  * mainly useful for asserts functions to check we added the correct number.
  */
 int BLI_bvhtree_get_len(const BVHTree *tree);
+/**
+ * Estimate of the cost of queries on the tree: the sum of the surface areas of all branches,
+ * relative to the root. It grows when a tree is refit after large deformations, so it can be used
+ * to decide when the tree should be rebuilt instead.
+ *
+ * \note Only for trees with axis aligned bounds (6, 8, 14 or 26 axes), returns zero otherwise.
+ */
+float BLI_bvhtree_get_surface_area_cost(const BVHTree *tree);
+
 /**
  * Maximum number of children that a node can have.
  */
@@ -291,6 +337,36 @@ void BLI_bvhtree_ray_cast_all(const BVHTree *tree,
                               BVHTree_RayCastCallback callback,
                               void *userdata);
 
+/**
+ * Batched version of #BLI_bvhtree_find_nearest, traversing the tree with packets of consecutive
+ * points to share the node visits between them, so spatially coherent input is fastest.
+ *
+ * \param nearest: Array of \a co_num results, the distance and index have to be initialized
+ * (as for #BLI_bvhtree_find_nearest_ex) and limit the search.
+ */
+void BLI_bvhtree_find_nearest_batch(const BVHTree *tree,
+                                    const float (*co)[3],
+                                    BVHTreeNearest *nearest,
+                                    int co_num,
+                                    BVHTree_NearestPointBatchCallback callback,
+                                    void *userdata);
+
+/**
+ * Batched version of #BLI_bvhtree_ray_cast_ex, traversing the tree with packets of consecutive
+ * rays to share the node visits between them, so coherent rays are fastest.
+ *
+ * \param rays: Array of \a rays_num rays with normalized directions.
+ * \param hits: Array of \a rays_num hits, the distance and index have to be initialized
+ * (as for #BLI_bvhtree_ray_cast_ex) and limit the search.
+ */
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const BVHTreeRay *rays,
+                                BVHTreeRayHit *hits,
+                                int rays_num,
+                                BVHTree_RayCastBatchCallback callback,
+                                void *userdata,
+                                int flag);
+
 float BLI_bvhtree_bb_raycast(const float bv[6],
                              const float light_start[3],
                              const float light_end[3],
@@ -346,6 +422,7 @@ extern const float bvhtree_kdop_axes[13][3];
 
 #  include "BLI_function_ref.hh"
 #  include "BLI_math_vector.hh"
+#  include "BLI_span.hh"
 
 namespace blender {
 
@@ -372,6 +449,74 @@ inline void BLI_bvhtree_ray_cast_all_cpp(const BVHTree &tree,
       &fn);
 }
 
+/**
+ * Batched ray-cast, see #BLI_bvhtree_ray_cast_batch.
+ *
+ * \param fn: Ray intersection with the primitive of a leaf, with the same role as
+ * #BVHTree_RayCastCallback: `void fn(int index, const BVHTreeRay &ray, BVHTreeRayHit &hit)`.
+ * It's called in a loop over the rays of a packet, so it can be inlined.
+ */
+template<typename Fn>
+inline void BLI_bvhtree_ray_cast_batch_cpp(const BVHTree &tree,
+                                           const Span<BVHTreeRay> rays,
+                                           MutableSpan<BVHTreeRayHit> hits,
+                                           const Fn &fn,
+                                           const int flag = BVH_RAYCAST_DEFAULT)
+{
+  BLI_assert(rays.size() == hits.size());
+  BLI_bvhtree_ray_cast_batch(
+      &tree,
+      rays.data(),
+      hits.data(),
+      int(rays.size()),
+      [](void *userdata,
+         const int index,
+         const BVHTreeRay *rays,
+         BVHTreeRayHit *hits,
+         const int *ray_indices,
+         const int ray_indices_num) {
+        const Fn &fn = *static_cast<const Fn *>(userdata);
+        for (int i = 0; i < ray_indices_num; i++) {
+          fn(index, rays[ray_indices[i]], hits[ray_indices[i]]);
+        }
+      },
+      const_cast<Fn *>(&fn),
+      flag);
+}
+
+/**
+ * Batched nearest point query, see #BLI_bvhtree_find_nearest_batch.
+ *
+ * \param fn: Nearest point on the primitive of a leaf, with the same role as
+ * #BVHTree_NearestPointCallback: `void fn(int index, const float3 &co, BVHTreeNearest &nearest)`.
+ * It's called in a loop over the points of a packet, so it can be inlined.
+ */
+template<typename Fn>
+inline void BLI_bvhtree_find_nearest_batch_cpp(const BVHTree &tree,
+                                               const Span<float3> co,
+                                               MutableSpan<BVHTreeNearest> nearest,
+                                               const Fn &fn)
+{
+  BLI_assert(co.size() == nearest.size());
+  BLI_bvhtree_find_nearest_batch(
+      &tree,
+      reinterpret_cast<const float(*)[3]>(co.data()),
+      nearest.data(),
+      int(co.size()),
+      [](void *userdata,
+         const int index,
+         const float(*co)[3],
+         BVHTreeNearest *nearest,
+         const int *co_indices,
+         const int co_indices_num) {
+        const Fn &fn = *static_cast<const Fn *>(userdata);
+        for (int i = 0; i < co_indices_num; i++) {
+          fn(index, float3(co[co_indices[i]]), nearest[co_indices[i]]);
+        }
+      },
+      const_cast<Fn *>(&fn));
+}
+
 using BVHTree_RangeQuery_CPP = FunctionRef<void(int index, const float3 &co, float dist_sq)>;
 
 inline void BLI_bvhtree_range_query_cpp(const BVHTree &tree,
@@ -79,6 +79,32 @@ void *BLI_mempool_as_arrayN(BLI_mempool *pool,
                             const char *allocstr) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT
     ATTR_NONNULL(1, 2);
 
+/**
+ * Chunk access, to process the elements of a pool in bulk (see `BLI_mempool.hh`).
+ * Like the iterator, these require the #BLI_MEMPOOL_ALLOW_ITER flag.
+ */
+
+/** Number of chunks currently allocated by the pool. */
+int BLI_mempool_chunks_len(const BLI_mempool *pool) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+/** Number of elements that fit into a single chunk. */
+int BLI_mempool_chunk_capacity(const BLI_mempool *pool) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+/**
+ * Fill in \a chunks with all chunks of the pool, in iteration order.
+ *
+ * \param chunks: array of pointers at least the size of #BLI_mempool_chunks_len.
+ */
+void BLI_mempool_chunks_as_table(BLI_mempool *pool, struct BLI_mempool_chunk **chunks)
+    ATTR_NONNULL(1, 2);
+/**
+ * Fill in \a r_elems with the used elements of a chunk, in memory order.
+ *
+ * \param r_elems: array of pointers at least the size of #BLI_mempool_chunk_capacity.
+ * \return The number of used elements.
+ */
+int BLI_mempool_chunk_used_elems(BLI_mempool *pool,
+                                 struct BLI_mempool_chunk *chunk,
+                                 void **r_elems) ATTR_NONNULL(1, 2, 3);
+
 #ifndef NDEBUG
 void BLI_mempool_set_memory_debug(void);
 #endif
@@ -0,0 +1,97 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * C++ utilities to process the elements of a #BLI_mempool a chunk at a time. Compared to
+ * stepping through the pool with #BLI_mempool_iterstep, this avoids the per-element overhead of
+ * the iterator, gives the compiler a simple loop over a span of elements, and makes it possible to
+ * split the work between threads without any synchronization between them.
+ *
+ * All functions require the #BLI_MEMPOOL_ALLOW_ITER flag. The pool must not be modified while it
+ * is processed.
+ *
+ * \code{.cc}
+ * mempool::parallel_for_each<BMVert>(bm->vpool, 1024, [&](BMVert &v) { ... });
+ * \endcode
+ */
+
+#include "BLI_array.hh"
+#include "BLI_function_ref.hh"
+#include "BLI_index_range.hh"
+#include "BLI_mempool.h"
+#include "BLI_span.hh"
+
+namespace blender::mempool {
+
+/**
+ * A snapshot of the chunks of a pool, to access them by index.
+ */
+class ChunksView {
+ private:
+  BLI_mempool *pool_;
+  Array<BLI_mempool_chunk *> chunks_;
+  int chunk_capacity_;
+
+ public:
+  explicit ChunksView(BLI_mempool *pool);
+
+  int64_t size() const
+  {
+    return chunks_.size();
+  }
+
+  IndexRange index_range() const
+  {
+    return chunks_.index_range();
+  }
+
+  /** The maximum number of elements in a chunk. */
+  int chunk_capacity() const
+  {
+    return chunk_capacity_;
+  }
+
+  /**
+   * Gather the used elements of a chunk, in memory order.
+   * \param buffer: Storage for at least #chunk_capacity pointers, the returned span refers to it.
+   */
+  Span<void *> used_elems(int64_t chunk_index, MutableSpan<void *> buffer) const;
+
+  /**
+   * Hint the CPU to start loading the beginning of the chunk into the cache. Chunks are separate
+   * allocations, so the hardware prefetcher can't predict the jump to the next chunk.
+   */
+  void prefetch(int64_t chunk_index) const;
+};
+
+/**
+ * Call \a fn with the used elements of every chunk of the pool. Chunks are distributed over
+ * multiple threads, the elements of a chunk are always processed by the same thread.
+ *
+ * \param grain_size: The approximate number of elements (used or not) that is processed by a
+ * single task. It is rounded to whole chunks.
+ */
+void parallel_for_each_chunk(BLI_mempool *pool,
+                             int64_t grain_size,
+                             FunctionRef<void(Span<void *> elems)> fn);
+
+/**
+ * Call \a fn for every used element of the pool, possibly in parallel.
+ * See #parallel_for_each_chunk.
+ */
+template<typename T, typename Fn>
+inline void parallel_for_each(BLI_mempool *pool, const int64_t grain_size, const Fn &fn)
+{
+  parallel_for_each_chunk(pool, grain_size, [&](const Span<void *> elems) {
+    for (void *elem : elems) {
+      fn(*static_cast<T *>(elem));
+    }
+  });
+}
+
+}  // namespace blender::mempool
@@ -101,6 +101,14 @@ template<typename T> class SharedCache {
   {
     return cache_->mutex.is_cached();
   }
+
+  /**
+   * Return true if the cache is shared with other objects.
+   */
+  bool is_shared() const
+  {
+    return !cache_.unique();
+  }
 };
 
 }  // namespace blender
@@ -0,0 +1,154 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A directed acyclic graph of tasks that is executed on multiple threads, while respecting the
+ * dependencies between the tasks. Unlike the C task graph in `BLI_task.h`, the graph only stores
+ * its structure: the work of a node is done by a callback that gets the index of the node. That
+ * way the same graph can be executed many times, for any subset of its nodes, without allocating
+ * anything per node.
+ *
+ * Of all nodes whose dependencies are finished, the node with the highest priority is started
+ * first. Using the length of the longest path to the end of the graph as priority (see
+ * #TaskGraph::set_critical_path_priorities) makes sure that long chains of dependent nodes are
+ * started as early as possible, which reduces the total time when there are more ready nodes than
+ * threads.
+ *
+ * \code{.cc}
+ * TaskGraph graph(4, {{0, 1}, {0, 2}, {1, 3}, {2, 3}});
+ * graph.set_critical_path_priorities(costs);
+ * graph.execute(IndexRange(4), [&](const int node) { evaluate(node); });
+ * \endcode
+ */
+
+#include <atomic>
+
+#include "BLI_array.hh"
+#include "BLI_function_ref.hh"
+#include "BLI_index_mask_fwd.hh"
+#include "BLI_math_vector_types.hh"
+#include "BLI_offset_indices.hh"
+
+namespace blender::threading {
+
+class TaskGraph {
+ public:
+  struct NodeTiming {
+    /** Start and end of the execution of the node, in seconds since the start of #execute. */
+    double start = 0.0;
+    double end = 0.0;
+    /** Index of the thread in the task arena that executed the node. */
+    int thread = -1;
+  };
+
+  struct ExecuteSettings {
+    /**
+     * Run every node in an isolated region (see #isolate_task), so that a thread waiting for
+     * multi-threaded work done inside a node doesn't start other nodes of the graph in the
+     * meantime. That is necessary when nodes hold locks while doing multi-threaded work.
+     */
+    bool isolate = true;
+    /** Execute all nodes on the calling thread, still in order of priority. */
+    bool single_threaded = false;
+    /** Record the time and thread of every executed node, see #timings. */
+    bool capture_timings = false;
+  };
+
+ private:
+  int nodes_num_ = 0;
+  Array<int> successor_offsets_data_;
+  Array<int> successors_;
+  /** All nodes ordered so that every node comes after all its predecessors. */
+  Array<int> topological_order_;
+  Array<float> priorities_;
+  Array<NodeTiming> timings_;
+  std::atomic<bool> is_cancelled_ = false;
+
+ public:
+  TaskGraph() = default;
+  /**
+   * \param edges: Pairs of node indices, the second node can only be executed after the first.
+   * Edges must not form cycles. Duplicate edges are allowed.
+   */
+  TaskGraph(int nodes_num, Span<int2> edges);
+
+  TaskGraph(const TaskGraph &other) = delete;
+  TaskGraph &operator=(const TaskGraph &other) = delete;
+
+  int nodes_num() const
+  {
+    return nodes_num_;
+  }
+
+  /** The nodes that depend on the given node. */
+  Span<int> successors(const int node) const
+  {
+    return successors_.as_span().slice(OffsetIndices<int>(successor_offsets_data_)[node]);
+  }
+
+  Span<int> topological_order() const
+  {
+    return topological_order_;
+  }
+
+  Span<float> priorities() const
+  {
+    return priorities_;
+  }
+
+  /** Nodes with a higher priority are started first. All priorities are zero by default. */
+  void set_priorities(Span<float> priorities);
+
+  /**
+   * Set the priority of every node to the sum of the costs along the most expensive path from the
+   * node to the end of the graph, including the cost of the node itself.
+   * \param costs: The expected execution time of every node, in any unit.
+   */
+  void set_critical_path_priorities(Span<float> costs);
+
+  /**
+   * Call \a fn for every node in \a mask, after it was called for all predecessors of the node
+   * that are in the mask as well. Nodes outside of the mask are considered to be finished already.
+   * The graph must not be executed on multiple threads at the same time.
+   *
+   * \return False when the execution was cancelled, then \a fn may not have been called for some
+   * of the nodes.
+   */
+  bool execute(const IndexMask &mask,
+               FunctionRef<void(int node)> fn,
+               const ExecuteSettings &settings);
+  bool execute(const IndexMask &mask, const FunctionRef<void(int node)> fn)
+  {
+    return this->execute(mask, fn, ExecuteSettings());
+  }
+
+  /**
+   * Don't start any more nodes in the current execution. Nodes that are running already are not
+   * interrupted. Can be called from any thread, usually from within a node.
+   */
+  void cancel()
+  {
+    is_cancelled_.store(true, std::memory_order_relaxed);
+  }
+
+  bool is_cancelled() const
+  {
+    return is_cancelled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Timings of the nodes executed by the last call to #execute with
+   * #ExecuteSettings::capture_timings enabled. Nodes that were not executed have no thread.
+   */
+  Span<NodeTiming> timings() const
+  {
+    return timings_;
+  }
+};
+
+}  // namespace blender::threading
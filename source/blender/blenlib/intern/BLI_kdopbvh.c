@@ -23,12 +23,16 @@
  *   #BLI_bvhtree_range_query
  */
 
+#include <string.h>
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_alloca.h"
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_math_bits.h"
 #include "BLI_math_geom.h"
+#include "BLI_simd.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
@@ -55,6 +59,14 @@
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
 #endif
 
+/* Nodes with more leafs than this refit and partition their leafs on multiple threads,
+ * otherwise the first levels of the tree are built on a single thread. */
+#ifndef NDEBUG
+#  define KDOPBVH_THREAD_PARTITION_THRESHOLD 256
+#else
+#  define KDOPBVH_THREAD_PARTITION_THRESHOLD (1 << 16)
+#endif
+
 /* -------------------------------------------------------------------- */
 /** \name Struct Definitions
  * \{ */
@@ -373,14 +385,16 @@ static void create_kdop_hull(
 /**
  * \note depends on the fact that the BVH's for each face is already built
  */
-static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int end)
+static void refit_kdop_hull_bv(const BVHTree *tree, float *__restrict bv, int start, int end)
 {
   float newmin, newmax;
-  float *__restrict bv = node->bv;
   int j;
   axis_t axis_iter;
 
-  node_minmax_init(tree, node);
+  for (axis_iter = tree->start_axis; axis_iter != tree->stop_axis; axis_iter++) {
+    bv[(2 * axis_iter)] = FLT_MAX;
+    bv[(2 * axis_iter) + 1] = -FLT_MAX;
+  }
 
   for (j = start; j < end; j++) {
     float *__restrict node_bv = tree->nodes[j]->bv;
@@ -400,6 +414,11 @@ static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int e
   }
 }
 
+static void refit_kdop_hull(const BVHTree *tree, BVHNode *node, int start, int end)
+{
+  refit_kdop_hull_bv(tree, node->bv, start, end);
+}
+
 /**
  * Only supports x,y,z axis in the moment
  * but we should use a plain and simple function here for speed sake.
@@ -681,10 +700,435 @@ static void split_leafs(BVHNode **leafs_array,
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Parallel Node Building
+ *
+ * The first levels of the tree only have a few branches, each of them covering many leafs.
+ * Multi-threading over the branches of a level doesn't help there, so for large branches
+ * the leafs are processed in chunks on multiple threads instead.
+ *
+ * Partitioning first scatters the leafs into bins along the split axis (keeping the order
+ * of leafs within a bin), after which only the bins containing a split position need to be
+ * partitioned with #partition_nth_element.
+ * \{ */
+
+#define KDOPBVH_PARTITION_BINS 1024
+#define KDOPBVH_SAH_BINS 16
+
+typedef struct BVHSahBin {
+  int count;
+  float bv[6];
+} BVHSahBin;
+
+typedef struct BVHChunkData {
+  const BVHTree *tree;
+  BVHNode **leafs_array;
+  BVHNode **leafs_temp;
+  int begin, end;
+  int chunk_size;
+
+  /* Binning along #axis. */
+  int axis;
+  float key_min, key_scale;
+  int bins_num;
+
+  /** Bounding volume per chunk, `2 * BVHTree.stop_axis` floats each. */
+  float *chunk_bv;
+  /** Leaf count per bin and chunk, turned into scatter offsets after counting. */
+  int *chunk_bin_offsets;
+  /** Surface area heuristic bins per chunk, for the 3 main axes. */
+  BVHSahBin *chunk_sah_bins;
+} BVHChunkData;
+
+static int bvh_chunks_num(const int begin, const int end, int *r_chunk_size)
+{
+  const int len = end - begin;
+  const int chunk_size = max_ii(KDOPBVH_THREAD_PARTITION_THRESHOLD / 4, len / 256);
+  *r_chunk_size = chunk_size;
+  return (len + chunk_size - 1) / chunk_size;
+}
+
+static void bvh_chunk_range(const BVHChunkData *data, const int chunk, int *r_begin, int *r_end)
+{
+  *r_begin = data->begin + chunk * data->chunk_size;
+  *r_end = min_ii(*r_begin + data->chunk_size, data->end);
+}
+
+BLI_INLINE int bvh_bin_index(const float key,
+                             const float key_min,
+                             const float key_scale,
+                             const int bins_num)
+{
+  const float f = (key - key_min) * key_scale;
+  /* Also catches NAN. */
+  if (!(f > 0.0f)) {
+    return 0;
+  }
+  return min_ii((int)f, bins_num - 1);
+}
+
+static void bvh_bin_range_init(BVHChunkData *data, const float *bv, const int axis)
+{
+  const float key_min = bv[axis - 1];
+  const float key_range = bv[axis] - key_min;
+  data->axis = axis;
+  data->key_min = key_min;
+  data->key_scale = (key_range > 0.0f) ? (float)data->bins_num / key_range : 0.0f;
+}
+
+static void bvh_refit_chunk_cb(void *__restrict userdata,
+                               const int chunk,
+                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHChunkData *data = userdata;
+  int begin, end;
+  bvh_chunk_range(data, chunk, &begin, &end);
+  float *chunk_bv = &data->chunk_bv[chunk * 2 * data->tree->stop_axis];
+  refit_kdop_hull_bv(data->tree, chunk_bv, begin, end);
+}
+
+/**
+ * Same as #refit_kdop_hull, refitting chunks of leafs on multiple threads for large ranges.
+ */
+static void refit_kdop_hull_parallel(const BVHTree *tree, BVHNode *node, int start, int end)
+{
+  if (end - start < KDOPBVH_THREAD_PARTITION_THRESHOLD) {
+    refit_kdop_hull(tree, node, start, end);
+    return;
+  }
+
+  BVHChunkData data = {
+      .tree = tree,
+      .leafs_array = tree->nodes,
+      .begin = start,
+      .end = end,
+  };
+  const int chunks_num = bvh_chunks_num(start, end, &data.chunk_size);
+  data.chunk_bv = MEM_mallocN(sizeof(float) * (size_t)(chunks_num * 2 * tree->stop_axis),
+                              __func__);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_range(0, chunks_num, &data, bvh_refit_chunk_cb, &settings);
+
+  float *__restrict bv = node->bv;
+  for (axis_t axis_iter = tree->start_axis; axis_iter != tree->stop_axis; axis_iter++) {
+    float newmin = FLT_MAX, newmax = -FLT_MAX;
+    for (int chunk = 0; chunk < chunks_num; chunk++) {
+      const float *chunk_bv = &data.chunk_bv[chunk * 2 * tree->stop_axis];
+      newmin = min_ff(newmin, chunk_bv[2 * axis_iter]);
+      newmax = max_ff(newmax, chunk_bv[(2 * axis_iter) + 1]);
+    }
+    bv[2 * axis_iter] = newmin;
+    bv[(2 * axis_iter) + 1] = newmax;
+  }
+
+  MEM_freeN(data.chunk_bv);
+}
+
+static void bvh_partition_count_chunk_cb(void *__restrict userdata,
+                                         const int chunk,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHChunkData *data = userdata;
+  int *counts = &data->chunk_bin_offsets[chunk * KDOPBVH_PARTITION_BINS];
+  int begin, end;
+  bvh_chunk_range(data, chunk, &begin, &end);
+
+  memset(counts, 0, sizeof(int) * KDOPBVH_PARTITION_BINS);
+  for (int i = begin; i < end; i++) {
+    const float key = data->leafs_array[i]->bv[data->axis];
+    counts[bvh_bin_index(key, data->key_min, data->key_scale, KDOPBVH_PARTITION_BINS)]++;
+  }
+}
+
+static void bvh_partition_scatter_chunk_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHChunkData *data = userdata;
+  int *offsets = &data->chunk_bin_offsets[chunk * KDOPBVH_PARTITION_BINS];
+  int begin, end;
+  bvh_chunk_range(data, chunk, &begin, &end);
+
+  for (int i = begin; i < end; i++) {
+    BVHNode *leaf = data->leafs_array[i];
+    const float key = leaf->bv[data->axis];
+    data->leafs_temp[offsets[bvh_bin_index(
+        key, data->key_min, data->key_scale, KDOPBVH_PARTITION_BINS)]++] = leaf;
+  }
+}
+
+static void bvh_partition_copy_chunk_cb(void *__restrict userdata,
+                                        const int chunk,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHChunkData *data = userdata;
+  int begin, end;
+  bvh_chunk_range(data, chunk, &begin, &end);
+  memcpy(&data->leafs_array[begin],
+         &data->leafs_temp[begin],
+         sizeof(BVHNode *) * (size_t)(end - begin));
+}
+
+/**
+ * Same as #split_leafs, binning large ranges of leafs on multiple threads first.
+ *
+ * \param bv: The bounds of all leafs in the range, used to map the keys to bins.
+ * \param leafs_temp: Scratch buffer for scattering, indexed like \a leafs_array.
+ */
+static void split_leafs_parallel(const BVHTree *tree,
+                                 BVHNode **leafs_array,
+                                 BVHNode **leafs_temp,
+                                 const int nth[],
+                                 const int partitions,
+                                 const int split_axis,
+                                 const float *bv)
+{
+  const int begin = nth[0];
+  const int end = nth[partitions];
+  if (end - begin < KDOPBVH_THREAD_PARTITION_THRESHOLD || leafs_temp == NULL) {
+    split_leafs(leafs_array, nth, partitions, split_axis);
+    return;
+  }
+
+  BVHChunkData data = {
+      .tree = tree,
+      .leafs_array = leafs_array,
+      .leafs_temp = leafs_temp,
+      .begin = begin,
+      .end = end,
+      .bins_num = KDOPBVH_PARTITION_BINS,
+  };
+  bvh_bin_range_init(&data, bv, split_axis);
+  const int chunks_num = bvh_chunks_num(begin, end, &data.chunk_size);
+  data.chunk_bin_offsets = MEM_mallocN(
+      sizeof(int) * (size_t)(chunks_num * KDOPBVH_PARTITION_BINS), __func__);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_range(0, chunks_num, &data, bvh_partition_count_chunk_cb, &settings);
+
+  /* Turn the counts into offsets, bins are stored consecutively and within a bin the
+   * leafs of each chunk keep their order. */
+  int bin_start[KDOPBVH_PARTITION_BINS + 1];
+  int offset = begin;
+  for (int bin = 0; bin < KDOPBVH_PARTITION_BINS; bin++) {
+    bin_start[bin] = offset;
+    for (int chunk = 0; chunk < chunks_num; chunk++) {
+      int *chunk_offset = &data.chunk_bin_offsets[chunk * KDOPBVH_PARTITION_BINS + bin];
+      const int count = *chunk_offset;
+      *chunk_offset = offset;
+      offset += count;
+    }
+  }
+  bin_start[KDOPBVH_PARTITION_BINS] = end;
+  BLI_assert(offset == end);
+
+  BLI_task_parallel_range(0, chunks_num, &data, bvh_partition_scatter_chunk_cb, &settings);
+  BLI_task_parallel_range(0, chunks_num, &data, bvh_partition_copy_chunk_cb, &settings);
+
+  MEM_freeN(data.chunk_bin_offsets);
+
+  /* Every bin holds larger keys than the bins before it,
+   * only the bins containing a split position remain to be partitioned. */
+  int bin = 0;
+  for (int i = 0; i < partitions - 1; i++) {
+    if (nth[i] >= end) {
+      break;
+    }
+    const int n = nth[i + 1];
+    if (n >= end) {
+      break;
+    }
+    while (bin_start[bin + 1] <= n) {
+      bin++;
+    }
+    partition_nth_element(
+        leafs_array, max_ii(nth[i], bin_start[bin]), bin_start[bin + 1], n, split_axis);
+  }
+}
+
+BLI_INLINE float bvh_sah_area(const float bv[6])
+{
+  const float dx = bv[1] - bv[0];
+  const float dy = bv[3] - bv[2];
+  const float dz = bv[5] - bv[4];
+  if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+    return 0.0f;
+  }
+  return dx * dy + dy * dz + dz * dx;
+}
+
+static void bvh_sah_bins_init(BVHSahBin *bins, const int bins_num)
+{
+  for (int i = 0; i < bins_num; i++) {
+    bins[i].count = 0;
+    for (int j = 0; j < 6; j += 2) {
+      bins[i].bv[j] = FLT_MAX;
+      bins[i].bv[j + 1] = -FLT_MAX;
+    }
+  }
+}
+
+BLI_INLINE void bvh_sah_bv_expand(float bv[6], const float other[6])
+{
+  for (int j = 0; j < 6; j += 2) {
+    bv[j] = min_ff(bv[j], other[j]);
+    bv[j + 1] = max_ff(bv[j + 1], other[j + 1]);
+  }
+}
+
+/** Fill #KDOPBVH_SAH_BINS bins for each of the 3 main axes with the leafs in a range. */
+static void bvh_sah_bins_fill(BVHSahBin *bins,
+                              BVHNode **leafs_array,
+                              const int begin,
+                              const int end,
+                              const float *parent_bv)
+{
+  float key_min[3], key_scale[3];
+  for (int axis_index = 0; axis_index < 3; axis_index++) {
+    const float range = parent_bv[axis_index * 2 + 1] - parent_bv[axis_index * 2];
+    key_min[axis_index] = parent_bv[axis_index * 2];
+    key_scale[axis_index] = (range > 0.0f) ? (float)KDOPBVH_SAH_BINS / range : 0.0f;
+  }
+
+  bvh_sah_bins_init(bins, KDOPBVH_SAH_BINS * 3);
+  for (int i = begin; i < end; i++) {
+    const float *leaf_bv = leafs_array[i]->bv;
+    for (int axis_index = 0; axis_index < 3; axis_index++) {
+      BVHSahBin *bin = &bins[axis_index * KDOPBVH_SAH_BINS +
+                             bvh_bin_index(leaf_bv[axis_index * 2 + 1],
+                                           key_min[axis_index],
+                                           key_scale[axis_index],
+                                           KDOPBVH_SAH_BINS)];
+      bin->count++;
+      bvh_sah_bv_expand(bin->bv, leaf_bv);
+    }
+  }
+}
+
+typedef struct BVHSahChunkData {
+  BVHChunkData chunk;
+  const float *parent_bv;
+} BVHSahChunkData;
+
+static void bvh_sah_bins_chunk_cb(void *__restrict userdata,
+                                  const int chunk,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHSahChunkData *data = userdata;
+  int begin, end;
+  bvh_chunk_range(&data->chunk, chunk, &begin, &end);
+  bvh_sah_bins_fill(&data->chunk.chunk_sah_bins[chunk * KDOPBVH_SAH_BINS * 3],
+                    data->chunk.leafs_array,
+                    begin,
+                    end,
+                    data->parent_bv);
+}
+
+/**
+ * Choose the split axis using the surface area heuristic.
+ *
+ * The implicit tree layout fixes how many leafs each child gets, so only the axis is chosen:
+ * for each of the 3 main axes the leafs are binned by their key, and the cost of the split is
+ * estimated as the sum of the child surface areas weighted by their leaf counts.
+ *
+ * \note Only valid for trees that store the axis aligned bounds, see #BVHTree.start_axis.
+ */
+static char bvh_sah_split_axis(const BVHTree *tree,
+                               BVHNode **leafs_array,
+                               const int nth[],
+                               const int partitions,
+                               const float *parent_bv)
+{
+  const int begin = nth[0];
+  const int end = nth[partitions];
+  BVHSahBin bins[KDOPBVH_SAH_BINS * 3];
+
+  if (end - begin < KDOPBVH_THREAD_PARTITION_THRESHOLD) {
+    bvh_sah_bins_fill(bins, leafs_array, begin, end, parent_bv);
+  }
+  else {
+    BVHSahChunkData data = {
+        .chunk =
+            {
+                .tree = tree,
+                .leafs_array = leafs_array,
+                .begin = begin,
+                .end = end,
+            },
+        .parent_bv = parent_bv,
+    };
+    const int chunks_num = bvh_chunks_num(begin, end, &data.chunk.chunk_size);
+    data.chunk.chunk_sah_bins = MEM_mallocN(
+        sizeof(BVHSahBin) * (size_t)(chunks_num * KDOPBVH_SAH_BINS * 3), __func__);
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    BLI_task_parallel_range(0, chunks_num, &data, bvh_sah_bins_chunk_cb, &settings);
+
+    bvh_sah_bins_init(bins, KDOPBVH_SAH_BINS * 3);
+    for (int chunk = 0; chunk < chunks_num; chunk++) {
+      const BVHSahBin *chunk_bins = &data.chunk.chunk_sah_bins[chunk * KDOPBVH_SAH_BINS * 3];
+      for (int i = 0; i < KDOPBVH_SAH_BINS * 3; i++) {
+        bins[i].count += chunk_bins[i].count;
+        bvh_sah_bv_expand(bins[i].bv, chunk_bins[i].bv);
+      }
+    }
+    MEM_freeN(data.chunk.chunk_sah_bins);
+  }
+
+  /* Start with the largest axis, so it's kept when the costs are equal. */
+  const char largest_axis = get_largest_axis(parent_bv);
+  char best_axis = largest_axis;
+  float best_cost = FLT_MAX;
+
+  for (int axis_step = 0; axis_step < 3; axis_step++) {
+    const int axis_index = ((largest_axis / 2) + axis_step) % 3;
+    const BVHSahBin *axis_bins = &bins[axis_index * KDOPBVH_SAH_BINS];
+    float cost = 0.0f;
+
+    /* The bins overlapping each child's range of sorted leafs give an estimate of its bounds. */
+    int bin = 0, bin_end = begin + axis_bins[0].count;
+    for (int i = 0; i < partitions && nth[i] < end; i++) {
+      const int child_begin = nth[i];
+      const int child_end = min_ii(nth[i + 1], end);
+      float child_bv[6] = {FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX};
+
+      while (bin_end <= child_begin) {
+        bin++;
+        bin_end += axis_bins[bin].count;
+      }
+      int child_bin = bin, child_bin_end = bin_end;
+      bvh_sah_bv_expand(child_bv, axis_bins[child_bin].bv);
+      while (child_bin_end < child_end) {
+        child_bin++;
+        child_bin_end += axis_bins[child_bin].count;
+        bvh_sah_bv_expand(child_bv, axis_bins[child_bin].bv);
+      }
+      cost += bvh_sah_area(child_bv) * (float)(child_end - child_begin);
+    }
+
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_axis = (char)(axis_index * 2 + 1);
+    }
+  }
+
+  return best_axis;
+}
+
+/** \} */
+
 typedef struct BVHDivNodesData {
   const BVHTree *tree;
   BVHNode *branches_array;
   BVHNode **leafs_array;
+  /** Scratch buffer for #split_leafs_parallel, may be NULL for small trees. */
+  BVHNode **leafs_temp;
+  /** #BVH_BALANCE_SAH etc. */
+  int flag;
 
   int tree_type;
   int tree_offset;
@@ -711,10 +1155,25 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
   int parent_leafs_begin = implicit_leafs_index(data->data, data->depth, parent_level_index);
   int parent_leafs_end = implicit_leafs_index(data->data, data->depth, parent_level_index + 1);
 
+  nth_positions[0] = parent_leafs_begin;
+  nth_positions[data->tree_type] = parent_leafs_end;
+  for (k = 1; k < data->tree_type; k++) {
+    const int child_index = j * data->tree_type + data->tree_offset + k;
+    /* child level index */
+    const int child_level_index = child_index - data->first_of_next_level;
+    nth_positions[k] = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
+  }
+
   /* This calculates the bounding box of this branch
    * and chooses the largest axis as the axis to divide leafs */
-  refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
-  split_axis = get_largest_axis(parent->bv);
+  refit_kdop_hull_parallel(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+  if ((data->flag & BVH_BALANCE_SAH) && (data->tree->start_axis == 0)) {
+    split_axis = bvh_sah_split_axis(
+        data->tree, data->leafs_array, nth_positions, data->tree_type, parent->bv);
+  }
+  else {
+    split_axis = get_largest_axis(parent->bv);
+  }
 
   /* Save split axis (this can be used on ray-tracing to speedup the query time) */
   parent->main_axis = split_axis / 2;
@@ -723,16 +1182,13 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
    * Only to assure that the elements are partitioned on a way that each child takes the elements
    * it would take in case the whole array was sorted.
    * Split_leafs takes care of that "sort" problem. */
-  nth_positions[0] = parent_leafs_begin;
-  nth_positions[data->tree_type] = parent_leafs_end;
-  for (k = 1; k < data->tree_type; k++) {
-    const int child_index = j * data->tree_type + data->tree_offset + k;
-    /* child level index */
-    const int child_level_index = child_index - data->first_of_next_level;
-    nth_positions[k] = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
-  }
-
-  split_leafs(data->leafs_array, nth_positions, data->tree_type, split_axis);
+  split_leafs_parallel(data->tree,
+                       data->leafs_array,
+                       data->leafs_temp,
+                       nth_positions,
+                       data->tree_type,
+                       split_axis,
+                       parent->bv);
 
   /* Setup `children` and `node_num` counters
    * Not really needed but currently most of BVH code
@@ -783,7 +1239,8 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
 static void non_recursive_bvh_div_nodes(const BVHTree *tree,
                                         BVHNode *branches_array,
                                         BVHNode **leafs_array,
-                                        int leafs_num)
+                                        int leafs_num,
+                                        const int flag)
 {
   int i;
 
@@ -819,6 +1276,8 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
       .tree = tree,
       .branches_array = branches_array,
       .leafs_array = leafs_array,
+      .leafs_temp = NULL,
+      .flag = flag,
       .tree_type = tree_type,
       .tree_offset = tree_offset,
       .data = &data,
@@ -827,6 +1286,10 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
       .i = 0,
   };
 
+  if (leafs_num >= KDOPBVH_THREAD_PARTITION_THRESHOLD) {
+    cb_data.leafs_temp = MEM_mallocN(sizeof(BVHNode *) * (size_t)leafs_num, __func__);
+  }
+
   /* Loop tree levels (log N) loops */
   for (i = 1, depth = 1; i <= branches_num; i = i * tree_type + tree_offset, depth++) {
     const int first_of_next_level = i * tree_type + tree_offset;
@@ -852,6 +1315,8 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
       }
     }
   }
+
+  MEM_SAFE_FREE(cb_data.leafs_temp);
 }
 
 /** \} */
@@ -944,6 +1409,11 @@ void BLI_bvhtree_free(BVHTree *tree)
 }
 
 void BLI_bvhtree_balance(BVHTree *tree)
+{
+  BLI_bvhtree_balance_ex(tree, 0);
+}
+
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag)
 {
   BVHNode **leafs_array = tree->nodes;
 
@@ -953,7 +1423,7 @@ void BLI_bvhtree_balance(BVHTree *tree)
 
   /* Build the implicit tree */
   non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num, flag);
 
   /* current code expects the branches to be linked to the nodes array
    * we perform that linkage here */
@@ -1027,19 +1497,69 @@ bool BLI_bvhtree_update_node(
   return true;
 }
 
+static void bvhtree_update_tree_level_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHTree *tree = userdata;
+  node_join(tree, tree->nodes[tree->leaf_num + i]);
+}
+
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
   /* Update bottom=>top
    * TRICKY: the way we build the tree all the children have an index greater than the parent
    * This allows us todo a bottom up update by starting on the bigger numbered branch. */
 
-  BVHNode **root = tree->nodes + tree->leaf_num;
-  BVHNode **index = tree->nodes + tree->leaf_num + tree->branch_num - 1;
+  if (tree->branch_num <= KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    BVHNode **root = tree->nodes + tree->leaf_num;
+    BVHNode **index = tree->nodes + tree->leaf_num + tree->branch_num - 1;
 
-  for (; index >= root; index--) {
-    node_join(tree, *index);
+    for (; index >= root; index--) {
+      node_join(tree, *index);
+    }
+    return;
+  }
+
+  /* Large trees update the branches of each level in parallel,
+   * the levels are laid out like in #non_recursive_bvh_div_nodes. */
+  const int tree_offset = 2 - tree->tree_type;
+  int level_starts[64];
+  int levels_num = 0;
+  for (int i = 1; i <= tree->branch_num; i = i * tree->tree_type + tree_offset) {
+    BLI_assert(levels_num < (int)ARRAY_SIZE(level_starts));
+    level_starts[levels_num++] = i;
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1024;
+
+  for (int level = levels_num - 1; level >= 0; level--) {
+    const int level_start = level_starts[level] - 1;
+    const int level_end = (level + 1 < levels_num) ? level_starts[level + 1] - 1 :
+                                                      tree->branch_num;
+    BLI_task_parallel_range(
+        level_start, level_end, tree, bvhtree_update_tree_level_cb, &settings);
   }
 }
+
+float BLI_bvhtree_get_surface_area_cost(const BVHTree *tree)
+{
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  if (root == NULL || tree->start_axis != 0) {
+    return 0.0f;
+  }
+
+  float area_sum = 0.0f;
+  for (int i = 0; i < tree->branch_num; i++) {
+    area_sum += bvh_sah_area(tree->nodes[tree->leaf_num + i]->bv);
+  }
+
+  const float root_area = bvh_sah_area(root->bv);
+  return (root_area > 0.0f) ? area_sum / root_area : 0.0f;
+}
+
 int BLI_bvhtree_get_len(const BVHTree *tree)
 {
   return tree->leaf_num;
@@ -2119,6 +2639,365 @@ void BLI_bvhtree_ray_cast_all(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch / BLI_bvhtree_find_nearest_batch
+ *
+ * Batched queries traverse the tree with packets of up to #KDOPBVH_PACKET_SIZE consecutive rays
+ * or points. Each node's bounds are tested against all active queries of the packet at once
+ * (4 at a time with SSE), and each leaf runs the callback once for all queries reaching it.
+ * \{ */
+
+#define KDOPBVH_PACKET_SIZE 8
+
+typedef struct BVHRayPacketData {
+  const BVHTree *tree;
+
+  BVHTree_RayCastBatchCallback callback;
+  void *userdata;
+
+  BVHTreeRay rays[KDOPBVH_PACKET_SIZE];
+  BVHTreeRayHit hits[KDOPBVH_PACKET_SIZE];
+#ifdef USE_KDOPBVH_WATERTIGHT
+  struct IsectRayPrecalc isect_precalc[KDOPBVH_PACKET_SIZE];
+#endif
+
+  /* One array per component, to test bounds against all rays at once. */
+  float origin[3][KDOPBVH_PACKET_SIZE];
+  float idir[3][KDOPBVH_PACKET_SIZE];
+  float radius[KDOPBVH_PACKET_SIZE];
+  /** Copy of #BVHTreeRayHit.dist, updated after calling the callback. */
+  float dist[KDOPBVH_PACKET_SIZE];
+} BVHRayPacketData;
+
+typedef struct BVHNearestPacketData {
+  const BVHTree *tree;
+
+  BVHTree_NearestPointBatchCallback callback;
+  void *userdata;
+
+  float co[KDOPBVH_PACKET_SIZE][3];
+  BVHTreeNearest nearest[KDOPBVH_PACKET_SIZE];
+
+  /* One array per component, to test bounds against all points at once. */
+  float proj[3][KDOPBVH_PACKET_SIZE];
+  /** Copy of #BVHTreeNearest.dist_sq, updated after calling the callback. */
+  float dist_sq[KDOPBVH_PACKET_SIZE];
+} BVHNearestPacketData;
+
+/**
+ * Test the bounds against the rays of the packet in \a mask, in the same way as
+ * #ray_nearest_hit.
+ *
+ * \return The rays reaching the bounds before their current hit distance.
+ */
+static uint ray_packet_nearest_hit(const BVHRayPacketData *data,
+                                   const float bv[6],
+                                   const uint mask,
+                                   float r_dist[KDOPBVH_PACKET_SIZE])
+{
+  uint result = 0;
+#if BLI_HAVE_SSE2
+  for (int i = 0; i < KDOPBVH_PACKET_SIZE; i += 4) {
+    if (((mask >> i) & 0xf) == 0) {
+      continue;
+    }
+    const __m128 radius = _mm_loadu_ps(&data->radius[i]);
+    const __m128 dist = _mm_loadu_ps(&data->dist[i]);
+    __m128 low = _mm_setzero_ps();
+    __m128 upper = dist;
+    for (int axis = 0; axis < 3; axis++) {
+      const __m128 origin = _mm_loadu_ps(&data->origin[axis][i]);
+      const __m128 idir = _mm_loadu_ps(&data->idir[axis][i]);
+      const __m128 bv_min = _mm_sub_ps(_mm_set1_ps(bv[axis * 2]), radius);
+      const __m128 bv_max = _mm_add_ps(_mm_set1_ps(bv[axis * 2 + 1]), radius);
+      const __m128 t1 = _mm_mul_ps(_mm_sub_ps(bv_min, origin), idir);
+      const __m128 t2 = _mm_mul_ps(_mm_sub_ps(bv_max, origin), idir);
+      low = _mm_max_ps(low, _mm_min_ps(t1, t2));
+      upper = _mm_min_ps(upper, _mm_max_ps(t1, t2));
+    }
+    const __m128 hit = _mm_and_ps(_mm_cmple_ps(low, upper), _mm_cmplt_ps(low, dist));
+    _mm_storeu_ps(&r_dist[i], low);
+    result |= (uint)_mm_movemask_ps(hit) << i;
+  }
+#else
+  for (int i = 0; i < KDOPBVH_PACKET_SIZE; i++) {
+    if ((mask & (1u << i)) == 0) {
+      continue;
+    }
+    float low = 0.0f, upper = data->dist[i];
+    for (int axis = 0; axis < 3; axis++) {
+      const float origin = data->origin[axis][i];
+      const float idir = data->idir[axis][i];
+      const float t1 = (bv[axis * 2] - data->radius[i] - origin) * idir;
+      const float t2 = (bv[axis * 2 + 1] + data->radius[i] - origin) * idir;
+      low = max_ff(low, min_ff(t1, t2));
+      upper = min_ff(upper, max_ff(t1, t2));
+    }
+    if (low <= upper && low < data->dist[i]) {
+      result |= 1u << i;
+    }
+    r_dist[i] = low;
+  }
+#endif
+  return result & mask;
+}
+
+/**
+ * Test the bounds against the points of the packet in \a mask,
+ * in the same way as #calc_nearest_point_squared.
+ *
+ * \return The points closer to the bounds than their current nearest distance.
+ */
+static uint nearest_packet_nearest_hit(const BVHNearestPacketData *data,
+                                       const float bv[6],
+                                       const uint mask)
+{
+  uint result = 0;
+#if BLI_HAVE_SSE2
+  for (int i = 0; i < KDOPBVH_PACKET_SIZE; i += 4) {
+    if (((mask >> i) & 0xf) == 0) {
+      continue;
+    }
+    __m128 dist_sq = _mm_setzero_ps();
+    for (int axis = 0; axis < 3; axis++) {
+      const __m128 proj = _mm_loadu_ps(&data->proj[axis][i]);
+      const __m128 nearest = _mm_min_ps(_mm_max_ps(proj, _mm_set1_ps(bv[axis * 2])),
+                                        _mm_set1_ps(bv[axis * 2 + 1]));
+      const __m128 delta = _mm_sub_ps(nearest, proj);
+      dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(delta, delta));
+    }
+    const __m128 hit = _mm_cmplt_ps(dist_sq, _mm_loadu_ps(&data->dist_sq[i]));
+    result |= (uint)_mm_movemask_ps(hit) << i;
+  }
+#else
+  for (int i = 0; i < KDOPBVH_PACKET_SIZE; i++) {
+    if ((mask & (1u << i)) == 0) {
+      continue;
+    }
+    float dist_sq = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+      const float proj = data->proj[axis][i];
+      const float delta = min_ff(max_ff(proj, bv[axis * 2]), bv[axis * 2 + 1]) - proj;
+      dist_sq += delta * delta;
+    }
+    if (dist_sq < data->dist_sq[i]) {
+      result |= 1u << i;
+    }
+  }
+#endif
+  return result & mask;
+}
+
+static int packet_mask_to_indices(uint mask, int r_indices[KDOPBVH_PACKET_SIZE])
+{
+  int indices_num = 0;
+  while (mask) {
+    const int i = (int)bitscan_forward_uint(mask);
+    r_indices[indices_num++] = i;
+    mask &= mask - 1;
+  }
+  return indices_num;
+}
+
+static void dfs_raycast_packet(BVHRayPacketData *data, const BVHNode *node, uint mask)
+{
+  float dist[KDOPBVH_PACKET_SIZE];
+  mask = ray_packet_nearest_hit(data, node->bv, mask, dist);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    int ray_indices[KDOPBVH_PACKET_SIZE];
+    const int ray_indices_num = packet_mask_to_indices(mask, ray_indices);
+    if (data->callback) {
+      data->callback(
+          data->userdata, node->index, data->rays, data->hits, ray_indices, ray_indices_num);
+    }
+    for (int j = 0; j < ray_indices_num; j++) {
+      const int i = ray_indices[j];
+      if (data->callback == NULL) {
+        data->hits[i].index = node->index;
+        data->hits[i].dist = dist[i];
+        madd_v3_v3v3fl(data->hits[i].co, data->rays[i].origin, data->rays[i].direction, dist[i]);
+      }
+      data->dist[i] = data->hits[i].dist;
+    }
+  }
+  else {
+    /* Pick loop direction to dive into the tree, based on the first ray of the packet. */
+    const int first = (int)bitscan_forward_uint(mask);
+    if (data->rays[first].direction[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+  }
+}
+
+static void dfs_find_nearest_packet(BVHNearestPacketData *data, const BVHNode *node, uint mask)
+{
+  mask = nearest_packet_nearest_hit(data, node->bv, mask);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    int co_indices[KDOPBVH_PACKET_SIZE];
+    const int co_indices_num = packet_mask_to_indices(mask, co_indices);
+    if (data->callback) {
+      data->callback(
+          data->userdata, node->index, data->co, data->nearest, co_indices, co_indices_num);
+    }
+    for (int j = 0; j < co_indices_num; j++) {
+      const int i = co_indices[j];
+      if (data->callback == NULL) {
+        BVHTreeNearest *nearest = &data->nearest[i];
+        nearest->index = node->index;
+        nearest->dist_sq = calc_nearest_point_squared(data->co[i], (BVHNode *)node, nearest->co);
+      }
+      data->dist_sq[i] = data->nearest[i].dist_sq;
+    }
+  }
+  else {
+    /* Pick loop direction to dive into the tree, based on the first point of the packet. */
+    const int first = (int)bitscan_forward_uint(mask);
+    const int axis = node->main_axis;
+    if (data->proj[axis][first] <= node->children[0]->bv[axis * 2 + 1]) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_find_nearest_packet(data, node->children[i], mask);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_find_nearest_packet(data, node->children[i], mask);
+      }
+    }
+  }
+}
+
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const BVHTreeRay *rays,
+                                BVHTreeRayHit *hits,
+                                const int rays_num,
+                                BVHTree_RayCastBatchCallback callback,
+                                void *userdata,
+                                const int flag)
+{
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  if (root == NULL) {
+    return;
+  }
+
+  BVHRayPacketData data;
+  data.tree = tree;
+  data.callback = callback;
+  data.userdata = userdata;
+
+  for (int start = 0; start < rays_num; start += KDOPBVH_PACKET_SIZE) {
+    const int packet_size = min_ii(KDOPBVH_PACKET_SIZE, rays_num - start);
+    uint mask = 0;
+
+    for (int i = 0; i < KDOPBVH_PACKET_SIZE; i++) {
+      if (i >= packet_size) {
+        /* Unused lanes never hit anything. */
+        for (int axis = 0; axis < 3; axis++) {
+          data.origin[axis][i] = 0.0f;
+          data.idir[axis][i] = 0.0f;
+        }
+        data.radius[i] = 0.0f;
+        data.dist[i] = 0.0f;
+        continue;
+      }
+
+      const BVHTreeRay *ray = &rays[start + i];
+      BLI_ASSERT_UNIT_V3(ray->direction);
+
+      data.rays[i] = *ray;
+      data.hits[i] = hits[start + i];
+      for (int axis = 0; axis < 3; axis++) {
+        const float dir = ray->direction[axis];
+        data.origin[axis][i] = ray->origin[axis];
+        data.idir[axis][i] = (fabsf(dir) < FLT_EPSILON) ? FLT_MAX : 1.0f / dir;
+      }
+      data.radius[i] = ray->radius;
+      data.dist[i] = data.hits[i].dist;
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+      if (flag & BVH_RAYCAST_WATERTIGHT) {
+        isect_ray_tri_watertight_v3_precalc(&data.isect_precalc[i], ray->direction);
+        data.rays[i].isect_precalc = &data.isect_precalc[i];
+      }
+      else {
+        data.rays[i].isect_precalc = NULL;
+      }
+#endif
+      mask |= 1u << i;
+    }
+
+    dfs_raycast_packet(&data, root, mask);
+
+    memcpy(&hits[start], data.hits, sizeof(*hits) * (size_t)packet_size);
+  }
+
+#ifndef USE_KDOPBVH_WATERTIGHT
+  UNUSED_VARS(flag);
+#endif
+}
+
+void BLI_bvhtree_find_nearest_batch(const BVHTree *tree,
+                                    const float (*co)[3],
+                                    BVHTreeNearest *nearest,
+                                    const int co_num,
+                                    BVHTree_NearestPointBatchCallback callback,
+                                    void *userdata)
+{
+  BVHNode *root = tree->nodes[tree->leaf_num];
+  if (root == NULL) {
+    return;
+  }
+
+  BVHNearestPacketData data;
+  data.tree = tree;
+  data.callback = callback;
+  data.userdata = userdata;
+
+  for (int start = 0; start < co_num; start += KDOPBVH_PACKET_SIZE) {
+    const int packet_size = min_ii(KDOPBVH_PACKET_SIZE, co_num - start);
+    uint mask = 0;
+
+    for (int i = 0; i < KDOPBVH_PACKET_SIZE; i++) {
+      if (i >= packet_size) {
+        /* Unused lanes never get closer than a zero distance. */
+        for (int axis = 0; axis < 3; axis++) {
+          data.proj[axis][i] = 0.0f;
+        }
+        data.dist_sq[i] = 0.0f;
+        continue;
+      }
+
+      copy_v3_v3(data.co[i], co[start + i]);
+      data.nearest[i] = nearest[start + i];
+      for (int axis = 0; axis < 3; axis++) {
+        data.proj[axis][i] = co[start + i][axis];
+      }
+      data.dist_sq[i] = data.nearest[i].dist_sq;
+      mask |= 1u << i;
+    }
+
+    dfs_find_nearest_packet(&data, root, mask);
+
+    memcpy(&nearest[start], data.nearest, sizeof(*nearest) * (size_t)packet_size);
+  }
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
@@ -638,6 +638,58 @@ void *BLI_mempool_as_arrayN(BLI_mempool *pool, const char *allocstr)
   return data;
 }
 
+int BLI_mempool_chunks_len(const BLI_mempool *pool)
+{
+  int chunks_num = 0;
+  for (const BLI_mempool_chunk *mpchunk = pool->chunks; mpchunk; mpchunk = mpchunk->next) {
+    chunks_num++;
+  }
+  return chunks_num;
+}
+
+int BLI_mempool_chunk_capacity(const BLI_mempool *pool)
+{
+  return (int)pool->pchunk;
+}
+
+void BLI_mempool_chunks_as_table(BLI_mempool *pool, BLI_mempool_chunk **chunks)
+{
+  BLI_mempool_chunk **p = chunks;
+  for (BLI_mempool_chunk *mpchunk = pool->chunks; mpchunk; mpchunk = mpchunk->next) {
+    *p++ = mpchunk;
+  }
+}
+
+int BLI_mempool_chunk_used_elems(BLI_mempool *pool, BLI_mempool_chunk *mpchunk, void **r_elems)
+{
+  const uint esize = pool->esize;
+  BLI_freenode *curnode = CHUNK_DATA(mpchunk);
+  int elems_num = 0;
+
+  BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
+
+  mempool_asan_lock(pool);
+  for (uint i = 0; i < pool->pchunk; i++) {
+    BLI_asan_unpoison(curnode, esize - POISON_REDZONE_SIZE);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MAKE_MEM_DEFINED(curnode, esize - POISON_REDZONE_SIZE);
+#endif
+    if (curnode->freeword == FREEWORD) {
+      BLI_asan_poison(curnode, esize);
+#ifdef WITH_MEM_VALGRIND
+      VALGRIND_MAKE_MEM_UNDEFINED(curnode, esize);
+#endif
+    }
+    else {
+      r_elems[elems_num++] = curnode;
+    }
+    curnode = NODE_STEP_NEXT(curnode);
+  }
+  mempool_asan_unlock(pool);
+
+  return elems_num;
+}
+
 void BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter)
 {
   BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
@@ -8,9 +8,11 @@
 
 #include "BLI_mmap.h"
 #include "BLI_fileops.h"
-#include "BLI_listbase.h"
+#include "BLI_threads.h"
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include <string.h>
 
 #ifndef WIN32
@@ -41,7 +43,7 @@ struct BLI_mmap_file {
 #ifndef WIN32
 /* When using memory-mapped files, any IO errors will result in a SIGBUS signal.
  * Therefore, we need to catch that signal and stop reading the file in question.
- * To do so, we keep a list of all current FileDatas that use memory-mapped files,
+ * To do so, we keep a table of all current files that use memory-mapped files,
  * and if a SIGBUS is caught, we check if the failed address is inside one of the
  * mapped regions.
  * If it is, we set a flag to indicate a failed read and remap the memory in
@@ -50,13 +52,22 @@ struct BLI_mmap_file {
  * set after it's done reading.
  * If the error occurred outside of a memory-mapped region, we call the previous
  * handler if one was configured and abort the process otherwise.
+ * Files are added and removed from multiple threads (file reading, importers) while the
+ * handler may run at any time, so the table has a fixed size and its slots are only changed
+ * atomically. The handler never sees a partially updated entry and doesn't need a lock.
  */
 
+/* Maximum number of files mapped at the same time, opening more files fails. */
+#  define MMAP_MAX_OPEN_FILES 1024
+
 static struct error_handler_data {
-  ListBase open_mmaps;
+  BLI_mmap_file *open_mmaps[MMAP_MAX_OPEN_FILES];
   char configured;
   void (*next_handler)(int, siginfo_t *, void *);
-} error_handler = {0};
+} error_handler = {{NULL}};
+
+/* Guards the setup of the handler, the table of open files doesn't need it. */
+static ThreadMutex error_handler_mutex = BLI_MUTEX_INITIALIZER;
 
 static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 {
@@ -65,8 +76,11 @@ static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 
   char *error_addr = (char *)siginfo->si_addr;
   /* Find the file that this error belongs to. */
-  LISTBASE_FOREACH (LinkData *, link, &error_handler.open_mmaps) {
-    BLI_mmap_file *file = link->data;
+  for (int i = 0; i < MMAP_MAX_OPEN_FILES; i++) {
+    BLI_mmap_file *file = atomic_load_ptr((void **)&error_handler.open_mmaps[i]);
+    if (file == NULL) {
+      continue;
+    }
 
     /* Is the address where the error occurred in this file's mapped range? */
     if (error_addr >= file->memory && error_addr < file->memory + file->length) {
@@ -115,17 +129,26 @@ static bool sigbus_handler_setup(void)
   return true;
 }
 
-/* Adds a file to the list that the error handler checks. */
-static void sigbus_handler_add(BLI_mmap_file *file)
+/* Adds a file to the table that the error handler checks, returns false if the table is full. */
+static bool sigbus_handler_add(BLI_mmap_file *file)
 {
-  BLI_addtail(&error_handler.open_mmaps, BLI_genericNodeN(file));
+  for (int i = 0; i < MMAP_MAX_OPEN_FILES; i++) {
+    if (atomic_cas_ptr((void **)&error_handler.open_mmaps[i], NULL, file) == NULL) {
+      return true;
+    }
+  }
+  return false;
 }
 
-/* Removes a file from the list that the error handler checks. */
+/* Removes a file from the table that the error handler checks. */
 static void sigbus_handler_remove(BLI_mmap_file *file)
 {
-  LinkData *link = BLI_findptr(&error_handler.open_mmaps, file, offsetof(LinkData, data));
-  BLI_freelinkN(&error_handler.open_mmaps, link);
+  for (int i = 0; i < MMAP_MAX_OPEN_FILES; i++) {
+    if (atomic_cas_ptr((void **)&error_handler.open_mmaps[i], file, NULL) == file) {
+      return;
+    }
+  }
+  BLI_assert_unreachable();
 }
 #endif
 
@@ -139,7 +162,10 @@ BLI_mmap_file *BLI_mmap_open(int fd)
 
 #ifndef WIN32
   /* Ensure that the SIGBUS handler is configured. */
-  if (!sigbus_handler_setup()) {
+  BLI_mutex_lock(&error_handler_mutex);
+  const bool handler_configured = sigbus_handler_setup();
+  BLI_mutex_unlock(&error_handler_mutex);
+  if (!handler_configured) {
     return NULL;
   }
 
@@ -173,7 +199,11 @@ BLI_mmap_file *BLI_mmap_open(int fd)
 
 #ifndef WIN32
   /* Register the file with the error handler. */
-  sigbus_handler_add(file);
+  if (!sigbus_handler_add(file)) {
+    munmap(memory, length);
+    MEM_freeN(file);
+    return NULL;
+  }
 #endif
 
   return file;
@@ -218,11 +248,17 @@ size_t BLI_mmap_get_length(const BLI_mmap_file *file)
   return file->length;
 }
 
+bool BLI_mmap_any_io_error(const BLI_mmap_file *file)
+{
+  return file->io_error;
+}
+
 void BLI_mmap_free(BLI_mmap_file *file)
 {
 #ifndef WIN32
-  munmap((void *)file->memory, file->length);
+  /* Unregister before unmapping, so the range can't be mistaken for a newly mapped file. */
   sigbus_handler_remove(file);
+  munmap((void *)file->memory, file->length);
 #else
   UnmapViewOfFile(file->memory);
   CloseHandle(file->handle);
@@ -0,0 +1,144 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <atomic>
+
+#include "BLI_array.hh"
+#include "BLI_calc_duplicates.h"
+#include "BLI_math_base.h"
+#include "BLI_offset_indices.hh"
+#include "BLI_task.h"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+
+struct DuplicatesSearch {
+  /** Only modified once all candidates are gathered. */
+  const int *duplicates;
+  /** Index of the searched point. */
+  int index;
+  blender::Vector<int> *candidates;
+};
+
+namespace blender {
+
+/**
+ * The parallel search can't skip points merged by earlier searches, so it's only faster when
+ * there are enough points and a few threads to share the extra work.
+ */
+static constexpr int duplicates_parallel_min_items = 8192;
+/** Number of items gathered into the same candidates array by one thread. */
+static constexpr int duplicates_chunk_size = 1024;
+/**
+ * Fall back to the serial search when there are more candidates than this per item on average,
+ * to avoid storing them all when the range is large compared to the point spacing.
+ */
+static constexpr int duplicates_candidates_max_average = 32;
+
+struct DuplicatesChunk {
+  /** Start of the candidates of every item of the chunk in #candidates, and the total size. */
+  Vector<int> offsets;
+  Vector<int> candidates;
+};
+
+}  // namespace blender
+
+void BLI_duplicates_search_add(DuplicatesSearch *search, const int index)
+{
+  if (index != search->index && search->duplicates[index] == -1) {
+    search->candidates->append(index);
+  }
+}
+
+bool BLI_calc_duplicates_parallel(const int items_num,
+                                  const int *order,
+                                  const int order_len,
+                                  const DuplicatesItemIndexFn item_index_fn,
+                                  const DuplicatesGatherFn gather_fn,
+                                  const void *userdata,
+                                  int *duplicates,
+                                  int *r_found)
+{
+  using namespace blender;
+  if (items_num < duplicates_parallel_min_items || BLI_task_scheduler_num_threads() <= 2) {
+    return false;
+  }
+
+  const int chunks_num = int(divide_ceil_u(uint(items_num), uint(duplicates_chunk_size)));
+  Array<DuplicatesChunk> chunks(chunks_num);
+  std::atomic<bool> is_full = false;
+  threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange chunks_range) {
+    for (const int chunk_index : chunks_range) {
+      if (is_full) {
+        return;
+      }
+      DuplicatesChunk &chunk = chunks[chunk_index];
+      const IndexRange items = IndexRange(chunk_index * duplicates_chunk_size,
+                                          duplicates_chunk_size)
+                                   .intersect(IndexRange(items_num));
+      chunk.offsets.reserve(items.size() + 1);
+      DuplicatesSearch search{duplicates, -1, &chunk.candidates};
+      for (const int item : items) {
+        chunk.offsets.append(int(chunk.candidates.size()));
+        const int index = item_index_fn(userdata, item);
+        if (!ELEM(duplicates[index], -1, index)) {
+          continue;
+        }
+        search.index = index;
+        gather_fn(userdata, item, &search);
+        if (chunk.candidates.size() > duplicates_chunk_size * duplicates_candidates_max_average) {
+          is_full = true;
+          return;
+        }
+      }
+      chunk.offsets.append(int(chunk.candidates.size()));
+    }
+  });
+  if (is_full) {
+    return false;
+  }
+
+  int found = 0;
+  /* Matches a single step of the serial search. */
+  const auto apply_candidates = [&](const int item) {
+    const int index = item_index_fn(userdata, item);
+    if (!ELEM(duplicates[index], -1, index)) {
+      return;
+    }
+    const DuplicatesChunk &chunk = chunks[item / duplicates_chunk_size];
+    const OffsetIndices<int> offsets = chunk.offsets.as_span();
+    const int found_prev = found;
+    for (const int other :
+         chunk.candidates.as_span().slice(offsets[item % duplicates_chunk_size]))
+    {
+      if (duplicates[other] == -1) {
+        duplicates[other] = index;
+        found++;
+      }
+    }
+    if (found != found_prev) {
+      /* Prevent chains of doubles. */
+      duplicates[index] = index;
+    }
+  };
+
+  if (order != nullptr) {
+    for (const int i : IndexRange(order_len)) {
+      if (order[i] != -1) {
+        apply_candidates(order[i]);
+      }
+    }
+  }
+  else {
+    for (const int item : IndexRange(items_num)) {
+      apply_candidates(item);
+    }
+  }
+
+  *r_found = found;
+  return true;
+}
@@ -0,0 +1,168 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <algorithm>
+
+#include "atomic_ops.h"
+
+#include "BLI_bounds.hh"
+#include "BLI_calc_duplicates.h"
+#include "BLI_hash_grid.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_math_base.h"
+#include "BLI_task.hh"
+
+namespace blender {
+
+PointHashGrid::PointHashGrid(const Span<float3> positions,
+                             const IndexMask &mask,
+                             const float cell_size)
+{
+  const std::optional<Bounds<float3>> bounds = bounds::min_max(mask, positions);
+  if (!bounds) {
+    bucket_offsets_data_ = Array<int>(2, 0);
+    return;
+  }
+  origin_ = bounds->min;
+  const float extent = math::reduce_max(bounds->max - bounds->min);
+  cell_size_ = std::max(cell_size, extent / float(max_cell_coord / 2));
+  if (!(cell_size_ > 0.0f)) {
+    /* All points are at the same position. */
+    cell_size_ = 1.0f;
+  }
+  cell_size_inv_ = 1.0f / cell_size_;
+
+  const int points_num = int(mask.size());
+  const int buckets_num = power_of_2_max_i(points_num);
+  buckets_mask_ = uint64_t(buckets_num - 1);
+
+  Array<int> bucket_indices(points_num);
+  mask.foreach_index_optimized<int>(GrainSize(4096), [&](const int i, const int pos) {
+    bucket_indices[pos] = this->bucket_index(this->cell_coord(positions[i]));
+  });
+
+  bucket_offsets_data_ = Array<int>(buckets_num + 1, 0);
+  offset_indices::build_reverse_offsets(bucket_indices, bucket_offsets_data_);
+  const OffsetIndices<int> buckets = this->bucket_offsets();
+
+  /* Scatter the points into their buckets in parallel, then sort each bucket to make the order
+   * deterministic. Indices in the mask are sorted, so sorting positions in the mask sorts the
+   * indices as well. */
+  Array<int> sorted_mask_indices(points_num);
+  Array<int> counts(buckets_num, 0);
+  threading::parallel_for(IndexRange(points_num), 4096, [&](const IndexRange range) {
+    for (const int pos : range) {
+      const int bucket = bucket_indices[pos];
+      const int index_in_bucket = atomic_fetch_and_add_int32(&counts[bucket], 1);
+      sorted_mask_indices[buckets[bucket][index_in_bucket]] = pos;
+    }
+  });
+
+  sorted_indices_.reinitialize(points_num);
+  sorted_positions_.reinitialize(points_num);
+  threading::parallel_for(buckets.index_range(), 1024, [&](const IndexRange range) {
+    for (const int bucket : range) {
+      MutableSpan<int> group = sorted_mask_indices.as_mutable_span().slice(buckets[bucket]);
+      std::sort(group.begin(), group.end());
+      for (const int i : buckets[bucket]) {
+        const int index = int(mask[sorted_mask_indices[i]]);
+        sorted_indices_[i] = index;
+        sorted_positions_[i] = positions[index];
+      }
+    }
+  });
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Duplicate Search
+ * \{ */
+
+struct DuplicatesSearchData {
+  const PointHashGrid *grid;
+  float range;
+};
+
+static int duplicates_item_index_cb(const void *userdata, const int grid_index)
+{
+  const DuplicatesSearchData &data = *static_cast<const DuplicatesSearchData *>(userdata);
+  return data.grid->sorted_indices()[grid_index];
+}
+
+static void duplicates_gather_cb(const void *userdata,
+                                 const int grid_index,
+                                 DuplicatesSearch *search)
+{
+  const DuplicatesSearchData &data = *static_cast<const DuplicatesSearchData *>(userdata);
+  data.grid->foreach_point_in_range(
+      data.grid->sorted_positions()[grid_index],
+      data.range,
+      [&](const int other, const float3 & /*co*/, const float /*dist_sq*/) {
+        BLI_duplicates_search_add(search, other);
+      });
+}
+
+static int calc_duplicates_serial(const PointHashGrid &grid,
+                                  const Span<int> grid_index_by_point,
+                                  const float range,
+                                  MutableSpan<int> duplicates)
+{
+  const Span<float3> positions = grid.sorted_positions();
+  int found = 0;
+  for (const int index : grid_index_by_point.index_range()) {
+    const int grid_index = grid_index_by_point[index];
+    if (grid_index == -1 || !ELEM(duplicates[index], -1, index)) {
+      continue;
+    }
+    const int found_prev = found;
+    grid.foreach_point_in_range(
+        positions[grid_index],
+        range,
+        [&](const int other, const float3 & /*co*/, const float /*dist_sq*/) {
+          if (other != index && duplicates[other] == -1) {
+            duplicates[other] = index;
+            found++;
+          }
+        });
+    if (found != found_prev) {
+      /* Prevent chains of doubles. */
+      duplicates[index] = index;
+    }
+  }
+  return found;
+}
+
+int PointHashGrid::calc_duplicates(const float range, MutableSpan<int> duplicates) const
+{
+  const int points_num = int(sorted_indices_.size());
+
+  Array<int> grid_index_by_point(duplicates.size(), -1);
+  threading::parallel_for(IndexRange(points_num), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      grid_index_by_point[sorted_indices_[i]] = i;
+    }
+  });
+
+  const DuplicatesSearchData data{this, range};
+  int found = 0;
+  if (BLI_calc_duplicates_parallel(points_num,
+                                   grid_index_by_point.data(),
+                                   int(grid_index_by_point.size()),
+                                   duplicates_item_index_cb,
+                                   duplicates_gather_cb,
+                                   &data,
+                                   duplicates.data(),
+                                   &found))
+  {
+    return found;
+  }
+  return calc_duplicates_serial(*this, grid_index_by_point, range, duplicates);
+}
+
+/** \} */
+
+}  // namespace blender
@@ -8,9 +8,11 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_calc_duplicates.h"
 #include "BLI_kdtree_impl.h"
 #include "BLI_math_base.h"
 #include "BLI_strict_flags.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include <string.h>
@@ -138,20 +140,16 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/**
+ * Quick-sort style partitioning of the nodes around their median on \a axis.
+ *
+ * \return The index of the median node.
+ */
+static uint kdtree_partition(KDTreeNode *nodes, uint nodes_len, uint axis)
 {
-  KDTreeNode *node;
   float co;
   uint left, right, median, i, j;
 
-  if (nodes_len <= 0) {
-    return KD_NODE_UNSET;
-  }
-  else if (nodes_len == 1) {
-    return 0 + ofs;
-  }
-
-  /* Quick-sort style sorting around median. */
   left = 0;
   right = nodes_len - 1;
   median = nodes_len / 2;
@@ -183,6 +181,24 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
     }
   }
 
+  return median;
+}
+
+static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  KDTreeNode *node;
+  uint median;
+
+  if (nodes_len <= 0) {
+    return KD_NODE_UNSET;
+  }
+  else if (nodes_len == 1) {
+    return 0 + ofs;
+  }
+
+  /* Quick-sort style sorting around median. */
+  median = kdtree_partition(nodes, nodes_len, axis);
+
   /* Set node and sort sub-nodes. */
   node = &nodes[median];
   node->d = axis;
@@ -194,6 +210,122 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   return median + ofs;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Parallel Balancing
+ *
+ * The top levels of the tree are split one level at a time, each level partitioning all of its
+ * sub-trees in parallel. Once there are enough independent sub-trees, they are balanced with
+ * #kdtree_balance on their own threads. The resulting tree is identical to a serial balance.
+ * \{ */
+
+/** Use multiple threads to balance trees with at least this many nodes. */
+#define KD_BALANCE_THREAD_THRESHOLD 8192
+/** Number of independent sub-trees to split the nodes into before balancing them in parallel. */
+#define KD_BALANCE_THREAD_RANGES 64
+
+typedef struct KDTreeBalanceRange {
+  uint ofs;
+  uint nodes_len;
+  uint axis;
+  /** Where to store the index of the root node of this range, null for unused ranges. */
+  uint *r_node;
+} KDTreeBalanceRange;
+
+typedef struct KDTreeBalanceData {
+  KDTreeNode *nodes;
+  const KDTreeBalanceRange *ranges;
+  /** Two ranges for every range in #ranges, only used when splitting. */
+  KDTreeBalanceRange *ranges_next;
+} KDTreeBalanceData;
+
+static void kdtree_balance_split_cb(void *__restrict userdata,
+                                    const int range_index,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBalanceData *data = userdata;
+  const KDTreeBalanceRange *range = &data->ranges[range_index];
+  KDTreeBalanceRange *ranges_next = &data->ranges_next[range_index * 2];
+
+  memset(ranges_next, 0, sizeof(*ranges_next) * 2);
+
+  if (range->r_node == NULL) {
+    return;
+  }
+  if (range->nodes_len <= 1) {
+    *range->r_node = kdtree_balance(
+        data->nodes + range->ofs, range->nodes_len, range->axis, range->ofs);
+    return;
+  }
+
+  KDTreeNode *nodes = data->nodes + range->ofs;
+  const uint median = kdtree_partition(nodes, range->nodes_len, range->axis);
+  KDTreeNode *node = &nodes[median];
+  node->d = range->axis;
+  *range->r_node = median + range->ofs;
+
+  const uint axis_next = (range->axis + 1) % KD_DIMS;
+  ranges_next[0].ofs = range->ofs;
+  ranges_next[0].nodes_len = median;
+  ranges_next[0].axis = axis_next;
+  ranges_next[0].r_node = &node->left;
+  ranges_next[1].ofs = range->ofs + median + 1;
+  ranges_next[1].nodes_len = range->nodes_len - (median + 1);
+  ranges_next[1].axis = axis_next;
+  ranges_next[1].r_node = &node->right;
+}
+
+static void kdtree_balance_range_cb(void *__restrict userdata,
+                                    const int range_index,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBalanceData *data = userdata;
+  const KDTreeBalanceRange *range = &data->ranges[range_index];
+  if (range->r_node == NULL) {
+    return;
+  }
+  *range->r_node = kdtree_balance(
+      data->nodes + range->ofs, range->nodes_len, range->axis, range->ofs);
+}
+
+static uint kdtree_balance_parallel(KDTreeNode *nodes, uint nodes_len)
+{
+  uint root = KD_NODE_UNSET;
+
+  KDTreeBalanceRange *ranges = MEM_mallocN(sizeof(*ranges), __func__);
+  uint ranges_len = 1;
+  ranges[0].ofs = 0;
+  ranges[0].nodes_len = nodes_len;
+  ranges[0].axis = 0;
+  ranges[0].r_node = &root;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+
+  KDTreeBalanceData data;
+  data.nodes = nodes;
+
+  while (ranges_len < KD_BALANCE_THREAD_RANGES) {
+    KDTreeBalanceRange *ranges_next = MEM_mallocN(sizeof(*ranges_next) * ranges_len * 2,
+                                                  __func__);
+    data.ranges = ranges;
+    data.ranges_next = ranges_next;
+    BLI_task_parallel_range(0, (int)ranges_len, &data, kdtree_balance_split_cb, &settings);
+    MEM_freeN(ranges);
+    ranges = ranges_next;
+    ranges_len *= 2;
+  }
+
+  data.ranges = ranges;
+  data.ranges_next = NULL;
+  BLI_task_parallel_range(0, (int)ranges_len, &data, kdtree_balance_range_cb, &settings);
+  MEM_freeN(ranges);
+
+  return root;
+}
+
+/** \} */
+
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -203,7 +335,12 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len >= KD_BALANCE_THREAD_THRESHOLD) {
+    tree->root = kdtree_balance_parallel(tree->nodes, tree->nodes_len);
+  }
+  else {
+    tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifndef NDEBUG
   tree->is_balanced = true;
@@ -799,6 +936,131 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ *
+ * Run the same query for many coordinates at once, using multiple threads.
+ * \{ */
+
+/** Number of queries each thread handles at least. */
+#define KD_BATCH_MIN_QUERIES_PER_THREAD 256
+
+typedef struct KDTreeFindNearestNBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  KDTreeNearest *r_nearest;
+  uint nearest_len_capacity;
+  int *r_nearest_len;
+} KDTreeFindNearestNBatchData;
+
+static void kdtree_find_nearest_n_batch_cb(void *__restrict userdata,
+                                           const int co_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeFindNearestNBatchData *data = userdata;
+  const int nearest_len = BLI_kdtree_nd_(find_nearest_n)(
+      data->tree,
+      data->co[co_index],
+      &data->r_nearest[(size_t)co_index * data->nearest_len_capacity],
+      data->nearest_len_capacity);
+  if (data->r_nearest_len) {
+    data->r_nearest_len[co_index] = nearest_len;
+  }
+}
+
+/**
+ * A version of #BLI_kdtree_3d_find_nearest_n for many coordinates at once.
+ *
+ * \param r_nearest: An array sized at least `co_len * nearest_len_capacity`,
+ * the nearest points of `co[i]` are stored starting at `r_nearest[i * nearest_len_capacity]`.
+ * \param r_nearest_len: Optional array of \a co_len values, set to the number of points found.
+ */
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+  KDTreeFindNearestNBatchData data;
+  data.tree = tree;
+  data.co = co;
+  data.r_nearest = r_nearest;
+  data.nearest_len_capacity = nearest_len_capacity;
+  data.r_nearest_len = r_nearest_len;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = KD_BATCH_MIN_QUERIES_PER_THREAD;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_n_batch_cb, &settings);
+}
+
+typedef struct KDTreeRangeSearchBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  float range;
+  bool (*search_cb)(
+      void *user_data, int co_index, int index, const float co[KD_DIMS], float dist_sq);
+  void *user_data;
+} KDTreeRangeSearchBatchData;
+
+typedef struct KDTreeRangeSearchBatchQuery {
+  const KDTreeRangeSearchBatchData *data;
+  int co_index;
+} KDTreeRangeSearchBatchQuery;
+
+static bool kdtree_range_search_batch_query_cb(void *user_data,
+                                               const int index,
+                                               const float co[KD_DIMS],
+                                               const float dist_sq)
+{
+  const KDTreeRangeSearchBatchQuery *query = user_data;
+  return query->data->search_cb(query->data->user_data, query->co_index, index, co, dist_sq);
+}
+
+static void kdtree_range_search_batch_cb(void *__restrict userdata,
+                                         const int co_index,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeRangeSearchBatchData *data = userdata;
+  KDTreeRangeSearchBatchQuery query;
+  query.data = data;
+  query.co_index = co_index;
+  BLI_kdtree_nd_(range_search_cb)(
+      data->tree, data->co[co_index], data->range, kdtree_range_search_batch_query_cb, &query);
+}
+
+/**
+ * A version of #BLI_kdtree_3d_range_search_cb for many coordinates at once.
+ *
+ * \param search_cb: Called for every node found in \a range of `co[co_index]`,
+ * false return value stops the search for that coordinate.
+ * Called from multiple threads, but never concurrently for the same \a co_index.
+ */
+void BLI_kdtree_nd_(range_search_batch_cb)(
+    const KDTree *tree,
+    const float (*co)[KD_DIMS],
+    const uint co_len,
+    const float range,
+    bool (*search_cb)(
+        void *user_data, int co_index, int index, const float co[KD_DIMS], float dist_sq),
+    void *user_data)
+{
+  KDTreeRangeSearchBatchData data;
+  data.tree = tree;
+  data.co = co;
+  data.range = range;
+  data.search_cb = search_cb;
+  data.user_data = user_data;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = KD_BATCH_MIN_QUERIES_PER_THREAD;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_range_search_batch_cb, &settings);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
@@ -861,6 +1123,86 @@ static void deduplicate_recursive(const struct DeDuplicateParams *p, uint i)
   }
 }
 
+typedef struct DeDuplicateGatherData {
+  const KDTreeNode *nodes;
+  uint root;
+  float range;
+  float range_sq;
+} DeDuplicateGatherData;
+
+static void deduplicate_gather_recursive(const DeDuplicateGatherData *data,
+                                         const float search_co[KD_DIMS],
+                                         uint i,
+                                         DuplicatesSearch *search)
+{
+  const KDTreeNode *node = &data->nodes[i];
+  if (search_co[node->d] + data->range <= node->co[node->d]) {
+    if (node->left != KD_NODE_UNSET) {
+      deduplicate_gather_recursive(data, search_co, node->left, search);
+    }
+  }
+  else if (search_co[node->d] - data->range >= node->co[node->d]) {
+    if (node->right != KD_NODE_UNSET) {
+      deduplicate_gather_recursive(data, search_co, node->right, search);
+    }
+  }
+  else {
+    if (len_squared_vnvn(node->co, search_co) <= data->range_sq) {
+      BLI_duplicates_search_add(search, node->index);
+    }
+    if (node->left != KD_NODE_UNSET) {
+      deduplicate_gather_recursive(data, search_co, node->left, search);
+    }
+    if (node->right != KD_NODE_UNSET) {
+      deduplicate_gather_recursive(data, search_co, node->right, search);
+    }
+  }
+}
+
+static int deduplicate_node_index_cb(const void *userdata, const int node_index)
+{
+  const DeDuplicateGatherData *data = userdata;
+  return data->nodes[node_index].index;
+}
+
+static void deduplicate_gather_cb(const void *userdata,
+                                  const int node_index,
+                                  DuplicatesSearch *search)
+{
+  const DeDuplicateGatherData *data = userdata;
+  deduplicate_gather_recursive(data, data->nodes[node_index].co, data->root, search);
+}
+
+/**
+ * Multi-threaded version of #BLI_kdtree_3d_calc_duplicates_fast.
+ *
+ * \return False when the parallel search is not used, nothing is changed in that case.
+ */
+static bool kdtree_calc_duplicates_fast_parallel(const KDTree *tree,
+                                                 const float range,
+                                                 const bool use_index_order,
+                                                 int *duplicates,
+                                                 int *r_found)
+{
+  DeDuplicateGatherData data;
+  data.nodes = tree->nodes;
+  data.root = tree->root;
+  data.range = range;
+  data.range_sq = square_f(range);
+
+  int *order = use_index_order ? kdtree_order(tree) : NULL;
+  const bool result = BLI_calc_duplicates_parallel((int)tree->nodes_len,
+                                                   order,
+                                                   tree->max_node_index + 1,
+                                                   deduplicate_node_index_cb,
+                                                   deduplicate_gather_cb,
+                                                   &data,
+                                                   duplicates,
+                                                   r_found);
+  MEM_SAFE_FREE(order);
+  return result;
+}
+
 /**
  * Find duplicate points in \a range.
  * Favors speed over quality since it doesn't find the best target vertex for merging.
@@ -885,6 +1227,11 @@ int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
                                          int *duplicates)
 {
   int found = 0;
+
+  if (kdtree_calc_duplicates_fast_parallel(tree, range, use_index_order, duplicates, &found)) {
+    return found;
+  }
+
   struct DeDuplicateParams p = {
       .nodes = tree->nodes,
       .range = range,
@@ -0,0 +1,70 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <algorithm>
+
+#include "BLI_mempool.hh"
+#include "BLI_task.hh"
+
+namespace blender::mempool {
+
+/** Number of cache lines at the start of a chunk that are prefetched. */
+static constexpr int prefetch_cache_lines_num = 4;
+static constexpr int cache_line_size = 64;
+
+ChunksView::ChunksView(BLI_mempool *pool)
+    : pool_(pool),
+      chunks_(BLI_mempool_chunks_len(pool), NoInitialization()),
+      chunk_capacity_(BLI_mempool_chunk_capacity(pool))
+{
+  BLI_mempool_chunks_as_table(pool, chunks_.data());
+}
+
+Span<void *> ChunksView::used_elems(const int64_t chunk_index, MutableSpan<void *> buffer) const
+{
+  BLI_assert(buffer.size() >= chunk_capacity_);
+  const int elems_num = BLI_mempool_chunk_used_elems(pool_, chunks_[chunk_index], buffer.data());
+  return buffer.take_front(elems_num);
+}
+
+void ChunksView::prefetch(const int64_t chunk_index) const
+{
+#if defined(__GNUC__) || defined(__clang__)
+  const char *chunk = reinterpret_cast<const char *>(chunks_[chunk_index]);
+  for (int i = 0; i < prefetch_cache_lines_num; i++) {
+    __builtin_prefetch(chunk + i * cache_line_size);
+  }
+#else
+  UNUSED_VARS(chunk_index);
+#endif
+}
+
+void parallel_for_each_chunk(BLI_mempool *pool,
+                             const int64_t grain_size,
+                             const FunctionRef<void(Span<void *> elems)> fn)
+{
+  if (BLI_mempool_len(pool) == 0) {
+    return;
+  }
+  const ChunksView chunks(pool);
+  const int64_t chunks_grain_size = std::max<int64_t>(grain_size / chunks.chunk_capacity(), 1);
+  threading::parallel_for(chunks.index_range(), chunks_grain_size, [&](const IndexRange range) {
+    Array<void *> buffer(chunks.chunk_capacity(), NoInitialization());
+    for (const int64_t chunk_index : range) {
+      if (chunk_index + 1 < range.one_after_last()) {
+        chunks.prefetch(chunk_index + 1);
+      }
+      const Span<void *> elems = chunks.used_elems(chunk_index, buffer);
+      if (!elems.is_empty()) {
+        fn(elems);
+      }
+    }
+  });
+}
+
+}  // namespace blender::mempool
@@ -10,13 +10,24 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_index_mask.hh"
 #include "BLI_task.h"
+#include "BLI_task.hh"
+#include "BLI_task_graph.hh"
+#include "BLI_time.h"
 
+#include "atomic_ops.h"
+
+#include <algorithm>
 #include <memory>
+#include <queue>
 #include <vector>
 
 #ifdef WITH_TBB
+#  include <tbb/concurrent_priority_queue.h>
 #  include <tbb/flow_graph.h>
+#  include <tbb/task_arena.h>
+#  include <tbb/task_group.h>
 #endif
 
 /* Task Graph */
@@ -149,3 +160,238 @@ void BLI_task_graph_edge_create(TaskNode *from_node, TaskNode *to_node)
 
   from_node->successors.push_back(to_node);
 }
+
+/* -------------------------------------------------------------------- */
+/** \name C++ Task Graph
+ * \{ */
+
+namespace blender::threading {
+
+TaskGraph::TaskGraph(const int nodes_num, const Span<int2> edges) : nodes_num_(nodes_num)
+{
+  Array<int> from_nodes(edges.size());
+  for (const int i : edges.index_range()) {
+    BLI_assert(IndexRange(nodes_num).contains(edges[i][0]));
+    BLI_assert(IndexRange(nodes_num).contains(edges[i][1]));
+    from_nodes[i] = edges[i][0];
+  }
+  successor_offsets_data_ = Array<int>(nodes_num + 1, 0);
+  offset_indices::build_reverse_offsets(from_nodes, successor_offsets_data_);
+  const OffsetIndices<int> successor_offsets(successor_offsets_data_);
+
+  successors_.reinitialize(edges.size());
+  Array<int> predecessors_num(nodes_num, 0);
+  Array<int> fill_counts(nodes_num, 0);
+  for (const int2 &edge : edges) {
+    successors_[successor_offsets[edge[0]][fill_counts[edge[0]]++]] = edge[1];
+    predecessors_num[edge[1]]++;
+  }
+
+  /* Kahn's algorithm. The order only depends on the edges, to get deterministic priorities. */
+  topological_order_.reinitialize(nodes_num);
+  int order_num = 0;
+  for (const int node : IndexRange(nodes_num)) {
+    if (predecessors_num[node] == 0) {
+      topological_order_[order_num++] = node;
+    }
+  }
+  for (int i = 0; i < order_num; i++) {
+    for (const int successor : this->successors(topological_order_[i])) {
+      if (--predecessors_num[successor] == 0) {
+        topological_order_[order_num++] = successor;
+      }
+    }
+  }
+  BLI_assert_msg(order_num == nodes_num, "Task graph has dependency cycles");
+  if (order_num != nodes_num) {
+    /* Nodes of cycles are not ordered, they keep zero priority and are never executed. */
+    topological_order_ = Array<int>(topological_order_.as_span().take_front(order_num));
+  }
+
+  priorities_ = Array<float>(nodes_num, 0.0f);
+}
+
+void TaskGraph::set_priorities(const Span<float> priorities)
+{
+  BLI_assert(priorities.size() == nodes_num_);
+  priorities_.as_mutable_span().copy_from(priorities);
+}
+
+void TaskGraph::set_critical_path_priorities(const Span<float> costs)
+{
+  BLI_assert(costs.size() == nodes_num_);
+  for (int i = topological_order_.size() - 1; i >= 0; i--) {
+    const int node = topological_order_[i];
+    float successors_max = 0.0f;
+    for (const int successor : this->successors(node)) {
+      successors_max = std::max(successors_max, priorities_[successor]);
+    }
+    priorities_[node] = costs[node] + successors_max;
+  }
+}
+
+namespace {
+
+struct ReadyNode {
+  float priority;
+  int node;
+
+  /** Higher priorities first, then lower indices, for a deterministic single threaded order. */
+  bool operator<(const ReadyNode &other) const
+  {
+    if (priority != other.priority) {
+      return priority < other.priority;
+    }
+    return node > other.node;
+  }
+};
+
+/** State of a single #TaskGraph::execute call. */
+struct TaskGraphExecution {
+  const TaskGraph &graph;
+  FunctionRef<void(int node)> fn;
+  const TaskGraph::ExecuteSettings &settings;
+  MutableSpan<TaskGraph::NodeTiming> timings;
+  double start_time;
+
+  Array<bool> in_mask;
+  /** Number of unfinished predecessors of every node in the mask. */
+  Array<int> pending_num;
+
+  void run_node(const int node)
+  {
+    if (settings.capture_timings) {
+      TaskGraph::NodeTiming &timing = timings[node];
+      timing.start = BLI_check_seconds_timer() - start_time;
+#ifdef WITH_TBB
+      timing.thread = tbb::this_task_arena::current_thread_index();
+#else
+      timing.thread = 0;
+#endif
+      this->run_node_fn(node);
+      timing.end = BLI_check_seconds_timer() - start_time;
+    }
+    else {
+      this->run_node_fn(node);
+    }
+  }
+
+  void run_node_fn(const int node)
+  {
+    if (settings.isolate) {
+      threading::isolate_task([&]() { fn(node); });
+    }
+    else {
+      fn(node);
+    }
+  }
+
+  /** Call \a ready_fn for every successor whose last pending predecessor was \a node. */
+  template<typename Fn> void finish_node(const int node, const Fn &ready_fn)
+  {
+    for (const int successor : graph.successors(node)) {
+      if (!in_mask[successor]) {
+        continue;
+      }
+      if (atomic_sub_and_fetch_int32(&pending_num[successor], 1) == 0) {
+        ready_fn(successor);
+      }
+    }
+  }
+
+  template<typename Fn> void foreach_initial_node(const IndexMask &mask, const Fn &fn) const
+  {
+    mask.foreach_index([&](const int node) {
+      if (pending_num[node] == 0) {
+        fn(node);
+      }
+    });
+  }
+
+  void execute_serial(const IndexMask &mask)
+  {
+    std::priority_queue<ReadyNode> queue;
+    const Span<float> priorities = graph.priorities();
+    auto push = [&](const int node) { queue.push({priorities[node], node}); };
+    this->foreach_initial_node(mask, push);
+    while (!queue.empty() && !graph.is_cancelled()) {
+      const int node = queue.top().node;
+      queue.pop();
+      this->run_node(node);
+      this->finish_node(node, push);
+    }
+  }
+
+#ifdef WITH_TBB
+  /**
+   * Every ready node is added to the queue along with a task that runs the node with the highest
+   * priority in the queue at the time the task starts, which is not necessarily the node it was
+   * created for. TBB decides which threads execute the tasks.
+   */
+  tbb::concurrent_priority_queue<ReadyNode> queue;
+  tbb::task_group task_group;
+
+  void push_threaded(const int node)
+  {
+    queue.push({graph.priorities()[node], node});
+    task_group.run([this]() { this->run_ready_node_threaded(); });
+  }
+
+  void run_ready_node_threaded()
+  {
+    ReadyNode ready_node;
+    if (!queue.try_pop(ready_node)) {
+      BLI_assert_unreachable();
+      return;
+    }
+    if (graph.is_cancelled()) {
+      return;
+    }
+    this->run_node(ready_node.node);
+    this->finish_node(ready_node.node, [&](const int node) { this->push_threaded(node); });
+  }
+
+  void execute_threaded(const IndexMask &mask)
+  {
+    this->foreach_initial_node(mask, [&](const int node) { this->push_threaded(node); });
+    task_group.wait();
+  }
+#endif
+};
+
+}  // namespace
+
+bool TaskGraph::execute(const IndexMask &mask,
+                        const FunctionRef<void(int node)> fn,
+                        const ExecuteSettings &settings)
+{
+  is_cancelled_.store(false, std::memory_order_relaxed);
+  if (settings.capture_timings) {
+    timings_ = Array<NodeTiming>(nodes_num_);
+  }
+
+  TaskGraphExecution execution{*this, fn, settings, timings_, BLI_check_seconds_timer()};
+  execution.in_mask = Array<bool>(nodes_num_, false);
+  mask.to_bools(execution.in_mask);
+  execution.pending_num = Array<int>(nodes_num_, 0);
+  mask.foreach_index([&](const int node) {
+    for (const int successor : this->successors(node)) {
+      if (execution.in_mask[successor]) {
+        execution.pending_num[successor]++;
+      }
+    }
+  });
+
+#ifdef WITH_TBB
+  if (!settings.single_threaded && BLI_task_scheduler_num_threads() > 1) {
+    execution.execute_threaded(mask);
+    return !this->is_cancelled();
+  }
+#endif
+  execution.execute_serial(mask);
+  return !this->is_cancelled();
+}
+
+}  // namespace blender::threading
+
+/** \} */
@@ -0,0 +1,166 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include <limits>
+
+#include "BLI_array.hh"
+#include "BLI_hash_grid.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_kdtree.h"
+#include "BLI_rand.hh"
+#include "BLI_vector.hh"
+
+namespace blender::tests {
+
+static Array<float3> random_positions(const int size, const float scale, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<float3> positions(size);
+  for (float3 &position : positions) {
+    position = float3(rng.get_float(), rng.get_float(), rng.get_float()) * scale;
+  }
+  return positions;
+}
+
+TEST(hash_grid, Empty)
+{
+  const PointHashGrid grid({}, IndexMask(), 0.1f);
+  bool found = false;
+  grid.foreach_point_in_range(float3(0.0f), 1.0f, [&](int, const float3 &, float) {
+    found = true;
+  });
+  EXPECT_FALSE(found);
+  EXPECT_EQ(grid.calc_duplicates(0.1f, {}), 0);
+}
+
+static void range_search_test(const float range)
+{
+  const Array<float3> positions = random_positions(5000, 1.0f, 1);
+  IndexMaskMemory memory;
+  const IndexMask mask = IndexMask::from_predicate(
+      positions.index_range(), GrainSize(1024), memory, [](const int i) { return i % 3 != 0; });
+  const PointHashGrid grid(positions, mask, 0.05f);
+
+  const Array<float3> queries = random_positions(200, 1.2f, 2);
+  for (const float3 &query : queries) {
+    Vector<int> found;
+    grid.foreach_point_in_range(query, range, [&](const int index, const float3 &, float) {
+      found.append(index);
+    });
+    std::sort(found.begin(), found.end());
+
+    Vector<int> expected;
+    mask.foreach_index([&](const int i) {
+      if (math::distance(query, positions[i]) <= range) {
+        expected.append(i);
+      }
+    });
+    EXPECT_EQ(found.as_span(), expected.as_span());
+  }
+}
+
+TEST(hash_grid, RangeSearch)
+{
+  range_search_test(0.05f);
+}
+
+TEST(hash_grid, RangeSearchSmall)
+{
+  range_search_test(0.01f);
+}
+
+TEST(hash_grid, RangeSearchLarge)
+{
+  range_search_test(0.3f);
+}
+
+/**
+ * Compare with the KD-tree, the ranges used avoid distances between points at exactly the range,
+ * where the KD-tree can skip points.
+ */
+static void calc_duplicates_test(const int size, const float range)
+{
+  /* Quantize the positions to get exact duplicates as well. */
+  Array<float3> positions = random_positions(size, 100.0f, 3);
+  for (float3 &position : positions) {
+    position = math::floor(position) * 0.01f;
+  }
+
+  Array<int> duplicates(size, -1);
+  const PointHashGrid grid(positions, IndexMask(size), range);
+  const int found = grid.calc_duplicates(range, duplicates);
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(size);
+  for (const int i : positions.index_range()) {
+    BLI_kdtree_3d_insert(tree, i, positions[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  Array<int> duplicates_kdtree(size, -1);
+  const int found_kdtree = BLI_kdtree_3d_calc_duplicates_fast(
+      tree, range, true, duplicates_kdtree.data());
+  BLI_kdtree_3d_free(tree);
+
+  EXPECT_EQ(found, found_kdtree);
+  EXPECT_EQ(duplicates.as_span(), duplicates_kdtree.as_span());
+}
+
+TEST(hash_grid, CalcDuplicates)
+{
+  calc_duplicates_test(500, 0.0015f);
+  calc_duplicates_test(500, 0.045f);
+}
+
+TEST(hash_grid, CalcDuplicatesLarge)
+{
+  calc_duplicates_test(100000, 0.0015f);
+  /* Many candidates per point, uses the serial search. */
+  calc_duplicates_test(100000, 0.055f);
+}
+
+TEST(hash_grid, CalcDuplicatesExact)
+{
+  const int size = 10000;
+  const int unique_num = 1000;
+  const Array<float3> unique_positions = random_positions(unique_num, 1.0f, 4);
+  Array<float3> positions(size);
+  for (const int i : positions.index_range()) {
+    positions[i] = unique_positions[i % unique_num];
+  }
+
+  Array<int> duplicates(size, -1);
+  const PointHashGrid grid(positions, IndexMask(size), 0.0f);
+  EXPECT_EQ(grid.calc_duplicates(0.0f, duplicates), size - unique_num);
+  for (const int i : positions.index_range()) {
+    EXPECT_EQ(duplicates[i], i % unique_num);
+  }
+}
+
+TEST(hash_grid, NaNPositions)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  /* Add points far away from the others, so that the search visits the grid cells. */
+  Array<float3> positions(2005);
+  positions.as_mutable_span().take_front(5).copy_from(
+      {float3(0.0f), float3(nan), float3(0.001f, 0.0f, 0.0f), float3(1.0f), float3(nan, 0, 0)});
+  for (const int i : IndexRange(2000)) {
+    positions[5 + i] = float3(2 + i % 20, 2 + (i / 20) % 20, 2 + i / 400);
+  }
+  const PointHashGrid grid(positions, IndexMask(positions.size()), 0.01f);
+
+  Vector<int> found;
+  grid.foreach_point_in_range(float3(0.0f), 0.01f, [&](const int index, const float3 &, float) {
+    found.append(index);
+  });
+  std::sort(found.begin(), found.end());
+  EXPECT_EQ(found.as_span(), Span<int>({0, 2}));
+
+  /* Points with NaN positions are never merged. */
+  Array<int> duplicates(positions.size(), -1);
+  EXPECT_EQ(grid.calc_duplicates(0.01f, duplicates), 1);
+  EXPECT_EQ(duplicates.as_span().take_front(5), Span<int>({0, -1, 0, -1, -1}));
+}
+
+}  // namespace blender::tests
@@ -6,8 +6,11 @@
 
 /* TODO: ray intersection, overlap ... etc. */
 
+#include <algorithm>
+
 #include "MEM_guardedalloc.h"
 
+#include "BLI_array.hh"
 #include "BLI_compiler_attrs.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math_vector.h"
@@ -68,8 +71,12 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     int balance_flag = 0)
 {
   RNG *rng = BLI_rng_new(random_seed);
   BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
@@ -81,7 +88,7 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  BLI_bvhtree_balance_ex(tree, balance_flag);
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -121,6 +128,20 @@ TEST(kdopbvh, FindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12);
 }
+/* Large enough to partition the first levels of the tree on multiple threads. */
+TEST(kdopbvh, FindNearest_100000)
+{
+  find_nearest_points_test(100000, 1.0, 100000, 7);
+}
+
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, BVH_BALANCE_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_100000)
+{
+  find_nearest_points_test(100000, 1.0, 100000, 7, false, BVH_BALANCE_SAH);
+}
 
 TEST(kdopbvh, OptimalFindNearest_1)
 {
@@ -134,3 +155,227 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+/**
+ * \param use_callback: Without callback the nearest point on the bounds of the leafs is used,
+ * which is the point itself.
+ */
+static void find_nearest_batch_test(int points_len,
+                                    int queries_len,
+                                    int random_seed,
+                                    bool use_callback = true)
+{
+  RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 4, 6);
+
+  blender::Array<blender::float3> points(points_len);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  blender::Array<blender::float3> queries(queries_len);
+  blender::Array<BVHTreeNearest> nearest(queries_len);
+  for (int i = 0; i < queries_len; i++) {
+    rng_v3_round(queries[i], 3, rng, 1000, 1.5f);
+    nearest[i].index = -1;
+    nearest[i].dist_sq = FLT_MAX;
+  }
+
+  if (use_callback) {
+    BLI_bvhtree_find_nearest_batch_cpp(
+        *tree,
+        queries,
+        nearest,
+        [&](const int index, const blender::float3 &co, BVHTreeNearest &r_nearest) {
+          const float dist_sq = len_squared_v3v3(co, points[index]);
+          if (dist_sq < r_nearest.dist_sq) {
+            r_nearest.index = index;
+            r_nearest.dist_sq = dist_sq;
+            copy_v3_v3(r_nearest.co, points[index]);
+          }
+        });
+  }
+  else {
+    BLI_bvhtree_find_nearest_batch(tree,
+                                   reinterpret_cast<const float(*)[3]>(queries.data()),
+                                   nearest.data(),
+                                   queries_len,
+                                   nullptr,
+                                   nullptr);
+  }
+
+  for (int i = 0; i < queries_len; i++) {
+    BVHTreeNearest expected;
+    expected.index = -1;
+    expected.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, queries[i], &expected, nullptr, nullptr);
+    EXPECT_GE(nearest[i].index, 0);
+    const float expected_dist_sq = len_squared_v3v3(queries[i], points[expected.index]);
+    if (use_callback) {
+      EXPECT_FLOAT_EQ(nearest[i].dist_sq, expected_dist_sq);
+    }
+    else {
+      /* The bounds of the leafs are slightly larger than the points. */
+      EXPECT_NEAR(nearest[i].dist_sq, expected_dist_sq, 1e-5f);
+    }
+    EXPECT_V3_NEAR(nearest[i].co, points[nearest[i].index], 1e-6f);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, FindNearestBatch_1)
+{
+  find_nearest_batch_test(1, 13, 1234);
+}
+TEST(kdopbvh, FindNearestBatch_500)
+{
+  find_nearest_batch_test(500, 1001, 12);
+}
+TEST(kdopbvh, FindNearestBatchNoCallback_500)
+{
+  find_nearest_batch_test(500, 1001, 12, false);
+}
+
+/** Cast rays at points, the leafs are the bounds of the points (with a small epsilon). */
+TEST(kdopbvh, RayCastBatch)
+{
+  const int points_len = 500;
+  RNG *rng = BLI_rng_new(1);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 4, 6);
+
+  blender::Array<blender::float3> points(points_len);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  /* Rays along the Z axis, starting below each point. */
+  blender::Array<BVHTreeRay> rays(points_len);
+  blender::Array<BVHTreeRayHit> hits(points_len);
+  for (int i = 0; i < points_len; i++) {
+    copy_v3_v3(rays[i].origin, points[i]);
+    rays[i].origin[2] = -2.0f;
+    copy_v3_fl3(rays[i].direction, 0.0f, 0.0f, 1.0f);
+    rays[i].radius = 0.0f;
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  BLI_bvhtree_ray_cast_batch_cpp(
+      *tree, rays, hits, [&](const int index, const BVHTreeRay &ray, BVHTreeRayHit &hit) {
+        const float dist = points[index][2] - ray.origin[2];
+        if (points[index][0] == ray.origin[0] && points[index][1] == ray.origin[1] &&
+            dist < hit.dist)
+        {
+          hit.index = index;
+          hit.dist = dist;
+        }
+      });
+
+  for (int i = 0; i < points_len; i++) {
+    ASSERT_GE(hits[i].index, 0);
+    /* Another point may be in front of this one by chance. */
+    EXPECT_FLOAT_EQ(hits[i].dist, points[hits[i].index][2] + 2.0f);
+    EXPECT_LE(hits[i].dist, points[i][2] + 2.0f);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
+
+static BVHTree *points_tree_create(blender::Span<blender::float3> points)
+{
+  BVHTree *tree = BLI_bvhtree_new(int(points.size()), 0.0, 4, 6);
+  for (const int i : points.index_range()) {
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+static void points_tree_update(BVHTree *tree, blender::Span<blender::float3> points)
+{
+  for (const int i : points.index_range()) {
+    BLI_bvhtree_update_node(tree, i, points[i], nullptr, 1);
+  }
+  BLI_bvhtree_update_tree(tree);
+}
+
+/** Move all points and refit the tree, with enough branches to update them in parallel. */
+static void update_tree_test(int points_len, int random_seed)
+{
+  RNG *rng = BLI_rng_new(random_seed);
+  blender::Array<blender::float3> points(points_len);
+  for (blender::float3 &point : points) {
+    rng_v3_round(point, 3, rng, 1000, 1.0f);
+  }
+  BVHTree *tree = points_tree_create(points);
+
+  for (blender::float3 &point : points) {
+    blender::float3 offset;
+    rng_v3_round(offset, 3, rng, 1000, 0.1f);
+    point = point * 2.0f + offset;
+  }
+  points_tree_update(tree, points);
+
+  for (int i = 0; i < 100; i++) {
+    blender::float3 co;
+    rng_v3_round(co, 3, rng, 1000, 2.5f);
+    BVHTreeNearest nearest;
+    nearest.index = -1;
+    nearest.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, co, &nearest, nullptr, nullptr);
+
+    float expected_dist_sq = FLT_MAX;
+    for (const blender::float3 &point : points) {
+      expected_dist_sq = std::min(expected_dist_sq, len_squared_v3v3(co, point));
+    }
+    ASSERT_GE(nearest.index, 0);
+    EXPECT_NEAR(len_squared_v3v3(co, points[nearest.index]), expected_dist_sq, 1e-5f);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, UpdateTree_500)
+{
+  update_tree_test(500, 7);
+}
+TEST(kdopbvh, UpdateTree_100000)
+{
+  update_tree_test(100000, 7);
+}
+
+TEST(kdopbvh, SurfaceAreaCost)
+{
+  RNG *rng = BLI_rng_new(42);
+  blender::Array<blender::float3> points(2000);
+  for (blender::float3 &point : points) {
+    rng_v3_round(point, 3, rng, 1000, 1.0f);
+  }
+  BVHTree *tree = points_tree_create(points);
+  const float cost = BLI_bvhtree_get_surface_area_cost(tree);
+  /* The root alone has a cost of one. */
+  EXPECT_GT(cost, 1.0f);
+
+  /* The cost is relative to the root, so it doesn't change when scaling. */
+  for (blender::float3 &point : points) {
+    point *= 3.0f;
+  }
+  points_tree_update(tree, points);
+  EXPECT_NEAR(BLI_bvhtree_get_surface_area_cost(tree), cost, cost * 1e-3f);
+
+  /* Moving the points to unrelated positions makes the branches overlap. */
+  std::reverse(points.begin(), points.end());
+  points_tree_update(tree, points);
+  EXPECT_GT(BLI_bvhtree_get_surface_area_cost(tree), cost * 2.0f);
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+}
@@ -4,8 +4,14 @@
 
 #include "testing/testing.h"
 
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
 #include "BLI_kdtree.h"
+#include "BLI_math_vector_types.hh"
+#include "BLI_rand.h"
 
+#include <atomic>
 #include <cmath>
 
 /* -------------------------------------------------------------------- */
@@ -54,6 +60,128 @@ static void deduplicate_test()
   }
 }
 
+using blender::Array;
+using blender::float3;
+
+static Array<float3> random_points(const int points_num, const uint seed)
+{
+  Array<float3> points(points_num);
+  RNG *rng = BLI_rng_new(seed);
+  for (float3 &point : points) {
+    BLI_rng_get_float_unit_v3(rng, point);
+  }
+  BLI_rng_free(rng);
+  return points;
+}
+
+/* Large enough to balance the tree and search for duplicates on multiple threads. */
+static void find_nearest_large_test(const int points_num)
+{
+  const Array<float3> points = random_points(points_num, 1234);
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_num);
+  for (int i = 0; i < points_num; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+
+  for (int i = 0; i < points_num; i += 97) {
+    KDTreeNearest_3d nearest;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, points[i], &nearest), i);
+    EXPECT_EQ(nearest.dist, 0.0f);
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
+
+static void calc_duplicates_large_test(const int points_num, const bool use_index_order)
+{
+  /* Every point is inserted twice, at a small offset. */
+  const Array<float3> points = random_points(points_num, 4321);
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_num * 2);
+  for (int i = 0; i < points_num; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+    BLI_kdtree_3d_insert(tree, points_num + i, points[i] + float3(1e-6f, 0.0f, 0.0f));
+  }
+  BLI_kdtree_3d_balance(tree);
+
+  Array<int> duplicates(points_num * 2, -1);
+  const int found = BLI_kdtree_3d_calc_duplicates_fast(
+      tree, 1e-5f, use_index_order, duplicates.data());
+  EXPECT_EQ(found, points_num);
+  for (int i = 0; i < points_num; i++) {
+    /* One of each pair is merged into the other, which is kept. */
+    const int a = duplicates[i];
+    const int b = duplicates[points_num + i];
+    EXPECT_TRUE((a == i && b == i) || (a == points_num + i && b == points_num + i));
+    if (use_index_order) {
+      EXPECT_EQ(a, i);
+    }
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
+
+static void batch_test(const int points_num, const int queries_num)
+{
+  const Array<float3> points = random_points(points_num, 1);
+  const Array<float3> queries = random_points(queries_num, 2);
+  const float(*queries_co)[3] = reinterpret_cast<const float(*)[3]>(queries.data());
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_num);
+  for (int i = 0; i < points_num; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+
+  const int nearest_len_capacity = 4;
+  Array<KDTreeNearest_3d> nearest_batch(queries_num * nearest_len_capacity);
+  Array<int> nearest_len_batch(queries_num);
+  BLI_kdtree_3d_find_nearest_n_batch(tree,
+                                     queries_co,
+                                     queries_num,
+                                     nearest_batch.data(),
+                                     nearest_len_capacity,
+                                     nearest_len_batch.data());
+
+  const float range = 0.1f;
+  Array<std::atomic<int>> found_batch(queries_num);
+  for (std::atomic<int> &found : found_batch) {
+    found = 0;
+  }
+  BLI_kdtree_3d_range_search_batch_cb_cpp(
+      tree,
+      queries_co,
+      queries_num,
+      range,
+      [&](const int co_index, const int /*index*/, const float * /*co*/, const float dist_sq) {
+        EXPECT_LE(dist_sq, range * range);
+        found_batch[co_index]++;
+        return true;
+      });
+
+  for (int i = 0; i < queries_num; i++) {
+    KDTreeNearest_3d nearest[nearest_len_capacity];
+    const int nearest_len = BLI_kdtree_3d_find_nearest_n(
+        tree, queries[i], nearest, nearest_len_capacity);
+    EXPECT_EQ(nearest_len_batch[i], nearest_len);
+    for (int j = 0; j < nearest_len; j++) {
+      EXPECT_EQ(nearest_batch[i * nearest_len_capacity + j].index, nearest[j].index);
+      EXPECT_EQ(nearest_batch[i * nearest_len_capacity + j].dist, nearest[j].dist);
+    }
+
+    KDTreeNearest_3d *found = nullptr;
+    const int found_num = BLI_kdtree_3d_range_search(tree, queries[i], &found, range);
+    EXPECT_EQ(found_batch[i], found_num);
+    if (found) {
+      MEM_freeN(found);
+    }
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
+
 TEST(kdtree, Standard)
 {
   standard_test();
@@ -63,3 +191,23 @@ TEST(kdtree, Deduplicate)
 {
   deduplicate_test();
 }
+
+TEST(kdtree, FindNearestLarge)
+{
+  find_nearest_large_test(100000);
+}
+
+TEST(kdtree, CalcDuplicatesLarge)
+{
+  calc_duplicates_large_test(20000, false);
+}
+
+TEST(kdtree, CalcDuplicatesLargeIndexOrder)
+{
+  calc_duplicates_large_test(20000, true);
+}
+
+TEST(kdtree, Batch)
+{
+  batch_test(10000, 1000);
+}
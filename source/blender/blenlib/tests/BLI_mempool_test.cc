@@ -0,0 +1,98 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include <atomic>
+
+#include "BLI_mempool.hh"
+#include "BLI_task.h"
+#include "BLI_vector.hh"
+
+namespace blender::mempool::tests {
+
+struct Elem {
+  int value;
+  int padding[3];
+};
+
+/** Create a pool with holes in it, returns the used elements. */
+static Vector<Elem *> fill_pool_with_holes(BLI_mempool *pool, const int elems_num)
+{
+  Vector<Elem *> elems;
+  for (int i = 0; i < elems_num; i++) {
+    Elem *elem = static_cast<Elem *>(BLI_mempool_alloc(pool));
+    elem->value = i;
+    elems.append(elem);
+  }
+  Vector<Elem *> used_elems;
+  for (const int i : elems.index_range()) {
+    if (i % 3 == 0 || (i / 100) % 4 == 1) {
+      BLI_mempool_free(pool, elems[i]);
+    }
+    else {
+      used_elems.append(elems[i]);
+    }
+  }
+  return used_elems;
+}
+
+TEST(mempool, ChunksView)
+{
+  BLI_mempool *pool = BLI_mempool_create(sizeof(Elem), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+  const Vector<Elem *> used_elems = fill_pool_with_holes(pool, 1000);
+
+  const ChunksView chunks(pool);
+  EXPECT_EQ(chunks.size(), BLI_mempool_chunks_len(pool));
+  EXPECT_GE(chunks.chunk_capacity() * chunks.size(), 1000);
+
+  /* All used elements are found once, in iteration order. */
+  Vector<Elem *> found_elems;
+  Array<void *> buffer(chunks.chunk_capacity());
+  for (const int64_t chunk_index : chunks.index_range()) {
+    for (void *elem : chunks.used_elems(chunk_index, buffer)) {
+      found_elems.append(static_cast<Elem *>(elem));
+    }
+  }
+  EXPECT_EQ(found_elems.as_span(), used_elems.as_span());
+
+  BLI_mempool_destroy(pool);
+}
+
+TEST(mempool, ChunksViewEmpty)
+{
+  BLI_mempool *pool = BLI_mempool_create(sizeof(Elem), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+  EXPECT_EQ(ChunksView(pool).size(), 0);
+  parallel_for_each_chunk(pool, 1, [&](Span<void *> /*elems*/) { FAIL(); });
+  BLI_mempool_destroy(pool);
+}
+
+TEST(mempool, ParallelForEach)
+{
+  BLI_task_scheduler_init();
+  BLI_mempool *pool = BLI_mempool_create(sizeof(Elem), 0, 32, BLI_MEMPOOL_ALLOW_ITER);
+  const Vector<Elem *> used_elems = fill_pool_with_holes(pool, 10000);
+
+  for (const int64_t grain_size : {1, 100, 1000000}) {
+    std::atomic<int> elems_num = 0;
+    std::atomic<int64_t> sum = 0;
+    parallel_for_each<Elem>(pool, grain_size, [&](Elem &elem) {
+      elems_num++;
+      sum += elem.value;
+      elem.value++;
+    });
+    EXPECT_EQ(elems_num, used_elems.size());
+
+    int64_t expected_sum = 0;
+    for (Elem *elem : used_elems) {
+      expected_sum += elem->value - 1;
+    }
+    EXPECT_EQ(sum, expected_sum);
+  }
+
+  BLI_mempool_destroy(pool);
+  BLI_task_scheduler_exit();
+}
+
+}  // namespace blender::mempool::tests
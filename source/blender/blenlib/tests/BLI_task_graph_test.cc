@@ -4,9 +4,15 @@
 
 #include "testing/testing.h"
 
+#include <atomic>
+
 #include "MEM_guardedalloc.h"
 
+#include "BLI_array.hh"
+#include "BLI_index_mask.hh"
 #include "BLI_task.h"
+#include "BLI_task_graph.hh"
+#include "BLI_vector.hh"
 
 struct TaskData {
   int value;
@@ -190,3 +196,150 @@ TEST(task, GraphTaskData)
   EXPECT_EQ(1, data.value);
   EXPECT_EQ(0, data.store);
 }
+
+namespace blender::threading::tests {
+
+/** A layered graph where every node depends on a few nodes of the previous layer. */
+static Vector<int2> layered_graph_edges(const int layers_num, const int layer_size)
+{
+  Vector<int2> edges;
+  for (const int layer : IndexRange(1, layers_num - 1)) {
+    for (const int i : IndexRange(layer_size)) {
+      const int node = layer * layer_size + i;
+      for (const int offset : {0, 1, 3}) {
+        edges.append({(layer - 1) * layer_size + (i + offset) % layer_size, node});
+      }
+    }
+  }
+  return edges;
+}
+
+static void test_execution_order(const TaskGraph::ExecuteSettings &settings)
+{
+  const int layers_num = 20;
+  const int layer_size = 50;
+  const int nodes_num = layers_num * layer_size;
+  const Vector<int2> edges = layered_graph_edges(layers_num, layer_size);
+  TaskGraph graph(nodes_num, edges);
+  BLI_task_scheduler_init(); /* Without this, no parallelism. */
+
+  Array<std::atomic<int>> order(nodes_num);
+  std::atomic<int> counter = 0;
+  for (std::atomic<int> &value : order) {
+    value = -1;
+  }
+  const bool finished = graph.execute(
+      IndexRange(nodes_num),
+      [&](const int node) {
+        EXPECT_EQ(order[node].load(), -1);
+        order[node] = counter++;
+      },
+      settings);
+  EXPECT_TRUE(finished);
+
+  EXPECT_EQ(counter.load(), nodes_num);
+  for (const int2 &edge : edges) {
+    EXPECT_LT(order[edge[0]].load(), order[edge[1]].load());
+  }
+}
+
+TEST(task_graph, ExecutionOrder)
+{
+  test_execution_order({});
+}
+
+TEST(task_graph, ExecutionOrderSingleThreaded)
+{
+  TaskGraph::ExecuteSettings settings;
+  settings.single_threaded = true;
+  test_execution_order(settings);
+}
+
+TEST(task_graph, TopologicalOrder)
+{
+  const Vector<int2> edges = layered_graph_edges(5, 7);
+  const TaskGraph graph(35, edges);
+  Array<int> position(35);
+  for (const int i : graph.topological_order().index_range()) {
+    position[graph.topological_order()[i]] = i;
+  }
+  for (const int2 &edge : edges) {
+    EXPECT_LT(position[edge[0]], position[edge[1]]);
+  }
+}
+
+TEST(task_graph, Mask)
+{
+  /* A chain of nodes, only every second node is executed. */
+  const int nodes_num = 100;
+  Vector<int2> edges;
+  for (const int i : IndexRange(nodes_num - 1)) {
+    edges.append({i, i + 1});
+  }
+  TaskGraph graph(nodes_num, edges);
+  IndexMaskMemory memory;
+  const IndexMask mask = IndexMask::from_predicate(
+      IndexRange(nodes_num), GrainSize(16), memory, [](const int i) { return i % 2 == 0; });
+
+  Array<bool> executed(nodes_num, false);
+  graph.execute(mask, [&](const int node) { executed[node] = true; });
+  for (const int i : IndexRange(nodes_num)) {
+    EXPECT_EQ(executed[i], i % 2 == 0);
+  }
+}
+
+TEST(task_graph, CriticalPathPriorities)
+{
+  /* Node 0 starts a long chain 0 -> 1 -> 2, node 3 and 4 are independent. */
+  TaskGraph graph(5, {{0, 1}, {1, 2}});
+  graph.set_critical_path_priorities({1.0f, 2.0f, 3.0f, 1.0f, 4.0f});
+  EXPECT_EQ(graph.priorities(), Span<float>({6.0f, 5.0f, 3.0f, 1.0f, 4.0f}));
+
+  TaskGraph::ExecuteSettings settings;
+  settings.single_threaded = true;
+  Vector<int> order;
+  graph.execute(IndexRange(5), [&](const int node) { order.append(node); }, settings);
+  EXPECT_EQ(order.as_span(), Span<int>({0, 1, 4, 2, 3}));
+}
+
+TEST(task_graph, Cancel)
+{
+  const int nodes_num = 1000;
+  Vector<int2> edges;
+  for (const int i : IndexRange(nodes_num - 1)) {
+    edges.append({i, i + 1});
+  }
+  TaskGraph graph(nodes_num, edges);
+  BLI_task_scheduler_init();
+  std::atomic<int> executed = 0;
+  EXPECT_FALSE(graph.execute(IndexRange(nodes_num), [&](const int node) {
+    executed++;
+    if (node == 10) {
+      graph.cancel();
+    }
+  }));
+  EXPECT_EQ(executed.load(), 11);
+
+  /* The graph can be executed again after cancelling. */
+  executed = 0;
+  EXPECT_TRUE(graph.execute(IndexRange(nodes_num), [&](const int /*node*/) { executed++; }));
+  EXPECT_EQ(executed.load(), nodes_num);
+}
+
+TEST(task_graph, Timings)
+{
+  TaskGraph graph(3, {{0, 1}, {1, 2}});
+  TaskGraph::ExecuteSettings settings;
+  settings.capture_timings = true;
+  IndexMaskMemory memory;
+  graph.execute(
+      IndexMask::from_indices<int>({0, 1}, memory), [](const int /*node*/) {}, settings);
+  const Span<TaskGraph::NodeTiming> timings = graph.timings();
+  EXPECT_GE(timings[0].thread, 0);
+  EXPECT_GE(timings[1].thread, 0);
+  EXPECT_EQ(timings[2].thread, -1);
+  EXPECT_LE(timings[0].start, timings[0].end);
+  EXPECT_LE(timings[0].end, timings[1].start);
+}
+
+}  // namespace blender::threading::tests
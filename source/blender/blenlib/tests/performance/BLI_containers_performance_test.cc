@@ -0,0 +1,598 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+/** \file
+ * Benchmarks for blenlib containers and algorithms.
+ *
+ * Every test runs one benchmark multiple times and prints the result on a line starting with
+ * `BENCHMARK_RESULT: `, followed by a JSON object with the name and the minimum, median and mean
+ * time in seconds. These lines are parsed by `tests/performance/tests/blenlib.py`, so that the
+ * timings can be tracked over revisions. Run a single benchmark with `--gtest_filter`.
+ *
+ * All input data is generated from fixed seeds, so that every run uses the same data.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_function_ref.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_kdopbvh.h"
+#include "BLI_kdtree.h"
+#include "BLI_map.hh"
+#include "BLI_math_vector_types.hh"
+#include "BLI_rand.hh"
+#include "BLI_set.hh"
+#include "BLI_task.h"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+#include "BLI_vector_set.hh"
+#include "BLI_virtual_array.hh"
+
+namespace blender::tests {
+
+/** Every benchmark is repeated until it ran at least this long, or #max_iterations times. */
+static constexpr double min_total_time = 0.5;
+static constexpr int min_iterations = 3;
+static constexpr int max_iterations = 100;
+
+class BenchmarkTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite()
+  {
+    BLI_task_scheduler_init();
+  }
+
+  static void TearDownTestSuite()
+  {
+    BLI_task_scheduler_exit();
+  }
+};
+
+static volatile int64_t result_sink = 0;
+
+/** Keep the compiler from optimizing away computations whose result is not used otherwise. */
+static void use_result(const int64_t value)
+{
+  result_sink = value;
+}
+
+/**
+ * Time \a fn, with \a setup called before every run without being timed, and print the result.
+ */
+static void run_benchmark(const char *name,
+                          const FunctionRef<void()> fn,
+                          const FunctionRef<void()> setup = {})
+{
+  using Clock = std::chrono::steady_clock;
+  Vector<double> times;
+  double total_time = 0.0;
+  while (times.size() < max_iterations &&
+         (times.size() < min_iterations || total_time < min_total_time))
+  {
+    if (setup) {
+      setup();
+    }
+    const Clock::time_point start = Clock::now();
+    fn();
+    const double time = std::chrono::duration<double>(Clock::now() - start).count();
+    times.append(time);
+    total_time += time;
+  }
+  std::sort(times.begin(), times.end());
+  const double median = times[times.size() / 2];
+  const double mean = total_time / double(times.size());
+
+  printf("%-40s min %10.6f s, median %10.6f s (%d runs)\n",
+         name,
+         times.first(),
+         median,
+         int(times.size()));
+  printf("BENCHMARK_RESULT: {\"name\": \"%s\", \"time\": %.9f, \"median\": %.9f, \"mean\": %.9f, "
+         "\"iterations\": %d}\n",
+         name,
+         times.first(),
+         median,
+         mean,
+         int(times.size()));
+}
+
+static Array<int> random_ints(const int64_t size, const int max, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<int> values(size);
+  for (int &value : values) {
+    value = rng.get_int32(max);
+  }
+  return values;
+}
+
+static Array<float3> random_points(const int64_t size, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<float3> points(size);
+  for (float3 &point : points) {
+    point = float3(rng.get_float(), rng.get_float(), rng.get_float());
+  }
+  return points;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Hash Tables
+ * \{ */
+
+static constexpr int64_t hash_size = 1'000'000;
+
+TEST_F(BenchmarkTest, map_add_int)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 0);
+  run_benchmark("map_add_int", [&]() {
+    Map<int, int> map;
+    for (const int key : keys) {
+      map.add(key, key);
+    }
+    use_result(map.size());
+  });
+}
+
+TEST_F(BenchmarkTest, map_lookup_int)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 0);
+  const Array<int> queries = random_ints(hash_size, INT32_MAX, 1);
+  Map<int, int> map;
+  for (const int key : keys) {
+    map.add(key, key);
+  }
+  run_benchmark("map_lookup_int", [&]() {
+    int64_t found = 0;
+    for (const int key : keys) {
+      found += map.lookup_default(key, 0);
+    }
+    for (const int key : queries) {
+      found += map.contains(key);
+    }
+    use_result(found);
+  });
+}
+
+TEST_F(BenchmarkTest, map_add_string)
+{
+  const Array<int> values = random_ints(hash_size / 10, INT32_MAX, 2);
+  Vector<std::string> keys;
+  for (const int value : values) {
+    keys.append("key_" + std::to_string(value));
+  }
+  run_benchmark("map_add_string", [&]() {
+    Map<std::string, int> map;
+    for (const std::string &key : keys) {
+      map.add(key, 0);
+    }
+    use_result(map.size());
+  });
+}
+
+TEST_F(BenchmarkTest, set_add_int)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 3);
+  run_benchmark("set_add_int", [&]() {
+    Set<int> set;
+    for (const int key : keys) {
+      set.add(key);
+    }
+    use_result(set.size());
+  });
+}
+
+TEST_F(BenchmarkTest, set_contains_int)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 3);
+  const Array<int> queries = random_ints(hash_size, INT32_MAX, 4);
+  const Set<int> set(keys.as_span());
+  run_benchmark("set_contains_int", [&]() {
+    int64_t found = 0;
+    for (const int key : queries) {
+      found += set.contains(key);
+    }
+    use_result(found);
+  });
+}
+
+TEST_F(BenchmarkTest, vector_set_add_int)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 5);
+  run_benchmark("vector_set_add_int", [&]() {
+    VectorSet<int> set;
+    for (const int key : keys) {
+      set.add(key);
+    }
+    use_result(set.size());
+  });
+}
+
+TEST_F(BenchmarkTest, vector_set_index_of)
+{
+  const Array<int> keys = random_ints(hash_size, INT32_MAX, 5);
+  const VectorSet<int> set(keys.as_span());
+  run_benchmark("vector_set_index_of", [&]() {
+    int64_t sum = 0;
+    for (const int key : keys) {
+      sum += set.index_of(key);
+    }
+    use_result(sum);
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Vector
+ * \{ */
+
+TEST_F(BenchmarkTest, vector_append_int)
+{
+  run_benchmark("vector_append_int", []() {
+    Vector<int> vector;
+    for (int i = 0; i < 10'000'000; i++) {
+      vector.append(i);
+    }
+    use_result(vector.last());
+  });
+}
+
+TEST_F(BenchmarkTest, vector_append_small_int)
+{
+  /* Many small vectors that mostly use the inline buffer. */
+  run_benchmark("vector_append_small_int", []() {
+    int64_t sum = 0;
+    for (int i = 0; i < 1'000'000; i++) {
+      Vector<int> vector;
+      for (int j = 0; j < (i % 8); j++) {
+        vector.append(j);
+      }
+      sum += vector.size();
+    }
+    use_result(sum);
+  });
+}
+
+TEST_F(BenchmarkTest, vector_append_string)
+{
+  run_benchmark("vector_append_string", []() {
+    Vector<std::string> vector;
+    for (int i = 0; i < 1'000'000; i++) {
+      vector.append(std::string(i % 32, 'a'));
+    }
+    use_result(vector.size());
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Index Mask
+ * \{ */
+
+static constexpr int64_t mask_size = 10'000'000;
+
+/** Booleans with long runs of the same value, similar to typical selections. */
+static Array<bool> random_selection(const int64_t size, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Array<bool> selection(size);
+  bool value = false;
+  for (bool &selected : selection) {
+    if (rng.get_int32(64) == 0) {
+      value = !value;
+    }
+    selected = value;
+  }
+  return selection;
+}
+
+TEST_F(BenchmarkTest, index_mask_from_bools)
+{
+  const Array<bool> selection = random_selection(mask_size, 6);
+  run_benchmark("index_mask_from_bools", [&]() {
+    IndexMaskMemory memory;
+    const IndexMask mask = IndexMask::from_bools(selection, memory);
+    use_result(mask.size());
+  });
+}
+
+TEST_F(BenchmarkTest, index_mask_from_bools_sparse)
+{
+  RandomNumberGenerator rng(7);
+  Array<bool> selection(mask_size);
+  for (bool &selected : selection) {
+    selected = rng.get_int32(100) == 0;
+  }
+  run_benchmark("index_mask_from_bools_sparse", [&]() {
+    IndexMaskMemory memory;
+    const IndexMask mask = IndexMask::from_bools(selection, memory);
+    use_result(mask.size());
+  });
+}
+
+TEST_F(BenchmarkTest, index_mask_from_predicate)
+{
+  const Array<int> values = random_ints(mask_size, 100, 8);
+  run_benchmark("index_mask_from_predicate", [&]() {
+    IndexMaskMemory memory;
+    const IndexMask mask = IndexMask::from_predicate(
+        values.index_range(), GrainSize(4096), memory, [&](const int64_t i) {
+          return values[i] < 50;
+        });
+    use_result(mask.size());
+  });
+}
+
+TEST_F(BenchmarkTest, index_mask_from_union)
+{
+  const Array<bool> selection_a = random_selection(mask_size, 9);
+  const Array<bool> selection_b = random_selection(mask_size, 10);
+  IndexMaskMemory memory;
+  const IndexMask mask_a = IndexMask::from_bools(selection_a, memory);
+  const IndexMask mask_b = IndexMask::from_bools(selection_b, memory);
+  run_benchmark("index_mask_from_union", [&]() {
+    IndexMaskMemory union_memory;
+    const IndexMask mask = IndexMask::from_union(mask_a, mask_b, union_memory);
+    use_result(mask.size());
+  });
+}
+
+TEST_F(BenchmarkTest, index_mask_foreach_index)
+{
+  const Array<bool> selection = random_selection(mask_size, 11);
+  const Array<int> values = random_ints(mask_size, 100, 12);
+  IndexMaskMemory memory;
+  const IndexMask mask = IndexMask::from_bools(selection, memory);
+  run_benchmark("index_mask_foreach_index", [&]() {
+    int64_t sum = 0;
+    mask.foreach_index([&](const int64_t i) { sum += values[i]; });
+    use_result(sum);
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Threading
+ * \{ */
+
+TEST_F(BenchmarkTest, parallel_for_small_grain)
+{
+  /* Mostly measures the overhead of scheduling tasks. */
+  Array<int> values(100'000, 0);
+  run_benchmark("parallel_for_small_grain", [&]() {
+    threading::parallel_for(values.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        values[i]++;
+      }
+    });
+    use_result(values[0]);
+  });
+}
+
+TEST_F(BenchmarkTest, parallel_for_large_grain)
+{
+  Array<float> values(10'000'000, 1.0f);
+  run_benchmark("parallel_for_large_grain", [&]() {
+    threading::parallel_for(values.index_range(), 4096, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        values[i] = values[i] * 0.5f + 1.0f;
+      }
+    });
+    use_result(int64_t(values[0]));
+  });
+}
+
+TEST_F(BenchmarkTest, parallel_for_nested)
+{
+  Array<int> values(1'000'000, 0);
+  run_benchmark("parallel_for_nested", [&]() {
+    threading::parallel_for(IndexRange(100), 1, [&](const IndexRange outer) {
+      for (const int64_t i : outer) {
+        const IndexRange inner_range(i * 10'000, 10'000);
+        threading::parallel_for(inner_range, 512, [&](const IndexRange inner) {
+          for (const int64_t j : inner) {
+            values[j]++;
+          }
+        });
+      }
+    });
+    use_result(values[0]);
+  });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Virtual Arrays
+ * \{ */
+
+static constexpr int64_t varray_size = 10'000'000;
+
+static int64_t sum_varray(const VArray<int> &varray, const bool devirtualize)
+{
+  int64_t sum = 0;
+  devirtualize_varray(
+      varray,
+      [&](const auto &values) {
+        for (const int64_t i : varray.index_range()) {
+          sum += values[i];
+        }
+      },
+      devirtualize);
+  return sum;
+}
+
+TEST_F(BenchmarkTest, varray_span_devirtualized)
+{
+  const Array<int> values = random_ints(varray_size, 100, 13);
+  const VArray<int> varray = VArray<int>::ForSpan(values);
+  run_benchmark("varray_span_devirtualized", [&]() { use_result(sum_varray(varray, true)); });
+}
+
+TEST_F(BenchmarkTest, varray_span_virtual)
+{
+  const Array<int> values = random_ints(varray_size, 100, 13);
+  const VArray<int> varray = VArray<int>::ForSpan(values);
+  run_benchmark("varray_span_virtual", [&]() { use_result(sum_varray(varray, false)); });
+}
+
+TEST_F(BenchmarkTest, varray_single_devirtualized)
+{
+  const VArray<int> varray = VArray<int>::ForSingle(3, varray_size);
+  run_benchmark("varray_single_devirtualized", [&]() { use_result(sum_varray(varray, true)); });
+}
+
+TEST_F(BenchmarkTest, varray_func)
+{
+  const VArray<int> varray = VArray<int>::ForFunc(varray_size,
+                                                  [](const int64_t i) { return int(i % 7); });
+  run_benchmark("varray_func", [&]() { use_result(sum_varray(varray, true)); });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Spatial Trees
+ * \{ */
+
+static constexpr int64_t tree_points_num = 1'000'000;
+static constexpr int64_t tree_queries_num = 100'000;
+
+static BVHTree *build_bvhtree(const Span<float3> points)
+{
+  BVHTree *tree = BLI_bvhtree_new(int(points.size()), 0.0f, 2, 6);
+  for (const int i : points.index_range()) {
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+TEST_F(BenchmarkTest, bvhtree_build)
+{
+  const Array<float3> points = random_points(tree_points_num, 14);
+  run_benchmark("bvhtree_build", [&]() {
+    BVHTree *tree = build_bvhtree(points);
+    use_result(BLI_bvhtree_get_len(tree));
+    BLI_bvhtree_free(tree);
+  });
+}
+
+TEST_F(BenchmarkTest, bvhtree_find_nearest)
+{
+  const Array<float3> points = random_points(tree_points_num, 14);
+  const Array<float3> queries = random_points(tree_queries_num, 15);
+  BVHTree *tree = build_bvhtree(points);
+  run_benchmark("bvhtree_find_nearest", [&]() {
+    int64_t sum = 0;
+    for (const float3 &query : queries) {
+      BVHTreeNearest nearest;
+      nearest.index = -1;
+      nearest.dist_sq = FLT_MAX;
+      sum += BLI_bvhtree_find_nearest(tree, query, &nearest, nullptr, nullptr);
+    }
+    use_result(sum);
+  });
+  BLI_bvhtree_free(tree);
+}
+
+TEST_F(BenchmarkTest, bvhtree_overlap_self)
+{
+  const Array<float3> points = random_points(tree_points_num / 10, 16);
+  BVHTree *tree = BLI_bvhtree_new(int(points.size()), 0.001f, 4, 6);
+  for (const int i : points.index_range()) {
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+  run_benchmark("bvhtree_overlap_self", [&]() {
+    uint overlap_num = 0;
+    BVHTreeOverlap *overlap = BLI_bvhtree_overlap_self(tree, &overlap_num, nullptr, nullptr);
+    use_result(overlap_num);
+    MEM_SAFE_FREE(overlap);
+  });
+  BLI_bvhtree_free(tree);
+}
+
+static KDTree_3d *build_kdtree(const Span<float3> points)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(uint(points.size()));
+  for (const int i : points.index_range()) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+TEST_F(BenchmarkTest, kdtree_build)
+{
+  const Array<float3> points = random_points(tree_points_num, 17);
+  run_benchmark("kdtree_build", [&]() {
+    KDTree_3d *tree = build_kdtree(points);
+    BLI_kdtree_3d_free(tree);
+  });
+}
+
+TEST_F(BenchmarkTest, kdtree_find_nearest)
+{
+  const Array<float3> points = random_points(tree_points_num, 17);
+  const Array<float3> queries = random_points(tree_queries_num, 18);
+  KDTree_3d *tree = build_kdtree(points);
+  run_benchmark("kdtree_find_nearest", [&]() {
+    int64_t sum = 0;
+    for (const float3 &query : queries) {
+      sum += BLI_kdtree_3d_find_nearest(tree, query, nullptr);
+    }
+    use_result(sum);
+  });
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST_F(BenchmarkTest, kdtree_find_nearest_n_batch)
+{
+  const int nearest_num = 8;
+  const Array<float3> points = random_points(tree_points_num, 17);
+  const Array<float3> queries = random_points(tree_queries_num, 18);
+  KDTree_3d *tree = build_kdtree(points);
+  Array<KDTreeNearest_3d> nearest(queries.size() * nearest_num);
+  Array<int> nearest_lens(queries.size());
+  run_benchmark("kdtree_find_nearest_n_batch", [&]() {
+    BLI_kdtree_3d_find_nearest_n_batch(tree,
+                                       reinterpret_cast<const float(*)[3]>(queries.data()),
+                                       uint(queries.size()),
+                                       nearest.data(),
+                                       nearest_num,
+                                       nearest_lens.data());
+    use_result(nearest_lens[0]);
+  });
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST_F(BenchmarkTest, kdtree_calc_duplicates_fast)
+{
+  const Array<float3> points = random_points(tree_points_num, 19);
+  KDTree_3d *tree = build_kdtree(points);
+  Array<int> duplicates(points.size());
+  run_benchmark(
+      "kdtree_calc_duplicates_fast",
+      [&]() {
+        use_result(BLI_kdtree_3d_calc_duplicates_fast(tree, 0.002f, false, duplicates.data()));
+      },
+      [&]() { duplicates.fill(-1); });
+  BLI_kdtree_3d_free(tree);
+}
+
+/** \} */
+
+}  // namespace blender::tests
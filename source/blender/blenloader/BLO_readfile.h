@@ -250,6 +250,18 @@ void BLO_datablock_info_linklist_free(struct LinkNode * /*BLODataBlockInfo*/ dat
  * \return A handle on success, or NULL on failure.
  */
 BlendHandle *BLO_blendhandle_from_file(const char *filepath, struct BlendFileReadReport *reports);
+/**
+ * Same as #BLO_blendhandle_from_file, but uses a cached index of the block headers
+ * (stored in the user cache directory and checked against the file size, modification time and
+ * the first and last block headers), so that listing and linking data-blocks of files that were
+ * opened before doesn't have to walk through the whole file.
+ *
+ * \param update_index_cache: Create or update the cache when it can't be used. Only worth it
+ * when the file is expected to be opened again, e.g. when linking from it.
+ */
+BlendHandle *BLO_blendhandle_from_file_indexed(const char *filepath,
+                                               struct BlendFileReadReport *reports,
+                                               bool update_index_cache);
 /**
  * Open a blendhandle from memory.
  *
@@ -14,6 +14,7 @@
 #include "BLI_map.hh"
 
 struct Main;
+struct MemFileChunkBuffer;
 struct Scene;
 
 struct MemFileChunk {
@@ -21,7 +22,12 @@ struct MemFileChunk {
   const char *buf;
   /** Size in bytes. */
   size_t size;
-  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
+  /**
+   * Reference counted owner of #buf. Chunks with the same content share their buffer, in the
+   * same or in any other undo step.
+   */
+  MemFileChunkBuffer *buffer;
+  /** When true, this chunk is identical to the one at the same position in the previous step. */
   bool is_identical;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
@@ -84,6 +90,8 @@ void BLO_memfile_free(MemFile *memfile);
 /**
  * Result is that 'first' is being freed.
  * To keep the #MemFile linked list of consistent, `first` is always first in list.
+ *
+ * \note Chunk buffers are reference counted, so buffers still used by `second` are kept.
  */
 void BLO_memfile_merge(MemFile *first, MemFile *second);
 /**
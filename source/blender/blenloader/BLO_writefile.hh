@@ -43,6 +43,14 @@ struct BlendFileWriteParams {
   uint use_save_as_copy : 1;
   uint use_userdef : 1;
   const BlendThumbnail *thumb;
+  /** Zstandard compression level used for compressed files, zero to use the default. */
+  int compression_level;
+  /**
+   * Number of threads used to compress the file, zero to use all available threads.
+   * Data-blocks are serialized in parallel using the task scheduler, unless this is one,
+   * which writes them on the calling thread only.
+   */
+  int threads_num;
 };
 
 /**
@@ -73,6 +73,20 @@ BlendHandle *BLO_blendhandle_from_file(const char *filepath, BlendFileReadReport
   return bh;
 }
 
+BlendHandle *BLO_blendhandle_from_file_indexed(const char *filepath,
+                                               BlendFileReadReport *reports,
+                                               const bool update_index_cache)
+{
+  BlendHandle *bh;
+
+  bh = (BlendHandle *)blo_filedata_from_file(
+      filepath,
+      reports,
+      update_index_cache ? BHEAD_INDEX_CACHE_READ_WRITE : BHEAD_INDEX_CACHE_READ);
+
+  return bh;
+}
+
 BlendHandle *BLO_blendhandle_from_memory(const void *mem,
                                          int memsize,
                                          BlendFileReadReport *reports)
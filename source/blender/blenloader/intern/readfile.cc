@@ -6,6 +6,7 @@
  * \ingroup blenloader
  */
 
+#include <algorithm>
 #include <cctype> /* for isdigit. */
 #include <cerrno>
 #include <climits>
@@ -14,6 +15,7 @@
 #include <cstdlib> /* for atoi. */
 #include <ctime>   /* for gmtime. */
 #include <fcntl.h> /* for open flags (O_BINARY, O_RDONLY). */
+#include <filesystem>
 
 #include "BLI_utildefines.h"
 #ifndef WIN32
@@ -51,16 +53,20 @@
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
+#include "BLI_hash.hh"
+#include "BLI_hash_md5.hh"
 #include "BLI_linklist.h"
 #include "BLI_map.hh"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
 #include "BLI_threads.h"
 #include "BLI_time.h"
+#include "BLI_vector.hh"
 
 #include "BLT_translation.h"
 
 #include "BKE_anim_data.h"
+#include "BKE_appdir.hh"
 #include "BKE_animsys.h"
 #include "BKE_asset.hh"
 #include "BKE_blender_version.h"
@@ -902,6 +908,387 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   }
   return &new_bhead_data->bhead;
 }
+
+/**
+ * Create the #FileData.bhead_list from an index of all block headers,
+ * in the format described at #BLO_BHEAD_INDEX_MAGIC (without the trailer).
+ */
+static bool bhead_list_from_index(FileData *fd, const char *index, const size_t index_size)
+{
+  BLI_assert(BLI_listbase_is_empty(&fd->bhead_list));
+
+  ListBase bhead_list = {nullptr, nullptr};
+  const char *index_end = index + index_size;
+  const char *pos = index;
+  bool success = false;
+  while (true) {
+    uint64_t data_offset;
+    BHead bhead;
+    if (index_end - pos < int64_t(sizeof(data_offset) + sizeof(bhead))) {
+      break;
+    }
+    memcpy(&data_offset, pos, sizeof(data_offset));
+    memcpy(&bhead, pos + sizeof(data_offset), sizeof(bhead));
+    pos += sizeof(data_offset) + sizeof(bhead);
+    if (bhead.len < 0) {
+      break;
+    }
+
+    BHeadN *new_bhead;
+    if (BHEAD_USE_READ_ON_DEMAND(&bhead)) {
+      new_bhead = static_cast<BHeadN *>(MEM_mallocN(sizeof(BHeadN), "new_bhead"));
+      new_bhead->file_offset = off64_t(data_offset);
+      new_bhead->has_data = false;
+    }
+    else {
+      if (index_end - pos < bhead.len) {
+        break;
+      }
+      new_bhead = static_cast<BHeadN *>(
+          MEM_mallocN(sizeof(BHeadN) + size_t(bhead.len), "new_bhead"));
+      new_bhead->file_offset = 0; /* don't seek. */
+      new_bhead->has_data = true;
+      memcpy(new_bhead + 1, pos, size_t(bhead.len));
+      pos += bhead.len;
+    }
+    new_bhead->next = new_bhead->prev = nullptr;
+    new_bhead->is_memchunk_identical = false;
+    new_bhead->bhead = bhead;
+    BLI_addtail(&bhead_list, new_bhead);
+
+    if (bhead.code == BLO_CODE_ENDB) {
+      success = true;
+      break;
+    }
+  }
+
+  if (!success) {
+    BLI_freelistN(&bhead_list);
+    return false;
+  }
+
+  fd->bhead_list = bhead_list;
+  /* All blocks are known, there is nothing left to read sequentially. */
+  fd->is_eof = true;
+  return true;
+}
+
+/**
+ * The index can only be used when blocks don't need conversion
+ * and the data of #BLO_CODE_DATA blocks can be read on demand.
+ */
+static bool bhead_index_supported(const FileData *fd)
+{
+  return fd->file->seek != nullptr && !(fd->flags & FD_FLAGS_IS_MEMFILE) &&
+         !(fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS));
+}
+
+/**
+ * Compressed files written by Blender end with an index of all block headers
+ * (see #BLO_BHEAD_INDEX_MAGIC). Loading the whole #FileData.bhead_list from it only decompresses
+ * the frames at the end of the file, the data of #BLO_CODE_DATA blocks is then read on demand
+ * from the frames that hold it, so linking a few data-blocks from a large library stays cheap.
+ *
+ * \return false when the file has no usable index, leaving the file position unchanged.
+ */
+static bool read_bhead_index(FileData *fd)
+{
+  if (!bhead_index_supported(fd)) {
+    return false;
+  }
+  FileReader *file = fd->file;
+
+  const off64_t header_end = file->offset;
+  const off64_t trailer_offset = file->seek(
+      file, -off64_t(BLO_BHEAD_INDEX_TRAILER_SIZE), SEEK_END);
+
+  char trailer[BLO_BHEAD_INDEX_TRAILER_SIZE];
+  uint64_t index_size = 0;
+  int magic = 0;
+  if (trailer_offset > header_end &&
+      file->read(file, trailer, sizeof(trailer)) == int64_t(sizeof(trailer)))
+  {
+    memcpy(&index_size, trailer, sizeof(index_size));
+    memcpy(&magic, trailer + sizeof(index_size), sizeof(magic));
+  }
+
+  bool success = false;
+  if (magic == BLO_BHEAD_INDEX_MAGIC && index_size <= uint64_t(trailer_offset - header_end) &&
+      file->seek(file, trailer_offset - off64_t(index_size), SEEK_SET) != -1)
+  {
+    char *index = static_cast<char *>(MEM_mallocN(size_t(index_size), __func__));
+    success = file->read(file, index, size_t(index_size)) == int64_t(index_size) &&
+              bhead_list_from_index(fd, index, size_t(index_size));
+    MEM_freeN(index);
+  }
+
+  if (!success) {
+    file->seek(file, header_end, SEEK_SET);
+  }
+  return success;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Block Header Index Cache
+ *
+ * Files that don't store the block header index themselves (uncompressed files, or files written
+ * by older versions) can have it cached in the user cache directory, so that browsing and linking
+ * from asset libraries doesn't have to walk all block headers of every file again.
+ *
+ * Cache files are named after the hash and name of the blend-file path. They store the size and
+ * modification time of the blend-file they were created from and a hash of its file header, first
+ * and last block headers, followed by the index. A cache that doesn't match its blend-file or
+ * can't be read is deleted. The modification time is compared with the full resolution of the
+ * file system, since the headers rarely differ between versions of a file and it can be written
+ * again within the same second.
+ *
+ * The index holds the data of all blocks other than #BLO_CODE_DATA, so it's only cached when it's
+ * much smaller than the blend-file. The least recently used cache files are removed when the
+ * total size of the cache directory exceeds #BHEAD_INDEX_CACHE_MAX_SIZE.
+ * \{ */
+
+#define BHEAD_INDEX_CACHE_VERSION 3
+#define BHEAD_INDEX_CACHE_EXTENSION ".bhead_index"
+/** Total size of all cache files. */
+#define BHEAD_INDEX_CACHE_MAX_SIZE (int64_t(256) << 20)
+/** Only cache indices smaller than the blend-file size divided by this. */
+#define BHEAD_INDEX_CACHE_MIN_FILE_RATIO 4
+
+struct BHeadIndexCacheHeader {
+  char magic[8];
+  int version;
+  int bhead_size;
+  int64_t file_size;
+  /** In the units of `std::filesystem::file_time_type`, see #bhead_index_cache_file_mtime. */
+  int64_t file_mtime;
+  /** MD5 of the file header, the first and the last block header of the blend-file. */
+  uchar file_hash[16];
+};
+
+static const char bhead_index_cache_magic[8] = {'B', 'L', 'O', 'I', 'N', 'D', 'E', 'X'};
+
+static bool bhead_index_cache_directory(char *r_cache_dir, const size_t cache_dir_maxncpy)
+{
+  char caches_dir[FILE_MAX];
+  if (!BKE_appdir_folder_caches(caches_dir, sizeof(caches_dir))) {
+    return false;
+  }
+  BLI_path_join(r_cache_dir, cache_dir_maxncpy, caches_dir, "blend-file-indices");
+  return true;
+}
+
+bool blo_bhead_index_cache_filepath(const char *filepath,
+                                    char *r_cache_filepath,
+                                    const size_t cache_filepath_maxncpy)
+{
+  char cache_dir[FILE_MAX];
+  if (!bhead_index_cache_directory(cache_dir, sizeof(cache_dir))) {
+    return false;
+  }
+  char cache_filename[FILE_MAXFILE];
+  SNPRINTF(cache_filename,
+           "%016llx_%s" BHEAD_INDEX_CACHE_EXTENSION,
+           (unsigned long long)blender::get_default_hash(blender::StringRef(filepath)),
+           BLI_path_basename(filepath));
+  BLI_path_join(r_cache_filepath, cache_filepath_maxncpy, cache_dir, cache_filename);
+  return true;
+}
+
+/**
+ * Hash the file header followed by the first block header, and the last block header, which
+ * is #BLO_CODE_ENDB for files that don't store an index. Keeps the file position unchanged.
+ */
+static bool bhead_index_cache_file_hash(FileData *fd, uchar r_hash[16])
+{
+  FileReader *file = fd->file;
+  const off64_t offset = file->offset;
+
+  char data[SIZEOFBLENDERHEADER + sizeof(BHead) * 2];
+  const int64_t head_size = SIZEOFBLENDERHEADER + sizeof(BHead);
+  const bool success = file->seek(file, 0, SEEK_SET) == 0 &&
+                       file->read(file, data, head_size) == head_size &&
+                       file->seek(file, -off64_t(sizeof(BHead)), SEEK_END) != -1 &&
+                       file->read(file, data + head_size, sizeof(BHead)) ==
+                           int64_t(sizeof(BHead));
+  file->seek(file, offset, SEEK_SET);
+  if (success) {
+    BLI_hash_md5_buffer(data, sizeof(data), r_hash);
+  }
+  return success;
+}
+
+/**
+ * Modification time of the file with the resolution of the file system, unlike #BLI_stat which
+ * only has seconds on some platforms.
+ */
+static bool bhead_index_cache_file_mtime(const char *filepath, int64_t *r_mtime)
+{
+  std::error_code error;
+  const std::filesystem::file_time_type mtime = std::filesystem::last_write_time(
+      std::filesystem::u8path(filepath), error);
+  if (error) {
+    return false;
+  }
+  *r_mtime = int64_t(mtime.time_since_epoch().count());
+  return true;
+}
+
+static bool bhead_index_cache_header_init(FileData *fd, BHeadIndexCacheHeader *r_header)
+{
+  BLI_stat_t st;
+  int64_t mtime;
+  if (BLI_stat(fd->relabase, &st) == -1 || !bhead_index_cache_file_mtime(fd->relabase, &mtime)) {
+    return false;
+  }
+  memset(r_header, 0, sizeof(*r_header));
+  memcpy(r_header->magic, bhead_index_cache_magic, sizeof(r_header->magic));
+  r_header->version = BHEAD_INDEX_CACHE_VERSION;
+  r_header->bhead_size = int(sizeof(BHead));
+  r_header->file_size = int64_t(st.st_size);
+  r_header->file_mtime = mtime;
+  return bhead_index_cache_file_hash(fd, r_header->file_hash);
+}
+
+/**
+ * Load the block headers from the cache, if it was created from the same version of the file.
+ * Caches that are out of date or invalid are deleted.
+ */
+static bool bhead_index_cache_read(FileData *fd)
+{
+  char cache_filepath[FILE_MAX];
+  BHeadIndexCacheHeader header;
+  if (!bhead_index_supported(fd) ||
+      !blo_bhead_index_cache_filepath(fd->relabase, cache_filepath, sizeof(cache_filepath)) ||
+      !BLI_exists(cache_filepath) || !bhead_index_cache_header_init(fd, &header))
+  {
+    return false;
+  }
+
+  size_t cache_size = 0;
+  char *cache = static_cast<char *>(BLI_file_read_binary_as_mem(cache_filepath, 0, &cache_size));
+  const bool success = cache != nullptr && cache_size > sizeof(header) &&
+                       memcmp(cache, &header, sizeof(header)) == 0 &&
+                       bhead_list_from_index(
+                           fd, cache + sizeof(header), cache_size - sizeof(header));
+  MEM_SAFE_FREE(cache);
+
+  if (success) {
+    /* Mark as recently used, see #bhead_index_cache_evict. */
+    BLI_file_touch(cache_filepath);
+  }
+  else {
+    BLI_delete(cache_filepath, false, false);
+  }
+  return success;
+}
+
+/**
+ * Delete the least recently used cache files until their total size is below
+ * #BHEAD_INDEX_CACHE_MAX_SIZE.
+ */
+static void bhead_index_cache_evict()
+{
+  char cache_dir[FILE_MAX];
+  if (!bhead_index_cache_directory(cache_dir, sizeof(cache_dir))) {
+    return;
+  }
+  direntry *entries;
+  const uint entries_num = BLI_filelist_dir_contents(cache_dir, &entries);
+
+  blender::Vector<const direntry *> cache_files;
+  int64_t total_size = 0;
+  for (const direntry &entry : blender::Span<direntry>(entries, entries_num)) {
+    if (S_ISREG(entry.s.st_mode) &&
+        BLI_path_extension_check(entry.relname, BHEAD_INDEX_CACHE_EXTENSION))
+    {
+      cache_files.append(&entry);
+      total_size += int64_t(entry.s.st_size);
+    }
+  }
+
+  if (total_size > BHEAD_INDEX_CACHE_MAX_SIZE) {
+    std::sort(cache_files.begin(), cache_files.end(), [](const direntry *a, const direntry *b) {
+      return a->s.st_mtime < b->s.st_mtime;
+    });
+    for (const direntry *entry : cache_files) {
+      if (total_size <= BHEAD_INDEX_CACHE_MAX_SIZE) {
+        break;
+      }
+      /* Another process may be deleting the same file. */
+      BLI_delete(entry->path, false, false);
+      total_size -= int64_t(entry->s.st_size);
+    }
+  }
+
+  BLI_filelist_free(entries, entries_num);
+}
+
+/**
+ * Store the block headers of the whole file in the cache. All headers are read to do so, but
+ * this is cheap after #read_file_dna, since #BLO_CODE_DNA1 is written just before the end.
+ */
+static void bhead_index_cache_write(FileData *fd)
+{
+  char cache_filepath[FILE_MAX];
+  BHeadIndexCacheHeader header;
+  if (!bhead_index_supported(fd) ||
+      !blo_bhead_index_cache_filepath(fd->relabase, cache_filepath, sizeof(cache_filepath)) ||
+      !bhead_index_cache_header_init(fd, &header))
+  {
+    return;
+  }
+
+  const int64_t max_size = header.file_size / BHEAD_INDEX_CACHE_MIN_FILE_RATIO;
+  blender::Vector<char> index;
+  index.extend(blender::Span<char>(reinterpret_cast<const char *>(&header), sizeof(header)));
+  BHead *bhead;
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+    const BHeadN *new_bhead = BHEADN_FROM_BHEAD(bhead);
+    const uint64_t data_offset = uint64_t(new_bhead->has_data ? 0 : new_bhead->file_offset);
+    index.extend(
+        blender::Span<char>(reinterpret_cast<const char *>(&data_offset), sizeof(data_offset)));
+    index.extend(blender::Span<char>(reinterpret_cast<const char *>(bhead), sizeof(*bhead)));
+    if (new_bhead->has_data) {
+      BLI_assert(!BHEAD_USE_READ_ON_DEMAND(bhead));
+      index.extend(blender::Span<char>(reinterpret_cast<const char *>(bhead + 1), bhead->len));
+    }
+    if (index.size() > max_size) {
+      /* Reading the file itself is about as fast as reading the index. */
+      return;
+    }
+    if (bhead->code == BLO_CODE_ENDB) {
+      break;
+    }
+  }
+  if (bhead == nullptr) {
+    /* Truncated file. */
+    return;
+  }
+
+  /* Write to a temporary file first, so that concurrent readers never see a partial index. */
+  char cache_filepath_temp[FILE_MAX];
+  SNPRINTF(cache_filepath_temp, "%s@", cache_filepath);
+  if (!BLI_file_ensure_parent_dir_exists(cache_filepath_temp)) {
+    return;
+  }
+  FILE *file = BLI_fopen(cache_filepath_temp, "wb");
+  if (file == nullptr) {
+    return;
+  }
+  const bool written = fwrite(index.data(), 1, size_t(index.size()), file) ==
+                       size_t(index.size());
+  if ((fclose(file) != 0) || !written || BLI_rename_overwrite(cache_filepath_temp, cache_filepath))
+  {
+    BLI_delete(cache_filepath_temp, false, false);
+    CLOG_WARN(&LOG, "Failed to write block header index cache '%s'", cache_filepath);
+    return;
+  }
+
+  bhead_index_cache_evict();
+}
+
+/** \} */
+
 #endif /* USE_BHEAD_READ_ON_DEMAND */
 
 const char *blo_bhead_id_name(const FileData *fd, const BHead *bhead)
@@ -1129,11 +1516,27 @@ static bool is_minversion_older_than_blender(FileData *fd, ReportList *reports)
   return false;
 }
 
-static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
+/**
+ * \param bhead_index_cache: Read the block headers from the cache in the user cache directory if
+ * possible, and optionally update the cache otherwise (requires #FileData.relabase).
+ */
+static FileData *blo_decode_and_check(
+    FileData *fd,
+    ReportList *reports,
+    const eBHeadIndexCacheMode bhead_index_cache = BHEAD_INDEX_CACHE_NONE)
 {
   decode_blender_header(fd);
 
   if (fd->flags & FD_FLAGS_FILE_OK) {
+    bool update_bhead_index_cache = false;
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    if (!read_bhead_index(fd) && bhead_index_cache != BHEAD_INDEX_CACHE_NONE) {
+      update_bhead_index_cache = !bhead_index_cache_read(fd) &&
+                                 bhead_index_cache == BHEAD_INDEX_CACHE_READ_WRITE;
+    }
+#else
+    UNUSED_VARS(bhead_index_cache);
+#endif
     const char *error_message = nullptr;
     if (read_file_dna(fd, &error_message) == false) {
       BKE_reportf(
@@ -1145,6 +1548,11 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
       blo_filedata_free(fd);
       fd = nullptr;
     }
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    else if (update_bhead_index_cache) {
+      bhead_index_cache_write(fd);
+    }
+#endif
   }
   else {
     BKE_reportf(
@@ -1237,14 +1645,16 @@ static FileData *blo_filedata_from_file_open(const char *filepath, BlendFileRead
   return blo_filedata_from_file_descriptor(filepath, reports, file);
 }
 
-FileData *blo_filedata_from_file(const char *filepath, BlendFileReadReport *reports)
+FileData *blo_filedata_from_file(const char *filepath,
+                                 BlendFileReadReport *reports,
+                                 const eBHeadIndexCacheMode bhead_index_cache)
 {
   FileData *fd = blo_filedata_from_file_open(filepath, reports);
   if (fd != nullptr) {
     /* needed for library_append and read_libraries */
     STRNCPY(fd->relabase, filepath);
 
-    return blo_decode_and_check(fd, reports->reports);
+    return blo_decode_and_check(fd, reports->reports, bhead_index_cache);
   }
   return nullptr;
 }
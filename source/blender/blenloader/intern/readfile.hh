@@ -48,6 +48,15 @@ enum eFileDataFlag {
 };
 ENUM_OPERATORS(eFileDataFlag, FD_FLAGS_NOT_MY_LIBMAP)
 
+/** Use of the cached index of the block headers in the user cache directory. */
+enum eBHeadIndexCacheMode {
+  BHEAD_INDEX_CACHE_NONE = 0,
+  /** Read the block headers from the cache when it's up to date. */
+  BHEAD_INDEX_CACHE_READ = 1,
+  /** Also create or update the cache when it can't be used. */
+  BHEAD_INDEX_CACHE_READ_WRITE = 2,
+};
+
 /* Disallow since it's 32bit on ms-windows. */
 #ifdef __GNUC__
 #  pragma GCC poison off_t
@@ -153,8 +162,20 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath);
  * On each new library added, it now checks for the current #FileData and expands relativeness
  *
  * cannot be called with relative paths anymore!
+ *
+ * \param bhead_index_cache: Use of the cached index of the block headers in the user cache
+ * directory, avoids walking all block headers when the file is opened again.
+ */
+FileData *blo_filedata_from_file(const char *filepath,
+                                 BlendFileReadReport *reports,
+                                 eBHeadIndexCacheMode bhead_index_cache = BHEAD_INDEX_CACHE_NONE);
+/**
+ * Path of the cached block header index of the blend-file at \a filepath.
+ * \return false when there is no cache directory.
  */
-FileData *blo_filedata_from_file(const char *filepath, BlendFileReadReport *reports);
+bool blo_bhead_index_cache_filepath(const char *filepath,
+                                    char *r_cache_filepath,
+                                    size_t cache_filepath_maxncpy);
 FileData *blo_filedata_from_memory(const void *mem, int memsize, BlendFileReadReport *reports);
 FileData *blo_filedata_from_memfile(MemFile *memfile,
                                     const BlendFileReadParams *params,
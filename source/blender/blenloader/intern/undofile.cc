@@ -12,6 +12,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
+#include <mutex>
+#include <utility>
 
 /* open/close */
 #ifndef _WIN32
@@ -25,6 +27,8 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_hash_mm2a.hh"
+#include "BLI_map.hh"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.hh"
@@ -38,45 +42,112 @@
 
 /* **************** support for memory-write, for undo buffers *************** */
 
-void BLO_memfile_free(MemFile *memfile)
+/** Size and content hash of a buffer. */
+using MemFileChunkBufferKey = std::pair<size_t, uint32_t>;
+
+/**
+ * Memory of #MemFileChunk, shared by all chunks with the same content in any undo step.
+ *
+ * Comparing chunks with the one at the same position in the previous step only finds data that
+ * didn't move. Buffers are therefore also registered by a hash of their content, so unchanged
+ * data is only stored once, even when data written before it grew or shrank.
+ */
+struct MemFileChunkBuffer {
+  char *data;
+  size_t size;
+  /** Key in #MemFileChunkBuffers::map. */
+  MemFileChunkBufferKey key;
+  /** Chunks using this buffer. */
+  int users;
+  /** False when a different buffer with the same key was registered already. */
+  bool is_registered;
+};
+
+struct MemFileChunkBuffers {
+  /** Undo steps may be freed from other threads than the one writing them. */
+  std::mutex mutex;
+  blender::Map<MemFileChunkBufferKey, MemFileChunkBuffer *> map;
+};
+
+static MemFileChunkBuffers &memfile_chunk_buffers()
 {
-  while (MemFileChunk *chunk = static_cast<MemFileChunk *>(BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
-      MEM_freeN((void *)chunk->buf);
-    }
-    MEM_freeN(chunk);
+  static MemFileChunkBuffers buffers;
+  return buffers;
+}
+
+static MemFileChunkBufferKey memfile_chunk_buffer_key(const char *buf, const size_t size)
+{
+  return {size, BLI_hash_mm2(reinterpret_cast<const uchar *>(buf), size, 0)};
+}
+
+/**
+ * Find a buffer with the same content or create a new one.
+ * \return True when the buffer was newly allocated.
+ */
+static bool memfile_chunk_buffer_ensure(const char *buf,
+                                        const size_t size,
+                                        MemFileChunkBuffer **r_buffer)
+{
+  MemFileChunkBuffers &buffers = memfile_chunk_buffers();
+  const MemFileChunkBufferKey key = memfile_chunk_buffer_key(buf, size);
+
+  std::scoped_lock lock(buffers.mutex);
+  MemFileChunkBuffer *existing = buffers.map.lookup_default(key, nullptr);
+  if (existing != nullptr && existing->size == size && memcmp(existing->data, buf, size) == 0) {
+    existing->users++;
+    *r_buffer = existing;
+    return false;
   }
-  memfile->size = 0;
+
+  MemFileChunkBuffer *buffer = MEM_new<MemFileChunkBuffer>(__func__);
+  buffer->data = static_cast<char *>(MEM_mallocN(size, "Chunk buffer"));
+  memcpy(buffer->data, buf, size);
+  buffer->size = size;
+  buffer->key = key;
+  buffer->users = 1;
+  /* On hash collisions keep the first buffer, the new one just isn't shared. */
+  buffer->is_registered = buffers.map.add(key, buffer);
+  *r_buffer = buffer;
+  return true;
+}
+
+static void memfile_chunk_buffer_add_user(MemFileChunkBuffer *buffer)
+{
+  std::scoped_lock lock(memfile_chunk_buffers().mutex);
+  buffer->users++;
 }
 
-void BLO_memfile_merge(MemFile *first, MemFile *second)
+static void memfile_chunk_buffer_remove_user(MemFileChunkBuffer *buffer)
 {
-  /* We use this mapping to store the memory buffers from second memfile chunks which are not owned
-   * by it (i.e. shared with some previous memory steps). */
-  blender::Map<const char *, MemFileChunk *> buffer_to_second_memchunk;
-
-  /* First, detect all memchunks in second memfile that are not owned by it. */
-  LISTBASE_FOREACH (MemFileChunk *, sc, &second->chunks) {
-    if (sc->is_identical) {
-      buffer_to_second_memchunk.add(sc->buf, sc);
+  MemFileChunkBuffers &buffers = memfile_chunk_buffers();
+  std::scoped_lock lock(buffers.mutex);
+  BLI_assert(buffer->users > 0);
+  if (--buffer->users > 0) {
+    return;
+  }
+  if (buffer->is_registered) {
+    buffers.map.remove(buffer->key);
+    if (buffers.map.is_empty()) {
+      /* Don't keep memory around when there are no undo steps. */
+      buffers.map.clear_and_shrink();
     }
   }
+  MEM_freeN(buffer->data);
+  MEM_delete(buffer);
+}
 
-  /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
-   * it is also used by the second memfile, transfer the ownership. */
-  LISTBASE_FOREACH (MemFileChunk *, fc, &first->chunks) {
-    if (!fc->is_identical) {
-      if (MemFileChunk *sc = buffer_to_second_memchunk.lookup_default(fc->buf, nullptr)) {
-        BLI_assert(sc->is_identical);
-        sc->is_identical = false;
-        fc->is_identical = true;
-      }
-      /* Note that if the second memfile does not use that chunk, we assume that the first one
-       * fully owns it without sharing it with any other memfile, and hence it should be freed with
-       * it. */
-    }
+void BLO_memfile_free(MemFile *memfile)
+{
+  while (MemFileChunk *chunk = static_cast<MemFileChunk *>(BLI_pophead(&memfile->chunks))) {
+    memfile_chunk_buffer_remove_user(chunk->buffer);
+    MEM_freeN(chunk);
   }
+  memfile->size = 0;
+}
 
+void BLO_memfile_merge(MemFile *first, MemFile * /*second*/)
+{
+  /* Buffers shared with the second memfile are kept alive by their users count. */
   BLO_memfile_free(first);
 }
 
@@ -127,6 +198,7 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
       MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk"));
   curchunk->size = size;
   curchunk->buf = nullptr;
+  curchunk->buffer = nullptr;
   curchunk->is_identical = false;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
@@ -141,6 +213,8 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
     if (compchunk->size == curchunk->size) {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
+        curchunk->buffer = compchunk->buffer;
+        memfile_chunk_buffer_add_user(curchunk->buffer);
         curchunk->is_identical = true;
         compchunk->is_identical_future = true;
       }
@@ -150,10 +224,11 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
 
   /* not equal... */
   if (curchunk->buf == nullptr) {
-    char *buf_new = static_cast<char *>(MEM_mallocN(size, "Chunk buffer"));
-    memcpy(buf_new, buf, size);
-    curchunk->buf = buf_new;
-    memfile->size += size;
+    /* The data may still exist elsewhere in the undo stack, only count new memory. */
+    if (memfile_chunk_buffer_ensure(buf, size, &curchunk->buffer)) {
+      memfile->size += size;
+    }
+    curchunk->buf = curchunk->buffer->data;
   }
 }
 
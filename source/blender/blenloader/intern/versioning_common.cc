@@ -13,10 +13,13 @@
 #include "DNA_node_types.h"
 #include "DNA_screen_types.h"
 
+#include "BLI_hash_mm2a.hh"
 #include "BLI_listbase.h"
 #include "BLI_map.hh"
 #include "BLI_string.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
 
 #include "BKE_animsys.h"
 #include "BKE_idprop.h"
@@ -461,6 +464,45 @@ void version_update_node_input(
   }
 }
 
+#ifndef NDEBUG
+/** Hash of the #ID struct of every data-block, which includes the links of the list. */
+static blender::Vector<uint32_t> version_id_headers_hash(const blender::Span<ID *> ids)
+{
+  blender::Vector<uint32_t> hashes;
+  for (const ID *id : ids) {
+    hashes.append(BLI_hash_mm2(reinterpret_cast<const uchar *>(id), sizeof(ID), 0));
+  }
+  return hashes;
+}
+#endif
+
+void version_foreach_id_parallel(ListBase &ids, FunctionRef<void(ID &id)> fn)
+{
+  blender::Vector<ID *> ids_vector;
+  LISTBASE_FOREACH (ID *, id, &ids) {
+    ids_vector.append(id);
+  }
+#ifndef NDEBUG
+  /* Callbacks run concurrently, so they must not add, remove, rename or re-tag data-blocks, or
+   * change user counts, not even of their own data-block. */
+  const blender::Vector<uint32_t> id_hashes = version_id_headers_hash(ids_vector);
+#endif
+
+  /* Data-blocks can be very different in size, so distribute them one by one. */
+  blender::threading::parallel_for(
+      ids_vector.index_range(), 1, [&](const blender::IndexRange range) {
+        for (const int64_t i : range) {
+          fn(*ids_vector[i]);
+        }
+      });
+
+#ifndef NDEBUG
+  BLI_assert_msg(BLI_listbase_count(&ids) == ids_vector.size() &&
+                     version_id_headers_hash(ids_vector) == id_hashes,
+                 "Parallel versioning callback changed data-blocks other than its own data");
+#endif
+}
+
 static bool blendfile_or_libraries_versions_atleast(Main *bmain,
                                                     const short versionfile,
                                                     const short subversionfile)
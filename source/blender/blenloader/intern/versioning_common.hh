@@ -144,3 +144,17 @@ void version_update_node_input(
     const char *socket_identifier,
     FunctionRef<void(bNode *, bNodeSocket *)> update_input,
     FunctionRef<void(bNode *, bNodeSocket *, bNode *, bNodeSocket *)> update_input_link);
+
+/**
+ * Call \a fn for every data-block in \a ids (one of the #Main lists), distributed over multiple
+ * threads. Only use this for versioning that reads and writes data owned by each data-block
+ * itself (e.g. converting legacy mesh layers), never other data-blocks, #Main or global state.
+ *
+ * All data-blocks are processed before this returns, so versioning that depends on the result
+ * still runs in the order it is written in. In debug builds, it asserts that the list and the
+ * #ID structs of its data-blocks are unchanged afterwards.
+ *
+ * \note Only these per-data-block versioning steps run in parallel. Reading direct data and
+ * lib-linking stay serial, since they share the #FileData and its old to new address maps.
+ */
+void version_foreach_id_parallel(ListBase &ids, FunctionRef<void(ID &id)> fn);
@@ -58,6 +58,8 @@
  *   - #BLENDER_USERPREF_FILE (on UNIX `~/.config/blender/X.X/config/userpref.blend`).
  */
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <climits>
 #include <cmath>
@@ -87,6 +89,7 @@
 #include "DNA_key_types.h"
 #include "DNA_sdna_types.h"
 
+#include "BLI_array.hh"
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
 #include "BLI_endian_defines.h"
@@ -95,7 +98,9 @@
 #include "BLI_linklist.h"
 #include "BLI_math_base.h"
 #include "BLI_mempool.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
+#include "BLI_vector.hh"
 
 #include "MEM_guardedalloc.h" /* MEM_freeN */
 
@@ -198,8 +203,115 @@ bool RawWriteWrap::write(const void *buf, size_t buf_len)
   return ::write(file_handle, buf, buf_len) == buf_len;
 }
 
+/**
+ * Collects written data in memory, used to serialize data-blocks on worker threads
+ * before they are passed on to the file in order.
+ */
+class MemoryWriteWrap : public WriteWrap {
+ public:
+  blender::Vector<char> data;
+
+  MemoryWriteWrap()
+  {
+    /* The data is collected into a single growable array already. */
+    use_buf = false;
+  }
+
+  bool open(const char * /*filepath*/) override
+  {
+    return true;
+  }
+  bool close() override
+  {
+    return true;
+  }
+  bool write(const void *buf, size_t buf_len) override
+  {
+    data.extend(blender::Span<char>(static_cast<const char *>(buf), int64_t(buf_len)));
+    return true;
+  }
+};
+
+/**
+ * Follows the block headers in the uncompressed stream to build the #BLO_BHEAD_INDEX_MAGIC index,
+ * which lets readers find data-blocks in compressed files without decompressing every frame.
+ */
+class BHeadIndexBuilder {
+  /** Offset in the uncompressed stream. */
+  uint64_t offset = 0;
+  /** Bytes to pass over before the next block header (the file header, or #BLO_CODE_DATA). */
+  size_t skip_len = SIZEOFBLENDERHEADER;
+  /** Bytes of block data to copy into the index before the next block header. */
+  size_t copy_len = 0;
+  BHead bhead = {};
+  size_t bhead_filled = 0;
+  bool finished = false;
+
+ public:
+  blender::Vector<char> index;
+
+  void add(const void *buf, const size_t buf_len)
+  {
+    const char *data = static_cast<const char *>(buf);
+    size_t remaining = buf_len;
+    while (remaining > 0 && !finished) {
+      size_t len;
+      if (skip_len > 0) {
+        len = std::min(skip_len, remaining);
+        skip_len -= len;
+      }
+      else if (copy_len > 0) {
+        len = std::min(copy_len, remaining);
+        index.extend(blender::Span<char>(data, int64_t(len)));
+        copy_len -= len;
+      }
+      else {
+        len = std::min(sizeof(BHead) - bhead_filled, remaining);
+        memcpy(reinterpret_cast<char *>(&bhead) + bhead_filled, data, len);
+        bhead_filled += len;
+        if (bhead_filled == sizeof(BHead)) {
+          bhead_filled = 0;
+          const uint64_t data_offset = offset + len;
+          index.extend(blender::Span<char>(reinterpret_cast<const char *>(&data_offset),
+                                           sizeof(data_offset)));
+          index.extend(
+              blender::Span<char>(reinterpret_cast<const char *>(&bhead), sizeof(bhead)));
+          if (bhead.code == BLO_CODE_ENDB) {
+            finished = true;
+          }
+          else if (bhead.code == BLO_CODE_DATA) {
+            skip_len = size_t(bhead.len);
+          }
+          else {
+            copy_len = size_t(bhead.len);
+          }
+        }
+      }
+      data += len;
+      offset += len;
+      remaining -= len;
+    }
+  }
+
+  /** Append the trailer, only valid once the whole file up to #BLO_CODE_ENDB was added. */
+  bool finish()
+  {
+    if (!finished) {
+      return false;
+    }
+    const uint64_t index_size = uint64_t(index.size());
+    const int magic = BLO_BHEAD_INDEX_MAGIC;
+    index.extend(
+        blender::Span<char>(reinterpret_cast<const char *>(&index_size), sizeof(index_size)));
+    index.extend(blender::Span<char>(reinterpret_cast<const char *>(&magic), sizeof(magic)));
+    return true;
+  }
+};
+
 class ZstdWriteWrap : public WriteWrap {
   WriteWrap &base_wrap;
+  int compression_level;
+  int threads_num;
 
   ListBase threadpool = {};
   ListBase tasks = {};
@@ -210,10 +322,21 @@ class ZstdWriteWrap : public WriteWrap {
 
   ListBase frames = {};
 
+  BHeadIndexBuilder bhead_index;
+
   bool write_error = false;
 
  public:
-  ZstdWriteWrap(WriteWrap &base_wrap) : base_wrap(base_wrap) {}
+  /**
+   * \param compression_level: Zstandard compression level, zero for the default.
+   * \param threads_num: Number of compression threads, zero to choose automatically.
+   */
+  ZstdWriteWrap(WriteWrap &base_wrap, const int compression_level, const int threads_num)
+      : base_wrap(base_wrap),
+        compression_level(compression_level > 0 ? compression_level : ZSTD_COMPRESSION_LEVEL),
+        threads_num(threads_num)
+  {
+  }
 
   bool open(const char *filepath) override;
   bool close() override;
@@ -222,6 +345,8 @@ class ZstdWriteWrap : public WriteWrap {
  private:
   struct ZstdWriteBlockTask;
   void write_task(ZstdWriteBlockTask *task);
+  bool write_frame(const void *buf, size_t buf_len);
+  void write_bhead_index();
   void write_u32_le(uint32_t val);
   void write_seekable_frames();
 };
@@ -246,7 +371,7 @@ void ZstdWriteWrap::write_task(ZstdWriteBlockTask *task)
   size_t out_buf_len = ZSTD_compressBound(task->size);
   void *out_buf = MEM_mallocN(out_buf_len, "Zstd out buffer");
   size_t out_size = ZSTD_compress(
-      out_buf, out_buf_len, task->data, task->size, ZSTD_COMPRESSION_LEVEL);
+      out_buf, out_buf_len, task->data, task->size, compression_level);
 
   MEM_freeN(task->data);
 
@@ -287,7 +412,7 @@ bool ZstdWriteWrap::open(const char *filepath)
   }
 
   /* Leave one thread open for the main writing logic, unless we only have one HW thread. */
-  int num_threads = max_ii(1, BLI_system_thread_count() - 1);
+  int num_threads = threads_num > 0 ? threads_num : max_ii(1, BLI_system_thread_count() - 1);
   BLI_threadpool_init(&threadpool, ZstdWriteBlockTask::write_task, num_threads);
   BLI_mutex_init(&mutex);
   BLI_condition_init(&condition);
@@ -336,8 +461,27 @@ void ZstdWriteWrap::write_seekable_frames()
   write_u32_le(0x8F92EAB1);
 }
 
+/* Compressed files can't be read at arbitrary offsets cheaply, so store an index of the block
+ * headers after the end of the file (see #BLO_BHEAD_INDEX_MAGIC). It goes into the regular
+ * frames so that the seek table covers it, readers that don't know about it stop at
+ * #BLO_CODE_ENDB before reaching it. */
+void ZstdWriteWrap::write_bhead_index()
+{
+  if (write_error || !bhead_index.finish()) {
+    return;
+  }
+  const blender::Span<char> index = bhead_index.index;
+  for (int64_t start = 0; start < index.size(); start += ZSTD_CHUNK_SIZE) {
+    const blender::Span<char> chunk = index.slice(
+        start, std::min<int64_t>(ZSTD_CHUNK_SIZE, index.size() - start));
+    write_frame(chunk.data(), size_t(chunk.size()));
+  }
+}
+
 bool ZstdWriteWrap::close()
 {
+  write_bhead_index();
+
   BLI_threadpool_end(&threadpool);
   BLI_freelistN(&tasks);
 
@@ -356,6 +500,13 @@ bool ZstdWriteWrap::write(const void *buf, size_t buf_len)
     return false;
   }
 
+  bhead_index.add(buf, buf_len);
+  return write_frame(buf, buf_len);
+}
+
+bool ZstdWriteWrap::write_frame(const void *buf, size_t buf_len)
+{
+
   ZstdWriteBlockTask *task = static_cast<ZstdWriteBlockTask *>(
       MEM_mallocN(sizeof(ZstdWriteBlockTask), __func__));
   task->data = MEM_mallocN(buf_len, __func__);
@@ -508,6 +659,54 @@ static void mywrite_flush(WriteData *wd)
   }
 }
 
+/**
+ * Length of the next piece when writing a large block of undo data.
+ *
+ * Splitting at fixed offsets means that inserting or removing data shifts the content of all
+ * following pieces, so none of them can be shared with the previous undo step anymore. Instead
+ * split where a rolling hash of the last bytes matches a pattern, so that the pieces depend on
+ * the content and the ones after an edit are the same as before (see #BLO_memfile_chunk_add).
+ */
+static size_t memfile_split_len(const char *data, const size_t len, const size_t chunk_size)
+{
+  const size_t min_len = chunk_size / 4;
+  const size_t max_len = chunk_size * 2;
+  if (len <= max_len) {
+    return len;
+  }
+
+  /* "Gear" table of random values for each byte value. */
+  static const std::array<uint64_t, 256> gear = []() {
+    std::array<uint64_t, 256> table;
+    uint64_t state = 0x9e3779b97f4a7c15;
+    for (uint64_t &value : table) {
+      /* SplitMix64. */
+      state += 0x9e3779b97f4a7c15;
+      uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      value = z ^ (z >> 31);
+    }
+    return table;
+  }();
+  /* Only the upper bits depend on enough (64) previous bytes. After the minimum length, a piece
+   * ends at each byte with a probability of `2^-mask_bits`. The number of bits is rounded down,
+   * so the expected distance to the end is between 3/8 and 3/4 of `chunk_size`. For the chunk
+   * sizes used here (just below a power of two) it's 1/2, so pieces average about 3/4 of
+   * `chunk_size` including the minimum length, slightly less because of the maximum length. */
+  const int mask_bits = max_ii(1, int(std::log2(double(chunk_size - min_len))));
+  const uint64_t mask = ~uint64_t(0) << (64 - mask_bits);
+
+  uint64_t hash = 0;
+  for (size_t i = min_len; i < max_len; i++) {
+    hash = (hash << 1) + gear[uint8_t(data[i])];
+    if ((hash & mask) == 0) {
+      return i + 1;
+    }
+  }
+  return max_len;
+}
+
 /**
  * Low level WRITE(2) wrapper that buffers data
  * \param adr: Pointer to new chunk of data
@@ -541,7 +740,10 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
       }
 
       do {
-        size_t writelen = std::min(len, wd->buffer.chunk_size);
+        size_t writelen = wd->use_memfile ?
+                              memfile_split_len(
+                                  static_cast<const char *>(adr), len, wd->buffer.chunk_size) :
+                              std::min(len, wd->buffer.chunk_size);
         writedata_do_write(wd, adr, writelen);
         adr = (const char *)adr + writelen;
         len -= writelen;
@@ -1194,11 +1396,152 @@ static int write_id_direct_linked_data_process_cb(LibraryIDLinkCallbackData *cb_
   return IDWALK_RET_NOP;
 }
 
+/**
+ * Whether an ID should not be written at all.
+ */
+static bool write_id_is_skipped(const WriteData *wd, const ID *id)
+{
+  /* We only write unused IDs in undo case. */
+  if (!wd->use_memfile) {
+    /* NOTE: All Scenes, WindowManagers and WorkSpaces should always be written to disk, so
+     * their user-count should never be zero currently. */
+    if (id->us == 0) {
+      BLI_assert(!ELEM(GS(id->name), ID_SCE, ID_WM, ID_WS));
+      return true;
+    }
+
+    /* XXX Special handling for ShapeKeys, as having unused shapekeys is not a good thing
+     * (and reported as error by e.g. `BLO_main_validate_shapekeys`), skip writing shapekeys
+     * when their 'owner' is not written.
+     *
+     * NOTE: Since ShapeKeys are conceptually embedded IDs (like root node trees e.g.), this
+     * behavior actually makes sense anyway. This remains more of a temp hack until topic of
+     * how to handle unused data on save is properly tackled. */
+    if (GS(id->name) == ID_KE) {
+      const Key *shape_key = reinterpret_cast<const Key *>(id);
+      /* NOTE: Here we are accessing the real owner ID data, not it's 'proxy' shallow copy
+       * generated for its file-writing. This is not expected to be an issue, but is worth
+       * noting. */
+      if (shape_key->from == nullptr || shape_key->from->us == 0) {
+        return true;
+      }
+    }
+  }
+
+  if ((id->tag & LIB_TAG_RUNTIME) != 0 && !wd->use_memfile) {
+    /* Runtime IDs are never written to .blend files, and they should not influence
+     * (in)direct status of linked IDs they may use. */
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * Serialize a data-block into \a wrap, used to write data-blocks on worker threads, see
+ * #write_ids_parallel.
+ * \return True if writing failed.
+ */
+static bool write_id_to_memory(ID *id, const IDTypeInfo *id_type, MemoryWriteWrap &wrap)
+{
+  WriteData *wd = mywrite_begin(&wrap, nullptr, nullptr);
+  BlendWriter writer = {wd};
+
+  BLO_Write_IDBuffer *id_buffer = BLO_write_allocate_id_buffer();
+  id_buffer_init_for_id_type(id_buffer, id_type);
+  id_buffer_init_from_id(id_buffer, id, false);
+  id_type->blend_write(&writer, static_cast<ID *>(id_buffer->temp_id), id);
+  BLO_write_destroy_id_buffer(&id_buffer);
+
+  return mywrite_end(wd);
+}
+
+/**
+ * Write all IDs of a list starting at \a first_id, for types that support
+ * #IDTYPE_FLAGS_PARALLEL_BLEND_WRITE. The IDs are serialized into memory in parallel, a batch of
+ * a few IDs per thread at a time, and passed on to \a wd in their original order. The memory
+ * buffers are reused for all batches.
+ *
+ * Work that modifies other IDs (tagging directly linked data) or the written ID itself (library
+ * overrides) is still done on the calling thread.
+ */
+static void write_ids_parallel(WriteData *wd,
+                               Main *bmain,
+                               OverrideLibraryStorage *override_storage,
+                               const IDTypeInfo *id_type,
+                               ID *first_id,
+                               const int threads_num)
+{
+  BLI_assert(!wd->use_memfile);
+
+  blender::Vector<ID *> ids;
+  for (ID *id = first_id; id; id = static_cast<ID *>(id->next)) {
+    BLI_assert(
+        (id->tag & (LIB_TAG_NO_MAIN | LIB_TAG_NO_USER_REFCOUNT | LIB_TAG_NOT_ALLOCATED)) == 0);
+    if (write_id_is_skipped(wd, id)) {
+      continue;
+    }
+    /* Properly set directly linked IDs as `LIB_TAG_EXTERN`. */
+    BKE_library_foreach_ID_link(
+        bmain, id, write_id_direct_linked_data_process_cb, nullptr, IDWALK_READONLY);
+    ids.append(id);
+  }
+  if (ids.is_empty() || id_type->blend_write == nullptr) {
+    return;
+  }
+
+  /* Storing override operations modifies the ID, so those are written on this thread. */
+  const auto is_written_serially = [&](const ID *id) {
+    return !ELEM(override_storage, nullptr, bmain) && ID_IS_OVERRIDE_LIBRARY_REAL(id);
+  };
+
+  const int64_t batch_size = std::min<int64_t>(int64_t(threads_num) * 4, ids.size());
+  blender::Array<MemoryWriteWrap> wraps(batch_size);
+  blender::Array<bool> errors(batch_size);
+
+  BLO_Write_IDBuffer *id_buffer = BLO_write_allocate_id_buffer();
+  id_buffer_init_for_id_type(id_buffer, id_type);
+  BlendWriter writer = {wd};
+
+  for (int64_t batch_start = 0; batch_start < ids.size(); batch_start += batch_size) {
+    const blender::IndexRange batch(batch_start,
+                                    std::min(batch_size, ids.size() - batch_start));
+    blender::threading::parallel_for(batch.index_range(), 1, [&](const blender::IndexRange range) {
+      for (const int64_t i : range) {
+        ID *id = ids[batch[i]];
+        if (!is_written_serially(id)) {
+          errors[i] = write_id_to_memory(id, id_type, wraps[i]);
+        }
+      }
+    });
+
+    for (const int64_t i : batch.index_range()) {
+      ID *id = ids[batch[i]];
+      if (is_written_serially(id)) {
+        BKE_lib_override_library_operations_store_start(bmain, override_storage, id);
+        id_buffer_init_from_id(id_buffer, id, false);
+        id_type->blend_write(&writer, static_cast<ID *>(id_buffer->temp_id), id);
+        BKE_lib_override_library_operations_store_end(override_storage, id);
+        continue;
+      }
+      if (errors[i]) {
+        wd->error = true;
+      }
+      mywrite(wd, wraps[i].data.data(), size_t(wraps[i].data.size()));
+      wraps[i].data.clear();
+    }
+  }
+
+  BLO_write_destroy_id_buffer(&id_buffer);
+}
+
 /**
  * When #MemFile arguments are non-null, this is a file-safe to memory.
  *
  * \param compare: Previous memory file (can be nullptr).
  * \param current: The current memory file (can be nullptr).
+ * \param threads_num: Data-blocks are serialized on multiple threads unless this is one, zero to
+ * use all available threads.
  */
 static bool write_file_handle(Main *mainvar,
                               WriteWrap *ww,
@@ -1206,7 +1549,8 @@ static bool write_file_handle(Main *mainvar,
                               MemFile *current,
                               int write_flags,
                               bool use_userdef,
-                              const BlendThumbnail *thumb)
+                              const BlendThumbnail *thumb,
+                              int threads_num)
 {
   BHead bhead;
   ListBase mainlist;
@@ -1216,6 +1560,10 @@ static bool write_file_handle(Main *mainvar,
   wd = mywrite_begin(ww, compare, current);
   BlendWriter writer = {wd};
 
+  if (threads_num <= 0) {
+    threads_num = BLI_system_thread_count();
+  }
+
   /* Clear 'directly linked' flag for all linked data, these are not necessarily valid/up-to-date
    * info, they will be re-generated while write code is processing local IDs below. */
   if (!wd->use_memfile) {
@@ -1293,42 +1641,21 @@ static bool write_file_handle(Main *mainvar,
       const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
       id_buffer_init_for_id_type(id_buffer, id_type);
 
+      if (!wd->use_memfile && threads_num > 1 &&
+          (id_type->flags & IDTYPE_FLAGS_PARALLEL_BLEND_WRITE))
+      {
+        write_ids_parallel(wd, bmain, override_storage, id_type, id, threads_num);
+        mywrite_flush(wd);
+        continue;
+      }
+
       for (; id; id = static_cast<ID *>(id->next)) {
         /* We should never attempt to write non-regular IDs
          * (i.e. all kind of temp/runtime ones). */
         BLI_assert(
             (id->tag & (LIB_TAG_NO_MAIN | LIB_TAG_NO_USER_REFCOUNT | LIB_TAG_NOT_ALLOCATED)) == 0);
 
-        /* We only write unused IDs in undo case. */
-        if (!wd->use_memfile) {
-          /* NOTE: All Scenes, WindowManagers and WorkSpaces should always be written to disk, so
-           * their user-count should never be zero currently. */
-          if (id->us == 0) {
-            BLI_assert(!ELEM(GS(id->name), ID_SCE, ID_WM, ID_WS));
-            continue;
-          }
-
-          /* XXX Special handling for ShapeKeys, as having unused shapekeys is not a good thing
-           * (and reported as error by e.g. `BLO_main_validate_shapekeys`), skip writing shapekeys
-           * when their 'owner' is not written.
-           *
-           * NOTE: Since ShapeKeys are conceptually embedded IDs (like root node trees e.g.), this
-           * behavior actually makes sense anyway. This remains more of a temp hack until topic of
-           * how to handle unused data on save is properly tackled. */
-          if (GS(id->name) == ID_KE) {
-            Key *shape_key = reinterpret_cast<Key *>(id);
-            /* NOTE: Here we are accessing the real owner ID data, not it's 'proxy' shallow copy
-             * generated for its file-writing. This is not expected to be an issue, but is worth
-             * noting. */
-            if (shape_key->from == nullptr || shape_key->from->us == 0) {
-              continue;
-            }
-          }
-        }
-
-        if ((id->tag & LIB_TAG_RUNTIME) != 0 && !wd->use_memfile) {
-          /* Runtime IDs are never written to .blend files, and they should not influence
-           * (in)direct status of linked IDs they may use. */
+        if (write_id_is_skipped(wd, id)) {
           continue;
         }
 
@@ -1599,7 +1926,7 @@ static bool BLO_write_file_impl(Main *mainvar,
 
   /* Actual file writing. */
   const bool err = write_file_handle(
-      mainvar, &ww, nullptr, nullptr, write_flags, use_userdef, thumb);
+      mainvar, &ww, nullptr, nullptr, write_flags, use_userdef, thumb, params->threads_num);
 
   ww.close();
 
@@ -1649,7 +1976,7 @@ bool BLO_write_file(Main *mainvar,
   RawWriteWrap raw_wrap;
 
   if (write_flags & G_FILE_COMPRESS) {
-    ZstdWriteWrap zstd_wrap(raw_wrap);
+    ZstdWriteWrap zstd_wrap(raw_wrap, params->compression_level, params->threads_num);
     return BLO_write_file_impl(mainvar, filepath, write_flags, params, reports, zstd_wrap);
   }
 
@@ -1660,8 +1987,10 @@ bool BLO_write_file_mem(Main *mainvar, MemFile *compare, MemFile *current, int w
 {
   bool use_userdef = false;
 
+  /* Undo steps are written on a single thread, #MemFile chunks are shared with the previous step
+   * based on the order they are written in. */
   const bool err = write_file_handle(
-      mainvar, nullptr, compare, current, write_flags, use_userdef, nullptr);
+      mainvar, nullptr, compare, current, write_flags, use_userdef, nullptr, 1);
 
   return (err == 0);
 }
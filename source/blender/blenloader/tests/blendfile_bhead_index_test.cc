@@ -0,0 +1,328 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_write_base_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+#include "BKE_appdir.hh"
+#include "BKE_global.h"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_vector.hh"
+
+#include "BLO_blend_defs.hh"
+#include "BLO_readfile.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_sdna_types.h"
+
+#include "intern/readfile.hh"
+
+namespace blender::blenloader::tests {
+
+class BlendfileBHeadIndexTest : public BlendfileWriteBaseTest {
+ protected:
+  void SetUp() override
+  {
+    BlendfileWriteBaseTest::SetUp();
+    /* Keep the caches out of the user cache directory. */
+    BKE_appdir_folder_caches_override_set(BKE_tempdir_session());
+  }
+
+  void TearDown() override
+  {
+    BKE_appdir_folder_caches_override_set(nullptr);
+    BlendfileWriteBaseTest::TearDown();
+  }
+};
+
+static void write_to_file(const std::string &filepath, const Span<char> data, const bool append)
+{
+  FILE *file = BLI_fopen(filepath.c_str(), append ? "ab" : "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(fwrite(data.data(), 1, size_t(data.size()), file), size_t(data.size()));
+  fclose(file);
+}
+
+static void write_to_file(const std::string &filepath, const Span<char> data)
+{
+  write_to_file(filepath, data, false);
+}
+
+/** Append bytes to the end of the file, to simulate a damaged index. */
+static void append_to_file(const std::string &filepath, const Span<char> data)
+{
+  write_to_file(filepath, data, true);
+}
+
+static void append_index_trailer(Vector<char> &data, const uint64_t index_size)
+{
+  const int magic = BLO_BHEAD_INDEX_MAGIC;
+  data.extend(Span<char>(reinterpret_cast<const char *>(&index_size), sizeof(index_size)));
+  data.extend(Span<char>(reinterpret_cast<const char *>(&magic), sizeof(magic)));
+}
+
+/**
+ * Read all block headers of the file.
+ * \param r_used_index: Set when the headers were loaded from the index or its cache rather than
+ * by reading the file up to the end.
+ */
+static Vector<BHead> read_bheads(const std::string &filepath,
+                                 bool *r_used_index,
+                                 const eBHeadIndexCacheMode cache_mode = BHEAD_INDEX_CACHE_NONE)
+{
+  BlendFileReadReport reports{};
+  FileData *fd = blo_filedata_from_file(filepath.c_str(), &reports, cache_mode);
+  if (fd == nullptr) {
+    ADD_FAILURE() << "Unable to open '" << filepath << "'";
+    return {};
+  }
+  /* Reading the DNA stops before the last block, only the index loads all headers at once. */
+  *r_used_index = fd->is_eof;
+
+  Vector<BHead> bheads;
+  for (BHead *bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+    bheads.append(*bhead);
+    if (bhead->code == BLO_CODE_ENDB) {
+      break;
+    }
+  }
+  blo_filedata_free(fd);
+  return bheads;
+}
+
+static void expect_bheads_eq(const Span<BHead> a, const Span<BHead> b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (const int i : a.index_range()) {
+    EXPECT_EQ(a[i].code, b[i].code);
+    EXPECT_EQ(a[i].len, b[i].len);
+    EXPECT_EQ(a[i].old, b[i].old);
+    EXPECT_EQ(a[i].SDNAnr, b[i].SDNAnr);
+    EXPECT_EQ(a[i].nr, b[i].nr);
+  }
+}
+
+TEST_F(BlendfileBHeadIndexTest, CompressedFileRoundTrip)
+{
+  Main *bmain = BKE_main_new();
+  add_meshes(bmain, 10, 100);
+
+  const std::string plain_filepath = temp_filepath("plain.blend");
+  const std::string compressed_filepath = temp_filepath("compressed.blend");
+  write_file(bmain, plain_filepath, 0);
+  write_file(bmain, compressed_filepath, G_FILE_COMPRESS);
+  BKE_main_free(bmain);
+
+  bool plain_used_index = true;
+  bool compressed_used_index = false;
+  const Vector<BHead> plain_bheads = read_bheads(plain_filepath, &plain_used_index);
+  const Vector<BHead> compressed_bheads = read_bheads(compressed_filepath,
+                                                     &compressed_used_index);
+  EXPECT_FALSE(plain_used_index);
+  EXPECT_TRUE(compressed_used_index);
+  EXPECT_FALSE(plain_bheads.is_empty());
+  expect_bheads_eq(plain_bheads, compressed_bheads);
+
+  /* The data of the blocks is read on demand from the frames holding it. */
+  BlendFileReadReport reports{};
+  BlendFileData *bfd = BLO_read_from_file(
+      compressed_filepath.c_str(), BLO_READ_SKIP_NONE, &reports);
+  ASSERT_NE(bfd, nullptr);
+  ASSERT_EQ(BLI_listbase_count(&bfd->main->meshes), 10);
+  LISTBASE_FOREACH (const Mesh *, mesh, &bfd->main->meshes) {
+    ASSERT_EQ(mesh->verts_num, 100);
+    EXPECT_EQ(mesh->vert_positions()[99].y, 99.0f);
+  }
+  BLO_blendfiledata_free(bfd);
+}
+
+TEST_F(BlendfileBHeadIndexTest, DamagedIndexFallsBackToLinearRead)
+{
+  Main *bmain = BKE_main_new();
+  add_meshes(bmain, 10, 100);
+  const std::string reference_filepath = temp_filepath("reference.blend");
+  const std::string invalid_bhead_filepath = temp_filepath("invalid_bhead.blend");
+  const std::string invalid_size_filepath = temp_filepath("invalid_size.blend");
+  const std::string missing_endb_filepath = temp_filepath("missing_endb.blend");
+  write_file(bmain, reference_filepath, 0);
+  write_file(bmain, invalid_bhead_filepath, 0);
+  write_file(bmain, invalid_size_filepath, 0);
+  write_file(bmain, missing_endb_filepath, 0);
+  BKE_main_free(bmain);
+
+  bool used_index = true;
+  const Vector<BHead> reference_bheads = read_bheads(reference_filepath, &used_index);
+  EXPECT_FALSE(used_index);
+  ASSERT_FALSE(reference_bheads.is_empty());
+
+  /* A block header with a negative length. */
+  Vector<char> invalid_bhead(sizeof(uint64_t) + sizeof(BHead), char(0xff));
+  append_index_trailer(invalid_bhead, sizeof(uint64_t) + sizeof(BHead));
+  append_to_file(invalid_bhead_filepath, invalid_bhead);
+
+  /* An index larger than the file. */
+  Vector<char> invalid_size;
+  append_index_trailer(invalid_size, uint64_t(1) << 40);
+  append_to_file(invalid_size_filepath, invalid_size);
+
+  /* An index that stops before the #BLO_CODE_ENDB block. */
+  BHead bhead = reference_bheads.first();
+  bhead.len = 0;
+  Vector<char> missing_endb(sizeof(uint64_t), 0);
+  missing_endb.extend(Span<char>(reinterpret_cast<const char *>(&bhead), sizeof(bhead)));
+  append_index_trailer(missing_endb, uint64_t(missing_endb.size()));
+  append_to_file(missing_endb_filepath, missing_endb);
+
+  for (const std::string &filepath :
+       {invalid_bhead_filepath, invalid_size_filepath, missing_endb_filepath})
+  {
+    used_index = true;
+    const Vector<BHead> bheads = read_bheads(filepath, &used_index);
+    EXPECT_FALSE(used_index) << filepath;
+    expect_bheads_eq(reference_bheads, bheads);
+  }
+}
+
+static std::string bhead_index_cache_filepath(const std::string &filepath)
+{
+  char cache_filepath[FILE_MAX];
+  EXPECT_TRUE(
+      blo_bhead_index_cache_filepath(filepath.c_str(), cache_filepath, sizeof(cache_filepath)));
+  return cache_filepath;
+}
+
+TEST_F(BlendfileBHeadIndexTest, CacheWriteAndRead)
+{
+  Main *bmain = BKE_main_new();
+  /* The index is only cached when it's much smaller than the file. */
+  add_meshes(bmain, 10, 20000);
+  const std::string filepath = temp_filepath("cached.blend");
+  write_file(bmain, filepath, 0);
+  BKE_main_free(bmain);
+  const std::string cache_filepath = bhead_index_cache_filepath(filepath);
+
+  bool used_index = true;
+  const Vector<BHead> reference_bheads = read_bheads(filepath, &used_index);
+  EXPECT_FALSE(used_index);
+
+  /* Browsing files doesn't create caches. */
+  read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ);
+  EXPECT_FALSE(used_index);
+  EXPECT_FALSE(BLI_exists(cache_filepath.c_str()));
+
+  read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ_WRITE);
+  EXPECT_FALSE(used_index);
+  EXPECT_TRUE(BLI_exists(cache_filepath.c_str()));
+
+  const Vector<BHead> cached_bheads = read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ);
+  EXPECT_TRUE(used_index);
+  expect_bheads_eq(reference_bheads, cached_bheads);
+}
+
+TEST_F(BlendfileBHeadIndexTest, CacheSkippedForSmallFiles)
+{
+  Main *bmain = BKE_main_new();
+  /* The file is mostly made of the DNA, which the index would duplicate. */
+  add_meshes(bmain, 1, 10);
+  const std::string filepath = temp_filepath("small.blend");
+  write_file(bmain, filepath, 0);
+  BKE_main_free(bmain);
+
+  bool used_index = true;
+  read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ_WRITE);
+  EXPECT_FALSE(used_index);
+  EXPECT_FALSE(BLI_exists(bhead_index_cache_filepath(filepath).c_str()));
+}
+
+TEST_F(BlendfileBHeadIndexTest, StaleCacheIsDeleted)
+{
+  Main *bmain = BKE_main_new();
+  add_meshes(bmain, 10, 20000);
+  const std::string filepath = temp_filepath("stale.blend");
+  write_file(bmain, filepath, 0);
+  const std::string cache_filepath = bhead_index_cache_filepath(filepath);
+
+  bool used_index = true;
+  read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ_WRITE);
+  ASSERT_TRUE(BLI_exists(cache_filepath.c_str()));
+
+  /* Overwrite the file with different contents and size. */
+  add_meshes(bmain, 1, 20000);
+  write_file(bmain, filepath, 0);
+  BKE_main_free(bmain);
+
+  Vector<BHead> reference_bheads = read_bheads(filepath, &used_index);
+  Vector<BHead> bheads = read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ);
+  EXPECT_FALSE(used_index);
+  EXPECT_FALSE(BLI_exists(cache_filepath.c_str()));
+  expect_bheads_eq(reference_bheads, bheads);
+
+  /* Change the positions of a mesh in place, keeping the size of the file and all block headers.
+   * The file is written again within the same second. */
+  const std::filesystem::file_time_type mtime = std::chrono::floor<std::chrono::seconds>(
+      std::filesystem::last_write_time(filepath));
+  std::filesystem::last_write_time(filepath, mtime);
+  read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ_WRITE);
+  ASSERT_TRUE(BLI_exists(cache_filepath.c_str()));
+  Vector<char> data = read_file(filepath);
+  const float3 position(0.0f, 12345.0f, 0.0f);
+  const Span<char> position_bytes(reinterpret_cast<const char *>(&position), sizeof(position));
+  char *position_in_file = std::search(
+      data.begin(), data.end(), position_bytes.begin(), position_bytes.end());
+  ASSERT_NE(position_in_file, data.end());
+  const float3 new_position(0.0f, 54321.0f, 0.0f);
+  memcpy(position_in_file, &new_position, sizeof(new_position));
+  write_to_file(filepath, data);
+  std::filesystem::last_write_time(filepath, mtime + std::chrono::milliseconds(1));
+
+  reference_bheads = read_bheads(filepath, &used_index);
+  bheads = read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ);
+  EXPECT_FALSE(used_index);
+  EXPECT_FALSE(BLI_exists(cache_filepath.c_str()));
+  expect_bheads_eq(reference_bheads, bheads);
+}
+
+TEST_F(BlendfileBHeadIndexTest, DamagedCacheIsDeleted)
+{
+  Main *bmain = BKE_main_new();
+  add_meshes(bmain, 10, 20000);
+  const std::string filepath = temp_filepath("damaged.blend");
+  write_file(bmain, filepath, 0);
+  BKE_main_free(bmain);
+  const std::string cache_filepath = bhead_index_cache_filepath(filepath);
+
+  bool used_index = true;
+  const Vector<BHead> reference_bheads = read_bheads(filepath, &used_index);
+
+  /* A cache with an unknown header, and a cache that is cut off. */
+  for (const bool truncate : {false, true}) {
+    read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ_WRITE);
+    Vector<char> cache = read_file(cache_filepath);
+    ASSERT_FALSE(cache.is_empty());
+    if (truncate) {
+      cache.resize(cache.size() / 2);
+    }
+    else {
+      cache[0] ^= 1;
+    }
+    write_to_file(cache_filepath, cache);
+
+    const Vector<BHead> bheads = read_bheads(filepath, &used_index, BHEAD_INDEX_CACHE_READ);
+    EXPECT_FALSE(used_index);
+    EXPECT_FALSE(BLI_exists(cache_filepath.c_str()));
+    expect_bheads_eq(reference_bheads, bheads);
+  }
+}
+
+}  // namespace blender::blenloader::tests
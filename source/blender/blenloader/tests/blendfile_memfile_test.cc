@@ -0,0 +1,155 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_loading_base_test.h"
+
+#include <string>
+
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+
+#include "BLI_listbase.h"
+#include "BLI_vector.hh"
+
+#include "BLO_undofile.hh"
+#include "BLO_writefile.hh"
+
+#include "DNA_mesh_types.h"
+
+namespace blender::blenloader::tests {
+
+static void memfile_write(MemFile *memfile, MemFile *reference, const Span<std::string> chunks)
+{
+  MemFileWriteData mem_data{};
+  BLO_memfile_write_init(&mem_data, memfile, reference);
+  for (const std::string &chunk : chunks) {
+    BLO_memfile_chunk_add(&mem_data, chunk.data(), chunk.size());
+  }
+  BLO_memfile_write_finalize(&mem_data);
+}
+
+static Vector<const MemFileChunk *> memfile_chunks(const MemFile &memfile)
+{
+  Vector<const MemFileChunk *> chunks;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    chunks.append(chunk);
+  }
+  return chunks;
+}
+
+static std::string chunk_data(const MemFileChunk *chunk)
+{
+  return std::string(chunk->buf, chunk->size);
+}
+
+TEST(memfile, IdenticalChunksAreShared)
+{
+  const std::string a(100, 'a');
+  const std::string b(200, 'b');
+
+  MemFile first{};
+  MemFile second{};
+  memfile_write(&first, nullptr, {a, b});
+  memfile_write(&second, &first, {a, b});
+  EXPECT_EQ(first.size, a.size() + b.size());
+  EXPECT_EQ(second.size, 0);
+
+  const Vector<const MemFileChunk *> first_chunks = memfile_chunks(first);
+  const Vector<const MemFileChunk *> second_chunks = memfile_chunks(second);
+  ASSERT_EQ(second_chunks.size(), 2);
+  for (const int i : second_chunks.index_range()) {
+    EXPECT_TRUE(second_chunks[i]->is_identical);
+    EXPECT_EQ(second_chunks[i]->buf, first_chunks[i]->buf);
+  }
+
+  BLO_memfile_free(&first);
+  BLO_memfile_free(&second);
+}
+
+TEST(memfile, MovedChunksAreShared)
+{
+  const std::string a(100, 'a');
+  const std::string b(200, 'b');
+  const std::string inserted(50, 'x');
+
+  MemFile first{};
+  MemFile second{};
+  memfile_write(&first, nullptr, {a, b});
+  memfile_write(&second, &first, {inserted, a, b});
+  /* Only the inserted chunk is new. */
+  EXPECT_EQ(second.size, inserted.size());
+
+  const Vector<const MemFileChunk *> first_chunks = memfile_chunks(first);
+  const Vector<const MemFileChunk *> second_chunks = memfile_chunks(second);
+  ASSERT_EQ(second_chunks.size(), 3);
+  /* The chunks don't match their positional counterparts, but still share the buffers. */
+  EXPECT_FALSE(second_chunks[1]->is_identical);
+  EXPECT_FALSE(second_chunks[2]->is_identical);
+  EXPECT_EQ(second_chunks[1]->buf, first_chunks[0]->buf);
+  EXPECT_EQ(second_chunks[2]->buf, first_chunks[1]->buf);
+
+  /* Shared buffers stay alive as long as a chunk uses them. */
+  BLO_memfile_free(&first);
+  EXPECT_EQ(chunk_data(second_chunks[0]), inserted);
+  EXPECT_EQ(chunk_data(second_chunks[1]), a);
+  EXPECT_EQ(chunk_data(second_chunks[2]), b);
+  BLO_memfile_free(&second);
+}
+
+TEST(memfile, DuplicateChunksInStep)
+{
+  const std::string a(100, 'a');
+  const std::string a_longer(101, 'a');
+
+  MemFile memfile{};
+  memfile_write(&memfile, nullptr, {a, a, a_longer});
+  /* Chunks with the same content in a single step are stored once, a different size never
+   * shares a buffer. */
+  EXPECT_EQ(memfile.size, a.size() + a_longer.size());
+
+  const Vector<const MemFileChunk *> chunks = memfile_chunks(memfile);
+  ASSERT_EQ(chunks.size(), 3);
+  EXPECT_EQ(chunks[0]->buf, chunks[1]->buf);
+  EXPECT_NE(chunks[0]->buf, chunks[2]->buf);
+  EXPECT_EQ(chunk_data(chunks[2]), a_longer);
+
+  BLO_memfile_free(&memfile);
+}
+
+class MemFileWriteTest : public BlendfileLoadingBaseTest {};
+
+static void mesh_set_positions(Mesh *mesh, const int verts_num, const int inserted_num)
+{
+  Mesh *mesh_src = BKE_mesh_new_nomain(inserted_num + verts_num, 0, 0, 0);
+  MutableSpan<float3> positions = mesh_src->vert_positions_for_write();
+  positions.take_front(inserted_num).fill(float3(-1.0f));
+  for (const int i : IndexRange(verts_num)) {
+    positions[inserted_num + i] = float3(float(i), float(i) * 0.5f, float(i % 1000));
+  }
+  BKE_mesh_nomain_to_mesh(mesh_src, mesh, nullptr);
+}
+
+TEST_F(MemFileWriteTest, InsertedDataKeepsLaterPiecesShared)
+{
+  Main *bmain = BKE_main_new();
+  Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+  constexpr int verts_num = 1000000;
+  mesh_set_positions(mesh, verts_num, 0);
+
+  MemFile first{};
+  EXPECT_TRUE(BLO_write_file_mem(bmain, nullptr, &first, 0));
+  EXPECT_GT(first.size, verts_num * sizeof(float3));
+
+  /* Shift all positions by inserting one vertex at the start. Pieces of large arrays are split
+   * at content-defined boundaries, so apart from the first piece they match the previous step. */
+  mesh_set_positions(mesh, verts_num, 1);
+  MemFile second{};
+  EXPECT_TRUE(BLO_write_file_mem(bmain, &first, &second, 0));
+  EXPECT_LT(second.size, first.size / 10);
+
+  BLO_memfile_free(&first);
+  BLO_memfile_free(&second);
+  BKE_main_free(bmain);
+}
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,76 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/* Allow using the legacy sculpt mask layer type. */
+#define DNA_DEPRECATED_ALLOW
+
+#include "blendfile_loading_base_test.h"
+
+#include "BKE_customdata.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+#include "BKE_mesh_legacy_convert.hh"
+
+#include "BLI_listbase.h"
+#include "BLI_span.hh"
+
+#include "DNA_mesh_types.h"
+
+#include "intern/versioning_common.hh"
+
+namespace blender::blenloader::tests {
+
+class VersioningParallelTest : public BlendfileLoadingBaseTest {};
+
+/** Add meshes with a legacy sculpt mask layer, with different values for every mesh. */
+static void add_legacy_mask_meshes(Main *bmain, const int meshes_num, const int verts_num)
+{
+  for (const int i : IndexRange(meshes_num)) {
+    Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+    mesh->verts_num = verts_num;
+    float *mask = static_cast<float *>(
+        CustomData_add_layer(&mesh->vert_data, CD_PAINT_MASK, CD_CONSTRUCT, verts_num));
+    for (const int vert : IndexRange(verts_num)) {
+      mask[vert] = float(i) + float(vert) / float(verts_num);
+    }
+  }
+}
+
+static Span<float> mesh_sculpt_mask(const Mesh &mesh)
+{
+  const float *mask = static_cast<const float *>(
+      CustomData_get_layer_named(&mesh.vert_data, CD_PROP_FLOAT, ".sculpt_mask"));
+  return mask ? Span<float>(mask, mesh.verts_num) : Span<float>();
+}
+
+TEST_F(VersioningParallelTest, MatchesSerial)
+{
+  Main *serial = BKE_main_new();
+  Main *parallel = BKE_main_new();
+  add_legacy_mask_meshes(serial, 100, 1000);
+  add_legacy_mask_meshes(parallel, 100, 1000);
+
+  LISTBASE_FOREACH (Mesh *, mesh, &serial->meshes) {
+    bke::mesh_sculpt_mask_to_generic(*mesh);
+  }
+  version_foreach_id_parallel(parallel->meshes, [](ID &id) {
+    bke::mesh_sculpt_mask_to_generic(reinterpret_cast<Mesh &>(id));
+  });
+
+  ASSERT_EQ(BLI_listbase_count(&serial->meshes), BLI_listbase_count(&parallel->meshes));
+  const Mesh *parallel_mesh = static_cast<const Mesh *>(parallel->meshes.first);
+  LISTBASE_FOREACH (const Mesh *, serial_mesh, &serial->meshes) {
+    EXPECT_STREQ(serial_mesh->id.name, parallel_mesh->id.name);
+    EXPECT_FALSE(CustomData_has_layer(&parallel_mesh->vert_data, CD_PAINT_MASK));
+    const Span<float> serial_mask = mesh_sculpt_mask(*serial_mesh);
+    EXPECT_FALSE(serial_mask.is_empty());
+    EXPECT_EQ(serial_mask, mesh_sculpt_mask(*parallel_mesh));
+    parallel_mesh = static_cast<const Mesh *>(parallel_mesh->id.next);
+  }
+
+  BKE_main_free(serial);
+  BKE_main_free(parallel);
+}
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,73 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_write_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+
+#include "BLO_writefile.hh"
+
+#include "DNA_mesh_types.h"
+
+namespace blender::blenloader::tests {
+
+void BlendfileWriteBaseTest::SetUp()
+{
+  BlendfileLoadingBaseTest::SetUp();
+  BKE_tempdir_init("");
+}
+
+void BlendfileWriteBaseTest::TearDown()
+{
+  BKE_tempdir_session_purge();
+  BlendfileLoadingBaseTest::TearDown();
+}
+
+std::string BlendfileWriteBaseTest::temp_filepath(const char *filename) const
+{
+  return std::string(BKE_tempdir_session()) + SEP_STR + filename;
+}
+
+void add_meshes(Main *bmain, const int meshes_num, const int verts_num)
+{
+  for (const int i : IndexRange(meshes_num)) {
+    Mesh *mesh_src = BKE_mesh_new_nomain(verts_num, 0, 0, 0);
+    MutableSpan<float3> positions = mesh_src->vert_positions_for_write();
+    for (const int vert : positions.index_range()) {
+      positions[vert] = float3(float(i), float(vert), float(i * vert));
+    }
+    Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+    BKE_mesh_nomain_to_mesh(mesh_src, mesh, nullptr);
+  }
+}
+
+void write_file(Main *bmain,
+                const std::string &filepath,
+                const int write_flags,
+                const int threads_num)
+{
+  BlendFileWriteParams params{};
+  params.threads_num = threads_num;
+  EXPECT_TRUE(BLO_write_file(bmain, filepath.c_str(), write_flags, &params, nullptr));
+}
+
+Vector<char> read_file(const std::string &filepath)
+{
+  size_t size = 0;
+  void *data = BLI_file_read_binary_as_mem(filepath.c_str(), 0, &size);
+  if (data == nullptr) {
+    return {};
+  }
+  Vector<char> result(Span<char>(static_cast<const char *>(data), int64_t(size)));
+  MEM_freeN(data);
+  return result;
+}
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,39 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+#include <string>
+
+#include "BLI_vector.hh"
+
+#include "blendfile_loading_base_test.h"
+
+struct Main;
+
+namespace blender::blenloader::tests {
+
+/**
+ * Base for tests that write blend-files. The files are written into the session temporary
+ * directory, which is removed after every test.
+ */
+class BlendfileWriteBaseTest : public BlendfileLoadingBaseTest {
+ protected:
+  void SetUp() override;
+  void TearDown() override;
+
+  /** Path of a file in the session temporary directory. */
+  std::string temp_filepath(const char *filename) const;
+};
+
+/** Add meshes with different positions, their type supports parallel writing. */
+void add_meshes(Main *bmain, int meshes_num, int verts_num);
+
+/** Write \a bmain to \a filepath, failing the test if that's not possible. */
+void write_file(Main *bmain, const std::string &filepath, int write_flags = 0, int threads_num = 0);
+
+/** The whole contents of the file, empty if it can't be read. */
+Vector<char> read_file(const std::string &filepath);
+
+}  // namespace blender::blenloader::tests
@@ -0,0 +1,34 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "blendfile_write_base_test.h"
+
+#include <string>
+
+#include "BKE_main.hh"
+
+namespace blender::blenloader::tests {
+
+class BlendfileWriteTest : public BlendfileWriteBaseTest {};
+
+TEST_F(BlendfileWriteTest, ParallelWriteMatchesSerial)
+{
+  Main *bmain = BKE_main_new();
+  /* More meshes than written in a single batch. */
+  add_meshes(bmain, 100, 1000);
+
+  const std::string serial_filepath = temp_filepath("serial.blend");
+  const std::string parallel_filepath = temp_filepath("parallel.blend");
+  write_file(bmain, serial_filepath, 0, 1);
+  write_file(bmain, parallel_filepath, 0, 8);
+
+  const Vector<char> serial = read_file(serial_filepath);
+  const Vector<char> parallel = read_file(parallel_filepath);
+  EXPECT_FALSE(serial.is_empty());
+  EXPECT_EQ(serial.size(), parallel.size());
+  EXPECT_TRUE(serial.as_span() == parallel.as_span());
+
+  BKE_main_free(bmain);
+}
+
+}  // namespace blender::blenloader::tests
@@ -13,6 +13,7 @@
  * that should be addressed eventually.
  */
 
+#include <atomic>
 #include <cstddef>
 
 #include "MEM_guardedalloc.h"
@@ -21,7 +22,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_math_vector.h"
-#include "BLI_task.h"
+#include "BLI_mempool.hh"
 
 #include "bmesh.hh"
 #include "bmesh_structure.hh"
@@ -33,100 +34,37 @@
 /** \name Recounting total selection.
  * \{ */
 
-struct SelectionCountChunkData {
-  int selection_len;
-};
-
-static void recount_totsels_range_vert_func(void * /*userdata*/,
-                                            MempoolIterData *iter,
-                                            const TaskParallelTLS *__restrict tls)
-{
-  SelectionCountChunkData *count = static_cast<SelectionCountChunkData *>(tls->userdata_chunk);
-  const BMVert *eve = (const BMVert *)iter;
-  if (BM_elem_flag_test(eve, BM_ELEM_SELECT)) {
-    count->selection_len += 1;
-  }
-}
-
-static void recount_totsels_range_edge_func(void * /*userdata*/,
-                                            MempoolIterData *iter,
-                                            const TaskParallelTLS *__restrict tls)
-{
-  SelectionCountChunkData *count = static_cast<SelectionCountChunkData *>(tls->userdata_chunk);
-  const BMEdge *eed = (const BMEdge *)iter;
-  if (BM_elem_flag_test(eed, BM_ELEM_SELECT)) {
-    count->selection_len += 1;
-  }
-}
-
-static void recount_totsels_range_face_func(void * /*userdata*/,
-                                            MempoolIterData *iter,
-                                            const TaskParallelTLS *__restrict tls)
-{
-  SelectionCountChunkData *count = static_cast<SelectionCountChunkData *>(tls->userdata_chunk);
-  const BMFace *efa = (const BMFace *)iter;
-  if (BM_elem_flag_test(efa, BM_ELEM_SELECT)) {
-    count->selection_len += 1;
-  }
-}
-
-static void recount_totsels_reduce(const void *__restrict /*userdata*/,
-                                   void *__restrict chunk_join,
-                                   void *__restrict chunk)
-{
-  SelectionCountChunkData *dst = static_cast<SelectionCountChunkData *>(chunk_join);
-  const SelectionCountChunkData *src = static_cast<const SelectionCountChunkData *>(chunk);
-  dst->selection_len += src->selection_len;
-}
-
-static TaskParallelMempoolFunc recount_totsels_get_range_func(BMIterType iter_type)
-{
-  BLI_assert(ELEM(iter_type, BM_VERTS_OF_MESH, BM_EDGES_OF_MESH, BM_FACES_OF_MESH));
-
-  TaskParallelMempoolFunc range_func = nullptr;
-  if (iter_type == BM_VERTS_OF_MESH) {
-    range_func = recount_totsels_range_vert_func;
-  }
-  else if (iter_type == BM_EDGES_OF_MESH) {
-    range_func = recount_totsels_range_edge_func;
-  }
-  else if (iter_type == BM_FACES_OF_MESH) {
-    range_func = recount_totsels_range_face_func;
-  }
-  return range_func;
-}
-
-static int recount_totsel(BMesh *bm, BMIterType iter_type)
+static int recount_totsel(BLI_mempool *pool)
 {
   const int MIN_ITER_SIZE = 1024;
 
-  TaskParallelSettings settings;
-  BLI_parallel_range_settings_defaults(&settings);
-  settings.func_reduce = recount_totsels_reduce;
-  settings.min_iter_per_thread = MIN_ITER_SIZE;
-
-  SelectionCountChunkData count = {0};
-  settings.userdata_chunk = &count;
-  settings.userdata_chunk_size = sizeof(count);
-
-  TaskParallelMempoolFunc range_func = recount_totsels_get_range_func(iter_type);
-  BM_iter_parallel(bm, iter_type, range_func, nullptr, &settings);
-  return count.selection_len;
+  std::atomic<int> selection_len = 0;
+  blender::mempool::parallel_for_each_chunk(
+      pool, MIN_ITER_SIZE, [&](const blender::Span<void *> elems) {
+        int chunk_selection_len = 0;
+        for (const void *elem : elems) {
+          if (BM_elem_flag_test(static_cast<const BMElem *>(elem), BM_ELEM_SELECT)) {
+            chunk_selection_len++;
+          }
+        }
+        selection_len.fetch_add(chunk_selection_len, std::memory_order_relaxed);
+      });
+  return selection_len;
 }
 
 static void recount_totvertsel(BMesh *bm)
 {
-  bm->totvertsel = recount_totsel(bm, BM_VERTS_OF_MESH);
+  bm->totvertsel = recount_totsel(bm->vpool);
 }
 
 static void recount_totedgesel(BMesh *bm)
 {
-  bm->totedgesel = recount_totsel(bm, BM_EDGES_OF_MESH);
+  bm->totedgesel = recount_totsel(bm->epool);
 }
 
 static void recount_totfacesel(BMesh *bm)
 {
-  bm->totfacesel = recount_totsel(bm, BM_FACES_OF_MESH);
+  bm->totfacesel = recount_totsel(bm->fpool);
 }
 
 static void recount_totsels(BMesh *bm)
@@ -139,9 +77,9 @@ static void recount_totsels(BMesh *bm)
 #ifndef NDEBUG
 static bool recount_totsels_are_ok(BMesh *bm)
 {
-  return bm->totvertsel == recount_totsel(bm, BM_VERTS_OF_MESH) &&
-         bm->totedgesel == recount_totsel(bm, BM_EDGES_OF_MESH) &&
-         bm->totfacesel == recount_totsel(bm, BM_FACES_OF_MESH);
+  return bm->totvertsel == recount_totsel(bm->vpool) &&
+         bm->totedgesel == recount_totsel(bm->epool) &&
+         bm->totfacesel == recount_totsel(bm->fpool);
 }
 #endif
 
@@ -308,103 +246,68 @@ void BM_mesh_select_mode_clean(BMesh *bm)
 /** \name Select mode flush selection
  * \{ */
 
-struct SelectionFlushChunkData {
-  int delta_selection_len;
-};
-
-static void bm_mesh_select_mode_flush_vert_to_edge_iter_fn(void * /*userdata*/,
-                                                           MempoolIterData *iter,
-                                                           const TaskParallelTLS *__restrict tls)
-{
-  SelectionFlushChunkData *chunk_data = static_cast<SelectionFlushChunkData *>(
-      tls->userdata_chunk);
-  BMEdge *e = (BMEdge *)iter;
-  const bool is_selected = BM_elem_flag_test(e, BM_ELEM_SELECT);
-  const bool is_hidden = BM_elem_flag_test(e, BM_ELEM_HIDDEN);
-  if (!is_hidden &&
-      (BM_elem_flag_test(e->v1, BM_ELEM_SELECT) && BM_elem_flag_test(e->v2, BM_ELEM_SELECT)))
-  {
-    BM_elem_flag_enable(e, BM_ELEM_SELECT);
-    chunk_data->delta_selection_len += is_selected ? 0 : 1;
-  }
-  else {
-    BM_elem_flag_disable(e, BM_ELEM_SELECT);
-    chunk_data->delta_selection_len += is_selected ? -1 : 0;
-  }
-}
-
-static void bm_mesh_select_mode_flush_edge_to_face_iter_fn(void * /*userdata*/,
-                                                           MempoolIterData *iter,
-                                                           const TaskParallelTLS *__restrict tls)
-{
-  SelectionFlushChunkData *chunk_data = static_cast<SelectionFlushChunkData *>(
-      tls->userdata_chunk);
-  BMFace *f = (BMFace *)iter;
-  BMLoop *l_iter;
-  BMLoop *l_first;
-  const bool is_selected = BM_elem_flag_test(f, BM_ELEM_SELECT);
-  bool ok = true;
-  if (!BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
-    l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-    do {
-      if (!BM_elem_flag_test(l_iter->e, BM_ELEM_SELECT)) {
-        ok = false;
-        break;
-      }
-    } while ((l_iter = l_iter->next) != l_first);
-  }
-  else {
-    ok = false;
-  }
-
-  BM_elem_flag_set(f, BM_ELEM_SELECT, ok);
-  if (is_selected && !ok) {
-    chunk_data->delta_selection_len -= 1;
-  }
-  else if (ok && !is_selected) {
-    chunk_data->delta_selection_len += 1;
-  }
-}
-
-static void bm_mesh_select_mode_flush_reduce_fn(const void *__restrict /*userdata*/,
-                                                void *__restrict chunk_join,
-                                                void *__restrict chunk)
-{
-  SelectionFlushChunkData *dst = static_cast<SelectionFlushChunkData *>(chunk_join);
-  const SelectionFlushChunkData *src = static_cast<const SelectionFlushChunkData *>(chunk);
-  dst->delta_selection_len += src->delta_selection_len;
-}
-
 static void bm_mesh_select_mode_flush_vert_to_edge(BMesh *bm)
 {
-  SelectionFlushChunkData chunk_data = {0};
-
-  TaskParallelSettings settings;
-  BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = bm->totedge >= BM_THREAD_LIMIT;
-  settings.userdata_chunk = &chunk_data;
-  settings.userdata_chunk_size = sizeof(chunk_data);
-  settings.func_reduce = bm_mesh_select_mode_flush_reduce_fn;
-
-  BM_iter_parallel(
-      bm, BM_EDGES_OF_MESH, bm_mesh_select_mode_flush_vert_to_edge_iter_fn, nullptr, &settings);
-  bm->totedgesel += chunk_data.delta_selection_len;
+  std::atomic<int> delta_selection_len = 0;
+  blender::mempool::parallel_for_each_chunk(
+      bm->epool, BM_THREAD_LIMIT, [&](const blender::Span<void *> elems) {
+        int chunk_delta_selection_len = 0;
+        for (void *elem : elems) {
+          BMEdge *e = static_cast<BMEdge *>(elem);
+          const bool is_selected = BM_elem_flag_test(e, BM_ELEM_SELECT);
+          const bool is_hidden = BM_elem_flag_test(e, BM_ELEM_HIDDEN);
+          if (!is_hidden && (BM_elem_flag_test(e->v1, BM_ELEM_SELECT) &&
+                             BM_elem_flag_test(e->v2, BM_ELEM_SELECT)))
+          {
+            BM_elem_flag_enable(e, BM_ELEM_SELECT);
+            chunk_delta_selection_len += is_selected ? 0 : 1;
+          }
+          else {
+            BM_elem_flag_disable(e, BM_ELEM_SELECT);
+            chunk_delta_selection_len += is_selected ? -1 : 0;
+          }
+        }
+        delta_selection_len.fetch_add(chunk_delta_selection_len, std::memory_order_relaxed);
+      });
+  bm->totedgesel += delta_selection_len;
 }
 
 static void bm_mesh_select_mode_flush_edge_to_face(BMesh *bm)
 {
-  SelectionFlushChunkData chunk_data = {0};
-
-  TaskParallelSettings settings;
-  BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = bm->totface >= BM_THREAD_LIMIT;
-  settings.userdata_chunk = &chunk_data;
-  settings.userdata_chunk_size = sizeof(chunk_data);
-  settings.func_reduce = bm_mesh_select_mode_flush_reduce_fn;
-
-  BM_iter_parallel(
-      bm, BM_FACES_OF_MESH, bm_mesh_select_mode_flush_edge_to_face_iter_fn, nullptr, &settings);
-  bm->totfacesel += chunk_data.delta_selection_len;
+  std::atomic<int> delta_selection_len = 0;
+  blender::mempool::parallel_for_each_chunk(
+      bm->fpool, BM_THREAD_LIMIT, [&](const blender::Span<void *> elems) {
+        int chunk_delta_selection_len = 0;
+        for (void *elem : elems) {
+          BMFace *f = static_cast<BMFace *>(elem);
+          BMLoop *l_iter;
+          BMLoop *l_first;
+          const bool is_selected = BM_elem_flag_test(f, BM_ELEM_SELECT);
+          bool ok = true;
+          if (!BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
+            l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+            do {
+              if (!BM_elem_flag_test(l_iter->e, BM_ELEM_SELECT)) {
+                ok = false;
+                break;
+              }
+            } while ((l_iter = l_iter->next) != l_first);
+          }
+          else {
+            ok = false;
+          }
+
+          BM_elem_flag_set(f, BM_ELEM_SELECT, ok);
+          if (is_selected && !ok) {
+            chunk_delta_selection_len -= 1;
+          }
+          else if (ok && !is_selected) {
+            chunk_delta_selection_len += 1;
+          }
+        }
+        delta_selection_len.fetch_add(chunk_delta_selection_len, std::memory_order_relaxed);
+      });
+  bm->totfacesel += delta_selection_len;
 }
 
 void BM_mesh_select_mode_flush_ex(BMesh *bm, const short selectmode, eBMSelectionFlushFLags flags)
@@ -1060,6 +1060,9 @@ void BM_mesh_rebuild(BMesh *bm,
                                             nullptr;
 
   const bool use_toolflags = params->use_toolflags;
+  /* When the element size doesn't change (e.g. when packing the mesh), keep the existing tool
+   * flags instead of allocating new ones. */
+  const bool keep_toolflags = use_toolflags && bm->use_toolflags;
 
   if (remap & BM_VERT) {
     BMIter iter;
@@ -1067,8 +1070,13 @@ void BM_mesh_rebuild(BMesh *bm,
     BMVert *v_src;
     BM_ITER_MESH_INDEX (v_src, &iter, bm, BM_VERTS_OF_MESH, index) {
       BMVert *v_dst = static_cast<BMVert *>(BLI_mempool_alloc(vpool_dst));
-      memcpy(v_dst, v_src, sizeof(BMVert));
-      if (use_toolflags) {
+      if (keep_toolflags) {
+        memcpy(v_dst, v_src, sizeof(BMVert_OFlag));
+      }
+      else {
+        memcpy(v_dst, v_src, sizeof(BMVert));
+      }
+      if (use_toolflags && !keep_toolflags) {
         ((BMVert_OFlag *)v_dst)->oflags = bm->vtoolflagpool ?
                                               static_cast<BMFlagLayer *>(
                                                   BLI_mempool_calloc(bm->vtoolflagpool)) :
@@ -1086,8 +1094,13 @@ void BM_mesh_rebuild(BMesh *bm,
     BMEdge *e_src;
     BM_ITER_MESH_INDEX (e_src, &iter, bm, BM_EDGES_OF_MESH, index) {
       BMEdge *e_dst = static_cast<BMEdge *>(BLI_mempool_alloc(epool_dst));
-      memcpy(e_dst, e_src, sizeof(BMEdge));
-      if (use_toolflags) {
+      if (keep_toolflags) {
+        memcpy(e_dst, e_src, sizeof(BMEdge_OFlag));
+      }
+      else {
+        memcpy(e_dst, e_src, sizeof(BMEdge));
+      }
+      if (use_toolflags && !keep_toolflags) {
         ((BMEdge_OFlag *)e_dst)->oflags = bm->etoolflagpool ?
                                               static_cast<BMFlagLayer *>(
                                                   BLI_mempool_calloc(bm->etoolflagpool)) :
@@ -1107,8 +1120,13 @@ void BM_mesh_rebuild(BMesh *bm,
 
       if (remap & BM_FACE) {
         BMFace *f_dst = static_cast<BMFace *>(BLI_mempool_alloc(fpool_dst));
-        memcpy(f_dst, f_src, sizeof(BMFace));
-        if (use_toolflags) {
+        if (keep_toolflags) {
+          memcpy(f_dst, f_src, sizeof(BMFace_OFlag));
+        }
+        else {
+          memcpy(f_dst, f_src, sizeof(BMFace));
+        }
+        if (use_toolflags && !keep_toolflags) {
           ((BMFace_OFlag *)f_dst)->oflags = bm->ftoolflagpool ?
                                                 static_cast<BMFlagLayer *>(
                                                     BLI_mempool_calloc(bm->ftoolflagpool)) :
@@ -1325,6 +1343,48 @@ void BM_mesh_toolflags_set(BMesh *bm, bool use_toolflags)
   bm->use_toolflags = use_toolflags;
 }
 
+void BM_mesh_pack(BMesh *bm)
+{
+  const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_BM(bm);
+
+  BLI_mempool *vpool_dst = nullptr;
+  BLI_mempool *epool_dst = nullptr;
+  BLI_mempool *lpool_dst = nullptr;
+  BLI_mempool *fpool_dst = nullptr;
+
+  bm_mempool_init_ex(
+      &allocsize, bm->use_toolflags, &vpool_dst, &epool_dst, &lpool_dst, &fpool_dst);
+
+  BMeshCreateParams params = {};
+  params.use_toolflags = bm->use_toolflags;
+
+  BM_mesh_rebuild(bm, &params, vpool_dst, epool_dst, lpool_dst, fpool_dst);
+
+  /* The loop normal spaces reference loops. */
+  if (bm->lnor_spacearr) {
+    BKE_lnor_spacearr_free(bm->lnor_spacearr);
+    MEM_freeN(bm->lnor_spacearr);
+    bm->lnor_spacearr = nullptr;
+    bm->spacearr_dirty |= BM_SPACEARR_DIRTY_ALL;
+  }
+}
+
+bool BM_mesh_is_fragmented(BMesh *bm, const float min_occupancy)
+{
+  BLI_mempool *pools[] = {bm->vpool, bm->epool, bm->fpool};
+  for (BLI_mempool *pool : pools) {
+    const int capacity = BLI_mempool_chunks_len(pool) * BLI_mempool_chunk_capacity(pool);
+    /* Pools that fit into a single chunk can't be packed any further. */
+    if (capacity <= BLI_mempool_chunk_capacity(pool)) {
+      continue;
+    }
+    if (float(BLI_mempool_len(pool)) < float(capacity) * min_occupancy) {
+      return true;
+    }
+  }
+  return false;
+}
+
 /* -------------------------------------------------------------------- */
 /** \name BMesh Coordinate Access
  * \{ */
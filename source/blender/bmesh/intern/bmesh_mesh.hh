@@ -167,6 +167,22 @@ void BM_mesh_rebuild(BMesh *bm,
                      BLI_mempool *lpool,
                      BLI_mempool *fpool);
 
+/**
+ * Move all elements into new memory pools, in iteration order, with the loops of every face next
+ * to each other. After many elements have been added and removed, the elements are scattered over
+ * many sparsely used chunks, which makes iterating over the mesh slow. Packing the mesh restores
+ * the memory layout of a newly created mesh.
+ *
+ * \warning All pointers to elements are invalidated, the same as for #BM_mesh_rebuild.
+ */
+void BM_mesh_pack(BMesh *bm);
+/**
+ * \return True when vertices, edges or faces only use a small part of their memory pools,
+ * so that #BM_mesh_pack would be worthwhile.
+ * \param min_occupancy: The fraction of the allocated elements that should be in use.
+ */
+bool BM_mesh_is_fragmented(BMesh *bm, float min_occupancy);
+
 struct BMAllocTemplate {
   int totvert, totedge, totloop, totface;
 };
@@ -18,6 +18,7 @@
 #include "BLI_linklist_stack.h"
 #include "BLI_math_base.hh"
 #include "BLI_math_vector.h"
+#include "BLI_mempool.hh"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 #include "BLI_vector.hh"
@@ -142,14 +143,6 @@ static void bm_vert_calc_normals_impl(BMVert *v)
   normalize_v3_v3(v_no, v->co);
 }
 
-static void bm_vert_calc_normals_cb(void * /*userdata*/,
-                                    MempoolIterData *mp_v,
-                                    const TaskParallelTLS *__restrict /*tls*/)
-{
-  BMVert *v = (BMVert *)mp_v;
-  bm_vert_calc_normals_impl(v);
-}
-
 static void bm_vert_calc_normals_with_coords(BMVert *v, BMVertsCalcNormalsWithCoordsData *data)
 {
   /* See #bm_vert_calc_normals_impl note on performance. */
@@ -193,29 +186,17 @@ static void bm_vert_calc_normals_with_coords(BMVert *v, BMVertsCalcNormalsWithCo
   normalize_v3_v3(v_no, data->vcos[BM_elem_index_get(v)]);
 }
 
-static void bm_vert_calc_normals_with_coords_cb(void *userdata,
-                                                MempoolIterData *mp_v,
-                                                const TaskParallelTLS *__restrict /*tls*/)
-{
-  BMVertsCalcNormalsWithCoordsData *data = static_cast<BMVertsCalcNormalsWithCoordsData *>(
-      userdata);
-  BMVert *v = (BMVert *)mp_v;
-  bm_vert_calc_normals_with_coords(v, data);
-}
-
 static void bm_mesh_verts_calc_normals(BMesh *bm,
                                        const float (*fnos)[3],
                                        const float (*vcos)[3],
                                        float (*vnos)[3])
 {
+  using namespace blender;
   BM_mesh_elem_index_ensure(bm, BM_FACE | ((vnos || vcos) ? BM_VERT : 0));
 
-  TaskParallelSettings settings;
-  BLI_parallel_mempool_settings_defaults(&settings);
-  settings.use_threading = bm->totvert >= BM_THREAD_LIMIT;
-
   if (vcos == nullptr) {
-    BM_iter_parallel(bm, BM_VERTS_OF_MESH, bm_vert_calc_normals_cb, nullptr, &settings);
+    mempool::parallel_for_each<BMVert>(
+        bm->vpool, BM_THREAD_LIMIT, [&](BMVert &v) { bm_vert_calc_normals_impl(&v); });
   }
   else {
     BLI_assert(!ELEM(nullptr, fnos, vnos));
@@ -223,28 +204,18 @@ static void bm_mesh_verts_calc_normals(BMesh *bm,
     data.fnos = fnos;
     data.vcos = vcos;
     data.vnos = vnos;
-    BM_iter_parallel(bm, BM_VERTS_OF_MESH, bm_vert_calc_normals_with_coords_cb, &data, &settings);
+    mempool::parallel_for_each<BMVert>(bm->vpool, BM_THREAD_LIMIT, [&](BMVert &v) {
+      bm_vert_calc_normals_with_coords(&v, &data);
+    });
   }
 }
 
-static void bm_face_calc_normals_cb(void * /*userdata*/,
-                                    MempoolIterData *mp_f,
-                                    const TaskParallelTLS *__restrict /*tls*/)
-{
-  BMFace *f = (BMFace *)mp_f;
-
-  BM_face_calc_normal(f, f->no);
-}
-
 void BM_mesh_normals_update_ex(BMesh *bm, const BMeshNormalsUpdate_Params *params)
 {
   if (params->face_normals) {
     /* Calculate all face normals. */
-    TaskParallelSettings settings;
-    BLI_parallel_mempool_settings_defaults(&settings);
-    settings.use_threading = bm->totedge >= BM_THREAD_LIMIT;
-
-    BM_iter_parallel(bm, BM_FACES_OF_MESH, bm_face_calc_normals_cb, nullptr, &settings);
+    blender::mempool::parallel_for_each<BMFace>(
+        bm->fpool, BM_THREAD_LIMIT, [](BMFace &f) { BM_face_calc_normal(&f, f.no); });
   }
 
   /* Add weighted face normals to vertices, and normalize vert normals. */
@@ -42,3 +42,61 @@ TEST(bmesh_core, BMVertCreate)
   EXPECT_EQ(BM_mesh_elem_count(bm, BM_VERT), 3);
   BM_mesh_free(bm);
 }
+
+TEST(bmesh_core, BMeshPack)
+{
+  BMeshCreateParams bmesh_create_params{};
+  bmesh_create_params.use_toolflags = true;
+  BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default, &bmesh_create_params);
+  BM_mesh_elem_toolflags_ensure(bm);
+
+  /* A grid of quads. */
+  const int size = 40;
+  BMVert *verts[size][size];
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const float co[3] = {float(x), float(y), 0.0f};
+      verts[y][x] = BM_vert_create(bm, co, nullptr, BM_CREATE_NOP);
+    }
+  }
+  for (int y = 0; y < size - 1; y++) {
+    for (int x = 0; x < size - 1; x++) {
+      BMVert *quad[4] = {verts[y][x], verts[y][x + 1], verts[y + 1][x + 1], verts[y + 1][x]};
+      BM_face_create_verts(bm, quad, 4, nullptr, BM_CREATE_NOP, true);
+    }
+  }
+  EXPECT_FALSE(BM_mesh_is_fragmented(bm, 0.5f));
+
+  /* Remove most of the grid, leaving a few rows. */
+  for (int y = 0; y < size - 4; y++) {
+    for (int x = 0; x < size; x++) {
+      BM_vert_kill(bm, verts[y][x]);
+    }
+  }
+  BMO_vert_flag_enable(bm, verts[size - 1][0], 1);
+  BM_select_history_store(bm, verts[size - 1][1]);
+  const int totvert = bm->totvert;
+  const int totedge = bm->totedge;
+  const int totloop = bm->totloop;
+  const int totface = bm->totface;
+  EXPECT_TRUE(BM_mesh_is_fragmented(bm, 0.5f));
+
+  BM_mesh_pack(bm);
+
+  EXPECT_FALSE(BM_mesh_is_fragmented(bm, 0.5f));
+  EXPECT_EQ(bm->totvert, totvert);
+  EXPECT_EQ(bm->totedge, totedge);
+  EXPECT_EQ(bm->totloop, totloop);
+  EXPECT_EQ(bm->totface, totface);
+  EXPECT_TRUE(BM_mesh_validate(bm));
+
+  /* Vertices keep their order, tool flags and selection history. */
+  BMVert *v_first = static_cast<BMVert *>(BLI_mempool_findelem(bm->vpool, 0));
+  EXPECT_EQ(v_first->co[1], float(size - 4));
+  BMVert *v_flag = static_cast<BMVert *>(BLI_mempool_findelem(bm->vpool, uint(totvert - size)));
+  EXPECT_TRUE(BMO_vert_flag_test(bm, v_flag, 1));
+  const BMEditSelection *ese = static_cast<const BMEditSelection *>(bm->selected.last);
+  EXPECT_EQ(ese->ele, BLI_mempool_findelem(bm->vpool, uint(totvert - size + 1)));
+
+  BM_mesh_free(bm);
+}
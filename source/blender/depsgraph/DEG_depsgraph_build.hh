@@ -66,6 +66,18 @@ void DEG_graph_relations_update(Depsgraph *graph);
 /** Tag all relations in the database for update. */
 void DEG_relations_tag_update(Main *bmain);
 
+/**
+ * Tag relations of the given ID for update in the given graph.
+ *
+ * Unlike #DEG_graph_tag_relations_update, allows the graph to only re-build nodes and relations
+ * of the tagged IDs, as long as they are all objects of the view layer. Otherwise the graph is
+ * fully re-built.
+ */
+void DEG_graph_id_relations_tag_update(Depsgraph *graph, ID *id);
+
+/** Tag relations of the given ID for update in all graphs of the database. */
+void DEG_id_relations_tag_update(Main *bmain, ID *id);
+
 /* Add Dependencies  ----------------------------- */
 
 /**
@@ -50,6 +50,21 @@ void DEG_debug_stats_gnuplot(const Depsgraph *graph,
                              const char *label,
                              const char *output_filename);
 
+/* ************************************************ */
+/* Evaluation Timeline */
+
+/**
+ * Start recording start and end time and thread of every operation evaluated by the subsequent
+ * evaluations of the graph. Previously recorded operations are discarded.
+ */
+void DEG_debug_trace_begin(Depsgraph *graph);
+
+/**
+ * Stop recording, and write the recorded operations to the file in the Chrome trace event format.
+ * Nothing is written when the file path is null.
+ */
+void DEG_debug_trace_end(Depsgraph *graph, const char *filepath);
+
 /* ************************************************ */
 
 /** Compare two dependency graphs. */
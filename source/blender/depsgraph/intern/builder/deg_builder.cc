@@ -33,6 +33,7 @@
 #include "intern/depsgraph_tag.hh"
 #include "intern/depsgraph_type.hh"
 #include "intern/eval/deg_eval_copy_on_write.h"
+#include "intern/eval/deg_eval_schedule.h"
 #include "intern/eval/deg_eval_visibility.h"
 #include "intern/node/deg_node.hh"
 #include "intern/node/deg_node_component.hh"
@@ -181,6 +182,9 @@ void deg_graph_build_finalize(Main *bmain, Depsgraph *graph)
   deg_graph_flush_visibility_flags(graph);
   deg_graph_remove_unused_noops(graph);
 
+  /* Operations and relations are final at this point. */
+  graph->evaluation_schedule.build(*graph);
+
   /* Re-tag IDs for update if it was tagged before the relations
    * update tag. */
   for (IDNode *id_node : graph->id_nodes) {
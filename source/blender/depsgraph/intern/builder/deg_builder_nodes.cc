@@ -110,6 +110,7 @@
 #include "intern/builder/deg_builder_rna.h"
 #include "intern/depsgraph.hh"
 #include "intern/depsgraph_light_linking.hh"
+#include "intern/depsgraph_relation.hh"
 #include "intern/depsgraph_tag.hh"
 #include "intern/depsgraph_type.hh"
 #include "intern/eval/deg_eval_copy_on_write.h"
@@ -545,6 +546,82 @@ void DepsgraphNodeBuilder::end_build()
   update_invalid_cow_pointers();
 }
 
+void DepsgraphNodeBuilder::begin_incremental_build(Span<IDNode *> rebuild_id_nodes)
+{
+  scene_ = graph_->scene;
+  view_layer_ = graph_->view_layer;
+  /* NOTE: Same as in build_view_layer(), after scene CoW there is only one view layer. */
+  view_layer_index_ = 0;
+
+  const Set<IDNode *> rebuild_id_nodes_set(rebuild_id_nodes);
+
+  /* Gather operations of the re-built IDs and all relations connected to them. */
+  Set<OperationNode *> operations_to_remove;
+  Set<Relation *> relations_to_remove;
+  for (IDNode *id_node : rebuild_id_nodes) {
+    for (ComponentNode *comp_node : id_node->components.values()) {
+      BLI_assert(comp_node->operations_map == nullptr);
+      for (OperationNode *op_node : comp_node->operations) {
+        operations_to_remove.add(op_node);
+        relations_to_remove.add_multiple(op_node->inlinks);
+        relations_to_remove.add_multiple(op_node->outlinks);
+      }
+    }
+  }
+
+  for (OperationNode *op_node : graph_->entry_tags) {
+    if (operations_to_remove.contains(op_node)) {
+      saved_entry_tags_.append_as(op_node);
+    }
+  }
+  graph_->entry_tags.remove_if(
+      [&](OperationNode *op_node) { return operations_to_remove.contains(op_node); });
+  graph_->operations.remove_if(
+      [&](OperationNode *op_node) { return operations_to_remove.contains(op_node); });
+
+  for (Relation *rel : relations_to_remove) {
+    rel->unlink();
+    delete rel;
+  }
+
+  /* The ID nodes themselves are kept, so that their CoW data-blocks are preserved. Removing all
+   * components makes add_id_node() to handle the nodes as newly created ones. */
+  for (IDNode *id_node : rebuild_id_nodes) {
+    for (ComponentNode *comp_node : id_node->components.values()) {
+      delete comp_node;
+    }
+    id_node->components.clear();
+  }
+
+  /* Nodes of all other IDs are kept in the graph, do not re-build them. */
+  for (IDNode *id_node : graph_->id_nodes) {
+    if (!rebuild_id_nodes_set.contains(id_node)) {
+      built_map_.tagBuild(id_node->id_orig);
+    }
+  }
+}
+
+void DepsgraphNodeBuilder::end_incremental_build(Span<IDNode *> rebuild_id_nodes)
+{
+  tag_previously_tagged_nodes();
+
+  /* No IDs are removed from the graph by the incremental update, so only the re-built IDs could
+   * start using IDs which did not have a CoW version before. */
+  for (IDNode *id_node : rebuild_id_nodes) {
+    if (ELEM(id_node->id_cow, id_node->id_orig, nullptr)) {
+      continue;
+    }
+    if (!deg_copy_on_write_is_expanded(id_node->id_cow)) {
+      continue;
+    }
+    BKE_library_foreach_ID_link(nullptr,
+                                id_node->id_cow,
+                                deg::foreach_id_cow_detect_need_for_update_callback,
+                                this,
+                                IDWALK_IGNORE_EMBEDDED_ID | IDWALK_READONLY);
+  }
+}
+
 void DepsgraphNodeBuilder::build_id(ID *id, const bool force_be_visible)
 {
   if (id == nullptr) {
@@ -89,6 +89,11 @@ class DepsgraphNodeBuilder : public DepsgraphBuilder {
   virtual void begin_build();
   virtual void end_build();
 
+  /* Prepare for re-building nodes of the given IDs only, leaving the rest of the graph intact.
+   * All nodes of the given IDs, and relations connected to them, are removed from the graph. */
+  void begin_incremental_build(Span<IDNode *> rebuild_id_nodes);
+  void end_incremental_build(Span<IDNode *> rebuild_id_nodes);
+
   /**
    * `id_cow_self` is the user of `id_pointer`,
    * see also `LibraryIDLinkCallbackData` struct definition.
@@ -69,6 +69,7 @@
 #include "BKE_image.h"
 #include "BKE_key.hh"
 #include "BKE_layer.hh"
+#include "BKE_lib_id.hh"
 #include "BKE_lib_query.hh"
 #include "BKE_material.h"
 #include "BKE_mball.hh"
@@ -365,13 +366,27 @@ void DepsgraphRelationBuilder::add_special_eval_flag(ID *id, uint32_t flag)
   }
 }
 
+Relation *DepsgraphRelationBuilder::add_graph_relation(Node *node_from,
+                                                       Node *node_to,
+                                                       const char *description,
+                                                       int flags)
+{
+  if (is_incremental_build_) {
+    /* Relations between the IDs which are not re-built are still in the graph. */
+    flags |= RELATION_CHECK_BEFORE_ADD;
+  }
+  const ID *owner_id = stack_.innermost_id();
+  const uint owner_session_uid = owner_id ? owner_id->session_uid : MAIN_ID_SESSION_UID_UNSET;
+  return graph_->add_new_relation(node_from, node_to, description, flags, owner_session_uid);
+}
+
 Relation *DepsgraphRelationBuilder::add_time_relation(TimeSourceNode *timesrc,
                                                       Node *node_to,
                                                       const char *description,
                                                       int flags)
 {
   if (timesrc && node_to) {
-    return graph_->add_new_relation(timesrc, node_to, description, flags);
+    return add_graph_relation(timesrc, node_to, description, flags);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -399,7 +414,7 @@ Relation *DepsgraphRelationBuilder::add_operation_relation(OperationNode *node_f
                                                            int flags)
 {
   if (node_from && node_to) {
-    return graph_->add_new_relation(node_from, node_to, description, flags);
+    return add_graph_relation(node_from, node_to, description, flags);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -513,6 +528,19 @@ Depsgraph *DepsgraphRelationBuilder::getGraph()
 
 void DepsgraphRelationBuilder::begin_build() {}
 
+void DepsgraphRelationBuilder::begin_incremental_build(Span<IDNode *> rebuild_id_nodes)
+{
+  scene_ = graph_->scene;
+  is_incremental_build_ = true;
+  /* Relations of all other IDs are kept in the graph, do not re-build them. */
+  const Set<IDNode *> rebuild_id_nodes_set(rebuild_id_nodes);
+  for (IDNode *id_node : graph_->id_nodes) {
+    if (!rebuild_id_nodes_set.contains(id_node)) {
+      built_map_.tagBuild(id_node->id_orig);
+    }
+  }
+}
+
 void DepsgraphRelationBuilder::build_id(ID *id)
 {
   if (id == nullptr) {
@@ -675,11 +703,11 @@ void DepsgraphRelationBuilder::build_collection(LayerCollection *from_layer_coll
     return;
   }
 
+  const BuilderStack::ScopedEntry stack_entry = stack_.trace(collection->id);
+
   build_idproperties(collection->id.properties);
   build_parameters(&collection->id);
 
-  const BuilderStack::ScopedEntry stack_entry = stack_.trace(collection->id);
-
   const OperationKey collection_geometry_key{
       &collection->id, NodeType::GEOMETRY, OperationCode::GEOMETRY_EVAL_DONE};
 
@@ -1628,7 +1656,7 @@ void DepsgraphRelationBuilder::build_animdata_curves_targets(ID *id,
       add_relation(adt_key, pose_init_key, "Animation -> Prop", RELATION_CHECK_BEFORE_ADD);
       continue;
     }
-    graph_->add_new_relation(
+    add_graph_relation(
         operation_from, operation_to, "Animation -> Prop", RELATION_CHECK_BEFORE_ADD);
     /* It is possible that animation is writing to a nested ID data-block,
      * need to make sure animation is evaluated after target ID is copied. */
@@ -3400,6 +3428,8 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
     return;
   }
 
+  const BuilderStack::ScopedEntry stack_entry = stack_.trace(*id_orig);
+
   OperationKey copy_on_write_key(id_orig, NodeType::COPY_ON_WRITE, OperationCode::COPY_ON_WRITE);
   /* XXX: This is a quick hack to make Alt-A to work. */
   // add_relation(time_source_key, copy_on_write_key, "Fluxgate capacitor hack");
@@ -3445,7 +3475,7 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
      * copy of ID. */
     OperationNode *op_entry = comp_node->get_entry_operation();
     if (op_entry != nullptr) {
-      Relation *rel = graph_->add_new_relation(op_cow, op_entry, "CoW Dependency");
+      Relation *rel = add_graph_relation(op_cow, op_entry, "CoW Dependency");
       rel->flag |= rel_flag;
     }
     /* All dangling operations should also be executed after copy-on-write. */
@@ -3454,7 +3484,7 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
         continue;
       }
       if (op_node->inlinks.is_empty()) {
-        Relation *rel = graph_->add_new_relation(op_cow, op_node, "CoW Dependency");
+        Relation *rel = add_graph_relation(op_cow, op_node, "CoW Dependency");
         rel->flag |= rel_flag;
       }
       else {
@@ -3470,7 +3500,7 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
           }
         }
         if (!has_same_comp_dependency) {
-          Relation *rel = graph_->add_new_relation(op_cow, op_node, "CoW Dependency");
+          Relation *rel = add_graph_relation(op_cow, op_node, "CoW Dependency");
           rel->flag |= rel_flag;
         }
       }
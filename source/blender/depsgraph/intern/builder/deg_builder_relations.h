@@ -86,6 +86,9 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
   DepsgraphRelationBuilder(Main *bmain, Depsgraph *graph, DepsgraphBuilderCache *cache);
 
   void begin_build();
+  /* Prepare for re-building relations of the given IDs only, leaving the rest of the graph
+   * intact. Relations which are added by the builder are de-duplicated against the existing ones. */
+  void begin_incremental_build(Span<IDNode *> rebuild_id_nodes);
 
   template<typename KeyFrom, typename KeyTo>
   Relation *add_relation(const KeyFrom &key_from,
@@ -286,6 +289,12 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
   bool has_node(const ComponentKey &key) const;
   bool has_node(const OperationKey &key) const;
 
+  /* Add relation to the graph, owned by the ID which is currently being built. */
+  Relation *add_graph_relation(Node *node_from,
+                               Node *node_to,
+                               const char *description,
+                               int flags = 0);
+
   Relation *add_time_relation(TimeSourceNode *timesrc,
                               Node *node_to,
                               const char *description,
@@ -333,6 +342,9 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
   /* State which demotes currently built entities. */
   Scene *scene_;
 
+  /* Relations of only some IDs are re-built, see #begin_incremental_build. */
+  bool is_incremental_build_ = false;
+
   BuilderMap built_map_;
   RNANodeQuery rna_node_query_;
   BuilderStack stack_;
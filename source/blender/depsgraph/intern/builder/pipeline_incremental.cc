@@ -0,0 +1,349 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "pipeline_incremental.h"
+
+#include "BLI_listbase.h"
+#include "BLI_set.hh"
+#include "BLI_time.h"
+
+#include "BKE_global.h"
+#include "BKE_layer.hh"
+
+#include "DNA_layer_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_force_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "DEG_depsgraph_physics.hh"
+
+#include "intern/builder/deg_builder_nodes.h"
+#include "intern/builder/deg_builder_relations.h"
+#include "intern/debug/deg_debug.h"
+#include "intern/depsgraph.hh"
+#include "intern/depsgraph_physics.hh"
+#include "intern/depsgraph_relation.hh"
+#include "intern/node/deg_node.hh"
+#include "intern/node/deg_node_component.hh"
+#include "intern/node/deg_node_id.hh"
+#include "intern/node/deg_node_operation.hh"
+
+namespace blender::deg {
+
+namespace {
+
+/* State of an ID node which the full build passes from the old node to the new one. */
+struct IDNodePreviousState {
+  IDComponentsMask visible_components_mask;
+  uint32_t eval_flags;
+  DEGCustomDataMeshMasks customdata_masks;
+};
+
+OperationNode *find_operation_node(const Depsgraph &graph, const OperationKey &key)
+{
+  const IDNode *id_node = graph.find_id_node(key.id);
+  if (id_node == nullptr) {
+    return nullptr;
+  }
+  const ComponentNode *comp_node = id_node->find_component(key.component_type,
+                                                           key.component_name);
+  if (comp_node == nullptr) {
+    return nullptr;
+  }
+  return comp_node->find_operation(key.opcode, key.name, key.name_tag);
+}
+
+/* Collision and effector relations of other objects are found by looking at all objects of the
+ * view layer or collection, so they depend on the physics settings of the object. */
+bool object_has_physics(const Object *object)
+{
+  if (object->pd != nullptr && object->pd->forcefield != PFIELD_NULL) {
+    return true;
+  }
+  if (object->soft != nullptr || !BLI_listbase_is_empty(&object->particlesystem)) {
+    return true;
+  }
+  LISTBASE_FOREACH (const ModifierData *, md, &object->modifiers) {
+    if (ELEM(md->type,
+             eModifierType_Collision,
+             eModifierType_Cloth,
+             eModifierType_DynamicPaint,
+             eModifierType_Fluid,
+             eModifierType_ParticleSystem,
+             eModifierType_Softbody,
+             eModifierType_Surface))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool has_physics_relations(const Depsgraph &graph)
+{
+  for (const int i : IndexRange(DEG_PHYSICS_RELATIONS_NUM)) {
+    if (graph.physics_relations[i] != nullptr && !graph.physics_relations[i]->is_empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+IncrementalBuilderPipeline::IncrementalBuilderPipeline(::Depsgraph *graph)
+    : AbstractBuilderPipeline(graph)
+{
+}
+
+bool IncrementalBuilderPipeline::build_incremental()
+{
+  double start_time = 0.0;
+  if (G.debug & (G_DEBUG_DEPSGRAPH_BUILD | G_DEBUG_DEPSGRAPH_TIME)) {
+    start_time = BLI_check_seconds_timer();
+  }
+
+  build_step_sanity_check();
+
+  unique_ptr<DepsgraphNodeBuilder> node_builder = construct_node_builder();
+  if (!find_objects_to_rebuild(*node_builder)) {
+    return false;
+  }
+
+  save_kept_relations();
+
+  /* Same as the full build, the re-built objects create the collision and effector lists from the
+   * current state of the scene. No object kept in the graph uses them, see
+   * #find_objects_to_rebuild. */
+  clear_physics_relations(deg_graph_);
+
+  /* Same as the full build, let the finalization compare the new state with the current one. */
+  Vector<IDNodePreviousState> previous_states;
+  previous_states.reserve(deg_graph_->id_nodes.size());
+  for (const IDNode *id_node : deg_graph_->id_nodes) {
+    previous_states.append(
+        {id_node->visible_components_mask, id_node->eval_flags, id_node->customdata_masks});
+  }
+
+  /* Nodes. */
+  node_builder->begin_incremental_build(rebuild_id_nodes_);
+  build_nodes(*node_builder);
+  node_builder->end_incremental_build(rebuild_id_nodes_);
+  node_builder.reset();
+
+  /* IDs which were pulled into the graph by the re-built objects are built from scratch. */
+  rebuild_id_nodes_.extend(deg_graph_->id_nodes.as_span().drop_front(previous_states.size()));
+
+  /* Relations. */
+  unique_ptr<DepsgraphRelationBuilder> relation_builder = construct_relation_builder();
+  relation_builder->begin_incremental_build(rebuild_id_nodes_);
+  build_relations(*relation_builder);
+  for (IDNode *id_node : rebuild_id_nodes_) {
+    relation_builder->build_copy_on_write_relations(id_node);
+    relation_builder->build_driver_relations(id_node);
+  }
+  relation_builder.reset();
+
+  if (!restore_kept_relations()) {
+    return false;
+  }
+
+  for (const int i : previous_states.index_range()) {
+    IDNode *id_node = deg_graph_->id_nodes[i];
+    id_node->previously_visible_components_mask = previous_states[i].visible_components_mask;
+    id_node->previous_eval_flags = previous_states[i].eval_flags;
+    id_node->previous_customdata_masks = previous_states[i].customdata_masks;
+  }
+
+  /* Cycles might have been solved by the update, let the cycle detection to find all of them
+   * again. */
+  for (OperationNode *op_node : deg_graph_->operations) {
+    for (Relation *rel : op_node->inlinks) {
+      rel->flag &= ~RELATION_FLAG_CYCLIC;
+    }
+  }
+
+  build_step_finalize();
+
+  if (G.debug & (G_DEBUG_DEPSGRAPH_BUILD | G_DEBUG_DEPSGRAPH_TIME)) {
+    printf("Depsgraph updated incrementally in %f seconds (%d objects re-built).\n",
+           BLI_check_seconds_timer() - start_time,
+           int(objects_to_rebuild_.size()));
+  }
+
+  return true;
+}
+
+void IncrementalBuilderPipeline::build_nodes(DepsgraphNodeBuilder &node_builder)
+{
+  for (const ObjectToRebuild &object_to_rebuild : objects_to_rebuild_) {
+    node_builder.build_object(
+        object_to_rebuild.base_index, object_to_rebuild.object, DEG_ID_LINKED_DIRECTLY, true);
+    if (!deg_graph_->has_animated_visibility) {
+      deg_graph_->has_animated_visibility |= node_builder.is_object_visibility_animated(
+          object_to_rebuild.object);
+    }
+  }
+}
+
+void IncrementalBuilderPipeline::build_relations(DepsgraphRelationBuilder &relation_builder)
+{
+  for (const ObjectToRebuild &object_to_rebuild : objects_to_rebuild_) {
+    relation_builder.build_object(object_to_rebuild.object);
+  }
+  /* The relation builder might not reach IDs in the same way as the node builder did. */
+  for (IDNode *id_node : rebuild_id_nodes_) {
+    relation_builder.build_id(id_node->id_orig);
+  }
+}
+
+bool IncrementalBuilderPipeline::find_objects_to_rebuild(DepsgraphNodeBuilder &node_builder)
+{
+  const Set<uint> &session_uids = deg_graph_->relations_update_ids;
+  if (session_uids.is_empty() || deg_graph_->is_render_pipeline_depsgraph) {
+    return false;
+  }
+  /* Updating a big part of the graph is not cheaper than the full build, and has a higher chance
+   * of falling back to it half-way. */
+  if (session_uids.size() * 8 > deg_graph_->id_nodes.size()) {
+    return false;
+  }
+  /* Light linking cache is collected for the whole scene. */
+  if (deg_graph_->light_linking_cache.has_light_linking()) {
+    return false;
+  }
+  /* The collision and effector lists are cached for the whole graph while building relations, and
+   * are used during evaluation. They can't be updated without re-building all objects using
+   * them. */
+  if (has_physics_relations(*deg_graph_)) {
+    return false;
+  }
+
+  /* Base index needs to match the one which the view layer builder has used. */
+  int base_index = 0;
+  BKE_view_layer_synced_ensure(scene_, view_layer_);
+  LISTBASE_FOREACH (Base *, base, BKE_view_layer_object_bases_get(view_layer_)) {
+    if (!node_builder.need_pull_base_into_graph(base)) {
+      continue;
+    }
+    if (session_uids.contains(base->object->id.session_uid)) {
+      objects_to_rebuild_.append({base->object, base_index});
+    }
+    base_index++;
+  }
+  if (objects_to_rebuild_.size() != session_uids.size()) {
+    /* Some of the IDs are not objects of the view layer. */
+    return false;
+  }
+
+  for (const ObjectToRebuild &object_to_rebuild : objects_to_rebuild_) {
+    Object *object = object_to_rebuild.object;
+    IDNode *id_node = deg_graph_->find_id_node(&object->id);
+    if (id_node == nullptr || id_node->linked_state != DEG_ID_LINKED_DIRECTLY) {
+      return false;
+    }
+    /* Nodes of rigid body objects are built by the scene. */
+    if (scene_->rigidbody_world != nullptr &&
+        (object->rigidbody_object != nullptr || object->rigidbody_constraint != nullptr))
+    {
+      return false;
+    }
+    if (object->light_linking != nullptr) {
+      return false;
+    }
+    /* Adding or removing physics might change relations of other objects. */
+    if (object_has_physics(object)) {
+      return false;
+    }
+    rebuild_id_nodes_.append(id_node);
+  }
+
+  return true;
+}
+
+void IncrementalBuilderPipeline::save_kept_relations()
+{
+  Set<uint> rebuild_session_uids;
+  for (const IDNode *id_node : rebuild_id_nodes_) {
+    rebuild_session_uids.add(id_node->id_orig_session_uid);
+  }
+
+  auto save_node = [&](Node *node) {
+    KeptRelationNode kept_node;
+    if (node->type == NodeType::OPERATION) {
+      const OperationNode *op_node = static_cast<const OperationNode *>(node);
+      if (rebuild_session_uids.contains(op_node->owner->owner->id_orig_session_uid)) {
+        kept_node.operation_key.emplace(op_node);
+        return kept_node;
+      }
+    }
+    kept_node.node = node;
+    return kept_node;
+  };
+
+  Set<const Relation *> visited_relations;
+  for (const IDNode *id_node : rebuild_id_nodes_) {
+    for (const ComponentNode *comp_node : id_node->components.values()) {
+      for (const OperationNode *op_node : comp_node->operations) {
+        for (const Span<Relation *> relations : {op_node->inlinks.as_span(),
+                                                 op_node->outlinks.as_span()})
+        {
+          for (const Relation *rel : relations) {
+            if (rebuild_session_uids.contains(rel->owner_session_uid)) {
+              /* Relation is re-created by the builder of the re-built ID. */
+              continue;
+            }
+            if (!visited_relations.add(rel)) {
+              continue;
+            }
+            kept_relations_.append({save_node(rel->from),
+                                    save_node(rel->to),
+                                    rel->name,
+                                    rel->flag,
+                                    rel->owner_session_uid});
+          }
+        }
+      }
+    }
+  }
+}
+
+bool IncrementalBuilderPipeline::restore_kept_relations()
+{
+  auto restore_node = [&](const KeptRelationNode &kept_node) -> Node * {
+    if (kept_node.operation_key) {
+      return find_operation_node(*deg_graph_, *kept_node.operation_key);
+    }
+    return kept_node.node;
+  };
+
+  for (const KeptRelation &kept_relation : kept_relations_) {
+    Node *from = restore_node(kept_relation.from);
+    Node *to = restore_node(kept_relation.to);
+    if (from == nullptr || to == nullptr) {
+      DEG_DEBUG_PRINTF((::Depsgraph *)deg_graph_,
+                       BUILD,
+                       "Incremental update failed to restore relation %s\n",
+                       kept_relation.name);
+      return false;
+    }
+    if (deg_graph_->check_nodes_connected(from, to, kept_relation.name) != nullptr) {
+      continue;
+    }
+    deg_graph_->add_new_relation(from,
+                                 to,
+                                 kept_relation.name,
+                                 kept_relation.flag & ~RELATION_FLAG_CYCLIC,
+                                 kept_relation.owner_session_uid);
+  }
+
+  return true;
+}
+
+}  // namespace blender::deg
@@ -0,0 +1,88 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include <optional>
+
+#include "pipeline.h"
+
+#include "BLI_vector.hh"
+
+#include "intern/builder/deg_builder_key.h"
+
+struct Object;
+
+namespace blender::deg {
+
+struct IDNode;
+struct Node;
+struct Relation;
+
+/* Updates dependency graph of a view layer in place, re-building nodes and relations of the
+ * objects which relations were tagged for update with #DEG_id_relations_tag_update().
+ *
+ * General notes:
+ *
+ * - Nodes of the tagged objects are removed together with all relations connected to them, and
+ *   then are built again. Every other ID is considered built, so the builders do not recurse into
+ *   them, but IDs which are not yet in the graph are added.
+ *
+ * - Relations know which ID builder added them. Relations connected to the tagged objects which
+ *   were added by builders of other IDs (their direct neighbors) or of the view layer are not
+ *   re-created by the object builders, so they are re-connected to the new nodes of the objects,
+ *   using keys of the operations.
+ *
+ * - When the update is not possible the graph is to be fully re-built. This is the case for
+ *   anything other than objects with a base in the view layer, or when the objects are involved
+ *   into the scene-level evaluation (rigid body world, light linking). It is also the case when a
+ *   relation of a neighbor can not be re-connected because the operation it was connected to does
+ *   not exist anymore. */
+class IncrementalBuilderPipeline : public AbstractBuilderPipeline {
+ public:
+  IncrementalBuilderPipeline(::Depsgraph *graph);
+
+  /* Returns false if the graph needs to be fully re-built. The graph is still consistent in this
+   * case, but might be missing some relations. */
+  bool build_incremental();
+
+ protected:
+  virtual void build_nodes(DepsgraphNodeBuilder &node_builder) override;
+  virtual void build_relations(DepsgraphRelationBuilder &relation_builder) override;
+
+ private:
+  struct ObjectToRebuild {
+    Object *object;
+    int base_index;
+  };
+
+  /* Either a node which is kept in the graph, or an operation of a re-built ID. */
+  struct KeptRelationNode {
+    Node *node = nullptr;
+    std::optional<PersistentOperationKey> operation_key;
+  };
+
+  /* Relation connected to a re-built ID which will not be re-created by its builder. */
+  struct KeptRelation {
+    KeptRelationNode from;
+    KeptRelationNode to;
+    const char *name;
+    int flag;
+    uint owner_session_uid;
+  };
+
+  bool find_objects_to_rebuild(DepsgraphNodeBuilder &node_builder);
+  void save_kept_relations();
+  bool restore_kept_relations();
+
+  Vector<ObjectToRebuild> objects_to_rebuild_;
+  Vector<IDNode *> rebuild_id_nodes_;
+  Vector<KeptRelation> kept_relations_;
+};
+
+}  // namespace blender::deg
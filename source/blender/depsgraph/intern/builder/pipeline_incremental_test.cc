@@ -0,0 +1,274 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "testing/testing.h"
+
+#include <string>
+
+#include "BLI_listbase.h"
+#include "BLI_map.hh"
+#include "BLI_set.hh"
+
+#include "BKE_collection.h"
+#include "BKE_constraint.h"
+#include "BKE_idtype.hh"
+#include "BKE_layer.hh"
+#include "BKE_main.hh"
+#include "BKE_mesh.hh"
+#include "BKE_modifier.hh"
+#include "BKE_object.hh"
+#include "BKE_scene.h"
+
+#include "DNA_constraint_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "DEG_depsgraph.hh"
+#include "DEG_depsgraph_build.hh"
+
+#include "RNA_define.hh"
+
+#include "intern/depsgraph.hh"
+#include "intern/depsgraph_relation.hh"
+#include "intern/depsgraph_type.hh"
+#include "intern/node/deg_node.hh"
+#include "intern/node/deg_node_component.hh"
+#include "intern/node/deg_node_id.hh"
+#include "intern/node/deg_node_operation.hh"
+
+namespace blender::deg::tests {
+
+class IncrementalBuildTest : public ::testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+    RNA_init();
+    BKE_modifier_init();
+    DEG_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    DEG_free_node_types();
+    RNA_exit();
+  }
+
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+  ViewLayer *view_layer = nullptr;
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    scene = BKE_scene_add(bmain, "Scene");
+    view_layer = static_cast<ViewLayer *>(scene->view_layers.first);
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+  }
+
+  Object *add_object(const char *name, const int type = OB_EMPTY)
+  {
+    Object *object = BKE_object_add_only_object(bmain, type, name);
+    if (type == OB_MESH) {
+      object->data = BKE_mesh_add(bmain, name);
+    }
+    BKE_collection_object_add(bmain, scene->master_collection, object);
+    BKE_view_layer_synced_ensure(scene, view_layer);
+    return object;
+  }
+
+  ::Depsgraph *build_full()
+  {
+    ::Depsgraph *graph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(graph);
+    return graph;
+  }
+};
+
+static std::string node_identifier(const Node *node)
+{
+  if (node->type != NodeType::OPERATION) {
+    return node->identifier();
+  }
+  const OperationNode *op_node = static_cast<const OperationNode *>(node);
+  return std::string(nodeTypeAsString(op_node->owner->type)) + "/" +
+         op_node->full_identifier() + "/" + std::to_string(op_node->name_tag);
+}
+
+static Set<std::string> graph_operations(const ::Depsgraph *graph)
+{
+  const Depsgraph *deg_graph = reinterpret_cast<const Depsgraph *>(graph);
+  Set<std::string> operations;
+  for (const OperationNode *op_node : deg_graph->operations) {
+    operations.add(node_identifier(op_node));
+  }
+  return operations;
+}
+
+static Set<std::string> graph_relations(const ::Depsgraph *graph)
+{
+  const Depsgraph *deg_graph = reinterpret_cast<const Depsgraph *>(graph);
+  Set<std::string> relations;
+  for (const OperationNode *op_node : deg_graph->operations) {
+    for (const Relation *rel : op_node->inlinks) {
+      relations.add(node_identifier(rel->from) + " -> " + node_identifier(rel->to) + " (" +
+                    rel->name + ")");
+    }
+  }
+  return relations;
+}
+
+static void expect_sets_eq(const Set<std::string> &incremental, const Set<std::string> &full)
+{
+  for (const std::string &item : full) {
+    EXPECT_TRUE(incremental.contains(item)) << "Missing in incremental build: " << item;
+  }
+  for (const std::string &item : incremental) {
+    EXPECT_TRUE(full.contains(item)) << "Missing in full build: " << item;
+  }
+}
+
+static void expect_graphs_eq(const ::Depsgraph *incremental, const ::Depsgraph *full)
+{
+  expect_sets_eq(graph_operations(incremental), graph_operations(full));
+  expect_sets_eq(graph_relations(incremental), graph_relations(full));
+}
+
+TEST_F(IncrementalBuildTest, ConstraintAddRemoveMatchesFullBuild)
+{
+  Object *target = add_object("Target");
+  Object *object = add_object("Object");
+  Object *child = add_object("Child");
+  child->parent = object;
+  add_object("Unrelated");
+
+  ::Depsgraph *graph = build_full();
+  const IDNode *target_node = reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id);
+
+  bConstraint *con = BKE_constraint_add_for_object(
+      object, "Copy Location", CONSTRAINT_TYPE_LOCLIKE);
+  static_cast<bLocateLikeConstraint *>(con->data)->tar = target;
+  DEG_graph_id_relations_tag_update(graph, &object->id);
+  DEG_graph_relations_update(graph);
+  /* Nodes of objects which are not re-built are kept by the incremental update. */
+  EXPECT_EQ(reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id), target_node);
+
+  ::Depsgraph *full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  BKE_constraint_remove(&object->constraints, con);
+  DEG_graph_id_relations_tag_update(graph, &object->id);
+  DEG_graph_relations_update(graph);
+  EXPECT_EQ(reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id), target_node);
+
+  full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  DEG_graph_free(graph);
+}
+
+TEST_F(IncrementalBuildTest, ModifierAddRemoveMatchesFullBuild)
+{
+  Object *target = add_object("Target");
+  Object *object = add_object("Object", OB_MESH);
+  Object *child = add_object("Child", OB_MESH);
+  child->parent = object;
+  add_object("Unrelated", OB_MESH);
+
+  ::Depsgraph *graph = build_full();
+  const IDNode *target_node = reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id);
+
+  ModifierData *md = BKE_modifier_new(eModifierType_Hook);
+  reinterpret_cast<HookModifierData *>(md)->object = target;
+  BLI_addtail(&object->modifiers, md);
+  DEG_graph_id_relations_tag_update(graph, &object->id);
+  DEG_graph_relations_update(graph);
+  /* Hooks don't have physics relations, so the object is re-built incrementally. */
+  EXPECT_EQ(reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id), target_node);
+
+  ::Depsgraph *full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  BLI_remlink(&object->modifiers, md);
+  BKE_modifier_free(md);
+  DEG_graph_id_relations_tag_update(graph, &object->id);
+  DEG_graph_relations_update(graph);
+  EXPECT_EQ(reinterpret_cast<Depsgraph *>(graph)->find_id_node(&target->id), target_node);
+
+  full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  DEG_graph_free(graph);
+}
+
+TEST_F(IncrementalBuildTest, PhysicsMatchesFullBuild)
+{
+  Object *collider = add_object("Collider", OB_MESH);
+  Object *object = add_object("Object", OB_MESH);
+  add_object("Unrelated", OB_MESH);
+
+  ::Depsgraph *graph = build_full();
+
+  /* Other objects find colliders by looking at the whole scene, so adding the modifier changes
+   * more than the relations of the object itself. */
+  BLI_addtail(&collider->modifiers, BKE_modifier_new(eModifierType_Collision));
+  DEG_graph_id_relations_tag_update(graph, &collider->id);
+  DEG_graph_relations_update(graph);
+
+  ::Depsgraph *full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  /* With collision relations in the graph, changes of other objects can't be done incrementally
+   * either. */
+  BLI_addtail(&object->modifiers, BKE_modifier_new(eModifierType_Cloth));
+  DEG_graph_id_relations_tag_update(graph, &object->id);
+  DEG_graph_relations_update(graph);
+
+  full_graph = build_full();
+  expect_graphs_eq(graph, full_graph);
+  DEG_graph_free(full_graph);
+
+  DEG_graph_free(graph);
+}
+
+TEST_F(IncrementalBuildTest, ScheduleKeepsCostsOnRebuild)
+{
+  add_object("Object", OB_MESH);
+  add_object("Other", OB_MESH);
+
+  ::Depsgraph *graph = build_full();
+  EvaluationSchedule &schedule = reinterpret_cast<Depsgraph *>(graph)->evaluation_schedule;
+  Map<std::string, float> costs;
+  for (const int i : IndexRange(schedule.size())) {
+    schedule.add_cost_sample(i, float(i + 1));
+    costs.add_new(node_identifier(schedule.operations[i]), float(i + 1));
+  }
+
+  /* Building from scratch frees all operation nodes, the costs are matched by the identity of
+   * the operations rather than the node addresses. */
+  DEG_graph_build_from_view_layer(graph);
+  ASSERT_EQ(schedule.size(), costs.size());
+  for (const int i : IndexRange(schedule.size())) {
+    EXPECT_EQ(schedule.costs[i], costs.lookup(node_identifier(schedule.operations[i])));
+  }
+
+  DEG_graph_free(graph);
+}
+
+}  // namespace blender::deg::tests
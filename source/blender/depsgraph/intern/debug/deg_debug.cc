@@ -27,9 +27,14 @@ bool DepsgraphDebug::do_time_debug() const
   return ((G.debug & G_DEBUG_DEPSGRAPH_TIME) != 0);
 }
 
+bool DepsgraphDebug::do_trace() const
+{
+  return trace != nullptr;
+}
+
 void DepsgraphDebug::begin_graph_evaluation()
 {
-  if (!do_time_debug()) {
+  if (!do_time_debug() && !do_trace()) {
     return;
   }
 
@@ -40,13 +45,24 @@ void DepsgraphDebug::begin_graph_evaluation()
 
 void DepsgraphDebug::end_graph_evaluation()
 {
-  if (!do_time_debug()) {
+  if (!do_time_debug() && !do_trace()) {
     return;
   }
 
   const double graph_eval_end_time = BLI_check_seconds_timer();
   const double graph_eval_time = graph_eval_end_time - graph_evaluation_start_time_;
 
+  if (do_trace()) {
+    if (flags & G_DEBUG_DEPSGRAPH_EVAL) {
+      trace->print_evaluation_summary(name, graph_eval_time);
+    }
+    trace->add_evaluation(graph_evaluation_start_time_, graph_eval_end_time);
+  }
+
+  if (!do_time_debug()) {
+    return;
+  }
+
   if (name.empty()) {
     printf("Depsgraph updated in %f seconds.\n", graph_eval_time);
   }
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "intern/debug/deg_debug_trace.h"
 #include "intern/depsgraph_type.hh"
 
 #include "BKE_global.h"
@@ -21,6 +22,7 @@ class DepsgraphDebug {
   DepsgraphDebug();
 
   bool do_time_debug() const;
+  bool do_trace() const;
 
   void begin_graph_evaluation();
   void end_graph_evaluation();
@@ -32,12 +34,16 @@ class DepsgraphDebug {
    * created for different view layer). */
   string name;
 
+  /* Timeline of the evaluated operations, only exists while tracing is enabled with
+   * #DEG_debug_trace_begin(). */
+  unique_ptr<EvaluationTrace> trace;
+
  protected:
   /* Maximum number of counters used to calculate frame rate of depsgraph update. */
   static const constexpr int MAX_FPS_COUNTERS = 64;
 
   /* Point in time when last graph evaluation began.
-   * Is initialized from begin_graph_evaluation() when time debug is enabled.
+   * Is initialized from begin_graph_evaluation() when time debug or tracing is enabled.
    */
   double graph_evaluation_start_time_;
 };
@@ -0,0 +1,134 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "intern/debug/deg_debug_trace.h"
+
+#include <cstdio>
+
+#include "BLI_serialize.hh"
+#include "BLI_task.h"
+#include "BLI_time.h"
+
+namespace blender::deg {
+
+namespace {
+
+/* Thread ID of the track with the graph evaluations, placed before the tracks of the threads. */
+constexpr int evaluations_track_id = 0;
+
+void append_complete_event(io::serialize::ArrayValue &trace_events,
+                           const EvaluationTrace::Event &event,
+                           const double trace_start_time,
+                           const int thread_id)
+{
+  /* Timestamps are in microseconds. */
+  std::shared_ptr<io::serialize::DictionaryValue> trace_event = trace_events.append_dict();
+  trace_event->append_str("name", event.name);
+  trace_event->append_str("cat", event.category);
+  trace_event->append_str("ph", "X");
+  trace_event->append_double("ts", (event.start_time - trace_start_time) * 1e6);
+  trace_event->append_double("dur", (event.end_time - event.start_time) * 1e6);
+  trace_event->append_int("pid", 0);
+  trace_event->append_int("tid", thread_id);
+}
+
+void append_metadata_event(io::serialize::ArrayValue &trace_events,
+                           const char *name,
+                           const int thread_id,
+                           std::string value)
+{
+  std::shared_ptr<io::serialize::DictionaryValue> trace_event = trace_events.append_dict();
+  trace_event->append_str("name", name);
+  trace_event->append_str("ph", "M");
+  trace_event->append_int("pid", 0);
+  trace_event->append_int("tid", thread_id);
+  trace_event->append_dict("args")->append_str("name", std::move(value));
+}
+
+}  // namespace
+
+EvaluationTrace::EvaluationTrace() : start_time_(BLI_check_seconds_timer()) {}
+
+void EvaluationTrace::add_event(std::string name,
+                                const char *category,
+                                const double start_time,
+                                const double end_time)
+{
+  ThreadEvents &thread = thread_events_.local();
+  thread.events.append({std::move(name), category, start_time, end_time});
+  thread.evaluation_events_num++;
+  thread.evaluation_busy_time += end_time - start_time;
+}
+
+void EvaluationTrace::add_evaluation(const double start_time, const double end_time)
+{
+  evaluations_.append({"Evaluation", "graph", start_time, end_time});
+  for (ThreadEvents &thread : thread_events_) {
+    thread.evaluation_events_num = 0;
+    thread.evaluation_busy_time = 0.0;
+  }
+}
+
+void EvaluationTrace::print_evaluation_summary(const StringRef graph_name,
+                                               const double evaluation_time)
+{
+  int operations_num = 0;
+  int threads_num = 0;
+  double busy_time = 0.0;
+  for (const ThreadEvents &thread : thread_events_) {
+    if (thread.evaluation_events_num == 0) {
+      continue;
+    }
+    operations_num += thread.evaluation_events_num;
+    threads_num++;
+    busy_time += thread.evaluation_busy_time;
+  }
+
+  /* Average number of threads which were busy evaluating operations during the evaluation. */
+  const double parallelism = (evaluation_time > 0.0) ? busy_time / evaluation_time : 0.0;
+  const std::string prefix = graph_name.is_empty() ? "" : "[" + std::string(graph_name) + "]: ";
+  printf("%sEvaluated %d operations on %d of %d threads, average parallelism %.2f.\n",
+         prefix.c_str(),
+         operations_num,
+         threads_num,
+         BLI_task_scheduler_num_threads(),
+         parallelism);
+}
+
+void EvaluationTrace::write_chrome_json(const StringRef filepath, const StringRef graph_name)
+{
+  io::serialize::DictionaryValue root;
+  root.append_str("displayTimeUnit", "ms");
+  std::shared_ptr<io::serialize::ArrayValue> trace_events = root.append_array("traceEvents");
+
+  const std::string process_name = graph_name.is_empty() ? StringRef("Depsgraph") : graph_name;
+  append_metadata_event(*trace_events, "process_name", 0, process_name);
+
+  append_metadata_event(*trace_events, "thread_name", evaluations_track_id, "Evaluations");
+  for (const Event &event : evaluations_) {
+    append_complete_event(*trace_events, event, start_time_, evaluations_track_id);
+  }
+
+  /* The order of the threads is arbitrary, they are only numbered to be told apart. */
+  int thread_id = evaluations_track_id + 1;
+  for (ThreadEvents &thread : thread_events_) {
+    if (thread.events.is_empty()) {
+      continue;
+    }
+    append_metadata_event(
+        *trace_events, "thread_name", thread_id, "Thread " + std::to_string(thread_id));
+    for (const Event &event : thread.events) {
+      append_complete_event(*trace_events, event, start_time_, thread_id);
+    }
+    thread_id++;
+  }
+
+  io::serialize::write_json_file(filepath, root);
+}
+
+}  // namespace blender::deg
@@ -0,0 +1,68 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include <string>
+
+#include "BLI_enumerable_thread_specific.hh"
+#include "BLI_string_ref.hh"
+#include "BLI_vector.hh"
+
+namespace blender::deg {
+
+/* Timeline of the operations evaluation, recorded between #DEG_debug_trace_begin() and
+ * #DEG_debug_trace_end().
+ *
+ * Every thread records the operations it has evaluated into its own list, so that recording does
+ * not need any synchronization between the threads. The timeline is written in the Chrome trace
+ * event format, which can be opened in `chrome://tracing` or https://ui.perfetto.dev, and shows
+ * how the evaluation is distributed over the threads. */
+class EvaluationTrace {
+ public:
+  struct Event {
+    std::string name;
+    /* Static string, such as the evaluation stage. */
+    const char *category;
+    double start_time;
+    double end_time;
+  };
+
+  EvaluationTrace();
+
+  /* Add event which happened on the current thread. Times are in seconds, as returned by
+   * #BLI_check_seconds_timer(). */
+  void add_event(std::string name, const char *category, double start_time, double end_time);
+
+  /* Add span of the whole graph evaluation, which is shown on its own track. Finishes the current
+   * evaluation, so that the next one starts with empty counters. */
+  void add_evaluation(double start_time, double end_time);
+
+  /* Print how the operations of the current evaluation were distributed over the threads. */
+  void print_evaluation_summary(StringRef graph_name, double evaluation_time);
+
+  /* Write all recorded events as Chrome trace event JSON. */
+  void write_chrome_json(StringRef filepath, StringRef graph_name);
+
+ private:
+  struct ThreadEvents {
+    Vector<Event> events;
+    /* Number of the operations and the time spent evaluating them during the current
+     * evaluation. */
+    int evaluation_events_num = 0;
+    double evaluation_busy_time = 0.0;
+  };
+
+  /* Time at which the tracing was started, timestamps in the file are relative to it. */
+  double start_time_;
+
+  Vector<Event> evaluations_;
+  threading::EnumerableThreadSpecific<ThreadEvents> thread_events_;
+};
+
+}  // namespace blender::deg
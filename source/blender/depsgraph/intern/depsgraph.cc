@@ -171,9 +171,11 @@ void Depsgraph::clear_id_nodes()
   clear_physics_relations(this);
 
   light_linking_cache.clear();
+  evaluation_schedule.clear();
 }
 
-Relation *Depsgraph::add_new_relation(Node *from, Node *to, const char *description, int flags)
+Relation *Depsgraph::add_new_relation(
+    Node *from, Node *to, const char *description, int flags, uint owner_session_uid)
 {
   Relation *rel = nullptr;
   if (flags & RELATION_CHECK_BEFORE_ADD) {
@@ -196,6 +198,7 @@ Relation *Depsgraph::add_new_relation(Node *from, Node *to, const char *descript
   /* Create new relation, and add it to the graph. */
   rel = new Relation(from, to, description);
   rel->flag |= flags;
+  rel->owner_session_uid = owner_session_uid;
   return rel;
 }
 
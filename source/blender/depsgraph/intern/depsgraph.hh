@@ -30,6 +30,7 @@
 #include "intern/debug/deg_debug.h"
 #include "intern/depsgraph_light_linking.hh"
 #include "intern/depsgraph_type.hh"
+#include "intern/eval/deg_eval_schedule.h"
 
 struct ID;
 struct Scene;
@@ -59,8 +60,11 @@ struct Depsgraph {
   IDNode *add_id_node(ID *id, ID *id_cow_hint = nullptr);
   void clear_id_nodes();
 
-  /** Add new relationship between two nodes. */
-  Relation *add_new_relation(Node *from, Node *to, const char *description, int flags = 0);
+  /** Add new relationship between two nodes.
+   * The owner is the session UID of the ID which builder adds the relation, see
+   * #Relation::owner_session_uid. */
+  Relation *add_new_relation(
+      Node *from, Node *to, const char *description, int flags = 0, uint owner_session_uid = 0);
 
   /* Check whether two nodes are connected by relation with given
    * description. Description might be nullptr to check ANY relation between
@@ -98,6 +102,12 @@ struct Depsgraph {
   /* Indicates whether relations needs to be updated. */
   bool need_update_relations;
 
+  /* Session UIDs of the IDs which relations were tagged for update with
+   * #DEG_id_relations_tag_update(). Is only filled in when all the relations update requests since
+   * the last build were done for specific IDs, which allows to update the graph incrementally.
+   * Empty when `need_update_relations` is set by a full relations update tag. */
+  Set<uint> relations_update_ids;
+
   /* Indicates whether indirect effect of nodes on a directly visible ones needs to be updated. */
   bool need_update_nodes_visibility;
 
@@ -123,6 +133,10 @@ struct Depsgraph {
   /* All operation nodes, sorted in order of single-thread traversal order. */
   OperationNodes operations;
 
+  /* Flat layout of the operations and relations between them used by the evaluation. Is built
+   * when the graph build is finalized. */
+  EvaluationSchedule evaluation_schedule;
+
   /* Spin lock for threading-critical operations.
    * Mainly used by graph evaluation. */
   SpinLock lock;
@@ -34,6 +34,7 @@
 #include "builder/pipeline_all_objects.h"
 #include "builder/pipeline_compositor.h"
 #include "builder/pipeline_from_ids.h"
+#include "builder/pipeline_incremental.h"
 #include "builder/pipeline_render.h"
 #include "builder/pipeline_view_layer.h"
 
@@ -281,6 +282,8 @@ void DEG_graph_tag_relations_update(Depsgraph *graph)
   DEG_DEBUG_PRINTF(graph, TAG, "%s: Tagging relations for update.\n", __func__);
   deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(graph);
   deg_graph->need_update_relations = true;
+  /* All relations are to be re-built, an incremental update is not possible anymore. */
+  deg_graph->relations_update_ids.clear();
 
   /* NOTE: When relations are updated, it's quite possible that we've got new bases in the scene.
    * This means, we need to re-create flat array of bases in view layer. */
@@ -304,6 +307,12 @@ void DEG_graph_relations_update(Depsgraph *graph)
     /* Graph is up to date, nothing to do. */
     return;
   }
+  if (!deg_graph->relations_update_ids.is_empty()) {
+    deg::IncrementalBuilderPipeline builder(graph);
+    if (builder.build_incremental()) {
+      return;
+    }
+  }
   DEG_graph_build_from_view_layer(graph);
 }
 
@@ -314,3 +323,32 @@ void DEG_relations_tag_update(Main *bmain)
     DEG_graph_tag_relations_update(reinterpret_cast<Depsgraph *>(depsgraph));
   }
 }
+
+void DEG_graph_id_relations_tag_update(Depsgraph *graph, ID *id)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(graph);
+  if (deg_graph->need_update_relations && deg_graph->relations_update_ids.is_empty()) {
+    /* All relations are already tagged for update. */
+    return;
+  }
+  DEG_DEBUG_PRINTF(graph, TAG, "%s: Tagging relations of %s for update.\n", __func__, id->name);
+  deg_graph->need_update_relations = true;
+  deg_graph->relations_update_ids.add(id->session_uid);
+  /* Same as for the full update, bases array might need to be re-created. */
+  deg::IDNode *id_node = deg_graph->find_id_node(&deg_graph->scene->id);
+  if (id_node != nullptr) {
+    graph_id_tag_update(deg_graph->bmain,
+                        deg_graph,
+                        &deg_graph->scene->id,
+                        ID_RECALC_BASE_FLAGS,
+                        deg::DEG_UPDATE_SOURCE_RELATIONS);
+  }
+}
+
+void DEG_id_relations_tag_update(Main *bmain, ID *id)
+{
+  DEG_GLOBAL_DEBUG_PRINTF(TAG, "%s: Tagging relations of %s for update.\n", __func__, id->name);
+  for (deg::Depsgraph *depsgraph : deg::get_all_registered_graphs(bmain)) {
+    DEG_graph_id_relations_tag_update(reinterpret_cast<Depsgraph *>(depsgraph), id);
+  }
+}
@@ -53,6 +53,26 @@ const char *DEG_debug_name_get(Depsgraph *depsgraph)
   return deg_graph->debug.name.c_str();
 }
 
+void DEG_debug_trace_begin(Depsgraph *depsgraph)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(depsgraph);
+  BLI_assert(!deg_graph->is_evaluating);
+  deg_graph->debug.trace = std::make_unique<deg::EvaluationTrace>();
+}
+
+void DEG_debug_trace_end(Depsgraph *depsgraph, const char *filepath)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(depsgraph);
+  BLI_assert(!deg_graph->is_evaluating);
+  if (!deg_graph->debug.do_trace()) {
+    return;
+  }
+  if (filepath != nullptr) {
+    deg_graph->debug.trace->write_chrome_json(filepath, deg_graph->debug.name);
+  }
+  deg_graph->debug.trace.reset();
+}
+
 bool DEG_debug_compare(const Depsgraph *graph1, const Depsgraph *graph2)
 {
   BLI_assert(graph1 != nullptr);
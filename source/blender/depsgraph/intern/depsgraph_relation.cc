@@ -10,13 +10,15 @@
 
 #include "BLI_utildefines.h"
 
+#include "BKE_lib_id.hh"
+
 #include "intern/depsgraph_type.hh"
 #include "intern/node/deg_node.hh"
 
 namespace blender::deg {
 
 Relation::Relation(Node *from, Node *to, const char *description)
-    : from(from), to(to), name(description), flag(0)
+    : from(from), to(to), name(description), flag(0), owner_session_uid(MAIN_ID_SESSION_UID_UNSET)
 {
   /* Hook it up to the nodes which use it.
    *
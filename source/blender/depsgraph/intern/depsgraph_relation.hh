@@ -10,6 +10,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_sys_types.h"
+
 namespace blender::deg {
 
 struct Node;
@@ -48,6 +50,11 @@ struct Relation {
   const char *name; /* label for debugging */
   int flag;         /* Bitmask of RelationFlag) */
 
+  /* Session UID of the ID which was being built when the relation was added, or
+   * MAIN_ID_SESSION_UID_UNSET for relations added outside of any ID builder (view layer, scene).
+   * Used by the incremental update to know which relations are re-created by re-building an ID. */
+  uint owner_session_uid;
+
   MEM_CXX_CLASS_ALLOC_FUNCS("Relation");
 };
 
@@ -11,9 +11,7 @@
 #include "intern/eval/deg_eval.h"
 
 #include "BLI_compiler_attrs.h"
-#include "BLI_function_ref.hh"
-#include "BLI_gsqueue.h"
-#include "BLI_task.h"
+#include "BLI_index_mask.hh"
 #include "BLI_time.h"
 #include "BLI_utildefines.h"
 
@@ -30,13 +28,12 @@
 #  include "BPY_extern.h"
 #endif
 
-#include "atomic_ops.h"
-
 #include "intern/depsgraph.hh"
 #include "intern/depsgraph_relation.hh"
 #include "intern/depsgraph_tag.hh"
 #include "intern/eval/deg_eval_copy_on_write.h"
 #include "intern/eval/deg_eval_flush.h"
+#include "intern/eval/deg_eval_schedule.h"
 #include "intern/eval/deg_eval_stats.h"
 #include "intern/eval/deg_eval_visibility.h"
 #include "intern/node/deg_node.hh"
@@ -49,13 +46,9 @@ namespace blender::deg {
 
 namespace {
 
-struct DepsgraphEvalState;
-
-void deg_task_run_func(TaskPool *pool, void *taskdata);
-
-void schedule_children(DepsgraphEvalState *state,
-                       OperationNode *node,
-                       FunctionRef<void(OperationNode *node)> schedule_fn);
+/* Costs of the operations are not expected to change much between evaluations, so the priorities
+ * are only updated once in a while. */
+constexpr int priorities_update_interval = 16;
 
 /* Denotes which part of dependency graph is being evaluated. */
 enum class EvaluationStage {
@@ -77,52 +70,66 @@ enum class EvaluationStage {
   SINGLE_THREADED_WORKAROUND,
 };
 
+const char *evaluation_stage_name(const EvaluationStage stage)
+{
+  switch (stage) {
+    case EvaluationStage::COPY_ON_WRITE:
+      return "COPY_ON_WRITE";
+    case EvaluationStage::DYNAMIC_VISIBILITY:
+      return "DYNAMIC_VISIBILITY";
+    case EvaluationStage::THREADED_EVALUATION:
+      return "THREADED_EVALUATION";
+    case EvaluationStage::SINGLE_THREADED_WORKAROUND:
+      return "SINGLE_THREADED_WORKAROUND";
+  }
+  BLI_assert_unreachable();
+  return "";
+}
+
 struct DepsgraphEvalState {
   Depsgraph *graph;
+  EvaluationSchedule *schedule;
   bool do_stats;
+  /* Records the evaluated operations when tracing is enabled, nullptr otherwise. */
+  EvaluationTrace *trace;
   EvaluationStage stage;
-  bool need_update_pending_parents = true;
+  bool need_update_evaluation_state = true;
   bool need_single_thread_pass = false;
+  /* Evaluate all operations on the calling thread. */
+  bool single_threaded = false;
 };
 
-void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_node)
+void evaluate_node(const DepsgraphEvalState *state, const int operation)
 {
   ::Depsgraph *depsgraph = reinterpret_cast<::Depsgraph *>(state->graph);
+  EvaluationSchedule &schedule = *state->schedule;
+  OperationNode *operation_node = schedule.operations[operation];
 
   /* Sanity checks. */
   BLI_assert_msg(!operation_node->is_noop(), "NOOP nodes should not actually be scheduled");
-  /* Perform operation. */
+  /* Perform operation. The time is always measured, as it is used for the priorities. */
+  const double start_time = BLI_check_seconds_timer();
+  operation_node->evaluate(depsgraph);
+  const double end_time = BLI_check_seconds_timer();
+  const double time = end_time - start_time;
   if (state->do_stats) {
-    const double start_time = BLI_check_seconds_timer();
-    operation_node->evaluate(depsgraph);
-    operation_node->stats.current_time += BLI_check_seconds_timer() - start_time;
+    operation_node->stats.current_time += time;
   }
-  else {
-    operation_node->evaluate(depsgraph);
+  if (state->trace != nullptr) {
+    state->trace->add_event(operation_node->full_identifier(),
+                            evaluation_stage_name(state->stage),
+                            start_time,
+                            end_time);
   }
+  schedule.add_cost_sample(operation, float(time));
 
   /* Clear the flag early on, allowing partial updates without re-evaluating the same node multiple
    * times.
-   * This is a thread-safe modification as the node's flags are only read for a non-scheduled nodes
-   * and this node has been scheduled. */
+   * This is a thread-safe modification as the node's flags are only read before the operations
+   * of an evaluation stage are executed. */
   operation_node->flag &= ~DEPSOP_FLAG_CLEAR_ON_EVAL;
 }
 
-void deg_task_run_func(TaskPool *pool, void *taskdata)
-{
-  void *userdata_v = BLI_task_pool_user_data(pool);
-  DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
-
-  /* Evaluate node. */
-  OperationNode *operation_node = reinterpret_cast<OperationNode *>(taskdata);
-  evaluate_node(state, operation_node);
-
-  /* Schedule children. */
-  schedule_children(state, operation_node, [&](OperationNode *node) {
-    BLI_task_pool_push(pool, deg_task_run_func, node, false, nullptr);
-  });
-}
-
 bool check_operation_node_visible(const DepsgraphEvalState *state, OperationNode *op_node)
 {
   const ComponentNode *comp_node = op_node->owner;
@@ -141,49 +148,23 @@ bool check_operation_node_visible(const DepsgraphEvalState *state, OperationNode
   return comp_node->affects_visible_id;
 }
 
-void calculate_pending_parents_for_node(const DepsgraphEvalState *state, OperationNode *node)
+void update_evaluation_state_if_needed(DepsgraphEvalState *state)
 {
-  /* Update counters, applies for both visible and invisible IDs. */
-  node->num_links_pending = 0;
-  node->scheduled = false;
-  /* Invisible IDs requires no pending operations. */
-  if (!check_operation_node_visible(state, node)) {
-    return;
-  }
-  /* No need to bother with anything if node is not tagged for update. */
-  if ((node->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
-    return;
-  }
-  for (Relation *rel : node->inlinks) {
-    if (rel->from->type == NodeType::OPERATION && (rel->flag & RELATION_FLAG_CYCLIC) == 0) {
-      OperationNode *from = (OperationNode *)rel->from;
-      /* TODO(sergey): This is how old layer system was checking for the
-       * calculation, but how is it possible that visible object depends
-       * on an invisible? This is something what is prohibited after
-       * deg_graph_build_flush_layers(). */
-      if (!check_operation_node_visible(state, from)) {
-        continue;
-      }
-      /* No need to wait for operation which is up to date. */
-      if ((from->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
-        continue;
-      }
-      ++node->num_links_pending;
-    }
-  }
-}
-
-void calculate_pending_parents_if_needed(DepsgraphEvalState *state)
-{
-  if (!state->need_update_pending_parents) {
+  if (!state->need_update_evaluation_state) {
     return;
   }
 
-  for (OperationNode *node : state->graph->operations) {
-    calculate_pending_parents_for_node(state, node);
+  EvaluationSchedule &schedule = *state->schedule;
+  for (const int i : schedule.operations.index_range()) {
+    OperationNode *node = schedule.operations[i];
+    schedule.evaluated[i] = false;
+    /* Invisible IDs requires no pending operations, and operations which are not tagged for
+     * update are considered up to date. */
+    schedule.need_evaluation[i] = check_operation_node_visible(state, node) &&
+                                  (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0;
   }
 
-  state->need_update_pending_parents = false;
+  state->need_update_evaluation_state = false;
 }
 
 void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
@@ -232,95 +213,74 @@ bool need_evaluate_operation_at_stage(DepsgraphEvalState *state,
   return false;
 }
 
-/* Schedule a node if it needs evaluation.
- *   dec_parents: Decrement pending parents count, true when child nodes are
- *                scheduled after a task has been completed.
- */
-void schedule_node(DepsgraphEvalState *state,
-                   OperationNode *node,
-                   bool dec_parents,
-                   const FunctionRef<void(OperationNode *node)> schedule_fn)
-{
-  /* No need to schedule nodes of invisible ID. */
-  if (!check_operation_node_visible(state, node)) {
-    return;
-  }
-  /* No need to schedule operations which are not tagged for update, they are
-   * considered to be up to date. */
-  if ((node->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
-    return;
-  }
-  /* TODO(sergey): This is not strictly speaking safe to read
-   * num_links_pending. */
-  if (dec_parents) {
-    BLI_assert(node->num_links_pending > 0);
-    atomic_sub_and_fetch_uint32(&node->num_links_pending, 1);
-  }
-  /* Cal not schedule operation while its dependencies are not yet
-   * evaluated. */
-  if (node->num_links_pending != 0) {
-    return;
-  }
-  /* During the COW stage only schedule COW nodes. */
-  if (!need_evaluate_operation_at_stage(state, node)) {
-    return;
-  }
-  /* Actually schedule the node. */
-  bool is_scheduled = atomic_fetch_and_or_uint8((uint8_t *)&node->scheduled, uint8_t(true));
-  if (!is_scheduled) {
-    if (node->is_noop()) {
-      /* Clear flags to avoid affecting subsequent update propagation.
-       * For normal nodes these are cleared when it is evaluated. */
-      node->flag &= ~DEPSOP_FLAG_CLEAR_ON_EVAL;
-
-      /* skip NOOP node, schedule children right away */
-      schedule_children(state, node, schedule_fn);
-    }
-    else {
-      /* children are scheduled once this task is completed */
-      schedule_fn(node);
-    }
-  }
-}
-
-void schedule_graph(DepsgraphEvalState *state,
-                    const FunctionRef<void(OperationNode *node)> schedule_fn)
+/* Gather operations to be evaluated at the current stage.
+ *
+ * An operation waits for all its parents which are visible and not up to date, so an operation
+ * whose parent is not evaluated at this stage is not evaluated at this stage either.
+ *
+ * NOTE: The visibility and update tag of the operations are taken from the last update of the
+ * evaluation state. The update tag of an operation is only cleared when it is evaluated, at which
+ * point it is also marked as evaluated, so this is the same as checking the current state of the
+ * operation. */
+IndexMask stage_operations_mask(DepsgraphEvalState *state, IndexMaskMemory &memory)
 {
-  for (OperationNode *node : state->graph->operations) {
-    schedule_node(state, node, false, schedule_fn);
-  }
-}
+  const EvaluationSchedule &schedule = *state->schedule;
+  const threading::TaskGraph &task_graph = *schedule.task_graph;
 
-void schedule_children(DepsgraphEvalState *state,
-                       OperationNode *node,
-                       const FunctionRef<void(OperationNode *node)> schedule_fn)
-{
-  for (Relation *rel : node->outlinks) {
-    OperationNode *child = (OperationNode *)rel->to;
-    BLI_assert(child->type == NodeType::OPERATION);
-    if (child->scheduled) {
-      /* Happens when having cyclic dependencies. */
+  Array<bool> blocked(schedule.size(), false);
+  Array<bool> in_stage(schedule.size(), false);
+  for (const int operation : task_graph.topological_order()) {
+    if (!schedule.need_evaluation[operation] || schedule.evaluated[operation]) {
+      continue;
+    }
+    if (!blocked[operation] &&
+        need_evaluate_operation_at_stage(state, schedule.operations[operation]))
+    {
+      in_stage[operation] = true;
       continue;
     }
-    schedule_node(state, child, (rel->flag & RELATION_FLAG_CYCLIC) == 0, schedule_fn);
+    for (const int child : task_graph.successors(operation)) {
+      blocked[child] = true;
+    }
   }
+  return IndexMask::from_bools(in_stage, memory);
 }
 
-/* Evaluate given stage of the dependency graph evaluation using multiple threads.
+/* Evaluate given stage of the dependency graph evaluation. The operations are evaluated by the
+ * task graph of the schedule, in order of their priorities.
  *
  * NOTE: Will assign the `state->stage` to the given stage. */
-void evaluate_graph_threaded_stage(DepsgraphEvalState *state,
-                                   TaskPool *task_pool,
-                                   const EvaluationStage stage)
+void evaluate_graph_stage(DepsgraphEvalState *state, const EvaluationStage stage)
 {
   state->stage = stage;
 
-  calculate_pending_parents_if_needed(state);
-
-  schedule_graph(state, [&](OperationNode *node) {
-    BLI_task_pool_push(task_pool, deg_task_run_func, node, false, nullptr);
-  });
-  BLI_task_pool_work_and_wait(task_pool);
+  update_evaluation_state_if_needed(state);
+
+  EvaluationSchedule &schedule = *state->schedule;
+  IndexMaskMemory memory;
+  const IndexMask operations = stage_operations_mask(state, memory);
+
+  threading::TaskGraph::ExecuteSettings settings;
+  /* Operations which do multi-threaded work while holding a lock isolate that work themselves. */
+  settings.isolate = false;
+  settings.single_threaded = state->single_threaded ||
+                             stage == EvaluationStage::SINGLE_THREADED_WORKAROUND;
+  schedule.task_graph->execute(
+      operations,
+      [&](const int operation) {
+        OperationNode *node = schedule.operations[operation];
+        if (node->is_noop()) {
+          /* Clear flags to avoid affecting subsequent update propagation.
+           * For normal nodes these are cleared when it is evaluated. */
+          node->flag &= ~DEPSOP_FLAG_CLEAR_ON_EVAL;
+        }
+        else {
+          evaluate_node(state, operation);
+        }
+      },
+      settings);
+
+  operations.foreach_index([&](const int operation) { schedule.evaluated[operation] = true; });
 }
 
 /* Evaluate remaining operations of the dependency graph in a single threaded manner. */
@@ -330,25 +290,9 @@ void evaluate_graph_single_threaded_if_needed(DepsgraphEvalState *state)
     return;
   }
 
-  BLI_assert(!state->need_update_pending_parents);
-
-  state->stage = EvaluationStage::SINGLE_THREADED_WORKAROUND;
-
-  GSQueue *evaluation_queue = BLI_gsqueue_new(sizeof(OperationNode *));
-  auto schedule_node_to_queue = [&](OperationNode *node) {
-    BLI_gsqueue_push(evaluation_queue, &node);
-  };
-  schedule_graph(state, schedule_node_to_queue);
+  BLI_assert(!state->need_update_evaluation_state);
 
-  while (!BLI_gsqueue_is_empty(evaluation_queue)) {
-    OperationNode *operation_node;
-    BLI_gsqueue_pop(evaluation_queue, &operation_node);
-
-    evaluate_node(state, operation_node);
-    schedule_children(state, operation_node, schedule_node_to_queue);
-  }
-
-  BLI_gsqueue_free(evaluation_queue);
+  evaluate_graph_stage(state, EvaluationStage::SINGLE_THREADED_WORKAROUND);
 }
 
 void depsgraph_ensure_view_layer(Depsgraph *graph)
@@ -368,15 +312,6 @@ void depsgraph_ensure_view_layer(Depsgraph *graph)
   deg_update_copy_on_write_datablock(graph, scene_id_node);
 }
 
-TaskPool *deg_evaluate_task_pool_create(DepsgraphEvalState *state)
-{
-  if (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) {
-    return BLI_task_pool_create_no_threads(state);
-  }
-
-  return BLI_task_pool_create_suspended(state, TASK_PRIORITY_HIGH);
-}
-
 }  // namespace
 
 void deg_evaluate_on_refresh(Depsgraph *graph)
@@ -401,7 +336,11 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   /* Set up evaluation state. */
   DepsgraphEvalState state;
   state.graph = graph;
+  state.schedule = &graph->evaluation_schedule;
+  BLI_assert(state.schedule->size() == graph->operations.size());
   state.do_stats = graph->debug.do_time_debug();
+  state.trace = graph->debug.trace.get();
+  state.single_threaded = (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) != 0;
 
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
@@ -423,33 +362,36 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
    *
    * - Single-threaded pass of all remaining operations. */
 
-  TaskPool *task_pool = deg_evaluate_task_pool_create(&state);
-
-  evaluate_graph_threaded_stage(&state, task_pool, EvaluationStage::COPY_ON_WRITE);
+  evaluate_graph_stage(&state, EvaluationStage::COPY_ON_WRITE);
 
   if (graph->has_animated_visibility || graph->need_update_nodes_visibility) {
-    /* Update pending parents including only the ones which are affecting operations which are
-     * affecting visibility. */
-    state.need_update_pending_parents = true;
+    /* Update the evaluation state including only the operations which are affecting
+     * visibility. */
+    state.need_update_evaluation_state = true;
 
-    evaluate_graph_threaded_stage(&state, task_pool, EvaluationStage::DYNAMIC_VISIBILITY);
+    evaluate_graph_stage(&state, EvaluationStage::DYNAMIC_VISIBILITY);
 
     deg_graph_flush_visibility_flags_if_needed(graph);
 
-    /* Update parents to an updated visibility and evaluation stage.
+    /* Update the evaluation state to an updated visibility and evaluation stage.
      *
-     * Need to do it regardless of whether visibility is actually changed or not: current state of
-     * the pending parents are all zeroes because it was previously calculated for only visibility
-     * related nodes and those are fully evaluated by now. */
-    state.need_update_pending_parents = true;
+     * Need to do it regardless of whether visibility is actually changed or not: the current
+     * state was previously calculated for only visibility related operations and those are fully
+     * evaluated by now. */
+    state.need_update_evaluation_state = true;
   }
 
-  evaluate_graph_threaded_stage(&state, task_pool, EvaluationStage::THREADED_EVALUATION);
-
-  BLI_task_pool_free(task_pool);
+  evaluate_graph_stage(&state, EvaluationStage::THREADED_EVALUATION);
 
   evaluate_graph_single_threaded_if_needed(&state);
 
+  /* Update priorities after the first evaluation, which usually measures costs of all operations,
+   * and then periodically. */
+  EvaluationSchedule &schedule = graph->evaluation_schedule;
+  if (schedule.evaluations_num++ % priorities_update_interval == 0) {
+    schedule.update_priorities();
+  }
+
   /* Finalize statistics gathering. This is because we only gather single
    * operation timing here, without aggregating anything to avoid any extra
    * synchronization. */
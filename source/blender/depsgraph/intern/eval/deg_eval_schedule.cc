@@ -0,0 +1,114 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "intern/eval/deg_eval_schedule.h"
+
+#include "BLI_hash.hh"
+#include "BLI_map.hh"
+#include "BLI_vector.hh"
+
+#include "intern/depsgraph.hh"
+#include "intern/depsgraph_relation.hh"
+#include "intern/node/deg_node_component.hh"
+#include "intern/node/deg_node_id.hh"
+#include "intern/node/deg_node_operation.hh"
+
+namespace blender::deg {
+
+uint64_t EvaluationScheduleOperationKey::hash() const
+{
+  return get_default_hash(get_default_hash(id_session_uid, component_type, component_name),
+                          get_default_hash(opcode, name, name_tag));
+}
+
+bool operator==(const EvaluationScheduleOperationKey &a, const EvaluationScheduleOperationKey &b)
+{
+  return a.id_session_uid == b.id_session_uid && a.component_type == b.component_type &&
+         a.component_name == b.component_name && a.opcode == b.opcode && a.name == b.name &&
+         a.name_tag == b.name_tag;
+}
+
+void EvaluationSchedule::build(const Depsgraph &graph)
+{
+  const Span<OperationNode *> graph_operations = graph.operations;
+  const int operations_num = int(graph_operations.size());
+
+  /* Operations which are kept by an update of the graph keep their measured costs, so that their
+   * priorities don't have to be learned again. The nodes of the previous schedule might have been
+   * freed already, so they are matched by their keys. */
+  Map<EvaluationScheduleOperationKey, float> previous_costs;
+  previous_costs.reserve(operation_keys.size());
+  for (const int i : operation_keys.index_range()) {
+    if (costs[i] != 0.0f) {
+      previous_costs.add(std::move(operation_keys[i]), costs[i]);
+    }
+  }
+
+  operations = graph_operations;
+
+  operation_keys.reinitialize(operations_num);
+  for (const int i : graph_operations.index_range()) {
+    const OperationNode *node = graph_operations[i];
+    const ComponentNode *component = node->owner;
+    operation_keys[i] = {component->owner->id_orig_session_uid,
+                         component->type,
+                         component->name,
+                         node->opcode,
+                         node->name,
+                         node->name_tag};
+  }
+
+  Map<const OperationNode *, int> operation_indices;
+  operation_indices.reserve(operations_num);
+  for (const int i : graph_operations.index_range()) {
+    operation_indices.add_new(graph_operations[i], i);
+  }
+
+  /* Cyclic relations are ignored, the remaining relations do not form cycles after the cycle
+   * detection. */
+  Vector<int2> edges;
+  for (const int i : graph_operations.index_range()) {
+    for (const Relation *rel : graph_operations[i]->outlinks) {
+      BLI_assert(rel->to->type == NodeType::OPERATION);
+      if ((rel->flag & RELATION_FLAG_CYCLIC) == 0) {
+        edges.append({i, operation_indices.lookup(static_cast<const OperationNode *>(rel->to))});
+      }
+    }
+  }
+  task_graph = std::make_unique<threading::TaskGraph>(operations_num, edges);
+
+  costs.reinitialize(operations_num);
+  for (const int i : graph_operations.index_range()) {
+    costs[i] = previous_costs.lookup_default(operation_keys[i], 0.0f);
+  }
+  this->update_priorities();
+  evaluations_num = 0;
+
+  need_evaluation.reinitialize(operations_num);
+  need_evaluation.fill(false);
+  evaluated.reinitialize(operations_num);
+  evaluated.fill(false);
+}
+
+void EvaluationSchedule::clear()
+{
+  /* The operation keys and costs are kept, so that the costs can be re-used when the graph is
+   * built again. */
+  operations = {};
+  task_graph.reset();
+  evaluations_num = 0;
+  need_evaluation = {};
+  evaluated = {};
+}
+
+void EvaluationSchedule::update_priorities()
+{
+  task_graph->set_critical_path_priorities(costs);
+}
+
+}  // namespace blender::deg
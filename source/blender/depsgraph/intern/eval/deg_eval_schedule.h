@@ -0,0 +1,97 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "BLI_array.hh"
+#include "BLI_sys_types.h"
+#include "BLI_task_graph.hh"
+
+namespace blender::deg {
+
+struct Depsgraph;
+struct OperationNode;
+enum class NodeType;
+enum class OperationCode;
+
+/* Identifier of an operation which stays the same when the graph is re-built. Unlike the address
+ * of the operation node it can not be re-used by a different operation once the node is freed. */
+struct EvaluationScheduleOperationKey {
+  /* Session UID of the original ID which owns the operation. */
+  uint id_session_uid;
+  NodeType component_type;
+  std::string component_name;
+  OperationCode opcode;
+  std::string name;
+  int name_tag;
+
+  uint64_t hash() const;
+  friend bool operator==(const EvaluationScheduleOperationKey &a,
+                         const EvaluationScheduleOperationKey &b);
+};
+
+/* Flat representation of the operation nodes of the graph and relations between them, which is
+ * used by the evaluation scheduler.
+ *
+ * Operations are referred to by their index in #Depsgraph::operations. Relations which are not
+ * cyclic are stored in a task graph, which evaluates the operations in the order of their
+ * priorities. Cyclic relations are ignored: evaluation of the child does not wait for the parent
+ * in this case.
+ *
+ * The schedule is built at the end of every graph build, and is only valid for as long as the
+ * operations and relations of the graph are not modified. */
+struct EvaluationSchedule {
+  /* Same order as #Depsgraph::operations. */
+  Array<OperationNode *> operations;
+  /* Stable identifiers of the operations, used to match measured costs when the schedule is
+   * re-built. */
+  Array<EvaluationScheduleOperationKey> operation_keys;
+
+  /* Node of every operation has the same index as the operation. The priority of an operation is
+   * the sum of the costs along the most expensive path from the operation to the end of the graph,
+   * so that long chains of dependent operations are started as early as possible. */
+  std::unique_ptr<threading::TaskGraph> task_graph;
+
+  /* Estimated evaluation time of every operation in seconds, measured during evaluation. Kept for
+   * the operations which stay in the graph when the schedule is re-built, also when the graph is
+   * cleared and built from scratch. */
+  Array<float> costs;
+  /* Number of evaluations since the schedule was built. */
+  int evaluations_num = 0;
+
+  /* Evaluation state of every operation. */
+
+  /* Operation is visible for the current evaluation stage and is tagged for update. */
+  Array<bool> need_evaluation;
+  /* Operation has been evaluated by one of the previous stages since the need for evaluation was
+   * last updated. */
+  Array<bool> evaluated;
+
+  void build(const Depsgraph &graph);
+  void clear();
+
+  /* Update priorities of the task graph from the current costs. */
+  void update_priorities();
+
+  void add_cost_sample(const int operation, const float time)
+  {
+    /* Smooth out differences between evaluations. */
+    float &cost = costs[operation];
+    cost = (cost == 0.0f) ? time : cost * 0.75f + time * 0.25f;
+  }
+
+  int size() const
+  {
+    return int(operations.size());
+  }
+};
+
+}  // namespace blender::deg
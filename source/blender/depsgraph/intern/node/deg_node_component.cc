@@ -165,6 +165,19 @@ OperationNode *ComponentNode::add_operation(const DepsEvalOperationCb &op,
 {
   OperationNode *op_node = find_operation(opcode, name, name_tag);
   if (!op_node) {
+    if (operations_map == nullptr) {
+      /* Component was finalized by a previous build, and the graph is now being updated
+       * incrementally. Move operations back to the map until the build is finalized again. */
+      operations_map = new Map<ComponentNode::OperationIDKey, OperationNode *>();
+      for (OperationNode *existing_op_node : operations) {
+        operations_map->add_new(
+            OperationIDKey(existing_op_node->opcode,
+                           existing_op_node->name.c_str(),
+                           existing_op_node->name_tag),
+            existing_op_node);
+      }
+      operations.clear();
+    }
     DepsNodeFactory *factory = type_get_factory(NodeType::OPERATION);
     op_node = (OperationNode *)factory->create_node(this->owner->id_orig, "", name);
 
@@ -279,6 +292,10 @@ OperationNode *ComponentNode::get_exit_operation()
 
 void ComponentNode::finalize_build(Depsgraph * /*graph*/)
 {
+  if (operations_map == nullptr) {
+    /* Component was not modified by an incremental update of the graph. */
+    return;
+  }
   operations.reserve(operations_map->size());
   for (OperationNode *op_node : operations_map->values()) {
     operations.append(op_node);
@@ -190,6 +190,7 @@ static int wm_stl_import_exec(bContext *C, wmOperator *op)
   params.use_scene_unit = RNA_boolean_get(op->ptr, "use_scene_unit");
   params.global_scale = RNA_float_get(op->ptr, "global_scale");
   params.use_mesh_validate = RNA_boolean_get(op->ptr, "use_mesh_validate");
+  params.merge_distance = RNA_float_get(op->ptr, "merge_distance");
 
   params.reports = op->reports;
 
@@ -239,6 +240,7 @@ static void ui_stl_import_settings(uiLayout *layout, PointerRNA *ptr)
   uiItemR(col, ptr, "forward_axis", UI_ITEM_NONE, IFACE_("Forward Axis"), ICON_NONE);
   uiItemR(col, ptr, "up_axis", UI_ITEM_NONE, nullptr, ICON_NONE);
   uiItemR(col, ptr, "use_mesh_validate", UI_ITEM_NONE, nullptr, ICON_NONE);
+  uiItemR(col, ptr, "merge_distance", UI_ITEM_NONE, nullptr, ICON_NONE);
 }
 
 static void wm_stl_import_draw(bContext * /*C*/, wmOperator *op)
@@ -288,6 +290,16 @@ void WM_OT_stl_import(wmOperatorType *ot)
                   false,
                   "Validate Mesh",
                   "Validate and correct imported mesh (slow)");
+  RNA_def_float_distance(ot->srna,
+                         "merge_distance",
+                         0.0f,
+                         0.0f,
+                         FLT_MAX,
+                         "Merge Distance",
+                         "Merge vertices closer than this distance (zero only merges vertices at "
+                         "the same position)",
+                         0.0f,
+                         1.0f);
 
   /* Only show .stl files by default. */
   prop = RNA_def_string(ot->srna, "filter_glob", "*.stl", 0, "Extension Filter", "");
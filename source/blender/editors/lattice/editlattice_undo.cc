@@ -15,6 +15,7 @@
 #include "CLG_log.h"
 
 #include "BLI_array_utils.h"
+#include "BLI_implicit_sharing.hh"
 #include "BLI_utildefines.h"
 
 #include "DNA_curve_types.h"
@@ -65,8 +66,11 @@ static void undolatt_to_editlatt(UndoLattice *ult, EditLatt *editlatt)
   const int len_src = ult->pntsu * ult->pntsv * ult->pntsw;
   const int len_dst = editlatt->latt->pntsu * editlatt->latt->pntsv * editlatt->latt->pntsw;
   if (len_src != len_dst) {
-    MEM_freeN(editlatt->latt->def);
+    blender::implicit_sharing::free_shared_data(&editlatt->latt->def,
+                                                &editlatt->latt->def_sharing_info);
     editlatt->latt->def = static_cast<BPoint *>(MEM_dupallocN(ult->def));
+    editlatt->latt->def_sharing_info = blender::implicit_sharing::info_for_mem_free(
+        editlatt->latt->def);
   }
   else {
     memcpy(editlatt->latt->def, ult->def, sizeof(BPoint) * len_src);
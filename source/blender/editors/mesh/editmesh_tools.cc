@@ -7200,6 +7200,70 @@ void MESH_OT_sort_elements(wmOperatorType *ot)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Pack Elements Operator
+ * \{ */
+
+/** Python keeps pointers to the elements of a BMesh it accesses, packing would invalidate them. */
+static bool edbm_bmesh_is_used_by_python(const BMesh *bm)
+{
+  return bm->py_handle != nullptr || CustomData_has_layer(&bm->vdata, CD_BM_ELEM_PYPTR) ||
+         CustomData_has_layer(&bm->edata, CD_BM_ELEM_PYPTR) ||
+         CustomData_has_layer(&bm->ldata, CD_BM_ELEM_PYPTR) ||
+         CustomData_has_layer(&bm->pdata, CD_BM_ELEM_PYPTR);
+}
+
+static int edbm_pack_elements_exec(bContext *C, wmOperator *op)
+{
+  const Scene *scene = CTX_data_scene(C);
+  ViewLayer *view_layer = CTX_data_view_layer(C);
+  Vector<Object *> objects = BKE_view_layer_array_from_objects_in_edit_mode_unique_data(
+      scene, view_layer, CTX_wm_view3d(C));
+
+  int packed_num = 0;
+  for (Object *obedit : objects) {
+    BMEditMesh *em = BKE_editmesh_from_object(obedit);
+    BMesh *bm = em->bm;
+
+    if (edbm_bmesh_is_used_by_python(bm)) {
+      BKE_reportf(op->reports,
+                  RPT_WARNING,
+                  "Mesh \"%s\" is accessed from Python and was not packed",
+                  obedit->id.name + 2);
+      continue;
+    }
+    BM_mesh_pack(bm);
+    packed_num++;
+
+    EDBMUpdate_Params params{};
+    params.calc_looptris = true;
+    params.calc_normals = false;
+    params.is_destructive = true;
+    EDBM_update(static_cast<Mesh *>(obedit->data), &params);
+  }
+
+  return packed_num ? OPERATOR_FINISHED : OPERATOR_CANCELLED;
+}
+
+void MESH_OT_pack_elements(wmOperatorType *ot)
+{
+  /* identifiers */
+  ot->name = "Pack Mesh Elements";
+  ot->description =
+      "Store the vertices, edges and faces next to each other in memory again, which speeds up "
+      "editing after many elements have been added and removed";
+  ot->idname = "MESH_OT_pack_elements";
+
+  /* api callbacks */
+  ot->exec = edbm_pack_elements_exec;
+  ot->poll = ED_operator_editmesh;
+
+  /* flags */
+  ot->flag = OPTYPE_REGISTER | OPTYPE_UNDO;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Bridge Operator
  * \{ */
@@ -1340,7 +1340,7 @@ void ED_object_constraint_dependency_update(Main *bmain, Object *ob)
   if (ob->pose) {
     object_pose_tag_update(bmain, ob);
   }
-  DEG_relations_tag_update(bmain);
+  DEG_id_relations_tag_update(bmain, &ob->id);
 }
 
 void ED_object_constraint_tag_update(Main *bmain, Object *ob, bConstraint *con)
@@ -1373,7 +1373,7 @@ void ED_object_constraint_dependency_tag_update(Main *bmain, Object *ob, bConstr
   if (ob->pose) {
     object_pose_tag_update(bmain, ob);
   }
-  DEG_relations_tag_update(bmain);
+  DEG_id_relations_tag_update(bmain, &ob->id);
 }
 
 bool ED_object_constraint_move_to_index(Object *ob, bConstraint *con, const int index)
@@ -1451,7 +1451,7 @@ static int constraint_delete_exec(bContext *C, wmOperator *op)
     ED_object_constraint_update(bmain, ob);
 
     /* relations */
-    DEG_relations_tag_update(bmain);
+    DEG_id_relations_tag_update(bmain, &ob->id);
 
     /* notifiers */
     WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_REMOVED, ob);
@@ -1540,7 +1540,7 @@ static int constraint_apply_exec(bContext *C, wmOperator *op)
   /* Needed to set the flags on pose-bones correctly. */
   ED_object_constraint_update(bmain, ob);
 
-  DEG_relations_tag_update(bmain);
+  DEG_id_relations_tag_update(bmain, &ob->id);
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_REMOVED, ob);
   if (pchan) {
     WM_event_add_notifier(C, NC_OBJECT | ND_POSE, ob);
@@ -1640,7 +1640,7 @@ static int constraint_copy_exec(bContext *C, wmOperator *op)
   /* Needed to set the flags on pose-bones correctly. */
   ED_object_constraint_update(bmain, ob);
 
-  DEG_relations_tag_update(bmain);
+  DEG_id_relations_tag_update(bmain, &ob->id);
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_ADDED, ob);
 
   if (RNA_boolean_get(op->ptr, "report")) {
@@ -1724,6 +1724,8 @@ static int constraint_copy_to_selected_exec(bContext *C, wmOperator *op)
 
       BKE_pose_tag_recalc(bmain, ob->pose);
       DEG_id_tag_update((ID *)ob, ID_RECALC_GEOMETRY);
+      /* Force depsgraph to get recalculated since new relationships added. */
+      DEG_id_relations_tag_update(bmain, &ob->id);
       prev_ob = ob;
     }
     CTX_DATA_END;
@@ -1740,13 +1742,12 @@ static int constraint_copy_to_selected_exec(bContext *C, wmOperator *op)
       copy_con->flag |= CONSTRAINT_OVERRIDE_LIBRARY_LOCAL;
 
       DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY | ID_RECALC_TRANSFORM);
+      /* Force depsgraph to get recalculated since new relationships added. */
+      DEG_id_relations_tag_update(bmain, &ob->id);
     }
     CTX_DATA_END;
   }
 
-  /* Force depsgraph to get recalculated since new relationships added. */
-  DEG_relations_tag_update(bmain);
-
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT, nullptr);
 
   return OPERATOR_FINISHED;
@@ -2021,15 +2022,14 @@ static int pose_constraints_clear_exec(bContext *C, wmOperator * /*op*/)
 
     if (prev_ob != ob) {
       DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+      /* force depsgraph to get recalculated since relationships removed */
+      DEG_id_relations_tag_update(bmain, &ob->id);
       WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_REMOVED, ob);
       prev_ob = ob;
     }
   }
   CTX_DATA_END;
 
-  /* force depsgraph to get recalculated since relationships removed */
-  DEG_relations_tag_update(bmain);
-
   /* NOTE: calling BIK_clear_data() isn't needed here. */
 
   return OPERATOR_FINISHED;
@@ -2056,12 +2056,11 @@ static int object_constraints_clear_exec(bContext *C, wmOperator * /*op*/)
   CTX_DATA_BEGIN (C, Object *, ob, selected_editable_objects) {
     BKE_constraints_free(&ob->constraints);
     DEG_id_tag_update(&ob->id, ID_RECALC_TRANSFORM);
+    /* force depsgraph to get recalculated since relationships removed */
+    DEG_id_relations_tag_update(bmain, &ob->id);
   }
   CTX_DATA_END;
 
-  /* force depsgraph to get recalculated since relationships removed */
-  DEG_relations_tag_update(bmain);
-
   /* do updates */
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_REMOVED, nullptr);
 
@@ -2116,15 +2115,14 @@ static int pose_constraint_copy_exec(bContext *C, wmOperator *op)
       if (prev_ob != ob) {
         BKE_pose_tag_recalc(bmain, ob->pose);
         DEG_id_tag_update((ID *)ob, ID_RECALC_GEOMETRY);
+        /* force depsgraph to get recalculated since new relationships added */
+        DEG_id_relations_tag_update(bmain, &ob->id);
         prev_ob = ob;
       }
     }
   }
   CTX_DATA_END;
 
-  /* force depsgraph to get recalculated since new relationships added */
-  DEG_relations_tag_update(bmain);
-
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT, nullptr);
 
   return OPERATOR_FINISHED;
@@ -2162,13 +2160,12 @@ static int object_constraint_copy_exec(bContext *C, wmOperator * /*op*/)
     if (obact != ob) {
       BKE_constraints_copy(&ob->constraints, &obact->constraints, true);
       DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY | ID_RECALC_TRANSFORM);
+      /* force depsgraph to get recalculated since new relationships added */
+      DEG_id_relations_tag_update(bmain, &ob->id);
     }
   }
   CTX_DATA_END;
 
-  /* force depsgraph to get recalculated since new relationships added */
-  DEG_relations_tag_update(bmain);
-
   /* notifiers for updates */
   WM_event_add_notifier(C, NC_OBJECT | ND_CONSTRAINT | NA_ADDED, nullptr);
 
@@ -2439,7 +2436,7 @@ static int constraint_add_exec(
   }
 
   /* force depsgraph to get recalculated since new relationships added */
-  DEG_relations_tag_update(bmain);
+  DEG_id_relations_tag_update(bmain, &ob->id);
 
   if ((ob->type == OB_ARMATURE) && (pchan)) {
     BKE_pose_tag_recalc(bmain, ob->pose); /* sort pose channels */
@@ -3341,7 +3341,8 @@ static std::optional<int> filelist_readjob_list_lib(FileListReadJob *job_params,
 
   /* Open the library file. */
   BlendFileReadReport bf_reports{};
-  libfiledata = BLO_blendhandle_from_file(dir, &bf_reports);
+  /* Only use existing caches, browsing many files shouldn't fill the cache directory. */
+  libfiledata = BLO_blendhandle_from_file_indexed(dir, &bf_reports, false);
   if (libfiledata == nullptr) {
     return std::nullopt;
   }
@@ -0,0 +1,58 @@
+/* SPDX-FileCopyrightText: 2023 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#pragma once
+
+#include "BLI_array.hh"
+#include "BLI_span.hh"
+#include "BLI_utility_mixins.hh"
+
+struct BLI_mmap_file;
+
+namespace blender::io {
+
+/**
+ * Read-only access to the whole contents of a file, shared by the importers so that parsers can
+ * work directly on the file bytes instead of copying them through `fread` buffers. Any part of
+ * the data can be sliced out and handed to a parallel task.
+ *
+ * The file is memory-mapped with #BLI_mmap_file. When that is not possible (empty files, file
+ * systems without mapping support) the contents are read into memory instead, with the same
+ * interface.
+ *
+ * Pages of a mapping are only loaded on access, so IO errors may happen while reading #data().
+ * They are caught by the SIGBUS handler of #BLI_mmap_file, and the contents are only valid if
+ * #has_io_error is false after reading them. On Windows such errors can only be caught with
+ * structured exception handling around every access, so files are always read into memory there.
+ */
+class MappedFile : NonCopyable, NonMovable {
+ private:
+  BLI_mmap_file *mmap_file_ = nullptr;
+  Array<char> fallback_buffer_;
+  Span<char> data_;
+  bool is_open_ = false;
+
+ public:
+  explicit MappedFile(const char *filepath);
+  ~MappedFile();
+
+  /** Whether the file could be opened; an empty file is open with empty #data(). */
+  bool is_open() const
+  {
+    return is_open_;
+  }
+
+  Span<char> data() const
+  {
+    return data_;
+  }
+
+  int64_t size() const
+  {
+    return data_.size();
+  }
+
+  bool has_io_error() const;
+};
+
+}  // namespace blender::io
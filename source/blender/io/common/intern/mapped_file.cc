@@ -0,0 +1,65 @@
+/* SPDX-FileCopyrightText: 2023 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+#include "IO_mapped_file.hh"
+
+#include "BLI_fileops.h"
+#include "BLI_mmap.h"
+
+#include <cstdio>
+#include <fcntl.h>
+
+#ifndef WIN32
+#  include <unistd.h>
+#else
+#  include <io.h>
+#endif
+
+namespace blender::io {
+
+MappedFile::MappedFile(const char *filepath)
+{
+  const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return;
+  }
+  is_open_ = true;
+
+#ifndef WIN32
+  mmap_file_ = BLI_mmap_open(file);
+  if (mmap_file_ != nullptr) {
+    close(file);
+    data_ = Span<char>(static_cast<const char *>(BLI_mmap_get_pointer(mmap_file_)),
+                       int64_t(BLI_mmap_get_length(mmap_file_)));
+    return;
+  }
+#endif
+
+  /* Mapping failed or is not used, read the whole file instead. */
+  const int64_t size = BLI_lseek(file, 0, SEEK_END);
+  if (size > 0) {
+    BLI_lseek(file, 0, SEEK_SET);
+    fallback_buffer_.reinitialize(size);
+    if (BLI_read(file, fallback_buffer_.data(), size_t(size)) != size) {
+      fprintf(stderr, "Failed to read file '%s'\n", filepath);
+      fallback_buffer_ = {};
+      is_open_ = false;
+    }
+  }
+  close(file);
+  data_ = fallback_buffer_;
+}
+
+MappedFile::~MappedFile()
+{
+  if (mmap_file_ != nullptr) {
+    BLI_mmap_free(mmap_file_);
+  }
+}
+
+bool MappedFile::has_io_error() const
+{
+  return mmap_file_ != nullptr && BLI_mmap_any_io_error(mmap_file_);
+}
+
+}  // namespace blender::io
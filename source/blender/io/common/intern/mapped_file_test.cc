@@ -0,0 +1,82 @@
+/* SPDX-FileCopyrightText: 2023 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "IO_mapped_file.hh"
+
+#include "BLI_fileops.h"
+#include "BLI_path_util.h"
+#include "BLI_tempfile.h"
+
+#include <cstdio>
+#include <string>
+
+namespace blender::io::tests {
+
+class MappedFileTest : public testing::Test {
+ public:
+  std::string temp_dir;
+
+  void SetUp() override
+  {
+    char temp_dir_c[FILE_MAX];
+    BLI_temp_directory_path_get(temp_dir_c, sizeof(temp_dir_c));
+    temp_dir = std::string(temp_dir_c) + SEP_STR + "blender_io_mapped_file_test";
+    if (!BLI_exists(temp_dir.c_str())) {
+      BLI_dir_create_recursive(temp_dir.c_str());
+    }
+  }
+
+  void TearDown() override
+  {
+    if (BLI_exists(temp_dir.c_str())) {
+      BLI_delete(temp_dir.c_str(), true, true);
+    }
+  }
+
+  std::string write_file(const char *name, const std::string &contents)
+  {
+    const std::string filepath = temp_dir + SEP_STR + name;
+    FILE *file = BLI_fopen(filepath.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+    return filepath;
+  }
+};
+
+TEST_F(MappedFileTest, contents)
+{
+  std::string contents = "v 1 2 3\nf 1 2 3\n";
+  contents.push_back('\0');
+  contents += "binary";
+  const std::string filepath = write_file("contents.obj", contents);
+
+  MappedFile file(filepath.c_str());
+  ASSERT_TRUE(file.is_open());
+  EXPECT_EQ(file.size(), int64_t(contents.size()));
+  EXPECT_EQ(std::string(file.data().data(), file.data().size()), contents);
+  EXPECT_FALSE(file.has_io_error());
+}
+
+TEST_F(MappedFileTest, empty)
+{
+  const std::string filepath = write_file("empty.obj", "");
+
+  MappedFile file(filepath.c_str());
+  EXPECT_TRUE(file.is_open());
+  EXPECT_TRUE(file.data().is_empty());
+  EXPECT_FALSE(file.has_io_error());
+}
+
+TEST_F(MappedFileTest, missing)
+{
+  const std::string filepath = temp_dir + SEP_STR + "missing.obj";
+
+  MappedFile file(filepath.c_str());
+  EXPECT_FALSE(file.is_open());
+  EXPECT_TRUE(file.data().is_empty());
+}
+
+}  // namespace blender::io::tests
@@ -18,7 +18,6 @@
 #include "BLI_memory_utils.hh"
 #include "IO_ply.hh"
 
-#include "ply_data.hh"
 #include "ply_export.hh"
 #include "ply_export_data.hh"
 #include "ply_export_header.hh"
@@ -30,8 +29,11 @@ namespace blender::io::ply {
 
 void exporter_main(bContext *C, const PLYExportParams &export_params)
 {
-  std::unique_ptr<blender::io::ply::PlyData> plyData = std::make_unique<PlyData>();
-  load_plydata(*plyData, CTX_data_ensure_evaluated_depsgraph(C), export_params);
+  /* Elements are written straight from the mesh data, without gathering them into #PlyData
+   * first, to keep memory usage low for large meshes. Meshes that are triangulated for export
+   * are still copied, see #PlyExportMesh::owned_mesh. */
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = gather_export_meshes(
+      CTX_data_ensure_evaluated_depsgraph(C), export_params);
 
   std::unique_ptr<FileBuffer> buffer;
 
@@ -52,13 +54,15 @@ void exporter_main(bContext *C, const PLYExportParams &export_params)
     return;
   }
 
-  write_header(*buffer.get(), *plyData.get(), export_params);
+  const PlyExportLayout layout = calc_export_layout(meshes, export_params);
 
-  write_vertices(*buffer.get(), *plyData.get());
+  write_header(*buffer.get(), layout, export_params);
 
-  write_faces(*buffer.get(), *plyData.get());
+  write_vertices(*buffer.get(), meshes, layout, export_params);
 
-  write_edges(*buffer.get(), *plyData.get());
+  write_faces(*buffer.get(), meshes);
+
+  write_edges(*buffer.get(), meshes);
 
   buffer->close_file();
 }
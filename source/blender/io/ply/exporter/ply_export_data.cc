@@ -7,56 +7,183 @@
  */
 
 #include "ply_export_data.hh"
-#include "ply_data.hh"
+#include "IO_ply.hh"
+#include "ply_export_load_plydata.hh"
 #include "ply_file_buffer.hh"
 
+#include "BKE_mesh.hh"
+#include "BLI_array.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_math_color.h"
+#include "BLI_math_matrix.h"
+#include "BLI_math_vector.h"
+#include "BLI_task.hh"
+#include "BLI_threads.h"
+
 namespace blender::io::ply {
 
-void write_vertices(FileBuffer &buffer, const PlyData &ply_data)
-{
-  for (int i = 0; i < ply_data.vertices.size(); i++) {
-    buffer.write_vertex(ply_data.vertices[i].x, ply_data.vertices[i].y, ply_data.vertices[i].z);
+/* Split up large meshes into multi-threaded jobs; each job processes
+ * this amount of items. */
+static const int64_t chunk_size = 32768;
 
-    if (!ply_data.vertex_normals.is_empty()) {
-      buffer.write_vertex_normal(ply_data.vertex_normals[i].x,
-                                 ply_data.vertex_normals[i].y,
-                                 ply_data.vertex_normals[i].z);
+/* Write /items_num/ items to the PLY file. Each item is written by a /function/ that
+ * should be independent from other items. Large amounts of items are written in parallel
+ * into temporary memory buffers, which are appended to /buffer/ in order. The output is
+ * flushed to the file after every batch of chunks, so only a bounded part of the file
+ * is held in memory at once. */
+template<typename Function>
+static void write_parallel_chunked(FileBuffer &buffer,
+                                   const int64_t items_num,
+                                   const Function &function)
+{
+  if (items_num <= 0) {
+    return;
+  }
+  const int64_t chunks_num = (items_num + chunk_size - 1) / chunk_size;
+  if (chunks_num == 1) {
+    for (const int64_t i : IndexRange(items_num)) {
+      function(buffer, i);
     }
+    buffer.write_to_file();
+    return;
+  }
 
-    if (!ply_data.vertex_colors.is_empty()) {
-      buffer.write_vertex_color(uchar(ply_data.vertex_colors[i].x * 255),
-                                uchar(ply_data.vertex_colors[i].y * 255),
-                                uchar(ply_data.vertex_colors[i].z * 255),
-                                uchar(ply_data.vertex_colors[i].w * 255));
-    }
+  const int64_t batch_size = std::min<int64_t>(BLI_system_thread_count() * 4, chunks_num);
+  Array<std::unique_ptr<FileBuffer>> chunk_buffers(batch_size);
+  for (std::unique_ptr<FileBuffer> &chunk_buffer : chunk_buffers) {
+    chunk_buffer = buffer.create_memory_buffer();
+  }
 
-    if (!ply_data.uv_coordinates.is_empty()) {
-      buffer.write_UV(ply_data.uv_coordinates[i].x, ply_data.uv_coordinates[i].y);
+  for (int64_t batch_start = 0; batch_start < chunks_num; batch_start += batch_size) {
+    const IndexRange batch(batch_start, std::min(batch_size, chunks_num - batch_start));
+    threading::parallel_for(batch.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t r : range) {
+        const int64_t start = batch[r] * chunk_size;
+        const IndexRange items(start, std::min(chunk_size, items_num - start));
+        FileBuffer &chunk_buffer = *chunk_buffers[r];
+        for (const int64_t i : items) {
+          function(chunk_buffer, i);
+        }
+      }
+    });
+    for (const int64_t r : batch.index_range()) {
+      buffer.append_from(*chunk_buffers[r]);
     }
+    buffer.write_to_file();
+  }
+}
+
+void write_vertices(FileBuffer &buffer,
+                    Span<std::unique_ptr<PlyExportMesh>> meshes,
+                    const PlyExportLayout &layout,
+                    const PLYExportParams &export_params)
+{
+  for (const std::unique_ptr<PlyExportMesh> &export_mesh : meshes) {
+    const Mesh *mesh = export_mesh->mesh;
+    const Span<float3> positions = mesh->vert_positions();
+    const Span<float3> vert_normals = layout.has_normals ? mesh->vert_normals() : Span<float3>();
+    const VArray<ColorGeometry4f> &colors = export_mesh->colors;
+    const Span<float2> uvs = export_mesh->uvs;
 
-    for (const PlyCustomAttribute &attr : ply_data.vertex_custom_attr) {
-      buffer.write_data(attr.data[i]);
+    /* Attributes in the order of the header, null if this mesh does not have them. */
+    Vector<const VArray<float> *> attributes;
+    for (const std::string &name : layout.custom_attribute_names) {
+      const VArray<float> *values = nullptr;
+      for (const PlyAttributeColumn &column : export_mesh->attributes) {
+        if (column.name == name) {
+          values = &column.values;
+          break;
+        }
+      }
+      attributes.append(values);
     }
 
-    buffer.write_vertex_end();
+    write_parallel_chunked(buffer, export_mesh->vertices_num(), [&](FileBuffer &buf, int64_t i) {
+      const int vertex = export_mesh->mesh_vertex(i);
+
+      float3 pos = positions[vertex];
+      mul_m4_v3(export_mesh->world_and_axes_transform, pos);
+      mul_v3_fl(pos, export_params.global_scale);
+      buf.write_vertex(pos.x, pos.y, pos.z);
+
+      if (layout.has_normals) {
+        float3 normal = vert_normals[vertex];
+        mul_m3_v3(export_mesh->world_and_axes_normal_transform, normal);
+        buf.write_vertex_normal(normal.x, normal.y, normal.z);
+      }
+
+      if (layout.has_colors) {
+        float4 color(0);
+        if (!colors.is_empty()) {
+          color = float4(colors[vertex]);
+          if (export_params.vertex_colors == PLY_VERTEX_COLOR_SRGB) {
+            linearrgb_to_srgb_v4(color, color);
+          }
+        }
+        buf.write_vertex_color(
+            uchar(color.x * 255), uchar(color.y * 255), uchar(color.z * 255), uchar(color.w * 255));
+      }
+
+      if (layout.has_uvs) {
+        const float2 uv = uvs.is_empty() ? float2(0) : uvs[i];
+        buf.write_UV(uv.x, uv.y);
+      }
+
+      for (const VArray<float> *values : attributes) {
+        buf.write_data(values ? (*values)[vertex] : 0.0f);
+      }
+
+      buf.write_vertex_end();
+    });
   }
   buffer.write_to_file();
 }
 
-void write_faces(FileBuffer &buffer, const PlyData &ply_data)
+void write_faces(FileBuffer &buffer, Span<std::unique_ptr<PlyExportMesh>> meshes)
 {
-  const uint32_t *indices = ply_data.face_vertices.data();
-  for (uint32_t face_size : ply_data.face_sizes) {
-    buffer.write_face(char(face_size), Span<uint32_t>(indices, face_size));
-    indices += face_size;
+  for (const std::unique_ptr<PlyExportMesh> &export_mesh : meshes) {
+    const Mesh *mesh = export_mesh->mesh;
+    const OffsetIndices faces = mesh->faces();
+    const Span<int> corner_verts = mesh->corner_verts();
+    const Span<int> loop_to_ply = export_mesh->loop_to_ply;
+    const uint32_t vertex_offset = uint32_t(export_mesh->vertex_offset);
+
+    write_parallel_chunked(buffer, faces.size(), [&](FileBuffer &buf, int64_t i) {
+      const IndexRange face = faces[i];
+      /* Faces with more vertices are triangulated before export. */
+      BLI_assert(face.size() <= 255);
+      uint32_t indices[255];
+      for (const int j : face.index_range()) {
+        const int corner = face[j];
+        const int ply_index = loop_to_ply.is_empty() ? corner_verts[corner] : loop_to_ply[corner];
+        indices[j] = uint32_t(ply_index) + vertex_offset;
+      }
+      buf.write_face(char(face.size()), Span<uint32_t>(indices, face.size()));
+    });
   }
   buffer.write_to_file();
 }
-void write_edges(FileBuffer &buffer, const PlyData &ply_data)
+
+void write_edges(FileBuffer &buffer, Span<std::unique_ptr<PlyExportMesh>> meshes)
 {
-  for (const std::pair<int, int> &edge : ply_data.edges) {
-    buffer.write_edge(edge.first, edge.second);
+  for (const std::unique_ptr<PlyExportMesh> &export_mesh : meshes) {
+    const Mesh *mesh = export_mesh->mesh;
+    const bke::LooseEdgeCache &loose_edges = mesh->loose_edges();
+    if (loose_edges.count <= 0) {
+      continue;
+    }
+    const Span<int2> edges = mesh->edges();
+    IndexMaskMemory memory;
+    const IndexMask loose_mask = IndexMask::from_bits(loose_edges.is_loose_bits, memory);
+    const int vertex_offset = int(export_mesh->vertex_offset);
+
+    write_parallel_chunked(buffer, loose_mask.size(), [&](FileBuffer &buf, int64_t i) {
+      const int2 edge = edges[loose_mask[i]];
+      buf.write_edge(export_mesh->ply_vertex(edge[0]) + vertex_offset,
+                     export_mesh->ply_vertex(edge[1]) + vertex_offset);
+    });
   }
   buffer.write_to_file();
 }
+
 }  // namespace blender::io::ply
@@ -8,15 +8,29 @@
 
 #pragma once
 
+#include <memory>
+
+#include "BLI_span.hh"
+
+struct PLYExportParams;
+
 namespace blender::io::ply {
 
 class FileBuffer;
-struct PlyData;
+class PlyExportMesh;
+struct PlyExportLayout;
 
-void write_vertices(FileBuffer &buffer, const PlyData &ply_data);
+/**
+ * Write the elements of all meshes. Elements are formatted straight from the mesh data in
+ * parallel chunks, and flushed to the file in order as they are done.
+ */
+void write_vertices(FileBuffer &buffer,
+                    Span<std::unique_ptr<PlyExportMesh>> meshes,
+                    const PlyExportLayout &layout,
+                    const PLYExportParams &export_params);
 
-void write_faces(FileBuffer &buffer, const PlyData &ply_data);
+void write_faces(FileBuffer &buffer, Span<std::unique_ptr<PlyExportMesh>> meshes);
 
-void write_edges(FileBuffer &buffer, const PlyData &ply_data);
+void write_edges(FileBuffer &buffer, Span<std::unique_ptr<PlyExportMesh>> meshes);
 
 }  // namespace blender::io::ply
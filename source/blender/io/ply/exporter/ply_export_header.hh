@@ -13,10 +13,10 @@ struct PLYExportParams;
 namespace blender::io::ply {
 
 class FileBuffer;
-struct PlyData;
+struct PlyExportLayout;
 
 void write_header(FileBuffer &buffer,
-                  const PlyData &ply_data,
+                  const PlyExportLayout &layout,
                   const PLYExportParams &export_params);
 
 }  // namespace blender::io::ply
@@ -8,7 +8,6 @@
 
 #include "ply_export_load_plydata.hh"
 #include "IO_ply.hh"
-#include "ply_data.hh"
 
 #include "BKE_attribute.hh"
 #include "BKE_lib_id.hh"
@@ -82,6 +81,10 @@ struct uv_vertex_key {
   }
 };
 
+/**
+ * Build the PLY vertex mappings. If we do not export or have UVs, PLY vertices match mesh
+ * vertices and the mappings are left empty.
+ */
 static void generate_vertex_map(const Mesh *mesh,
                                 const PLYExportParams &export_params,
                                 Vector<int> &r_ply_to_vertex,
@@ -100,23 +103,14 @@ static void generate_vertex_map(const Mesh *mesh,
     }
   }
 
-  const Span<int> corner_verts = mesh->corner_verts();
-  r_vertex_to_ply.resize(mesh->verts_num, -1);
-  r_loop_to_ply.resize(mesh->corners_num, -1);
-
-  /* If we do not export or have UVs, then mapping of vertex indices is simple. */
   if (!export_uv) {
-    r_ply_to_vertex.resize(mesh->verts_num);
-    for (int index = 0; index < mesh->verts_num; index++) {
-      r_vertex_to_ply[index] = index;
-      r_ply_to_vertex[index] = index;
-    }
-    for (int index = 0; index < mesh->corners_num; index++) {
-      r_loop_to_ply[index] = corner_verts[index];
-    }
     return;
   }
 
+  const Span<int> corner_verts = mesh->corner_verts();
+  r_vertex_to_ply.resize(mesh->verts_num, -1);
+  r_loop_to_ply.resize(mesh->corners_num, -1);
+
   /* We are exporting UVs. Need to build mappings of what
    * any unique (vertex, UV) values will map into the PLY data. */
   Map<uv_vertex_key, int> vertex_map;
@@ -148,33 +142,24 @@ static void generate_vertex_map(const Mesh *mesh,
   }
 }
 
-static float *find_or_add_attribute(const StringRef name,
-                                    int64_t size,
-                                    uint32_t vertex_offset,
-                                    Vector<PlyCustomAttribute> &r_attributes)
+template<typename T, typename ConvertFn>
+static void add_attribute_column(const std::string &name,
+                                 const VArray<T> &attribute,
+                                 const ConvertFn &convert,
+                                 Vector<PlyAttributeColumn> &r_columns)
 {
-  /* Do we have this attribute from some other object already? */
-  for (PlyCustomAttribute &attr : r_attributes) {
-    if (attr.name == name) {
-      BLI_assert(attr.data.size() == vertex_offset);
-      attr.data.resize(attr.data.size() + size, 0.0f);
-      return attr.data.data() + vertex_offset;
-    }
-  }
-  /* We don't have it yet, create and fill with zero data for previous objects. */
-  r_attributes.append(PlyCustomAttribute(name, vertex_offset + size));
-  return r_attributes.last().data.data() + vertex_offset;
+  r_columns.append({name,
+                    VArray<float>::ForFunc(attribute.size(), [attribute, convert](const int64_t i) {
+                      return float(convert(attribute[i]));
+                    })});
 }
 
-static void load_custom_attributes(const Mesh *mesh,
-                                   const Vector<int> &ply_to_vertex,
-                                   uint32_t vertex_offset,
-                                   Vector<PlyCustomAttribute> &r_attributes)
+static Vector<PlyAttributeColumn> gather_custom_attributes(const Mesh *mesh)
 {
   const bke::AttributeAccessor attributes = mesh->attributes();
   const StringRef color_name = mesh->active_color_attribute;
   const StringRef uv_name = CustomData_get_active_layer_name(&mesh->corner_data, CD_PROP_FLOAT2);
-  const int64_t size = ply_to_vertex.size();
+  Vector<PlyAttributeColumn> columns;
 
   attributes.for_all([&](const bke::AttributeIDRef &attribute_id,
                          const bke::AttributeMetaData &meta_data) {
@@ -185,145 +170,85 @@ static void load_custom_attributes(const Mesh *mesh,
       return true;
     }
 
-    const GVArraySpan attribute = *mesh->attributes().lookup(
+    const GVArray attribute = *attributes.lookup(
         attribute_id, meta_data.domain, meta_data.data_type);
     if (attribute.is_empty()) {
       return true;
     }
+    const std::string name = attribute_id.name();
     switch (meta_data.data_type) {
       case CD_PROP_FLOAT: {
-        float *attr = find_or_add_attribute(
-            attribute_id.name(), size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<float>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          attr[i] = typed[ply_to_vertex[i]];
-        }
+        columns.append({name, attribute.typed<float>()});
         break;
       }
       case CD_PROP_INT8: {
-        float *attr = find_or_add_attribute(
-            attribute_id.name(), size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<int8_t>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          attr[i] = typed[ply_to_vertex[i]];
-        }
+        add_attribute_column(
+            name, attribute.typed<int8_t>(), [](const int8_t v) { return v; }, columns);
         break;
       }
       case CD_PROP_INT32: {
-        float *attr = find_or_add_attribute(
-            attribute_id.name(), size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<int32_t>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          attr[i] = typed[ply_to_vertex[i]];
-        }
+        add_attribute_column(
+            name, attribute.typed<int32_t>(), [](const int32_t v) { return v; }, columns);
         break;
       }
       case CD_PROP_INT32_2D: {
-        float *attr_x = find_or_add_attribute(
-            attribute_id.name() + "_x", size, vertex_offset, r_attributes);
-        float *attr_y = find_or_add_attribute(
-            attribute_id.name() + "_y", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<int2>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          int j = ply_to_vertex[i];
-          attr_x[i] = typed[j].x;
-          attr_y[i] = typed[j].y;
-        }
+        const VArray<int2> typed = attribute.typed<int2>();
+        add_attribute_column(name + "_x", typed, [](const int2 &v) { return v.x; }, columns);
+        add_attribute_column(name + "_y", typed, [](const int2 &v) { return v.y; }, columns);
         break;
       }
       case CD_PROP_FLOAT2: {
-        float *attr_x = find_or_add_attribute(
-            attribute_id.name() + "_x", size, vertex_offset, r_attributes);
-        float *attr_y = find_or_add_attribute(
-            attribute_id.name() + "_y", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<float2>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          int j = ply_to_vertex[i];
-          attr_x[i] = typed[j].x;
-          attr_y[i] = typed[j].y;
-        }
+        const VArray<float2> typed = attribute.typed<float2>();
+        add_attribute_column(name + "_x", typed, [](const float2 &v) { return v.x; }, columns);
+        add_attribute_column(name + "_y", typed, [](const float2 &v) { return v.y; }, columns);
         break;
       }
       case CD_PROP_FLOAT3: {
-        float *attr_x = find_or_add_attribute(
-            attribute_id.name() + "_x", size, vertex_offset, r_attributes);
-        float *attr_y = find_or_add_attribute(
-            attribute_id.name() + "_y", size, vertex_offset, r_attributes);
-        float *attr_z = find_or_add_attribute(
-            attribute_id.name() + "_z", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<float3>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          int j = ply_to_vertex[i];
-          attr_x[i] = typed[j].x;
-          attr_y[i] = typed[j].y;
-          attr_z[i] = typed[j].z;
-        }
+        const VArray<float3> typed = attribute.typed<float3>();
+        add_attribute_column(name + "_x", typed, [](const float3 &v) { return v.x; }, columns);
+        add_attribute_column(name + "_y", typed, [](const float3 &v) { return v.y; }, columns);
+        add_attribute_column(name + "_z", typed, [](const float3 &v) { return v.z; }, columns);
         break;
       }
       case CD_PROP_BYTE_COLOR: {
-        float *attr_r = find_or_add_attribute(
-            attribute_id.name() + "_r", size, vertex_offset, r_attributes);
-        float *attr_g = find_or_add_attribute(
-            attribute_id.name() + "_g", size, vertex_offset, r_attributes);
-        float *attr_b = find_or_add_attribute(
-            attribute_id.name() + "_b", size, vertex_offset, r_attributes);
-        float *attr_a = find_or_add_attribute(
-            attribute_id.name() + "_a", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<ColorGeometry4b>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          ColorGeometry4f col = typed[ply_to_vertex[i]].decode();
-          attr_r[i] = col.r;
-          attr_g[i] = col.g;
-          attr_b[i] = col.b;
-          attr_a[i] = col.a;
-        }
+        const VArray<ColorGeometry4b> typed = attribute.typed<ColorGeometry4b>();
+        add_attribute_column(
+            name + "_r", typed, [](const ColorGeometry4b &v) { return v.decode().r; }, columns);
+        add_attribute_column(
+            name + "_g", typed, [](const ColorGeometry4b &v) { return v.decode().g; }, columns);
+        add_attribute_column(
+            name + "_b", typed, [](const ColorGeometry4b &v) { return v.decode().b; }, columns);
+        add_attribute_column(
+            name + "_a", typed, [](const ColorGeometry4b &v) { return v.decode().a; }, columns);
         break;
       }
       case CD_PROP_COLOR: {
-        float *attr_r = find_or_add_attribute(
-            attribute_id.name() + "_r", size, vertex_offset, r_attributes);
-        float *attr_g = find_or_add_attribute(
-            attribute_id.name() + "_g", size, vertex_offset, r_attributes);
-        float *attr_b = find_or_add_attribute(
-            attribute_id.name() + "_b", size, vertex_offset, r_attributes);
-        float *attr_a = find_or_add_attribute(
-            attribute_id.name() + "_a", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<ColorGeometry4f>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          ColorGeometry4f col = typed[ply_to_vertex[i]];
-          attr_r[i] = col.r;
-          attr_g[i] = col.g;
-          attr_b[i] = col.b;
-          attr_a[i] = col.a;
-        }
+        const VArray<ColorGeometry4f> typed = attribute.typed<ColorGeometry4f>();
+        add_attribute_column(
+            name + "_r", typed, [](const ColorGeometry4f &v) { return v.r; }, columns);
+        add_attribute_column(
+            name + "_g", typed, [](const ColorGeometry4f &v) { return v.g; }, columns);
+        add_attribute_column(
+            name + "_b", typed, [](const ColorGeometry4f &v) { return v.b; }, columns);
+        add_attribute_column(
+            name + "_a", typed, [](const ColorGeometry4f &v) { return v.a; }, columns);
         break;
       }
       case CD_PROP_BOOL: {
-        float *attr = find_or_add_attribute(
-            attribute_id.name(), size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<bool>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          attr[i] = typed[ply_to_vertex[i]] ? 1.0f : 0.0f;
-        }
+        add_attribute_column(
+            name, attribute.typed<bool>(), [](const bool v) { return v ? 1.0f : 0.0f; }, columns);
         break;
       }
       case CD_PROP_QUATERNION: {
-        float *attr_x = find_or_add_attribute(
-            attribute_id.name() + "_x", size, vertex_offset, r_attributes);
-        float *attr_y = find_or_add_attribute(
-            attribute_id.name() + "_y", size, vertex_offset, r_attributes);
-        float *attr_z = find_or_add_attribute(
-            attribute_id.name() + "_z", size, vertex_offset, r_attributes);
-        float *attr_w = find_or_add_attribute(
-            attribute_id.name() + "_w", size, vertex_offset, r_attributes);
-        auto typed = attribute.typed<math::Quaternion>();
-        for (const int64_t i : ply_to_vertex.index_range()) {
-          int j = ply_to_vertex[i];
-          attr_x[i] = typed[j].x;
-          attr_y[i] = typed[j].y;
-          attr_z[i] = typed[j].z;
-          attr_w[i] = typed[j].w;
-        }
+        const VArray<math::Quaternion> typed = attribute.typed<math::Quaternion>();
+        add_attribute_column(
+            name + "_x", typed, [](const math::Quaternion &v) { return v.x; }, columns);
+        add_attribute_column(
+            name + "_y", typed, [](const math::Quaternion &v) { return v.y; }, columns);
+        add_attribute_column(
+            name + "_z", typed, [](const math::Quaternion &v) { return v.z; }, columns);
+        add_attribute_column(
+            name + "_w", typed, [](const math::Quaternion &v) { return v.w; }, columns);
         break;
       }
       default:
@@ -331,9 +256,23 @@ static void load_custom_attributes(const Mesh *mesh,
     }
     return true;
   });
+  return columns;
+}
+
+PlyExportMesh::~PlyExportMesh()
+{
+  if (owned_mesh) {
+    BKE_id_free(nullptr, owned_mesh);
+  }
+}
+
+int64_t PlyExportMesh::vertices_num() const
+{
+  return ply_to_vertex.is_empty() ? mesh->verts_num : ply_to_vertex.size();
 }
 
-void load_plydata(PlyData &plyData, Depsgraph *depsgraph, const PLYExportParams &export_params)
+Vector<std::unique_ptr<PlyExportMesh>> gather_export_meshes(Depsgraph *depsgraph,
+                                                           const PLYExportParams &export_params)
 {
   DEGObjectIterSettings deg_iter_settings{};
   deg_iter_settings.depsgraph = depsgraph;
@@ -341,8 +280,9 @@ void load_plydata(PlyData &plyData, Depsgraph *depsgraph, const PLYExportParams
                             DEG_ITER_OBJECT_FLAG_LINKED_VIA_SET | DEG_ITER_OBJECT_FLAG_VISIBLE |
                             DEG_ITER_OBJECT_FLAG_DUPLI;
 
+  Vector<std::unique_ptr<PlyExportMesh>> meshes;
   /* When exporting multiple objects, vertex indices have to be offset. */
-  uint32_t vertex_offset = 0;
+  int64_t vertex_offset = 0;
 
   DEG_OBJECT_ITER_BEGIN (&deg_iter_settings, object) {
     if (object->type != OB_MESH) {
@@ -354,11 +294,12 @@ void load_plydata(PlyData &plyData, Depsgraph *depsgraph, const PLYExportParams
     }
 
     Object *obj_eval = DEG_get_evaluated_object(depsgraph, object);
-    Mesh *mesh = export_params.apply_modifiers ? BKE_object_get_evaluated_mesh(obj_eval) :
-                                                 BKE_object_get_pre_modified_mesh(obj_eval);
+    std::unique_ptr<PlyExportMesh> export_mesh = std::make_unique<PlyExportMesh>();
+    export_mesh->mesh = export_params.apply_modifiers ? BKE_object_get_evaluated_mesh(obj_eval) :
+                                                        BKE_object_get_pre_modified_mesh(obj_eval);
 
     bool force_triangulation = false;
-    OffsetIndices faces = mesh->faces();
+    const OffsetIndices faces = export_mesh->mesh->faces();
     for (const int i : faces.index_range()) {
       if (faces[i].size() > 255) {
         force_triangulation = true;
@@ -367,126 +308,72 @@ void load_plydata(PlyData &plyData, Depsgraph *depsgraph, const PLYExportParams
     }
 
     /* Triangulate */
-    bool manually_free_mesh = false;
     if (export_params.export_triangulated_mesh || force_triangulation) {
-      mesh = do_triangulation(mesh, export_params.export_triangulated_mesh);
-      faces = mesh->faces();
-      manually_free_mesh = true;
+      export_mesh->owned_mesh = do_triangulation(export_mesh->mesh,
+                                                 export_params.export_triangulated_mesh);
+      export_mesh->mesh = export_mesh->owned_mesh;
     }
+    const Mesh *mesh = export_mesh->mesh;
 
-    Vector<int> ply_to_vertex, vertex_to_ply, loop_to_ply;
-    Vector<float2> uvs;
-    generate_vertex_map(mesh, export_params, ply_to_vertex, vertex_to_ply, loop_to_ply, uvs);
+    generate_vertex_map(mesh,
+                        export_params,
+                        export_mesh->ply_to_vertex,
+                        export_mesh->vertex_to_ply,
+                        export_mesh->loop_to_ply,
+                        export_mesh->uvs);
 
-    float world_and_axes_transform[4][4];
-    float world_and_axes_normal_transform[3][3];
+    /* Dupli objects are temporary, so the transform has to be stored here. */
     set_world_axes_transform(*obj_eval,
                              export_params.forward_axis,
                              export_params.up_axis,
-                             world_and_axes_transform,
-                             world_and_axes_normal_transform);
-
-    /* Face data. */
-    plyData.face_vertices.reserve(plyData.face_vertices.size() + mesh->corners_num);
-    for (const int corner : IndexRange(mesh->corners_num)) {
-      int ply_index = loop_to_ply[corner];
-      BLI_assert(ply_index >= 0 && ply_index < ply_to_vertex.size());
-      plyData.face_vertices.append_unchecked(ply_index + vertex_offset);
-    }
-
-    plyData.face_sizes.reserve(plyData.face_sizes.size() + mesh->faces_num);
-    for (const int i : faces.index_range()) {
-      const IndexRange face = faces[i];
-      plyData.face_sizes.append_unchecked(face.size());
-    }
+                             export_mesh->world_and_axes_transform,
+                             export_mesh->world_and_axes_normal_transform);
 
-    /* Vertices */
-    plyData.vertices.reserve(plyData.vertices.size() + ply_to_vertex.size());
-    Span<float3> vert_positions = mesh->vert_positions();
-    for (int vertex_index : ply_to_vertex) {
-      float3 pos = vert_positions[vertex_index];
-      mul_m4_v3(world_and_axes_transform, pos);
-      mul_v3_fl(pos, export_params.global_scale);
-      plyData.vertices.append_unchecked(pos);
-    }
-
-    /* UV's */
-    if (uvs.is_empty()) {
-      uvs.append_n_times(float2(0), ply_to_vertex.size());
-    }
-    else {
-      BLI_assert(uvs.size() == ply_to_vertex.size());
-      plyData.uv_coordinates.extend(uvs);
-    }
-
-    /* Normals */
-    if (export_params.export_normals) {
-      plyData.vertex_normals.reserve(plyData.vertex_normals.size() + ply_to_vertex.size());
-      const Span<float3> vert_normals = mesh->vert_normals();
-      for (int vertex_index : ply_to_vertex) {
-        float3 normal = vert_normals[vertex_index];
-        mul_m3_v3(world_and_axes_normal_transform, normal);
-        plyData.vertex_normals.append(normal);
-      }
-    }
-
-    /* Colors */
     if (export_params.vertex_colors != PLY_VERTEX_COLOR_NONE) {
       const StringRef name = mesh->active_color_attribute;
       if (!name.is_empty()) {
         const bke::AttributeAccessor attributes = mesh->attributes();
-        const VArray color_attribute = *attributes.lookup_or_default<ColorGeometry4f>(
+        export_mesh->colors = *attributes.lookup_or_default<ColorGeometry4f>(
             name, bke::AttrDomain::Point, {0.0f, 0.0f, 0.0f, 0.0f});
-        if (!color_attribute.is_empty()) {
-          if (plyData.vertex_colors.size() != vertex_offset) {
-            plyData.vertex_colors.resize(vertex_offset, float4(0));
-          }
-
-          plyData.vertex_colors.reserve(vertex_offset + ply_to_vertex.size());
-          for (int vertex_index : ply_to_vertex) {
-            float4 color = float4(color_attribute[vertex_index]);
-            if (export_params.vertex_colors == PLY_VERTEX_COLOR_SRGB) {
-              linearrgb_to_srgb_v4(color, color);
-            }
-            plyData.vertex_colors.append(color);
-          }
-        }
       }
     }
 
-    /* Custom attributes */
     if (export_params.export_attributes) {
-      load_custom_attributes(mesh, ply_to_vertex, vertex_offset, plyData.vertex_custom_attr);
+      export_mesh->attributes = gather_custom_attributes(mesh);
     }
 
-    /* Loose edges */
-    const bke::LooseEdgeCache &loose_edges = mesh->loose_edges();
-    if (loose_edges.count > 0) {
-      Span<int2> edges = mesh->edges();
-      for (int i = 0; i < edges.size(); ++i) {
-        if (loose_edges.is_loose_bits[i]) {
-          plyData.edges.append({vertex_to_ply[edges[i][0]], vertex_to_ply[edges[i][1]]});
-        }
-      }
-    }
-
-    vertex_offset = int(plyData.vertices.size());
-    if (manually_free_mesh) {
-      BKE_id_free(nullptr, mesh);
-    }
+    export_mesh->vertex_offset = vertex_offset;
+    vertex_offset += export_mesh->vertices_num();
+    meshes.append(std::move(export_mesh));
   }
 
   DEG_OBJECT_ITER_END;
 
-  /* Make sure color and attribute arrays are encompassing all input objects */
-  if (!plyData.vertex_colors.is_empty()) {
-    BLI_assert(plyData.vertex_colors.size() <= vertex_offset);
-    plyData.vertex_colors.resize(vertex_offset, float4(0));
-  }
-  for (PlyCustomAttribute &attr : plyData.vertex_custom_attr) {
-    BLI_assert(attr.data.size() <= vertex_offset);
-    attr.data.resize(vertex_offset, 0.0f);
+  return meshes;
+}
+
+PlyExportLayout calc_export_layout(Span<std::unique_ptr<PlyExportMesh>> meshes,
+                                   const PLYExportParams &export_params)
+{
+  PlyExportLayout layout;
+  for (const std::unique_ptr<PlyExportMesh> &export_mesh : meshes) {
+    const Mesh *mesh = export_mesh->mesh;
+    layout.vertices_num += export_mesh->vertices_num();
+    layout.faces_num += mesh->faces_num;
+    const bke::LooseEdgeCache &loose_edges = mesh->loose_edges();
+    if (loose_edges.count > 0) {
+      layout.edges_num += loose_edges.count;
+    }
+    layout.has_colors |= !export_mesh->colors.is_empty();
+    layout.has_uvs |= !export_mesh->uvs.is_empty();
+    for (const PlyAttributeColumn &column : export_mesh->attributes) {
+      if (!layout.custom_attribute_names.contains(column.name)) {
+        layout.custom_attribute_names.append(column.name);
+      }
+    }
   }
+  layout.has_normals = export_params.export_normals && layout.vertices_num > 0;
+  return layout;
 }
 
 }  // namespace blender::io::ply
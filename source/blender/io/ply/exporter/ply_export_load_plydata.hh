@@ -8,13 +8,95 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
+#include "BLI_color.hh"
+#include "BLI_math_vector_types.hh"
+#include "BLI_utility_mixins.hh"
+#include "BLI_vector.hh"
+#include "BLI_virtual_array.hh"
+
 struct Depsgraph;
+struct Mesh;
 struct PLYExportParams;
 
 namespace blender::io::ply {
 
-struct PlyData;
+/** A custom vertex attribute component, converted to floats on access. */
+struct PlyAttributeColumn {
+  std::string name;
+  VArray<float> values;
+};
+
+/**
+ * One exported mesh object. References the evaluated mesh data directly so that the PLY elements
+ * can be written without first copying the whole mesh into #PlyData.
+ */
+class PlyExportMesh : NonCopyable, NonMovable {
+ public:
+  const Mesh *mesh = nullptr;
+  /**
+   * Triangulated copy of the evaluated mesh, owned by this object. All faces are written after
+   * all vertices, so the copies of all exported objects are kept until the whole file is written.
+   */
+  Mesh *owned_mesh = nullptr;
+
+  /**
+   * Mappings between PLY vertices, mesh vertices and face corners. When UVs are not exported
+   * PLY vertices match mesh vertices, and these are left empty.
+   */
+  Vector<int> ply_to_vertex;
+  Vector<int> vertex_to_ply;
+  Vector<int> loop_to_ply;
+  /** Per PLY vertex UVs, empty if the mesh has none or they are not exported. */
+  Vector<float2> uvs;
+
+  float world_and_axes_transform[4][4];
+  float world_and_axes_normal_transform[3][3];
+
+  /** Active color attribute on the point domain, empty if it is not exported. */
+  VArray<ColorGeometry4f> colors;
+  /** Custom point attributes, one entry per component. */
+  Vector<PlyAttributeColumn> attributes;
+
+  /** Index of the first PLY vertex of this mesh in the whole file. */
+  int64_t vertex_offset = 0;
+
+  ~PlyExportMesh();
+
+  int64_t vertices_num() const;
+
+  int mesh_vertex(const int ply_vertex) const
+  {
+    return ply_to_vertex.is_empty() ? ply_vertex : ply_to_vertex[ply_vertex];
+  }
+
+  int ply_vertex(const int mesh_vertex) const
+  {
+    return vertex_to_ply.is_empty() ? mesh_vertex : vertex_to_ply[mesh_vertex];
+  }
+};
+
+/** Which properties and how many elements the exported PLY file contains. */
+struct PlyExportLayout {
+  int64_t vertices_num = 0;
+  int64_t faces_num = 0;
+  int64_t edges_num = 0;
+  bool has_normals = false;
+  bool has_colors = false;
+  bool has_uvs = false;
+  Vector<std::string> custom_attribute_names;
+};
+
+/**
+ * Collect all meshes to export, triangulating them and building their vertex maps as needed.
+ * The vertex offsets of the returned meshes are set up for writing them into one file.
+ */
+Vector<std::unique_ptr<PlyExportMesh>> gather_export_meshes(Depsgraph *depsgraph,
+                                                           const PLYExportParams &export_params);
 
-void load_plydata(PlyData &plyData, Depsgraph *depsgraph, const PLYExportParams &export_params);
+PlyExportLayout calc_export_layout(Span<std::unique_ptr<PlyExportMesh>> meshes,
+                                   const PLYExportParams &export_params);
 
 }  // namespace blender::io::ply
@@ -22,8 +22,14 @@ FileBuffer::FileBuffer(const char *filepath, size_t buffer_chunk_size)
   }
 }
 
+FileBuffer::FileBuffer(size_t buffer_chunk_size)
+    : buffer_chunk_size_(buffer_chunk_size), filepath_(nullptr), outfile_(nullptr)
+{
+}
+
 void FileBuffer::write_to_file()
 {
+  BLI_assert(outfile_ != nullptr);
   for (const VectorChar &b : blocks_) {
     fwrite(b.data(), 1, b.size(), this->outfile_);
   }
@@ -42,6 +48,13 @@ void FileBuffer::close_file()
   }
 }
 
+void FileBuffer::append_from(FileBuffer &other)
+{
+  blocks_.extend(std::make_move_iterator(other.blocks_.begin()),
+                 std::make_move_iterator(other.blocks_.end()));
+  other.blocks_.clear();
+}
+
 void FileBuffer::write_header_element(StringRef name, int count)
 {
   write_fstring("element {} {}\n", name, count);
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <memory>
 #include <type_traits>
 
 #include "BLI_compiler_attrs.h"
@@ -28,6 +29,9 @@ namespace blender::io::ply {
  * (list of default 64 kilobyte blocks).
  * Call write_to_file once in a while to write the memory buffer(s)
  * into the given file.
+ *
+ * Buffers created without a file path only collect data in memory, and are used
+ * to format parts of the file on separate threads (see #append_from).
  */
 class FileBuffer : private NonMovable {
   using VectorChar = Vector<char>;
@@ -38,6 +42,7 @@ class FileBuffer : private NonMovable {
 
  public:
   FileBuffer(const char *filepath, size_t buffer_chunk_size = 64 * 1024);
+  explicit FileBuffer(size_t buffer_chunk_size = 64 * 1024);
 
   virtual ~FileBuffer() = default;
 
@@ -46,6 +51,12 @@ class FileBuffer : private NonMovable {
 
   void close_file();
 
+  /* Move the contents of a memory buffer to the end of this buffer. */
+  void append_from(FileBuffer &other);
+
+  /* Create a memory buffer with the same output format. */
+  virtual std::unique_ptr<FileBuffer> create_memory_buffer() const = 0;
+
   virtual void write_vertex(float x, float y, float z) = 0;
 
   virtual void write_UV(float u, float v) = 0;
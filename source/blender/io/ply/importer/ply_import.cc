@@ -181,7 +181,7 @@ void importer_main(Main *bmain,
   BLI_path_extension_strip(ob_name);
 
   /* Parse header. */
-  PlyReadBuffer file(import_params.filepath, 64 * 1024);
+  PlyReadBuffer file(import_params.filepath);
 
   PlyHeader header;
   const char *err = read_header(file, header);
@@ -198,6 +198,9 @@ void importer_main(Main *bmain,
     BKE_report(import_params.reports, RPT_ERROR, "PLY Importer: failed importing, unknown error");
     return;
   }
+  if (data->error.empty() && file.has_io_error()) {
+    data->error = "IO error while reading file";
+  }
   if (!data->error.empty()) {
     fprintf(stderr, "PLY Importer: failed importing %s: %s\n", ob_name, data->error.c_str());
     BKE_report(import_params.reports, RPT_ERROR, "PLY Importer: failed importing, unknown error");
@@ -17,9 +17,17 @@ static inline bool is_newline(char ch)
 namespace blender::io::ply {
 
 PlyReadBuffer::PlyReadBuffer(const char *file_path, size_t read_buffer_size)
-    : buffer_(read_buffer_size), read_buffer_size_(read_buffer_size)
 {
-  file_ = BLI_fopen(file_path, "rb");
+  if (read_buffer_size == 0) {
+    mapped_file_ = std::make_unique<MappedFile>(file_path);
+    data_ = mapped_file_->data();
+    line_end_ = data_.size();
+    at_eof_ = true;
+  }
+  else {
+    buffer_.reinitialize(int64_t(read_buffer_size));
+    file_ = BLI_fopen(file_path, "rb");
+  }
 }
 
 PlyReadBuffer::~PlyReadBuffer()
@@ -39,90 +47,104 @@ Span<char> PlyReadBuffer::read_line()
   if (is_binary_) {
     throw std::runtime_error("PLY read_line should not be used in binary mode");
   }
-  if (pos_ >= last_newline_) {
-    refill_buffer();
+  /* Skip past empty lines. */
+  while (true) {
+    while (pos_ < line_end_ && is_newline(data_[pos_])) {
+      pos_++;
+    }
+    if (pos_ < line_end_ || !this->refill_buffer()) {
+      break;
+    }
   }
-  BLI_assert(last_newline_ <= buffer_.size());
-  int res_begin = pos_;
-  while (pos_ < last_newline_ && !is_newline(buffer_[pos_])) {
+  const int64_t res_begin = pos_;
+  while (pos_ < line_end_ && !is_newline(data_[pos_])) {
     pos_++;
   }
-  int res_end = pos_;
+  int64_t res_end = pos_;
   /* Remove possible trailing CR from the result. */
-  if (res_end > res_begin && buffer_[res_end - 1] == '\r') {
+  if (res_end > res_begin && data_[res_end - 1] == '\r') {
     --res_end;
   }
   /* Move cursor past newline. */
-  if (pos_ < buf_used_ && is_newline(buffer_[pos_])) {
+  if (pos_ < data_.size() && is_newline(data_[pos_])) {
     pos_++;
   }
-  return Span<char>(buffer_.data() + res_begin, res_end - res_begin);
+  return data_.slice(res_begin, res_end - res_begin);
 }
 
 bool PlyReadBuffer::read_bytes(void *dst, size_t size)
 {
-  while (size > 0) {
-    if (pos_ + size > buf_used_) {
-      if (!refill_buffer()) {
-        return false;
-      }
-    }
-    int to_copy = int(size);
-    if (to_copy > buf_used_) {
-      to_copy = buf_used_;
-    }
-    memcpy(dst, buffer_.data() + pos_, to_copy);
-    pos_ += to_copy;
-    dst = (char *)dst + to_copy;
-    size -= to_copy;
+  if (size == 0) {
+    return true;
+  }
+  const Span<char> bytes = this->read_bytes_view(int64_t(size));
+  if (bytes.size() != size) {
+    return false;
   }
+  memcpy(dst, bytes.data(), size);
   return true;
 }
 
-bool PlyReadBuffer::refill_buffer()
+Span<char> PlyReadBuffer::read_bytes_view(int64_t size)
 {
-  BLI_assert(pos_ <= buf_used_);
-  BLI_assert(pos_ <= buffer_.size());
-  BLI_assert(buf_used_ <= buffer_.size());
+  if (pos_ + size > data_.size()) {
+    this->refill_buffer(size);
+  }
+  if (pos_ + size > data_.size()) {
+    pos_ = data_.size();
+    return {};
+  }
+  const Span<char> bytes = data_.slice(pos_, size);
+  pos_ += size;
+  return bytes;
+}
+
+bool PlyReadBuffer::has_io_error() const
+{
+  if (mapped_file_) {
+    return mapped_file_->has_io_error();
+  }
+  return file_ != nullptr && ferror(file_);
+}
+
+bool PlyReadBuffer::refill_buffer(const int64_t min_size)
+{
+  BLI_assert(pos_ <= data_.size());
 
   if (file_ == nullptr || at_eof_) {
     return false; /* File is fully read. */
   }
 
-  /* Move any leftover to start of buffer. */
-  int keep = buf_used_ - pos_;
-  if (keep > 0) {
-    memmove(buffer_.data(), buffer_.data() + pos_, keep);
+  /* Move any leftover to start of buffer, growing it if the requested bytes don't fit. */
+  const int64_t keep = data_.size() - pos_;
+  if (min_size > buffer_.size()) {
+    Array<char> new_buffer(min_size);
+    memcpy(new_buffer.data(), data_.data() + pos_, keep);
+    buffer_ = std::move(new_buffer);
+  }
+  else if (keep > 0) {
+    memmove(buffer_.data(), data_.data() + pos_, keep);
   }
   /* Read in data from the file. */
-  size_t read = fread(buffer_.data() + keep, 1, read_buffer_size_ - keep, file_) + keep;
-  at_eof_ = read < read_buffer_size_;
+  const size_t to_read = size_t(buffer_.size() - keep);
+  const size_t read = fread(buffer_.data() + keep, 1, to_read, file_);
+  at_eof_ = read < to_read;
   pos_ = 0;
-  buf_used_ = int(read);
+  data_ = buffer_.as_span().take_front(keep + int64_t(read));
 
-  /* Skip past newlines at the front of the buffer and find last newline. */
-  if (!is_binary_) {
-    while (pos_ < buf_used_ && is_newline(buffer_[pos_])) {
-      pos_++;
+  /* Find the last newline, the line after it continues in the next refill. */
+  line_end_ = data_.size();
+  if (!is_binary_ && !at_eof_) {
+    while (line_end_ > 0 && !is_newline(data_[line_end_ - 1])) {
+      --line_end_;
     }
-
-    int last_nl = buf_used_;
-    if (!at_eof_) {
-      while (last_nl > 0) {
-        --last_nl;
-        if (is_newline(buffer_[last_nl])) {
-          break;
-        }
-      }
-      if (!is_newline(buffer_[last_nl])) {
-        /* Whole line did not fit into our read buffer. */
-        throw std::runtime_error("PLY text line did not fit into the read buffer");
-      }
+    if (line_end_ == 0) {
+      /* Whole line did not fit into our read buffer. */
+      throw std::runtime_error("PLY text line did not fit into the read buffer");
     }
-    last_newline_ = last_nl;
   }
 
-  return true;
+  return read > 0;
 }
 
 }  // namespace blender::io::ply
@@ -8,28 +8,36 @@
 
 #pragma once
 
+#include <memory>
 #include <stddef.h>
 #include <stdio.h>
 
 #include "BLI_array.hh"
 #include "BLI_span.hh"
 
+#include "IO_mapped_file.hh"
+
 namespace blender::io::ply {
 
 /**
- * Reads underlying PLY file in large chunks, and provides interface for ascii/header
- * parsing to read individual lines, and for binary parsing to read chunks of bytes.
+ * Reads the underlying PLY file, and provides interface for ascii/header parsing to read
+ * individual lines, and for binary parsing to read chunks of bytes.
+ *
+ * By default the file is memory-mapped, and lines and byte views point directly into the mapped
+ * file without any copies. When a read buffer size is given, the file is read in chunks of that
+ * size instead; returned lines and views are then only valid until the next read.
  */
 class PlyReadBuffer {
  public:
-  PlyReadBuffer(const char *file_path, size_t read_buffer_size = 64 * 1024);
+  PlyReadBuffer(const char *file_path, size_t read_buffer_size = 0);
   ~PlyReadBuffer();
 
   /** After header is parsed, indicate whether the rest of reading will be ascii or binary. */
   void after_header(bool is_binary);
 
   /**
-   * Gets the next line from the file as a Span. The line does not include any newline characters.
+   * Gets the next non-empty line from the file as a Span. The line does not include any newline
+   * characters.
    */
   Span<char> read_line();
 
@@ -39,16 +47,31 @@ class PlyReadBuffer {
    */
   bool read_bytes(void *dst, size_t size);
 
+  /**
+   * Returns a view of the next `size` bytes of the file and moves past them. Returns an empty
+   * span if this amount of bytes can not be read.
+   */
+  Span<char> read_bytes_view(int64_t size);
+
+  /** Whether reading the file failed because of IO errors. */
+  bool has_io_error() const;
+
  private:
-  bool refill_buffer();
+  /**
+   * Keeps the unread part of the buffer and reads more of the file after it, growing the buffer
+   * to hold at least `min_size` bytes. Returns false if nothing more could be read.
+   */
+  bool refill_buffer(int64_t min_size = 0);
 
  private:
+  std::unique_ptr<MappedFile> mapped_file_;
   FILE *file_ = nullptr;
   Array<char> buffer_;
-  int pos_ = 0;
-  int buf_used_ = 0;
-  int last_newline_ = 0;
-  size_t read_buffer_size_ = 0;
+  /** The part of the file that can currently be read: the whole mapping or the used buffer. */
+  Span<char> data_;
+  int64_t pos_ = 0;
+  /** End of the complete lines in #data_, a line that continues past it needs a refill. */
+  int64_t line_end_ = 0;
   bool at_eof_ = false;
   bool is_binary_ = false;
 };
@@ -12,11 +12,14 @@
 
 #include "BLI_endian_switch.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
 
 #include "fast_float.h"
 
 #include <algorithm>
 #include <charconv>
+#include <cstring>
+#include <type_traits>
 
 static bool is_whitespace(char c)
 {
@@ -202,13 +205,14 @@ static const char *parse_row_binary(PlyReadBuffer &file,
   }
   BLI_assert(r_scratch.size() == element.stride);
   BLI_assert(r_values.size() == element.properties.size());
-  if (!file.read_bytes(r_scratch.data(), r_scratch.size())) {
-    return "Could not read row of binary property";
-  }
 
-  const uint8_t *ptr = r_scratch.data();
   if (header.type == PlyFormatType::BINARY_LE) {
-    /* Little endian: just read/convert the values. */
+    /* Little endian: just read/convert the values, directly from the file memory. */
+    const Span<char> row = file.read_bytes_view(element.stride);
+    if (row.is_empty()) {
+      return "Could not read row of binary property";
+    }
+    const uint8_t *ptr = reinterpret_cast<const uint8_t *>(row.data());
     for (int i = 0, n = int(element.properties.size()); i != n; i++) {
       const PlyProperty &prop = element.properties[i];
       float val = get_binary_value<float>(prop.type, ptr);
@@ -217,6 +221,10 @@ static const char *parse_row_binary(PlyReadBuffer &file,
   }
   else if (header.type == PlyFormatType::BINARY_BE) {
     /* Big endian: read, switch endian, convert the values. */
+    if (!file.read_bytes(r_scratch.data(), r_scratch.size())) {
+      return "Could not read row of binary property";
+    }
+    const uint8_t *ptr = r_scratch.data();
     for (int i = 0, n = int(element.properties.size()); i != n; i++) {
       const PlyProperty &prop = element.properties[i];
       endian_switch((uint8_t *)ptr, data_type_size[prop.type]);
@@ -230,6 +238,204 @@ static const char *parse_row_binary(PlyReadBuffer &file,
   return nullptr;
 }
 
+/**
+ * Where the values of one property of a binary element end up: a float component of one of the
+ * output arrays.
+ */
+struct PlyColumn {
+  PlyDataTypes type;
+  /** Byte offset of the property within a row. */
+  int offset;
+  /** The values are divided by this (used to normalize colors). */
+  float normalizer;
+  float *dst;
+  /** Number of floats between the values of consecutive rows in #dst. */
+  int dst_stride;
+};
+
+/** Byte offset of every property within a row of an element without list properties. */
+static Vector<int> calc_property_offsets(const PlyElement &element)
+{
+  Vector<int> offsets(element.properties.size());
+  int offset = 0;
+  for (const int i : element.properties.index_range()) {
+    offsets[i] = offset;
+    offset += data_type_size[element.properties[i].type];
+  }
+  return offsets;
+}
+
+template<typename T, bool big_endian> static inline T load_value(const uint8_t *ptr)
+{
+  using UInt = std::conditional_t<
+      sizeof(T) == 1,
+      uint8_t,
+      std::conditional_t<sizeof(T) == 2,
+                         uint16_t,
+                         std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+  UInt bits;
+  memcpy(&bits, ptr, sizeof(T));
+  if constexpr (big_endian && sizeof(T) == 2) {
+    BLI_endian_switch_uint16(&bits);
+  }
+  else if constexpr (big_endian && sizeof(T) == 4) {
+    BLI_endian_switch_uint32(&bits);
+  }
+  else if constexpr (big_endian && sizeof(T) == 8) {
+    BLI_endian_switch_uint64(&bits);
+  }
+  T value;
+  memcpy(&value, &bits, sizeof(T));
+  return value;
+}
+
+/**
+ * Convert the values of one column for a range of rows. The type is a template parameter so that
+ * the loop does not branch on it and the byte swapping can be vectorized by the compiler.
+ */
+template<typename T, bool big_endian>
+static void decode_column(const uint8_t *rows,
+                          const int64_t stride,
+                          const PlyColumn &column,
+                          const IndexRange range)
+{
+  const uint8_t *src = rows + column.offset;
+  for (const int64_t i : range) {
+    const T value = load_value<T, big_endian>(src + i * stride);
+    column.dst[i * column.dst_stride] = float(value) / column.normalizer;
+  }
+}
+
+template<bool big_endian>
+static void decode_column(const uint8_t *rows,
+                          const int64_t stride,
+                          const PlyColumn &column,
+                          const IndexRange range)
+{
+  /* Same conversions as #get_binary_value. */
+  switch (column.type) {
+    case CHAR:
+      decode_column<int8_t, big_endian>(rows, stride, column, range);
+      break;
+    case UCHAR:
+      decode_column<uint8_t, big_endian>(rows, stride, column, range);
+      break;
+    case SHORT:
+      decode_column<int16_t, big_endian>(rows, stride, column, range);
+      break;
+    case USHORT:
+      decode_column<uint16_t, big_endian>(rows, stride, column, range);
+      break;
+    case INT:
+    case UINT:
+      decode_column<int32_t, big_endian>(rows, stride, column, range);
+      break;
+    case FLOAT:
+      decode_column<float, big_endian>(rows, stride, column, range);
+      break;
+    case DOUBLE:
+      decode_column<double, big_endian>(rows, stride, column, range);
+      break;
+    default:
+      BLI_assert_msg(false, "Unknown property type");
+  }
+}
+
+/**
+ * Decode all rows of a binary element without list properties at once. The rows are split into
+ * blocks that are processed in parallel, within a block every column is converted separately.
+ */
+static void decode_binary_columns(const Span<char> data,
+                                  const PlyElement &element,
+                                  const bool big_endian,
+                                  const Span<PlyColumn> columns)
+{
+  const uint8_t *rows = reinterpret_cast<const uint8_t *>(data.data());
+  const int64_t stride = element.stride;
+  threading::parallel_for(IndexRange(element.count), 8192, [&](const IndexRange range) {
+    for (const PlyColumn &column : columns) {
+      if (big_endian) {
+        decode_column<true>(rows, stride, column, range);
+      }
+      else {
+        decode_column<false>(rows, stride, column, range);
+      }
+    }
+  });
+}
+
+static const char *load_vertex_element_binary(PlyReadBuffer &file,
+                                              const PlyHeader &header,
+                                              const PlyElement &element,
+                                              const int3 vertex_index,
+                                              const int3 color_index,
+                                              const int alpha_index,
+                                              const int3 normal_index,
+                                              const int2 uv_index,
+                                              const float4 color_norm,
+                                              const Span<int64_t> custom_attr_indices,
+                                              PlyData *data)
+{
+  if (element.stride == 0) {
+    return "Vertex/Edge element contains list properties, this is not supported";
+  }
+  if (!ELEM(header.type, PlyFormatType::BINARY_LE, PlyFormatType::BINARY_BE)) {
+    return "Unknown binary ply format for vertex element";
+  }
+  const Span<char> bytes = file.read_bytes_view(int64_t(element.stride) * element.count);
+  if (bytes.size() != int64_t(element.stride) * element.count) {
+    return "Could not read row of binary property";
+  }
+
+  const Vector<int> offsets = calc_property_offsets(element);
+  Vector<PlyColumn> columns;
+  auto add_column = [&](const int prop_index, const float normalizer, float *dst, int dst_stride) {
+    columns.append(
+        {element.properties[prop_index].type, offsets[prop_index], normalizer, dst, dst_stride});
+  };
+
+  data->vertices.resize(element.count);
+  float *positions = reinterpret_cast<float *>(data->vertices.data());
+  for (const int i : IndexRange(3)) {
+    add_column(vertex_index[i], 1.0f, positions + i, 3);
+  }
+  if (color_index.x >= 0 && color_index.y >= 0 && color_index.z >= 0) {
+    data->vertex_colors.resize(element.count);
+    float *colors = reinterpret_cast<float *>(data->vertex_colors.data());
+    for (const int i : IndexRange(3)) {
+      add_column(color_index[i], color_norm[i], colors + i, 4);
+    }
+    if (alpha_index >= 0) {
+      add_column(alpha_index, color_norm.w, colors + 3, 4);
+    }
+    else {
+      for (float4 &color : data->vertex_colors) {
+        color.w = 1.0f;
+      }
+    }
+  }
+  if (normal_index.x >= 0 && normal_index.y >= 0 && normal_index.z >= 0) {
+    data->vertex_normals.resize(element.count);
+    float *normals = reinterpret_cast<float *>(data->vertex_normals.data());
+    for (const int i : IndexRange(3)) {
+      add_column(normal_index[i], 1.0f, normals + i, 3);
+    }
+  }
+  if (uv_index.x >= 0 && uv_index.y >= 0) {
+    data->uv_coordinates.resize(element.count);
+    float *uvs = reinterpret_cast<float *>(data->uv_coordinates.data());
+    for (const int i : IndexRange(2)) {
+      add_column(uv_index[i], 1.0f, uvs + i, 2);
+    }
+  }
+  for (const int64_t ci : custom_attr_indices.index_range()) {
+    add_column(custom_attr_indices[ci], 1.0f, data->vertex_custom_attr[ci].data.data(), 1);
+  }
+
+  decode_binary_columns(bytes, element, header.type == PlyFormatType::BINARY_BE, columns);
+  return nullptr;
+}
+
 static const char *load_vertex_element(PlyReadBuffer &file,
                                        const PlyHeader &header,
                                        const PlyElement &element,
@@ -267,17 +473,6 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     data->vertex_custom_attr.append(attr);
   }
 
-  data->vertices.reserve(element.count);
-  if (has_color) {
-    data->vertex_colors.reserve(element.count);
-  }
-  if (has_normal) {
-    data->vertex_normals.reserve(element.count);
-  }
-  if (has_uv) {
-    data->uv_coordinates.reserve(element.count);
-  }
-
   float4 color_norm = {1, 1, 1, 1};
   if (has_color) {
     color_norm.x = data_type_normalizer[element.properties[color_index.x].type];
@@ -288,21 +483,35 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     color_norm.w = data_type_normalizer[element.properties[alpha_index].type];
   }
 
-  Vector<float> value_vec(element.properties.size());
-  Vector<uint8_t> scratch;
   if (header.type != PlyFormatType::ASCII) {
-    scratch.resize(element.stride);
+    return load_vertex_element_binary(file,
+                                      header,
+                                      element,
+                                      vertex_index,
+                                      color_index,
+                                      alpha_index,
+                                      normal_index,
+                                      uv_index,
+                                      color_norm,
+                                      custom_attr_indices,
+                                      data);
   }
 
-  for (int i = 0; i < element.count; i++) {
+  data->vertices.reserve(element.count);
+  if (has_color) {
+    data->vertex_colors.reserve(element.count);
+  }
+  if (has_normal) {
+    data->vertex_normals.reserve(element.count);
+  }
+  if (has_uv) {
+    data->uv_coordinates.reserve(element.count);
+  }
 
-    const char *error = nullptr;
-    if (header.type == PlyFormatType::ASCII) {
-      error = parse_row_ascii(file, value_vec);
-    }
-    else {
-      error = parse_row_binary(file, header, element, scratch, value_vec);
-    }
+  Vector<float> value_vec(element.properties.size());
+
+  for (int i = 0; i < element.count; i++) {
+    const char *error = parse_row_ascii(file, value_vec);
     if (error != nullptr) {
       return error;
     }
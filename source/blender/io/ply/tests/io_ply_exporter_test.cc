@@ -9,6 +9,9 @@
 
 #include "BKE_appdir.hh"
 #include "BKE_blender_version.h"
+#include "BKE_mesh.hh"
+
+#include "BLI_math_matrix.h"
 
 #include "DEG_depsgraph.hh"
 
@@ -20,6 +23,9 @@
 #include "ply_export_load_plydata.hh"
 #include "ply_file_buffer_ascii.hh"
 #include "ply_file_buffer_binary.hh"
+#include "ply_import.hh"
+#include "ply_import_buffer.hh"
+#include "ply_import_data.hh"
 
 #include <fstream>
 
@@ -58,38 +64,65 @@ class PLYExportTest : public BlendfileLoadingBaseTest {
   }
 };
 
-static std::unique_ptr<PlyData> load_cube(PLYExportParams &params)
+/**
+ * Cube with inward facing normals, exported with identity transforms. Owned by the returned
+ * export mesh.
+ */
+static Vector<std::unique_ptr<PlyExportMesh>> create_cube()
 {
-  std::unique_ptr<PlyData> plyData = std::make_unique<PlyData>();
-  plyData->vertices = {
-      {1.122082, 1.122082, 1.122082},
-      {1.122082, 1.122082, -1.122082},
-      {1.122082, -1.122082, 1.122082},
-      {1.122082, -1.122082, -1.122082},
-      {-1.122082, 1.122082, 1.122082},
-      {-1.122082, 1.122082, -1.122082},
-      {-1.122082, -1.122082, 1.122082},
-      {-1.122082, -1.122082, -1.122082},
-  };
-
-  plyData->face_sizes = {4, 4, 4, 4, 4, 4};
-  plyData->face_vertices = {0, 2, 6, 4, 3, 7, 6, 2, 7, 5, 4, 6,
-                            5, 7, 3, 1, 1, 3, 2, 0, 5, 1, 0, 4};
-
-  if (params.export_normals) {
-    plyData->vertex_normals = {
-        {-0.5773503, -0.5773503, -0.5773503},
-        {-0.5773503, -0.5773503, 0.5773503},
-        {-0.5773503, 0.5773503, -0.5773503},
-        {-0.5773503, 0.5773503, 0.5773503},
-        {0.5773503, -0.5773503, -0.5773503},
-        {0.5773503, -0.5773503, 0.5773503},
-        {0.5773503, 0.5773503, -0.5773503},
-        {0.5773503, 0.5773503, 0.5773503},
-    };
-  }
+  const float size = 1.122082f;
+  Mesh *mesh = BKE_mesh_new_nomain(8, 0, 6, 24);
+  mesh->vert_positions_for_write().copy_from({
+      {size, size, size},
+      {size, size, -size},
+      {size, -size, size},
+      {size, -size, -size},
+      {-size, size, size},
+      {-size, size, -size},
+      {-size, -size, size},
+      {-size, -size, -size},
+  });
+  offset_indices::fill_constant_group_size(4, 0, mesh->face_offsets_for_write());
+  mesh->corner_verts_for_write().copy_from(
+      {0, 2, 6, 4, 3, 7, 6, 2, 7, 5, 4, 6, 5, 7, 3, 1, 1, 3, 2, 0, 5, 1, 0, 4});
+  bke::mesh_calc_edges(*mesh, false, false);
+  bke::mesh_vert_normals_assign(*mesh,
+                                Span<float3>({
+                                    {-0.5773503, -0.5773503, -0.5773503},
+                                    {-0.5773503, -0.5773503, 0.5773503},
+                                    {-0.5773503, 0.5773503, -0.5773503},
+                                    {-0.5773503, 0.5773503, 0.5773503},
+                                    {0.5773503, -0.5773503, -0.5773503},
+                                    {0.5773503, -0.5773503, 0.5773503},
+                                    {0.5773503, 0.5773503, -0.5773503},
+                                    {0.5773503, 0.5773503, 0.5773503},
+                                }));
+
+  std::unique_ptr<PlyExportMesh> export_mesh = std::make_unique<PlyExportMesh>();
+  export_mesh->mesh = mesh;
+  export_mesh->owned_mesh = mesh;
+  unit_m4(export_mesh->world_and_axes_transform);
+  unit_m3(export_mesh->world_and_axes_normal_transform);
+
+  Vector<std::unique_ptr<PlyExportMesh>> meshes;
+  meshes.append(std::move(export_mesh));
+  return meshes;
+}
 
-  return plyData;
+/** Two vertices connected by a loose edge, exported with identity transforms after the cube. */
+static std::unique_ptr<PlyExportMesh> create_loose_edge()
+{
+  Mesh *mesh = BKE_mesh_new_nomain(2, 1, 0, 0);
+  mesh->vert_positions_for_write().copy_from({{0, 0, 0}, {1, 0, 0}});
+  mesh->edges_for_write().first() = int2(0, 1);
+
+  std::unique_ptr<PlyExportMesh> export_mesh = std::make_unique<PlyExportMesh>();
+  export_mesh->mesh = mesh;
+  export_mesh->owned_mesh = mesh;
+  export_mesh->vertex_offset = 8;
+  unit_m4(export_mesh->world_and_axes_transform);
+  unit_m3(export_mesh->world_and_axes_normal_transform);
+  return export_mesh;
 }
 
 /* The following is relative to BKE_tempdir_base.
@@ -141,11 +174,13 @@ TEST_F(PLYExportTest, WriteHeaderAscii)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
 
-  write_header(*buffer.get(), *plyData.get(), _params);
+  write_header(*buffer.get(), layout, _params);
 
   buffer->close_file();
 
@@ -179,11 +214,13 @@ TEST_F(PLYExportTest, WriteHeaderBinary)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferBinary>(_params.filepath);
 
-  write_header(*buffer.get(), *plyData.get(), _params);
+  write_header(*buffer.get(), layout, _params);
 
   buffer->close_file();
 
@@ -217,11 +254,13 @@ TEST_F(PLYExportTest, WriteVerticesAscii)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
 
-  write_vertices(*buffer.get(), *plyData.get());
+  write_vertices(*buffer.get(), meshes, layout, _params);
 
   buffer->close_file();
 
@@ -249,11 +288,13 @@ TEST_F(PLYExportTest, WriteVerticesBinary)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferBinary>(_params.filepath);
 
-  write_vertices(*buffer.get(), *plyData.get());
+  write_vertices(*buffer.get(), meshes, layout, _params);
 
   buffer->close_file();
 
@@ -285,11 +326,12 @@ TEST_F(PLYExportTest, WriteFacesAscii)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
 
-  write_faces(*buffer.get(), *plyData.get());
+  write_faces(*buffer.get(), meshes);
 
   buffer->close_file();
 
@@ -315,11 +357,12 @@ TEST_F(PLYExportTest, WriteFacesBinary)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferBinary>(_params.filepath);
 
-  write_faces(*buffer.get(), *plyData.get());
+  write_faces(*buffer.get(), meshes);
 
   buffer->close_file();
 
@@ -351,11 +394,13 @@ TEST_F(PLYExportTest, WriteVertexNormalsAscii)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
 
-  write_vertices(*buffer.get(), *plyData.get());
+  write_vertices(*buffer.get(), meshes, layout, _params);
 
   buffer->close_file();
 
@@ -383,11 +428,13 @@ TEST_F(PLYExportTest, WriteVertexNormalsBinary)
   _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
   STRNCPY(_params.filepath, filePath.c_str());
 
-  std::unique_ptr<PlyData> plyData = load_cube(_params);
+  _params.global_scale = 1.0f;
+  const Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
 
   std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferBinary>(_params.filepath);
 
-  write_vertices(*buffer.get(), *plyData.get());
+  write_vertices(*buffer.get(), meshes, layout, _params);
 
   buffer->close_file();
 
@@ -416,8 +463,71 @@ TEST_F(PLYExportTest, WriteVertexNormalsBinary)
   }
 }
 
+TEST_F(PLYExportTest, WriteEdgesVertexOffset)
+{
+  /* Loose edge indices are offset by the first vertex of their mesh in the file. */
+  std::string filePath = get_temp_ply_filename(temp_file_path);
+  PLYExportParams _params = {};
+  _params.ascii_format = true;
+  STRNCPY(_params.filepath, filePath.c_str());
+
+  Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  meshes.append(create_loose_edge());
+
+  std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
+
+  write_edges(*buffer.get(), meshes);
+
+  buffer->close_file();
+
+  std::string result = read_temp_file_in_string(filePath);
+
+  ASSERT_STREQ(result.c_str(), "8 9\n");
+}
+
+TEST_F(PLYExportTest, WriteVerticesMissingUVs)
+{
+  /* Meshes without UVs are written with zero UVs when other meshes in the file have them. */
+  std::string filePath = get_temp_ply_filename(temp_file_path);
+  PLYExportParams _params = {};
+  _params.ascii_format = true;
+  _params.export_normals = false;
+  _params.vertex_colors = PLY_VERTEX_COLOR_NONE;
+  STRNCPY(_params.filepath, filePath.c_str());
+
+  _params.global_scale = 1.0f;
+  Vector<std::unique_ptr<PlyExportMesh>> meshes = create_cube();
+  meshes.first()->uvs = Vector<float2>(8, float2(0.5f, 0.25f));
+  meshes.append(create_loose_edge());
+  const PlyExportLayout layout = calc_export_layout(meshes, _params);
+  EXPECT_TRUE(layout.has_uvs);
+
+  std::unique_ptr<FileBuffer> buffer = std::make_unique<FileBufferAscii>(_params.filepath);
+
+  write_vertices(*buffer.get(), meshes, layout, _params);
+
+  buffer->close_file();
+
+  std::string result = read_temp_file_in_string(filePath);
+
+  std::string expected =
+      "1.122082 1.122082 1.122082 0.5 0.25\n"
+      "1.122082 1.122082 -1.122082 0.5 0.25\n"
+      "1.122082 -1.122082 1.122082 0.5 0.25\n"
+      "1.122082 -1.122082 -1.122082 0.5 0.25\n"
+      "-1.122082 1.122082 1.122082 0.5 0.25\n"
+      "-1.122082 1.122082 -1.122082 0.5 0.25\n"
+      "-1.122082 -1.122082 1.122082 0.5 0.25\n"
+      "-1.122082 -1.122082 -1.122082 0.5 0.25\n"
+      "0 0 0 0 0\n"
+      "1 0 0 0 0\n";
+
+  ASSERT_STREQ(result.c_str(), expected.c_str());
+}
+
 class PLYExportPLYDataTest : public PLYExportTest {
  public:
+  /** Export the scene to a temporary file and read it back with the importer. */
   PlyData load_ply_data_from_blendfile(const std::string &blendfile, PLYExportParams &params)
   {
     PlyData data;
@@ -425,9 +535,29 @@ class PLYExportPLYDataTest : public PLYExportTest {
       return data;
     }
 
-    load_plydata(data, depsgraph, params);
+    const std::string filepath = get_temp_ply_filename(temp_file_path);
+    {
+      const Vector<std::unique_ptr<PlyExportMesh>> meshes = gather_export_meshes(depsgraph,
+                                                                                params);
+      const PlyExportLayout layout = calc_export_layout(meshes, params);
+      FileBufferBinary buffer(filepath.c_str());
+      write_header(buffer, layout, params);
+      write_vertices(buffer, meshes, layout, params);
+      write_faces(buffer, meshes);
+      write_edges(buffer, meshes);
+      buffer.close_file();
+    }
 
-    return data;
+    PlyReadBuffer infile(filepath.c_str());
+    PlyHeader header;
+    const char *header_err = read_header(infile, header);
+    if (header_err != nullptr) {
+      ADD_FAILURE() << header_err;
+      return data;
+    }
+    std::unique_ptr<PlyData> imported = import_ply_data(infile, header);
+    EXPECT_TRUE(imported->error.empty()) << imported->error;
+    return std::move(*imported);
   }
 };
 
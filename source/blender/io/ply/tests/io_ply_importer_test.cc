@@ -4,6 +4,8 @@
 
 #include "testing/testing.h"
 
+#include <fstream>
+
 #include "BLI_fileops.hh"
 #include "BLI_hash_mm2a.hh"
 
@@ -29,8 +31,19 @@ class PLYImportTest : public testing::Test {
     std::string ply_path = blender::tests::flags_test_asset_dir() +
                            SEP_STR "io_tests" SEP_STR "ply" SEP_STR + path;
 
-    /* Use a small read buffer size for better coverage of buffer refilling behavior. */
-    PlyReadBuffer infile(ply_path.c_str(), 128);
+    /* Read the memory-mapped file, and read it again with a small read buffer size for better
+     * coverage of buffer refilling behavior. */
+    for (const size_t read_buffer_size : {0, 128}) {
+      SCOPED_TRACE(read_buffer_size);
+      import_path_and_check(ply_path, read_buffer_size, exp);
+    }
+  }
+
+  void import_path_and_check(const std::string &ply_path,
+                             const size_t read_buffer_size,
+                             const Expectation &exp)
+  {
+    PlyReadBuffer infile(ply_path.c_str(), read_buffer_size);
     PlyHeader header;
     const char *header_err = read_header(infile, header);
     if (header_err != nullptr) {
@@ -293,6 +306,34 @@ TEST_F(PLYImportTest, PlyImportVertexCompOrder)
   import_and_check("vertex_comp_order_b.ply", expect);
 }
 
+TEST_F(PLYImportTest, PlyImportBlankLines)
+{
+  /* Empty lines anywhere in ascii files are skipped. */
+  const std::string ply_path = testing::TempDir() + "ply_import_blank_lines.ply";
+  {
+    std::ofstream file(ply_path, std::ios::binary);
+    file << "\nply\nformat ascii 1.0\n\nelement vertex 3\nproperty float x\n"
+            "property float y\nproperty float z\n\nelement face 1\n"
+            "property list uchar int vertex_indices\nend_header\n\n"
+            "0 0 0\n\n\n1 0 0\r\n0 1 0\n\n3 0 1 2\n\n";
+  }
+  Expectation expect = {3, 1, 3, 0, 0, 0, float3(0, 0, 0), float3(0, 1, 0)};
+  for (const size_t read_buffer_size : {0, 64}) {
+    SCOPED_TRACE(read_buffer_size);
+    PlyReadBuffer infile(ply_path.c_str(), read_buffer_size);
+    PlyHeader header;
+    ASSERT_EQ(read_header(infile, header), nullptr);
+    std::unique_ptr<PlyData> data = import_ply_data(infile, header);
+    ASSERT_TRUE(data->error.empty()) << data->error;
+    ASSERT_EQ(data->vertices.size(), expect.totvert);
+    ASSERT_EQ(data->face_sizes.size(), expect.faces_num);
+    EXPECT_V3_NEAR(data->vertices.first(), expect.vert_first, 0.0001f);
+    EXPECT_V3_NEAR(data->vertices.last(), expect.vert_last, 0.0001f);
+    EXPECT_EQ(data->face_vertices.as_span(), Span<uint32_t>({0, 1, 2}));
+  }
+  BLI_delete(ply_path.c_str(), false, false);
+}
+
 //@TODO: test with vertex element having list properties
 //@TODO: test with edges starting with non-vertex index properties
 //@TODO: test various malformed headers
@@ -21,6 +21,8 @@ struct STLImportParams {
   bool use_scene_unit;
   float global_scale;
   bool use_mesh_validate;
+  /** Merge vertices closer than this while importing, zero only merges equal positions. */
+  float merge_distance = 0.0f;
 
   ReportList *reports = nullptr;
 };
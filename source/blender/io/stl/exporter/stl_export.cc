@@ -112,8 +112,10 @@ void export_frame(Depsgraph *depsgraph,
 
     /* Write triangles. */
     const Span<float3> positions = mesh->vert_positions();
-    const blender::Span<int> corner_verts = mesh->corner_verts();
-    for (const int3 &tri : mesh->corner_tris()) {
+    const Span<int> corner_verts = mesh->corner_verts();
+    const Span<int3> corner_tris = mesh->corner_tris();
+    writer->write_triangles(corner_tris.size(), [&](const int64_t tri_index) {
+      const int3 &tri = corner_tris[tri_index];
       Triangle t;
       for (int i = 0; i < 3; i++) {
         float3 pos = positions[corner_verts[tri[i]]];
@@ -122,8 +124,8 @@ void export_frame(Depsgraph *depsgraph,
         t.vertices[i] = pos;
       }
       t.normal = math::normal_tri(t.vertices[0], t.vertices[1], t.vertices[2]);
-      writer->write_triangle(t);
-    }
+      return t;
+    });
   }
   DEG_OBJECT_ITER_END;
 }
@@ -16,7 +16,10 @@
 
 #include "stl_export_writer.hh"
 
+#include "BLI_array.hh"
 #include "BLI_fileops.h"
+#include "BLI_task.hh"
+#include "BLI_threads.h"
 
 namespace blender::io::stl {
 
@@ -67,31 +70,30 @@ FileWriter::~FileWriter()
   fclose(file_);
 }
 
-void FileWriter::write_triangle(const Triangle &t)
+static void format_triangle(fmt::memory_buffer &buf, const Triangle &t, const bool ascii)
 {
-  tris_num_++;
-  if (ascii_) {
-    fmt::print(file_,
-               "facet normal {} {} {}\n"
-               " outer loop\n"
-               "  vertex {} {} {}\n"
-               "  vertex {} {} {}\n"
-               "  vertex {} {} {}\n"
-               " endloop\n"
-               "endfacet\n",
-
-               t.normal.x,
-               t.normal.y,
-               t.normal.z,
-               t.vertices[0].x,
-               t.vertices[0].y,
-               t.vertices[0].z,
-               t.vertices[1].x,
-               t.vertices[1].y,
-               t.vertices[1].z,
-               t.vertices[2].x,
-               t.vertices[2].y,
-               t.vertices[2].z);
+  if (ascii) {
+    fmt::format_to(fmt::appender(buf),
+                   "facet normal {} {} {}\n"
+                   " outer loop\n"
+                   "  vertex {} {} {}\n"
+                   "  vertex {} {} {}\n"
+                   "  vertex {} {} {}\n"
+                   " endloop\n"
+                   "endfacet\n",
+
+                   t.normal.x,
+                   t.normal.y,
+                   t.normal.z,
+                   t.vertices[0].x,
+                   t.vertices[0].y,
+                   t.vertices[0].z,
+                   t.vertices[1].x,
+                   t.vertices[1].y,
+                   t.vertices[1].z,
+                   t.vertices[2].x,
+                   t.vertices[2].y,
+                   t.vertices[2].z);
   }
   else {
     ExportBinaryTriangle bin_tri;
@@ -100,7 +102,45 @@ void FileWriter::write_triangle(const Triangle &t)
     bin_tri.vertices[1] = t.vertices[1];
     bin_tri.vertices[2] = t.vertices[2];
     bin_tri.attribute_byte_count = 0;
-    fwrite(&bin_tri, sizeof(ExportBinaryTriangle), 1, file_);
+    const char *bytes = reinterpret_cast<const char *>(&bin_tri);
+    buf.append(bytes, bytes + sizeof(ExportBinaryTriangle));
+  }
+}
+
+/* Split up large meshes into multi-threaded jobs; each job processes
+ * this amount of triangles. */
+static const int64_t chunk_size = 32768;
+
+void FileWriter::write_triangles(const int64_t tris_num,
+                                 const FunctionRef<Triangle(int64_t)> get_triangle)
+{
+  if (tris_num <= 0) {
+    return;
+  }
+  tris_num_ += uint32_t(tris_num);
+
+  /* Only a limited number of chunks is formatted before they are written to the file,
+   * to keep memory usage independent of the mesh size. */
+  const int64_t chunks_num = (tris_num + chunk_size - 1) / chunk_size;
+  const int64_t batch_size = std::min<int64_t>(BLI_system_thread_count() * 4, chunks_num);
+  Array<fmt::memory_buffer> buffers(batch_size);
+
+  for (int64_t batch_start = 0; batch_start < chunks_num; batch_start += batch_size) {
+    const IndexRange batch(batch_start, std::min(batch_size, chunks_num - batch_start));
+    threading::parallel_for(batch.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t r : range) {
+        const int64_t start = batch[r] * chunk_size;
+        const IndexRange tris(start, std::min(chunk_size, tris_num - start));
+        fmt::memory_buffer &buf = buffers[r];
+        buf.clear();
+        for (const int64_t i : tris) {
+          format_triangle(buf, get_triangle(i), ascii_);
+        }
+      }
+    });
+    for (const int64_t r : batch.index_range()) {
+      fwrite(buffers[r].data(), 1, buffers[r].size(), file_);
+    }
   }
 }
 
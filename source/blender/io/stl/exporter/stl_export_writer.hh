@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "BLI_function_ref.hh"
 #include "BLI_math_vector_types.hh"
 
 namespace blender::io::stl {
@@ -21,7 +22,11 @@ class FileWriter {
  public:
   FileWriter(const char *filepath, bool ascii);
   ~FileWriter();
-  void write_triangle(const Triangle &t);
+  /**
+   * Write `tris_num` triangles created by `get_triangle`. Large amounts of triangles are
+   * formatted in parallel chunks, which are written to the file in order.
+   */
+  void write_triangles(int64_t tris_num, FunctionRef<Triangle(int64_t)> get_triangle);
 
  private:
   FILE *file_;
@@ -10,6 +10,7 @@
 
 #include "BKE_context.hh"
 #include "BKE_layer.hh"
+#include "BKE_lib_id.hh"
 #include "BKE_mesh.hh"
 #include "BKE_object.hh"
 #include "BKE_report.h"
@@ -30,23 +31,14 @@
 #include "DEG_depsgraph.hh"
 #include "DEG_depsgraph_build.hh"
 
+#include "IO_mapped_file.hh"
+
 #include "stl_import.hh"
 #include "stl_import_ascii_reader.hh"
 #include "stl_import_binary_reader.hh"
 
 namespace blender::io::stl {
 
-void stl_import_report_error(FILE *file)
-{
-  fprintf(stderr, "STL Importer: failed to read file");
-  if (feof(file)) {
-    fprintf(stderr, ", end of file reached.\n");
-  }
-  else if (ferror(file)) {
-    perror("Error");
-  }
-}
-
 void importer_main(bContext *C, const STLImportParams &import_params)
 {
   Main *bmain = CTX_data_main(C);
@@ -60,8 +52,8 @@ void importer_main(Main *bmain,
                    ViewLayer *view_layer,
                    const STLImportParams &import_params)
 {
-  FILE *file = BLI_fopen(import_params.filepath, "rb");
-  if (!file) {
+  MappedFile file(import_params.filepath);
+  if (!file.is_open()) {
     fprintf(stderr, "Failed to open STL file:'%s'.\n", import_params.filepath);
     BKE_reportf(import_params.reports,
                 RPT_ERROR,
@@ -69,23 +61,22 @@ void importer_main(Main *bmain,
                 import_params.filepath);
     return;
   }
-  BLI_SCOPED_DEFER([&]() { fclose(file); });
 
   /* Detect STL file type by comparing file size with expected file size,
    * could check if file starts with "solid", but some files do not adhere,
    * this is the same as the old Python importer.
    */
   uint32_t num_tri = 0;
-  size_t file_size = BLI_file_size(import_params.filepath);
-  fseek(file, BINARY_HEADER_SIZE, SEEK_SET);
-  if (fread(&num_tri, sizeof(uint32_t), 1, file) != 1) {
-    stl_import_report_error(file);
+  const size_t file_size = size_t(file.size());
+  if (file_size < BINARY_HEADER_SIZE + sizeof(uint32_t)) {
+    fprintf(stderr, "STL Importer: failed to read file, end of file reached.\n");
     BKE_reportf(import_params.reports,
                 RPT_ERROR,
                 "STL Import: Failed to read file '%s'",
                 import_params.filepath);
     return;
   }
+  memcpy(&num_tri, file.data().data() + BINARY_HEADER_SIZE, sizeof(uint32_t));
   bool is_ascii_stl = (file_size != (BINARY_HEADER_SIZE + 4 + BINARY_STRIDE * num_tri));
 
   /* Name used for both mesh and object. */
@@ -93,9 +84,15 @@ void importer_main(Main *bmain,
   STRNCPY(ob_name, BLI_path_basename(import_params.filepath));
   BLI_path_extension_strip(ob_name);
 
-  Mesh *mesh = is_ascii_stl ?
-                   read_stl_ascii(import_params.filepath, import_params.use_facet_normal) :
-                   read_stl_binary(file, import_params.use_facet_normal);
+  const bool use_custom_normals = import_params.use_facet_normal;
+  const float merge_distance = import_params.merge_distance;
+  Mesh *mesh = is_ascii_stl ? read_stl_ascii(file.data(), use_custom_normals, merge_distance) :
+                             read_stl_binary(file.data(), use_custom_normals, merge_distance);
+
+  if (mesh != nullptr && file.has_io_error()) {
+    BKE_id_free(nullptr, mesh);
+    mesh = nullptr;
+  }
 
   if (mesh == nullptr) {
     fprintf(stderr, "STL Importer: Failed to import mesh '%s'\n", import_params.filepath);
@@ -12,8 +12,6 @@
 
 namespace blender::io::stl {
 
-void stl_import_report_error(FILE *file);
-
 /* Main import function used from within Blender. */
 void importer_main(bContext *C, const STLImportParams &import_params);
 
@@ -33,11 +33,11 @@ namespace blender::io::stl {
 
 class StringBuffer {
  private:
-  char *start;
+  const char *start;
   const char *end;
 
  public:
-  StringBuffer(char *buf, size_t len)
+  StringBuffer(const char *buf, size_t len)
   {
     start = buf;
     end = start + len;
@@ -102,7 +102,7 @@ class StringBuffer {
     if (ELEM(res.ec, std::errc::invalid_argument, std::errc::result_out_of_range)) {
       out = 0.0f;
     }
-    start = const_cast<char *>(res.ptr);
+    start = res.ptr;
   }
 };
 
@@ -113,20 +113,14 @@ static inline void parse_float3(StringBuffer &buf, float out[3])
   }
 }
 
-Mesh *read_stl_ascii(const char *filepath, const bool use_custom_normals)
+Mesh *read_stl_ascii(const Span<char> data,
+                     const bool use_custom_normals,
+                     const float merge_distance)
 {
-  size_t buffer_len;
-  void *buffer = BLI_file_read_text_as_mem(filepath, 0, &buffer_len);
-  if (buffer == nullptr) {
-    fprintf(stderr, "STL Importer: cannot read from ASCII STL file: '%s'\n", filepath);
-    return nullptr;
-  }
-  BLI_SCOPED_DEFER([&]() { MEM_freeN(buffer); });
-
   int num_reserved_tris = 1024;
 
-  StringBuffer str_buf(static_cast<char *>(buffer), buffer_len);
-  STLMeshHelper stl_mesh(num_reserved_tris, use_custom_normals);
+  StringBuffer str_buf(data.data(), size_t(data.size()));
+  STLMeshHelper stl_mesh(num_reserved_tris, use_custom_normals, merge_distance);
   float triangle_buf[3][3];
   float custom_normal_buf[3];
   str_buf.drop_line(); /* Skip header line */
@@ -8,10 +8,10 @@
 
 #pragma once
 
-#include <cstdio>
-
 #include "BKE_mesh.h"
 
+#include "BLI_span.hh"
+
 #include "stl_import.hh"
 
 /**
@@ -32,6 +32,10 @@
 
 namespace blender::io::stl {
 
-Mesh *read_stl_ascii(const char *filepath, bool use_custom_normals);
+/**
+ * Create a mesh from the contents of an ASCII STL file, parsed in place from `data`.
+ * Vertices closer than `merge_distance` are merged, see #STLMeshHelper.
+ */
+Mesh *read_stl_ascii(Span<char> data, bool use_custom_normals, float merge_distance);
 
 }  // namespace blender::io::stl
@@ -6,14 +6,16 @@
  * \ingroup stl
  */
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 #include "BKE_main.hh"
 #include "BKE_mesh.hh"
 
-#include "BLI_array.hh"
 #include "BLI_memory_utils.hh"
+#include "BLI_task.hh"
 
 #include "DNA_mesh_types.h"
 
@@ -31,33 +33,44 @@ struct STLBinaryTriangle {
 };
 #pragma pack(pop)
 
-Mesh *read_stl_binary(FILE *file, const bool use_custom_normals)
+Mesh *read_stl_binary(const Span<char> data,
+                      const bool use_custom_normals,
+                      const float merge_distance)
 {
-  const int chunk_size = 1024;
   uint32_t num_tris = 0;
-  fseek(file, BINARY_HEADER_SIZE, SEEK_SET);
-  if (fread(&num_tris, sizeof(uint32_t), 1, file) != 1) {
-    stl_import_report_error(file);
+  if (data.size() < BINARY_HEADER_SIZE + sizeof(uint32_t)) {
+    fprintf(stderr, "STL Importer: failed to read file, end of file reached.\n");
     return nullptr;
   }
+  memcpy(&num_tris, data.data() + BINARY_HEADER_SIZE, sizeof(uint32_t));
 
   if (num_tris == 0) {
     return BKE_mesh_new_nomain(0, 0, 0, 0);
   }
 
-  Array<STLBinaryTriangle> tris_buf(chunk_size);
-  STLMeshHelper stl_mesh(num_tris, use_custom_normals);
-  size_t num_read_tris;
-  while ((num_read_tris = fread(tris_buf.data(), sizeof(STLBinaryTriangle), chunk_size, file))) {
-    for (size_t i = 0; i < num_read_tris; i++) {
-      if (use_custom_normals) {
-        stl_mesh.add_triangle(tris_buf[i].v1, tris_buf[i].v2, tris_buf[i].v3, tris_buf[i].normal);
-      }
-      else {
-        stl_mesh.add_triangle(tris_buf[i].v1, tris_buf[i].v2, tris_buf[i].v3);
+  /* Only use the triangles that are fully contained in the file. */
+  const int64_t tris_size = data.size() - BINARY_HEADER_SIZE - sizeof(uint32_t);
+  num_tris = uint32_t(std::min<int64_t>(num_tris, tris_size / sizeof(STLBinaryTriangle)));
+  const Span<STLBinaryTriangle> tris(
+      reinterpret_cast<const STLBinaryTriangle *>(data.data() + BINARY_HEADER_SIZE +
+                                                  sizeof(uint32_t)),
+      num_tris);
+
+  STLMeshHelper stl_mesh(num_tris, use_custom_normals, merge_distance);
+  MutableSpan<float3> corner_positions;
+  MutableSpan<float3> normals;
+  stl_mesh.add_triangles(num_tris, corner_positions, normals);
+  threading::parallel_for(tris.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      const STLBinaryTriangle &tri = tris[i];
+      corner_positions[i * 3 + 0] = tri.v1;
+      corner_positions[i * 3 + 1] = tri.v2;
+      corner_positions[i * 3 + 2] = tri.v3;
+      if (!normals.is_empty()) {
+        normals[i] = tri.normal;
       }
     }
-  }
+  });
 
   return stl_mesh.to_mesh();
 }
@@ -8,10 +8,10 @@
 
 #pragma once
 
-#include <cstdio>
-
 #include "BKE_mesh.h"
 
+#include "BLI_span.hh"
+
 /*  Binary STL spec.:
  *   UINT8[80]    – Header                  - 80 bytes
  *   UINT32       – Number of triangles     - 4 bytes
@@ -28,6 +28,11 @@ namespace blender::io::stl {
 const size_t BINARY_HEADER_SIZE = 80;
 const size_t BINARY_STRIDE = 12 * 4 + 2;
 
-Mesh *read_stl_binary(FILE *file, bool use_custom_normals);
+/**
+ * Create a mesh from the contents of a binary STL file.
+ * The triangles are read in place from `data`, which is usually a memory-mapped file.
+ * Vertices closer than `merge_distance` are merged, see #STLMeshHelper.
+ */
+Mesh *read_stl_binary(Span<char> data, bool use_custom_normals, float merge_distance);
 
 }  // namespace blender::io::stl
@@ -6,6 +6,7 @@
  * \ingroup stl
  */
 
+#include <cmath>
 #include <iostream>
 
 #include "BKE_customdata.hh"
@@ -15,41 +16,34 @@
 
 #include "BLI_array.hh"
 #include "BLI_array_utils.hh"
+#include "BLI_hash_grid.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_map.hh"
+#include "BLI_math_base.h"
 #include "BLI_math_vector.h"
 #include "BLI_math_vector.hh"
+#include "BLI_set.hh"
 #include "BLI_task.hh"
+#include "BLI_threads.h"
 
 #include "stl_import_mesh.hh"
 
 namespace blender::io::stl {
 
-STLMeshHelper::STLMeshHelper(int tris_num, bool use_custom_normals)
-    : use_custom_normals_(use_custom_normals)
+STLMeshHelper::STLMeshHelper(int tris_num, bool use_custom_normals, float merge_distance)
+    : use_custom_normals_(use_custom_normals), merge_distance_(merge_distance)
 {
-  degenerate_tris_num_ = 0;
-  duplicate_tris_num_ = 0;
-  tris_.reserve(tris_num);
-  /* Upper bound (all vertices are unique). */
-  verts_.reserve(tris_num * 3);
+  corner_positions_.reserve(int64_t(tris_num) * 3);
   if (use_custom_normals) {
-    loop_normals_.reserve(tris_num * 3);
+    tri_normals_.reserve(tris_num);
   }
 }
 
-bool STLMeshHelper::add_triangle(const float3 &a, const float3 &b, const float3 &c)
+void STLMeshHelper::add_triangle(const float3 &a, const float3 &b, const float3 &c)
 {
-  int v1_id = verts_.index_of_or_add(a);
-  int v2_id = verts_.index_of_or_add(b);
-  int v3_id = verts_.index_of_or_add(c);
-  if ((v1_id == v2_id) || (v1_id == v3_id) || (v2_id == v3_id)) {
-    degenerate_tris_num_++;
-    return false;
-  }
-  if (!tris_.add({v1_id, v2_id, v3_id})) {
-    duplicate_tris_num_++;
-    return false;
-  }
-  return true;
+  corner_positions_.append(a);
+  corner_positions_.append(b);
+  corner_positions_.append(c);
 }
 
 void STLMeshHelper::add_triangle(const float3 &a,
@@ -57,32 +51,256 @@ void STLMeshHelper::add_triangle(const float3 &a,
                                  const float3 &c,
                                  const float3 &custom_normal)
 {
-  if (add_triangle(a, b, c)) {
-    loop_normals_.append_n_times(custom_normal, 3);
+  this->add_triangle(a, b, c);
+  tri_normals_.append(custom_normal);
+}
+
+void STLMeshHelper::add_triangles(const int tris_num,
+                                  MutableSpan<float3> &r_corner_positions,
+                                  MutableSpan<float3> &r_normals)
+{
+  const int64_t corners_start = corner_positions_.size();
+  corner_positions_.resize(corners_start + int64_t(tris_num) * 3);
+  r_corner_positions = corner_positions_.as_mutable_span().drop_front(corners_start);
+  r_normals = {};
+  if (use_custom_normals_) {
+    const int64_t tris_start = tri_normals_.size();
+    tri_normals_.resize(tris_start + tris_num);
+    r_normals = tri_normals_.as_mutable_span().drop_front(tris_start);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Parallel Welding
+ *
+ * Deduplication is parallelized by having multiple hash tables for different subsets of the
+ * keys, like #bke::mesh_calc_edges does. Every table is filled by a separate task, which goes
+ * over all elements in order and only adds those belonging to its table. That way, the first
+ * occurrence of every key is known without any synchronization between the tasks.
+ * \{ */
+
+static int get_parallel_maps_count(const int64_t elements_num)
+{
+  /* Don't use parallelization when the mesh is small. */
+  if (elements_num < 4096) {
+    return 1;
+  }
+  /* The table of every element is computed beforehand, so a task only has to read one byte for
+   * elements of other tables. That makes using more tables than #mesh_calc_edges worthwhile. */
+  const int system_thread_count = BLI_system_thread_count();
+  return power_of_2_min_i(std::min(16, system_thread_count));
+}
+
+/**
+ * Choose the hash table of a key. This uses the high bits of a multiplicative hash, which are
+ * likely to be different from the low bits that choose the slot within a table.
+ */
+static uint8_t parallel_map_index(const uint64_t hash, const uint32_t parallel_mask)
+{
+  return uint8_t(((hash * uint64_t(0x9E3779B97F4A7C15)) >> 32) & parallel_mask);
+}
+
+template<typename HashFn>
+static Array<uint8_t> calc_parallel_map_indices(const int64_t size,
+                                                const uint32_t parallel_mask,
+                                                const HashFn &hash_fn)
+{
+  Array<uint8_t> map_indices(size);
+  threading::parallel_for(IndexRange(size), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      map_indices[i] = parallel_map_index(hash_fn(i), parallel_mask);
+    }
+  });
+  return map_indices;
+}
+
+/**
+ * Merge corners at exactly the same position into one vertex. Vertices are ordered by their
+ * first use, the same as adding the positions to a #VectorSet one after another.
+ *
+ * \return The positions of the new vertices.
+ */
+static Array<float3> weld_equal_positions(const Span<float3> corner_positions,
+                                          MutableSpan<int> r_corner_verts)
+{
+  const int parallel_maps = get_parallel_maps_count(corner_positions.size());
+  BLI_assert(is_power_of_2_i(parallel_maps));
+  const uint32_t parallel_mask = uint32_t(parallel_maps) - 1;
+  const Array<uint8_t> map_indices = calc_parallel_map_indices(
+      corner_positions.size(), parallel_mask, [&](const int64_t corner) {
+        return corner_positions[corner].hash();
+      });
+
+  /* Find the first corner at every position, temporarily stored as the corner's vertex. */
+  Array<Map<float3, int>> first_corner_maps(parallel_maps);
+  threading::parallel_for_each(first_corner_maps, [&](Map<float3, int> &first_corner_map) {
+    const int task_index = &first_corner_map - first_corner_maps.data();
+    /* In a closed triangle mesh, a vertex is used by six corners on average. */
+    first_corner_map.reserve(corner_positions.size() / 6 / parallel_maps);
+    for (const int corner : corner_positions.index_range()) {
+      if (map_indices[corner] == task_index) {
+        r_corner_verts[corner] = first_corner_map.lookup_or_add(corner_positions[corner], corner);
+      }
+    }
+  });
+  threading::parallel_for_each(first_corner_maps,
+                               [](Map<float3, int> &map) { map.clear_and_shrink(); });
+
+  IndexMaskMemory memory;
+  const IndexMask first_corners = IndexMask::from_predicate(
+      corner_positions.index_range(), GrainSize(4096), memory, [&](const int corner) {
+        return r_corner_verts[corner] == corner;
+      });
+
+  Array<float3> vert_positions(first_corners.size());
+  array_utils::gather(corner_positions, first_corners, vert_positions.as_mutable_span());
+
+  first_corners.foreach_index(GrainSize(4096), [&](const int corner, const int vert) {
+    r_corner_verts[corner] = vert;
+  });
+  first_corners.complement(corner_positions.index_range(), memory)
+      .foreach_index(GrainSize(4096), [&](const int corner) {
+        r_corner_verts[corner] = r_corner_verts[r_corner_verts[corner]];
+      });
+
+  return vert_positions;
+}
+
+/**
+ * Merge vertices closer than \a merge_distance into the first vertex within that distance which
+ * is kept. This gives the same result as merging by distance with a KD-tree in index order.
+ *
+ * \param r_vert_map: The new index of every vertex.
+ * \return The positions of the kept vertices.
+ */
+static Array<float3> weld_close_positions(const Span<float3> positions,
+                                          const float merge_distance,
+                                          MutableSpan<int> r_vert_map)
+{
+  Array<int> merge_targets(positions.size(), -1);
+  {
+    const PointHashGrid grid(positions, positions.index_range(), merge_distance);
+    grid.calc_duplicates(merge_distance, merge_targets);
   }
+
+  IndexMaskMemory memory;
+  const IndexMask kept_verts = IndexMask::from_predicate(
+      positions.index_range(), GrainSize(4096), memory, [&](const int vert) {
+        return ELEM(merge_targets[vert], -1, vert);
+      });
+
+  Array<float3> kept_positions(kept_verts.size());
+  array_utils::gather(positions, kept_verts, kept_positions.as_mutable_span());
+
+  kept_verts.foreach_index(GrainSize(4096), [&](const int vert, const int new_vert) {
+    r_vert_map[vert] = new_vert;
+  });
+  kept_verts.complement(positions.index_range(), memory)
+      .foreach_index(GrainSize(4096), [&](const int vert) {
+        r_vert_map[vert] = r_vert_map[merge_targets[vert]];
+      });
+
+  return kept_positions;
+}
+
+/**
+ * Find the triangles to add to the mesh. Degenerate triangles are skipped, and of duplicate
+ * triangles only the first one is used.
+ */
+static IndexMask find_valid_tris(const Span<Triangle> tris,
+                                 IndexMaskMemory &memory,
+                                 int &r_degenerate_tris_num,
+                                 int &r_duplicate_tris_num)
+{
+  const IndexMask non_degenerate_tris = IndexMask::from_predicate(
+      tris.index_range(), GrainSize(4096), memory, [&](const int i) {
+        const Triangle &tri = tris[i];
+        return (tri.v1 != tri.v2) && (tri.v1 != tri.v3) && (tri.v2 != tri.v3);
+      });
+  r_degenerate_tris_num = int(tris.size() - non_degenerate_tris.size());
+
+  const int parallel_maps = get_parallel_maps_count(tris.size());
+  BLI_assert(is_power_of_2_i(parallel_maps));
+  const uint32_t parallel_mask = uint32_t(parallel_maps) - 1;
+  const Array<uint8_t> map_indices = calc_parallel_map_indices(
+      tris.size(), parallel_mask, [&](const int64_t i) { return tris[i].hash(); });
+
+  Array<bool> is_duplicate(tris.size(), false);
+  Array<Set<Triangle>> tri_sets(parallel_maps);
+  threading::parallel_for_each(tri_sets, [&](Set<Triangle> &tri_set) {
+    const int task_index = &tri_set - tri_sets.data();
+    tri_set.reserve(non_degenerate_tris.size() / parallel_maps);
+    non_degenerate_tris.foreach_index([&](const int i) {
+      if (map_indices[i] == task_index && !tri_set.add(tris[i])) {
+        is_duplicate[i] = true;
+      }
+    });
+  });
+  threading::parallel_for_each(tri_sets, [](Set<Triangle> &set) { set.clear_and_shrink(); });
+
+  const IndexMask valid_tris = IndexMask::from_predicate(
+      non_degenerate_tris, GrainSize(4096), memory, [&](const int i) {
+        return !is_duplicate[i];
+      });
+  r_duplicate_tris_num = int(non_degenerate_tris.size() - valid_tris.size());
+  return valid_tris;
 }
 
+/** \} */
+
 Mesh *STLMeshHelper::to_mesh()
 {
-  if (degenerate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << degenerate_tris_num_ << " degenerate triangles were removed"
+  const bool use_custom_normals = use_custom_normals_ &&
+                                  tri_normals_.size() * 3 == corner_positions_.size();
+
+  Array<int> corner_verts(corner_positions_.size());
+  Array<float3> vert_positions = weld_equal_positions(corner_positions_, corner_verts);
+  corner_positions_.clear_and_shrink();
+
+  if (merge_distance_ > 0.0f) {
+    Array<int> vert_map(vert_positions.size());
+    vert_positions = weld_close_positions(vert_positions, merge_distance_, vert_map);
+    threading::parallel_for(corner_verts.index_range(), 4096, [&](const IndexRange range) {
+      for (const int corner : range) {
+        corner_verts[corner] = vert_map[corner_verts[corner]];
+      }
+    });
+  }
+
+  const Span<Triangle> tris = corner_verts.as_span().cast<Triangle>();
+  int degenerate_tris_num;
+  int duplicate_tris_num;
+  IndexMaskMemory memory;
+  const IndexMask valid_tris = find_valid_tris(
+      tris, memory, degenerate_tris_num, duplicate_tris_num);
+
+  if (degenerate_tris_num > 0) {
+    std::cout << "STL Importer: " << degenerate_tris_num << " degenerate triangles were removed"
               << std::endl;
   }
-  if (duplicate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << duplicate_tris_num_ << " duplicate triangles were removed"
+  if (duplicate_tris_num > 0) {
+    std::cout << "STL Importer: " << duplicate_tris_num << " duplicate triangles were removed"
               << std::endl;
   }
 
-  Mesh *mesh = BKE_mesh_new_nomain(verts_.size(), 0, tris_.size(), tris_.size() * 3);
-  mesh->vert_positions_for_write().copy_from(verts_);
+  const int tris_num = int(valid_tris.size());
+  Mesh *mesh = BKE_mesh_new_nomain(vert_positions.size(), 0, tris_num, tris_num * 3);
+  array_utils::copy(vert_positions.as_span(), mesh->vert_positions_for_write());
   offset_indices::fill_constant_group_size(3, 0, mesh->face_offsets_for_write());
-  array_utils::copy(tris_.as_span().cast<int>(), mesh->corner_verts_for_write());
+  MutableSpan<Triangle> mesh_tris = mesh->corner_verts_for_write().cast<Triangle>();
+  Array<float3> corner_normals(use_custom_normals ? tris_num * 3 : 0);
+  valid_tris.foreach_index(GrainSize(4096), [&](const int tri, const int face) {
+    mesh_tris[face] = tris[tri];
+    if (use_custom_normals) {
+      corner_normals.as_mutable_span().slice(face * 3, 3).fill(tri_normals_[tri]);
+    }
+  });
 
   /* NOTE: edges must be calculated first before setting custom normals. */
   bke::mesh_calc_edges(*mesh, false, false);
 
-  if (use_custom_normals_ && loop_normals_.size() == mesh->corners_num) {
-    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(loop_normals_.data()));
+  if (use_custom_normals) {
+    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(corner_normals.data()));
   }
 
   return mesh;
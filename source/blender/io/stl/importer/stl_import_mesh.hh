@@ -11,9 +11,8 @@
 #include <cstdint>
 
 #include "BLI_math_vector_types.hh"
-#include "BLI_set.hh"
+#include "BLI_span.hh"
 #include "BLI_vector.hh"
-#include "BLI_vector_set.hh"
 
 #include "DNA_mesh_types.h"
 
@@ -47,26 +46,43 @@ class Triangle {
   }
 };
 
+/**
+ * Collects the triangles of an STL file and turns them into a mesh. Triangles are only stored
+ * while reading; vertex welding and the removal of degenerate and duplicate triangles happen in
+ * #to_mesh, where they are done in parallel.
+ */
 class STLMeshHelper {
  private:
-  VectorSet<float3> verts_;
-  VectorSet<Triangle> tris_;
-  Vector<float3> loop_normals_;
-  int degenerate_tris_num_;
-  int duplicate_tris_num_;
+  /** Positions of the three corners of every triangle, in file order. */
+  Vector<float3> corner_positions_;
+  /** Facet normal of every triangle, only used with custom normals. */
+  Vector<float3> tri_normals_;
   const bool use_custom_normals_;
+  /**
+   * Vertices closer than this are merged into one. With zero, only vertices at exactly the same
+   * position are merged.
+   */
+  const float merge_distance_;
 
  public:
-  STLMeshHelper(int tris_num, bool use_custom_normals);
+  STLMeshHelper(int tris_num, bool use_custom_normals, float merge_distance);
 
-  /* Creates a new triangle from specified vertex locations,
-   * duplicate vertices and triangles are merged.
+  /* Adds a new triangle from specified vertex locations,
+   * duplicate vertices and triangles are merged in #to_mesh.
    */
-  bool add_triangle(const float3 &a, const float3 &b, const float3 &c);
+  void add_triangle(const float3 &a, const float3 &b, const float3 &c);
   void add_triangle(const float3 &a,
                     const float3 &b,
                     const float3 &c,
                     const float3 &custom_normal);
+  /**
+   * Adds \a tris_num triangles at once, their corner positions and normals are filled in by the
+   * caller afterwards, possibly from multiple threads. \a r_normals is empty when custom normals
+   * are not used.
+   */
+  void add_triangles(int tris_num,
+                     MutableSpan<float3> &r_corner_positions,
+                     MutableSpan<float3> &r_normals);
   Mesh *to_mesh();
 };
 
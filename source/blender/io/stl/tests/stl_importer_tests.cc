@@ -4,6 +4,7 @@
 
 #include "tests/blendfile_loading_base_test.h"
 
+#include "BKE_lib_id.hh"
 #include "BKE_mesh.hh"
 #include "BKE_object.hh"
 
@@ -16,6 +17,8 @@
 #include "DEG_depsgraph_query.hh"
 
 #include "stl_import.hh"
+#include "stl_import_ascii_reader.hh"
+#include "stl_import_mesh.hh"
 
 namespace blender::io::stl {
 
@@ -125,4 +128,163 @@ TEST_F(stl_importer_test, non_uniform_scale)
   import_and_check("non_uniform_scale.stl", expect);
 }
 
+TEST_F(stl_importer_test, merge_distance_separate_verts)
+{
+  /* Vertices of the cube are much further apart than the merge distance. */
+  params.merge_distance = 0.001f;
+  Expectation expect = {8, 18, 12, 36, float3(1, 1, 1), float3(1, -1, 1)};
+  import_and_check("all_quads.stl", expect);
+}
+
+/** Add a triangle of the given positions for every three positions. */
+static Mesh *mesh_from_corner_positions(const Span<float3> positions, const float merge_distance)
+{
+  STLMeshHelper helper(int(positions.size() / 3), false, merge_distance);
+  for (const int tri : IndexRange(positions.size() / 3)) {
+    helper.add_triangle(positions[tri * 3], positions[tri * 3 + 1], positions[tri * 3 + 2]);
+  }
+  return helper.to_mesh();
+}
+
+TEST_F(stl_importer_test, weld_equal_positions)
+{
+  /* Two triangles sharing an edge, a duplicate of the first one and a degenerate one. */
+  const Array<float3> positions = {float3(0, 0, 0),
+                                   float3(1, 0, 0),
+                                   float3(0, 1, 0),
+                                   float3(1, 0, 0),
+                                   float3(1, 1, 0),
+                                   float3(0, 1, 0),
+                                   float3(1, 0, 0),
+                                   float3(0, 1, 0),
+                                   float3(0, 0, 0),
+                                   float3(0, 0, 0),
+                                   float3(0, 0, 0),
+                                   float3(1, 1, 0)};
+  Mesh *mesh = mesh_from_corner_positions(positions, 0.0f);
+  EXPECT_EQ(mesh->verts_num, 4);
+  EXPECT_EQ(mesh->faces_num, 2);
+  EXPECT_EQ(mesh->edges_num, 5);
+  /* Vertices are ordered by their first use. */
+  EXPECT_EQ(mesh->vert_positions(),
+            Span<float3>({float3(0, 0, 0), float3(1, 0, 0), float3(0, 1, 0), float3(1, 1, 0)}));
+  EXPECT_EQ(mesh->corner_verts(), Span<int>({0, 1, 2, 1, 3, 2}));
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(stl_importer_test, weld_close_positions)
+{
+  /* The shared edge of the second triangle is slightly moved. */
+  const Array<float3> positions = {float3(0, 0, 0),
+                                   float3(1, 0, 0),
+                                   float3(0, 1, 0),
+                                   float3(1.001f, 0, 0),
+                                   float3(1, 1, 0),
+                                   float3(0, 1.001f, 0)};
+  {
+    Mesh *mesh = mesh_from_corner_positions(positions, 0.0f);
+    EXPECT_EQ(mesh->verts_num, 6);
+    EXPECT_EQ(mesh->faces_num, 2);
+    BKE_id_free(nullptr, mesh);
+  }
+  {
+    Mesh *mesh = mesh_from_corner_positions(positions, 0.01f);
+    EXPECT_EQ(mesh->verts_num, 4);
+    EXPECT_EQ(mesh->faces_num, 2);
+    EXPECT_EQ(mesh->edges_num, 5);
+    const Array<float3> expected_positions = {
+        float3(0, 0, 0), float3(1, 0, 0), float3(0, 1, 0), float3(1, 1, 0)};
+    EXPECT_EQ(mesh->vert_positions(), expected_positions.as_span());
+    EXPECT_EQ(mesh->corner_verts(), Span<int>({0, 1, 2, 1, 3, 2}));
+    BKE_id_free(nullptr, mesh);
+  }
+}
+
+TEST_F(stl_importer_test, weld_close_positions_no_chains)
+{
+  /* The second vertex is merged into the first one, the third one is only close to the second
+   * vertex, so it is kept, the same as when merging by distance. */
+  const Array<float3> positions = {float3(0, 0, 0),
+                                   float3(0.008f, 0, 0),
+                                   float3(0.016f, 0, 0),
+                                   float3(0, 1, 0),
+                                   float3(0.016f, 0, 0),
+                                   float3(0, 0, 1)};
+  Mesh *mesh = mesh_from_corner_positions(positions, 0.01f);
+  EXPECT_EQ(mesh->verts_num, 4);
+  EXPECT_EQ(
+      mesh->vert_positions(),
+      Span<float3>({float3(0, 0, 0), float3(0.016f, 0, 0), float3(0, 1, 0), float3(0, 0, 1)}));
+  /* The first triangle has become an edge. */
+  EXPECT_EQ(mesh->faces_num, 1);
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(stl_importer_test, weld_close_positions_grid)
+{
+  /* A grid of separate triangles with the corners of each grid vertex slightly moved apart.
+   * Large enough to do the duplicate search on multiple threads. */
+  const int size = 100;
+  const float spacing = 0.01f;
+  const auto grid_position = [&](const int x, const int y, const int corner) {
+    return float3(x * spacing + corner * 1e-6f, y * spacing, 0.0f);
+  };
+  Vector<float3> positions;
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      positions.extend({grid_position(x, y, 0),
+                        grid_position(x + 1, y, 1),
+                        grid_position(x + 1, y + 1, 2),
+                        grid_position(x, y, 3),
+                        grid_position(x + 1, y + 1, 4),
+                        grid_position(x, y + 1, 5)});
+    }
+  }
+  {
+    Mesh *mesh = mesh_from_corner_positions(positions, 0.0f);
+    EXPECT_EQ(mesh->verts_num, size * size * 6);
+    BKE_id_free(nullptr, mesh);
+  }
+  {
+    Mesh *mesh = mesh_from_corner_positions(positions, 1e-5f);
+    EXPECT_EQ(mesh->verts_num, (size + 1) * (size + 1));
+    EXPECT_EQ(mesh->faces_num, size * size * 2);
+    EXPECT_EQ(mesh->edges_num, size * (size + 1) * 2 + size * size);
+    BKE_id_free(nullptr, mesh);
+  }
+}
+
+TEST_F(stl_importer_test, ascii_merge_distance)
+{
+  const StringRef stl =
+      "solid test\n"
+      "facet normal 0 0 1\n"
+      "  outer loop\n"
+      "    vertex 0 0 0\n"
+      "    vertex 1 0 0\n"
+      "    vertex 0 1 0\n"
+      "  endloop\n"
+      "endfacet\n"
+      "facet normal 0 0 1\n"
+      "  outer loop\n"
+      "    vertex 1.0001 0 0\n"
+      "    vertex 1 1 0\n"
+      "    vertex 0 1.0001 0\n"
+      "  endloop\n"
+      "endfacet\n"
+      "endsolid test\n";
+  const Span<char> data(stl.data(), stl.size());
+  {
+    Mesh *mesh = read_stl_ascii(data, false, 0.0f);
+    EXPECT_EQ(mesh->verts_num, 6);
+    BKE_id_free(nullptr, mesh);
+  }
+  {
+    Mesh *mesh = read_stl_ascii(data, false, 0.001f);
+    EXPECT_EQ(mesh->verts_num, 4);
+    EXPECT_EQ(mesh->faces_num, 2);
+    BKE_id_free(nullptr, mesh);
+  }
+}
+
 }  // namespace blender::io::stl
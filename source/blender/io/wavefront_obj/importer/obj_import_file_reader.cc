@@ -13,6 +13,7 @@
 #include "BLI_math_vector.h"
 #include "BLI_string.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
 #include "BLI_vector.hh"
 
 #include "obj_export_mtl.hh"
@@ -70,11 +71,72 @@ static Geometry *create_geometry(Geometry *const prev_geometry,
   return new_geometry();
 }
 
-static void geom_add_vertex(const char *p, const char *end, GlobalVertices &r_global_vertices)
+/**
+ * The lines of each read buffer are split into chunks that get parsed in parallel. Vertex data
+ * and faces (the bulk of any large file) are parsed on the worker threads. All other lines either
+ * change or depend on the sequential parser state (current object, material, group etc.), so they
+ * are only recorded and get processed afterwards in file order.
+ */
+struct DeferredLine {
+  /** Line contents, with leading white-space dropped. */
+  StringRef line;
+  /** Number of faces of the chunk that come before this line. */
+  int face_index;
+  /** Number of vertex positions in the whole file that come before this line. */
+  int vertex_count;
+};
+
+struct ChunkFace {
+  int start_index;
+  int corner_count;
+  bool is_valid;
+};
+
+struct OBJChunk {
+  StringRef text;
+
+  /** Copy of the chunk text, only used when it contains line continuations. */
+  Array<char> fixed_text;
+
+  /* Filled by the counting pass. */
+  int vertex_count = 0;
+  int uv_count = 0;
+  int normal_count = 0;
+
+  /* Indices of the first vertex position, UV and normal of the chunk in the whole file. */
+  int vertex_offset = 0;
+  int uv_offset = 0;
+  int normal_offset = 0;
+
+  /* Filled by the parsing pass. */
+  Vector<FaceCorner> face_corners;
+  Vector<ChunkFace> faces;
+  Vector<DeferredLine> deferred_lines;
+  /** Vertex colors, with vertex indices already in the whole file space. */
+  Vector<GlobalVertices::VertexColorsBlock> vertex_colors;
+  /** Number of vertices before the line that started the first vertex colors block. */
+  int first_colors_vertex_count = -1;
+};
+
+/**
+ * State variables: once set, they remain the same for the remaining elements in the object.
+ */
+struct ParserState {
+  Geometry *curr_geom = nullptr;
+  bool shaded_smooth = false;
+  string group_name;
+  int group_index = -1;
+  string material_name;
+  int material_index = -1;
+};
+
+static void geom_add_vertex(const char *p,
+                            const char *end,
+                            const int vertex_index,
+                            MutableSpan<float3> r_vertices,
+                            Vector<GlobalVertices::VertexColorsBlock> &r_vertex_colors)
 {
-  float3 vert;
-  p = parse_floats(p, end, 0.0f, vert, 3);
-  r_global_vertices.vertices.append(vert);
+  p = parse_floats(p, end, 0.0f, r_vertices[vertex_index], 3);
   /* OBJ extension: `xyzrgb` vertex colors, when the vertex position
    * is followed by 3 more RGB color components. See
    * http://paulbourke.net/dataformats/obj/colour.html */
@@ -85,14 +147,14 @@ static void geom_add_vertex(const char *p, const char *end, GlobalVertices &r_gl
       float3 linear;
       srgb_to_linearrgb_v3_v3(linear, srgb);
 
-      auto &blocks = r_global_vertices.vertex_colors;
+      auto &blocks = r_vertex_colors;
       /* If we don't have vertex colors yet, or the previous vertex
        * was without color, we need to start a new vertex colors block. */
-      if (blocks.is_empty() || (blocks.last().start_vertex_index + blocks.last().colors.size() !=
-                                r_global_vertices.vertices.size() - 1))
+      if (blocks.is_empty() ||
+          (blocks.last().start_vertex_index + blocks.last().colors.size() != vertex_index))
       {
         GlobalVertices::VertexColorsBlock block;
-        block.start_vertex_index = r_global_vertices.vertices.size() - 1;
+        block.start_vertex_index = vertex_index;
         blocks.append(block);
       }
       blocks.last().colors.append(linear);
@@ -100,7 +162,10 @@ static void geom_add_vertex(const char *p, const char *end, GlobalVertices &r_gl
   }
 }
 
-static void geom_add_mrgb_colors(const char *p, const char *end, GlobalVertices &r_global_vertices)
+static void geom_add_mrgb_colors(const char *p,
+                                 const char *end,
+                                 const int vertex_count,
+                                 Vector<GlobalVertices::VertexColorsBlock> &r_vertex_colors)
 {
   /* MRGB color extension, in the form of
    * "#MRGB MMRRGGBBMMRRGGBB ..."
@@ -121,14 +186,14 @@ static void geom_add_mrgb_colors(const char *p, const char *end, GlobalVertices
     float linear[4];
     srgb_to_linearrgb_uchar4(linear, srgb);
 
-    auto &blocks = r_global_vertices.vertex_colors;
+    auto &blocks = r_vertex_colors;
     /* If we don't have vertex colors yet, or the previous vertex
      * was without color, we need to start a new vertex colors block. */
-    if (blocks.is_empty() || (blocks.last().start_vertex_index + blocks.last().colors.size() !=
-                              r_global_vertices.vertices.size()))
+    if (blocks.is_empty() ||
+        (blocks.last().start_vertex_index + blocks.last().colors.size() != vertex_count))
     {
       GlobalVertices::VertexColorsBlock block;
-      block.start_vertex_index = r_global_vertices.vertices.size();
+      block.start_vertex_index = vertex_count;
       blocks.append(block);
     }
     blocks.last().colors.append({linear[0], linear[1], linear[2]});
@@ -140,24 +205,18 @@ static void geom_add_mrgb_colors(const char *p, const char *end, GlobalVertices
   }
 }
 
-static void geom_add_vertex_normal(const char *p,
-                                   const char *end,
-                                   GlobalVertices &r_global_vertices)
+static void geom_add_vertex_normal(const char *p, const char *end, float3 &r_normal)
 {
-  float3 normal;
-  parse_floats(p, end, 0.0f, normal, 3);
+  parse_floats(p, end, 0.0f, r_normal, 3);
   /* Normals can be printed with only several digits in the file,
    * making them ever-so-slightly non unit length. Make sure they are
    * normalized. */
-  normalize_v3(normal);
-  r_global_vertices.vert_normals.append(normal);
+  normalize_v3(r_normal);
 }
 
-static void geom_add_uv_vertex(const char *p, const char *end, GlobalVertices &r_global_vertices)
+static void geom_add_uv_vertex(const char *p, const char *end, float2 &r_uv)
 {
-  float2 uv;
-  parse_floats(p, end, 0.0f, uv, 2);
-  r_global_vertices.uv_vertices.append(uv);
+  parse_floats(p, end, 0.0f, r_uv, 2);
 }
 
 /**
@@ -192,11 +251,11 @@ static const char *parse_vertex_index(const char *p, const char *end, size_t n_e
 static void geom_add_polyline(Geometry *geom,
                               const char *p,
                               const char *end,
-                              GlobalVertices &r_global_vertices)
+                              const int vertex_count)
 {
   int last_vertex_index;
   p = drop_whitespace(p, end);
-  p = parse_vertex_index(p, end, r_global_vertices.vertices.size(), last_vertex_index);
+  p = parse_vertex_index(p, end, vertex_count, last_vertex_index);
 
   if (last_vertex_index == INT32_MAX) {
     fprintf(stderr, "Skipping invalid OBJ polyline.\n");
@@ -212,7 +271,7 @@ static void geom_add_polyline(Geometry *geom,
     /* Skip whitespace to get to the next vertex. */
     p = drop_whitespace(p, end);
 
-    p = parse_vertex_index(p, end, r_global_vertices.vertices.size(), vertex_index);
+    p = parse_vertex_index(p, end, vertex_count, vertex_index);
     if (vertex_index == INT32_MAX) {
       break;
     }
@@ -223,33 +282,29 @@ static void geom_add_polyline(Geometry *geom,
   }
 }
 
-static void geom_add_polygon(Geometry *geom,
-                             const char *p,
-                             const char *end,
-                             const GlobalVertices &global_vertices,
-                             const int material_index,
-                             const int group_index,
-                             const bool shaded_smooth)
+/**
+ * Parse a face into the chunk's face list. The vertex, UV and normal counts are the numbers of
+ * elements in the whole file that come before the face line.
+ */
+static void parse_face(const char *p,
+                       const char *end,
+                       const int vertex_count,
+                       const int uv_count,
+                       const int normal_count,
+                       OBJChunk &r_chunk)
 {
-  FaceElem curr_face;
-  curr_face.shaded_smooth = shaded_smooth;
-  curr_face.material_index = material_index;
-  if (group_index >= 0) {
-    curr_face.vertex_group_index = group_index;
-    geom->has_vertex_groups_ = true;
-  }
+  ChunkFace face;
+  face.start_index = r_chunk.face_corners.size();
+  face.corner_count = 0;
+  face.is_valid = true;
 
-  const int orig_corners_size = geom->face_corners_.size();
-  curr_face.start_index_ = orig_corners_size;
-
-  bool face_valid = true;
   p = drop_whitespace(p, end);
-  while (p < end && face_valid) {
+  while (p < end && face.is_valid) {
     FaceCorner corner;
     bool got_uv = false, got_normal = false;
     /* Parse vertex index. */
     p = parse_int(p, end, INT32_MAX, corner.vert_index, false);
-    face_valid &= corner.vert_index != INT32_MAX;
+    face.is_valid &= corner.vert_index != INT32_MAX;
     if (p < end && *p == '/') {
       /* Parse UV index. */
       ++p;
@@ -265,47 +320,42 @@ static void geom_add_polygon(Geometry *geom,
       }
     }
     /* Always keep stored indices non-negative and zero-based. */
-    corner.vert_index += corner.vert_index < 0 ? global_vertices.vertices.size() : -1;
-    if (corner.vert_index < 0 || corner.vert_index >= global_vertices.vertices.size()) {
+    corner.vert_index += corner.vert_index < 0 ? vertex_count : -1;
+    if (corner.vert_index < 0 || corner.vert_index >= vertex_count) {
       fprintf(stderr,
               "Invalid vertex index %i (valid range [0, %zu)), ignoring face\n",
               corner.vert_index,
-              size_t(global_vertices.vertices.size()));
-      face_valid = false;
-    }
-    else {
-      geom->track_vertex_index(corner.vert_index);
+              size_t(vertex_count));
+      face.is_valid = false;
+      /* Mark the corner so that its vertex does not get used by the geometry. */
+      corner.vert_index = -1;
     }
     /* Ignore UV index, if the geometry does not have any UVs (#103212). */
-    if (got_uv && !global_vertices.uv_vertices.is_empty()) {
-      corner.uv_vert_index += corner.uv_vert_index < 0 ? global_vertices.uv_vertices.size() : -1;
-      if (corner.uv_vert_index < 0 || corner.uv_vert_index >= global_vertices.uv_vertices.size()) {
+    if (got_uv && uv_count != 0) {
+      corner.uv_vert_index += corner.uv_vert_index < 0 ? uv_count : -1;
+      if (corner.uv_vert_index < 0 || corner.uv_vert_index >= uv_count) {
         fprintf(stderr,
                 "Invalid UV index %i (valid range [0, %zu)), ignoring face\n",
                 corner.uv_vert_index,
-                size_t(global_vertices.uv_vertices.size()));
-        face_valid = false;
+                size_t(uv_count));
+        face.is_valid = false;
       }
     }
     /* Ignore corner normal index, if the geometry does not have any normals.
      * Some obj files out there do have face definitions that refer to normal indices,
      * without any normals being present (#98782). */
-    if (got_normal && !global_vertices.vert_normals.is_empty()) {
-      corner.vertex_normal_index += corner.vertex_normal_index < 0 ?
-                                        global_vertices.vert_normals.size() :
-                                        -1;
-      if (corner.vertex_normal_index < 0 ||
-          corner.vertex_normal_index >= global_vertices.vert_normals.size())
-      {
+    if (got_normal && normal_count != 0) {
+      corner.vertex_normal_index += corner.vertex_normal_index < 0 ? normal_count : -1;
+      if (corner.vertex_normal_index < 0 || corner.vertex_normal_index >= normal_count) {
         fprintf(stderr,
                 "Invalid normal index %i (valid range [0, %zu)), ignoring face\n",
                 corner.vertex_normal_index,
-                size_t(global_vertices.vert_normals.size()));
-        face_valid = false;
+                size_t(normal_count));
+        face.is_valid = false;
       }
     }
-    geom->face_corners_.append(corner);
-    curr_face.corner_count_++;
+    r_chunk.face_corners.append(corner);
+    face.corner_count++;
 
     /* Some files contain extra stuff per face (e.g. 4 indices); skip any remainder (#103441). */
     p = drop_non_whitespace(p, end);
@@ -313,15 +363,57 @@ static void geom_add_polygon(Geometry *geom,
     p = drop_whitespace(p, end);
   }
 
-  if (face_valid) {
+  r_chunk.faces.append(face);
+}
+
+/**
+ * Add already parsed faces of a chunk to the current geometry, using the current parser state.
+ */
+static void geom_add_polygons(const OBJChunk &chunk,
+                              const IndexRange face_range,
+                              ParserState &state)
+{
+  Geometry *geom = state.curr_geom;
+  for (const int face_index : face_range) {
+    const ChunkFace &face = chunk.faces[face_index];
+    const Span<FaceCorner> corners = chunk.face_corners.as_span().slice(face.start_index,
+                                                                        face.corner_count);
+
+    /* If we don't have a material index assigned yet, get one.
+     * It means "usemtl" state came from the previous object. */
+    if (state.material_index == -1 && !state.material_name.empty() &&
+        geom->material_indices_.is_empty())
+    {
+      geom->material_indices_.add_new(state.material_name, 0);
+      geom->material_order_.append(state.material_name);
+      state.material_index = 0;
+    }
+
+    FaceElem curr_face;
+    curr_face.shaded_smooth = state.shaded_smooth;
+    curr_face.material_index = state.material_index;
+    if (state.group_index >= 0) {
+      curr_face.vertex_group_index = state.group_index;
+      geom->has_vertex_groups_ = true;
+    }
+
+    for (const FaceCorner &corner : corners) {
+      if (corner.vert_index >= 0) {
+        geom->track_vertex_index(corner.vert_index);
+      }
+    }
+
+    if (!face.is_valid) {
+      geom->has_invalid_faces_ = true;
+      continue;
+    }
+
+    curr_face.start_index_ = geom->face_corners_.size();
+    curr_face.corner_count_ = face.corner_count;
+    geom->face_corners_.extend(corners);
     geom->face_elements_.append(curr_face);
     geom->total_corner_ += curr_face.corner_count_;
   }
-  else {
-    /* Remove just-added corners for the invalid face. */
-    geom->face_corners_.resize(orig_corners_size);
-    geom->has_invalid_faces_ = true;
-  }
 }
 
 static Geometry *geom_set_curve_type(Geometry *geom,
@@ -348,7 +440,7 @@ static void geom_set_curve_degree(Geometry *geom, const char *p, const char *end
 static void geom_add_curve_vertex_indices(Geometry *geom,
                                           const char *p,
                                           const char *end,
-                                          const GlobalVertices &global_vertices)
+                                          const int vertex_count)
 {
   /* Curve lines always have "0.0" and "1.0", skip over them. */
   float dummy[2];
@@ -361,7 +453,7 @@ static void geom_add_curve_vertex_indices(Geometry *geom,
       return;
     }
     /* Always keep stored indices non-negative and zero-based. */
-    index += index < 0 ? global_vertices.vertices.size() : -1;
+    index += index < 0 ? vertex_count : -1;
     geom->nurbs_element_.curv_indices.append(index);
   }
 }
@@ -438,10 +530,11 @@ static void geom_new_object(const char *p,
 }
 
 OBJParser::OBJParser(const OBJImportParams &import_params, size_t read_buffer_size)
-    : import_params_(import_params), read_buffer_size_(read_buffer_size)
+    : import_params_(import_params),
+      obj_file_(import_params.filepath),
+      read_buffer_size_(read_buffer_size)
 {
-  obj_file_ = BLI_fopen(import_params_.filepath, "rb");
-  if (!obj_file_) {
+  if (!obj_file_.is_open()) {
     fprintf(stderr, "Cannot read from OBJ file:'%s'.\n", import_params_.filepath);
     BKE_reportf(import_params_.reports,
                 RPT_ERROR,
@@ -451,13 +544,6 @@ OBJParser::OBJParser(const OBJImportParams &import_params, size_t read_buffer_si
   }
 }
 
-OBJParser::~OBJParser()
-{
-  if (obj_file_) {
-    fclose(obj_file_);
-  }
-}
-
 /* If line starts with keyword followed by whitespace, returns true and drops it from the line. */
 static bool parse_keyword(const char *&p, const char *end, StringRef keyword)
 {
@@ -493,10 +579,162 @@ static void use_all_vertices_if_no_faces(Geometry *geom,
   }
 }
 
+/**
+ * Whether the newline at the given index ends a line that continues on the next one,
+ * see #fixup_line_continuations.
+ */
+static bool is_line_continuation(const StringRef text, int64_t newline)
+{
+  for (int64_t i = newline - 1; i >= 0; i--) {
+    if (text[i] == '\\') {
+      return true;
+    }
+    if (text[i] > ' ' || text[i] == '\n') {
+      return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * Return the end of the line that contains the given position: the index right after its
+ * newline, or the end of the text. Continued lines are treated as a single line.
+ */
+static int64_t find_line_end(const StringRef text, const int64_t pos)
+{
+  if (pos >= text.size()) {
+    return text.size();
+  }
+  int64_t newline = text.find('\n', std::max<int64_t>(pos - 1, 0));
+  while (newline != StringRef::not_found && is_line_continuation(text, newline)) {
+    newline = text.find('\n', newline + 1);
+  }
+  return newline == StringRef::not_found ? text.size() : newline + 1;
+}
+
+/**
+ * Split whole lines of the input into chunks of roughly `chunk_size` bytes, each one ending
+ * at a line boundary.
+ */
+static void split_into_chunks(StringRef text, const int64_t chunk_size, Vector<OBJChunk> &r_chunks)
+{
+  r_chunks.clear();
+  while (!text.is_empty()) {
+    const int64_t chunk_end = find_line_end(text, chunk_size);
+
+    OBJChunk chunk;
+    chunk.text = text.substr(0, chunk_end);
+    r_chunks.append(std::move(chunk));
+    text = text.drop_prefix(chunk_end);
+  }
+}
+
+/**
+ * Take care of line continuations in the chunk (turn them into spaces), so that the rest of the
+ * parsing code does not need to worry about them anymore. The file memory is read-only, so this
+ * works on a copy of the text, which is only needed for chunks with backslashes at all.
+ */
+static void fixup_chunk_line_continuations(OBJChunk &chunk)
+{
+  if (chunk.text.find('\\') == StringRef::not_found) {
+    return;
+  }
+  chunk.fixed_text.reinitialize(chunk.text.size());
+  memcpy(chunk.fixed_text.data(), chunk.text.data(), chunk.text.size());
+  fixup_line_continuations(chunk.fixed_text.begin(), chunk.fixed_text.end());
+  chunk.text = StringRef(chunk.fixed_text.data(), chunk.fixed_text.size());
+}
+
+/**
+ * Count the vertex data elements in a chunk, so that the global indices of the
+ * elements in all the chunks are known before parsing them.
+ */
+static void count_chunk_elements(OBJChunk &chunk)
+{
+  StringRef text = chunk.text;
+  while (!text.is_empty()) {
+    StringRef line = read_next_line(text);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    if (p == end || *p != 'v') {
+      continue;
+    }
+    if (parse_keyword(p, end, "v")) {
+      chunk.vertex_count++;
+    }
+    else if (parse_keyword(p, end, "vn")) {
+      chunk.normal_count++;
+    }
+    else if (parse_keyword(p, end, "vt")) {
+      chunk.uv_count++;
+    }
+  }
+}
+
+/**
+ * Parse vertex data and faces of a chunk, and record all the other lines for processing them
+ * later in file order. Vertex data is written directly into the already allocated global arrays.
+ */
+static void parse_chunk(OBJChunk &chunk, GlobalVertices &r_global_vertices)
+{
+  MutableSpan<float3> vertices = r_global_vertices.vertices;
+  MutableSpan<float2> uv_vertices = r_global_vertices.uv_vertices;
+  MutableSpan<float3> vert_normals = r_global_vertices.vert_normals;
+
+  int vertex_count = chunk.vertex_offset;
+  int uv_count = chunk.uv_offset;
+  int normal_count = chunk.normal_offset;
+
+  StringRef text = chunk.text;
+  while (!text.is_empty()) {
+    StringRef line = read_next_line(text);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    if (p == end) {
+      continue;
+    }
+    /* Most common things that start with 'v': vertices, normals, UVs. */
+    if (*p == 'v') {
+      if (parse_keyword(p, end, "v")) {
+        geom_add_vertex(p, end, vertex_count, vertices, chunk.vertex_colors);
+        if (chunk.first_colors_vertex_count == -1 && !chunk.vertex_colors.is_empty()) {
+          chunk.first_colors_vertex_count = vertex_count;
+        }
+        vertex_count++;
+      }
+      else if (parse_keyword(p, end, "vn")) {
+        geom_add_vertex_normal(p, end, vert_normals[normal_count]);
+        normal_count++;
+      }
+      else if (parse_keyword(p, end, "vt")) {
+        geom_add_uv_vertex(p, end, uv_vertices[uv_count]);
+        uv_count++;
+      }
+    }
+    /* Faces. */
+    else if (parse_keyword(p, end, "f")) {
+      parse_face(p, end, vertex_count, uv_count, normal_count, chunk);
+    }
+    else if (parse_keyword(p, end, "#MRGB")) {
+      geom_add_mrgb_colors(p, end, vertex_count, chunk.vertex_colors);
+      if (chunk.first_colors_vertex_count == -1 && !chunk.vertex_colors.is_empty()) {
+        chunk.first_colors_vertex_count = vertex_count;
+      }
+    }
+    /* Comments. */
+    else if (*p == '#') {
+      /* Nothing to do. */
+    }
+    else {
+      chunk.deferred_lines.append({StringRef(p, end), int(chunk.faces.size()), vertex_count});
+    }
+  }
+}
+
 void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
                       GlobalVertices &r_global_vertices)
 {
-  if (!obj_file_) {
+  if (!obj_file_.is_open()) {
     return;
   }
 
@@ -505,197 +743,172 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
   STRNCPY(ob_name, BLI_path_basename(import_params_.filepath));
   BLI_path_extension_strip(ob_name);
 
-  Geometry *curr_geom = create_geometry(nullptr, GEOM_MESH, ob_name, r_all_geometries);
-
-  /* State variables: once set, they remain the same for the remaining
-   * elements in the object. */
-  bool state_shaded_smooth = false;
-  string state_group_name;
-  int state_group_index = -1;
-  string state_material_name;
-  int state_material_index = -1;
-
-  /* Read the input file in chunks. We need up to twice the possible chunk size,
-   * to possibly store remainder of the previous input line that got broken mid-chunk. */
-  Array<char> buffer(read_buffer_size_ * 2);
+  ParserState state;
+  state.curr_geom = create_geometry(nullptr, GEOM_MESH, ob_name, r_all_geometries);
 
-  size_t buffer_offset = 0;
-  size_t line_number = 0;
-  while (true) {
-    /* Read a chunk of input from the file. */
-    size_t bytes_read = fread(buffer.data() + buffer_offset, 1, read_buffer_size_, obj_file_);
-    if (bytes_read == 0 && buffer_offset == 0) {
-      break; /* No more data to read. */
+  /* Process a line that was deferred by #parse_chunk, updating the parser state. */
+  auto process_deferred_line = [&](const DeferredLine &deferred) {
+    const char *p = deferred.line.begin(), *end = deferred.line.end();
+    /* Polylines. */
+    if (parse_keyword(p, end, "l")) {
+      geom_add_polyline(state.curr_geom, p, end, deferred.vertex_count);
     }
-
-    /* Take care of line continuations now (turn them into spaces);
-     * the rest of the parsing code does not need to worry about them anymore. */
-    fixup_line_continuations(buffer.data() + buffer_offset,
-                             buffer.data() + buffer_offset + bytes_read);
-
-    /* Ensure buffer ends in a newline. */
-    if (bytes_read < read_buffer_size_) {
-      if (bytes_read == 0 || buffer[buffer_offset + bytes_read - 1] != '\n') {
-        buffer[buffer_offset + bytes_read] = '\n';
-        bytes_read++;
+    /* Objects. */
+    else if (parse_keyword(p, end, "o")) {
+      if (import_params_.use_split_objects) {
+        geom_new_object(p,
+                        end,
+                        state.shaded_smooth,
+                        state.group_name,
+                        state.material_index,
+                        state.curr_geom,
+                        r_all_geometries);
       }
     }
-
-    size_t buffer_end = buffer_offset + bytes_read;
-    if (buffer_end == 0) {
-      break;
+    /* Groups. */
+    else if (parse_keyword(p, end, "g")) {
+      if (import_params_.use_split_groups) {
+        geom_new_object(p,
+                        end,
+                        state.shaded_smooth,
+                        state.group_name,
+                        state.material_index,
+                        state.curr_geom,
+                        r_all_geometries);
+      }
+      else {
+        Geometry *geom = state.curr_geom;
+        geom_update_group(StringRef(p, end).trim(), state.group_name);
+        int new_index = geom->group_indices_.size();
+        state.group_index = geom->group_indices_.lookup_or_add(state.group_name, new_index);
+        if (new_index == state.group_index) {
+          geom->group_order_.append(state.group_name);
+        }
+      }
     }
-
-    /* Find last newline. */
-    size_t last_nl = buffer_end;
-    while (last_nl > 0) {
-      --last_nl;
-      if (buffer[last_nl] == '\n') {
-        break;
+    /* Smoothing groups. */
+    else if (parse_keyword(p, end, "s")) {
+      geom_update_smooth_group(p, end, state.shaded_smooth);
+    }
+    /* Materials and their libraries. */
+    else if (parse_keyword(p, end, "usemtl")) {
+      Geometry *geom = state.curr_geom;
+      state.material_name = StringRef(p, end).trim();
+      int new_mat_index = geom->material_indices_.size();
+      state.material_index = geom->material_indices_.lookup_or_add(state.material_name,
+                                                                   new_mat_index);
+      if (new_mat_index == state.material_index) {
+        geom->material_order_.append(state.material_name);
       }
     }
-    if (buffer[last_nl] != '\n') {
-      /* Whole line did not fit into our read buffer. Warn and exit. */
-      fprintf(stderr,
-              "OBJ file contains a line #%zu that is too long (max. length %zu)\n",
-              line_number,
-              read_buffer_size_);
-      break;
+    else if (parse_keyword(p, end, "mtllib")) {
+      add_mtl_library(StringRef(p, end).trim());
     }
-    ++last_nl;
-
-    /* Parse the buffer (until last newline) that we have so far,
-     * line by line. */
-    StringRef buffer_str{buffer.data(), int64_t(last_nl)};
-    while (!buffer_str.is_empty()) {
-      StringRef line = read_next_line(buffer_str);
-      const char *p = line.begin(), *end = line.end();
-      p = drop_whitespace(p, end);
-      ++line_number;
-      if (p == end) {
-        continue;
-      }
-      /* Most common things that start with 'v': vertices, normals, UVs. */
-      if (*p == 'v') {
-        if (parse_keyword(p, end, "v")) {
-          geom_add_vertex(p, end, r_global_vertices);
-        }
-        else if (parse_keyword(p, end, "vn")) {
-          geom_add_vertex_normal(p, end, r_global_vertices);
-        }
-        else if (parse_keyword(p, end, "vt")) {
-          geom_add_uv_vertex(p, end, r_global_vertices);
-        }
+    /* Curve related things. */
+    else if (parse_keyword(p, end, "cstype")) {
+      state.curr_geom = geom_set_curve_type(
+          state.curr_geom, p, end, state.group_name, r_all_geometries);
+    }
+    else if (parse_keyword(p, end, "deg")) {
+      geom_set_curve_degree(state.curr_geom, p, end);
+    }
+    else if (parse_keyword(p, end, "curv")) {
+      geom_add_curve_vertex_indices(state.curr_geom, p, end, deferred.vertex_count);
+    }
+    else if (parse_keyword(p, end, "parm")) {
+      geom_add_curve_parameters(state.curr_geom, p, end);
+    }
+    else if (StringRef(p, end).startswith("end")) {
+      /* End of curve definition, nothing else to do. */
+    }
+    else {
+      std::cout << "OBJ element not recognized: '" << std::string(p, end) << "'" << std::endl;
+    }
+  };
+
+  /* Process the file in batches of whole lines, which bounds the memory used for the parsed
+   * chunk data before it gets merged into the geometries. Each batch is split into a fixed
+   * number of parsing chunks, to give the task scheduler some room for balancing lines of
+   * varying cost. */
+  const StringRef file_text(obj_file_.data().data(), obj_file_.size());
+  const int64_t parse_chunk_size = std::max<int64_t>(read_buffer_size_ / 16, 1);
+  Vector<OBJChunk> chunks;
+
+  int64_t batch_start = 0;
+  while (batch_start < file_text.size()) {
+    const int64_t batch_end = find_line_end(file_text, batch_start + read_buffer_size_);
+    const StringRef batch_text = file_text.substr(batch_start, batch_end - batch_start);
+    batch_start = batch_end;
+
+    /* First count the vertex data in each chunk, so that all chunks know where their elements go
+     * in the global arrays. */
+    split_into_chunks(batch_text, parse_chunk_size, chunks);
+    threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        fixup_chunk_line_continuations(chunks[i]);
+        count_chunk_elements(chunks[i]);
       }
-      /* Faces. */
-      else if (parse_keyword(p, end, "f")) {
-        /* If we don't have a material index assigned yet, get one.
-         * It means "usemtl" state came from the previous object. */
-        if (state_material_index == -1 && !state_material_name.empty() &&
-            curr_geom->material_indices_.is_empty())
-        {
-          curr_geom->material_indices_.add_new(state_material_name, 0);
-          curr_geom->material_order_.append(state_material_name);
-          state_material_index = 0;
-        }
+    });
+
+    int vertex_offset = r_global_vertices.vertices.size();
+    int uv_offset = r_global_vertices.uv_vertices.size();
+    int normal_offset = r_global_vertices.vert_normals.size();
+    for (OBJChunk &chunk : chunks) {
+      chunk.vertex_offset = vertex_offset;
+      chunk.uv_offset = uv_offset;
+      chunk.normal_offset = normal_offset;
+      vertex_offset += chunk.vertex_count;
+      uv_offset += chunk.uv_count;
+      normal_offset += chunk.normal_count;
+    }
+    r_global_vertices.vertices.resize(vertex_offset);
+    r_global_vertices.uv_vertices.resize(uv_offset);
+    r_global_vertices.vert_normals.resize(normal_offset);
 
-        geom_add_polygon(curr_geom,
-                         p,
-                         end,
-                         r_global_vertices,
-                         state_material_index,
-                         state_group_index,
-                         state_shaded_smooth);
-      }
-      /* Faces. */
-      else if (parse_keyword(p, end, "l")) {
-        geom_add_polyline(curr_geom, p, end, r_global_vertices);
-      }
-      /* Objects. */
-      else if (parse_keyword(p, end, "o")) {
-        if (import_params_.use_split_objects) {
-          geom_new_object(p,
-                          end,
-                          state_shaded_smooth,
-                          state_group_name,
-                          state_material_index,
-                          curr_geom,
-                          r_all_geometries);
-        }
+    threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        parse_chunk(chunks[i], r_global_vertices);
       }
-      /* Groups. */
-      else if (parse_keyword(p, end, "g")) {
-        if (import_params_.use_split_groups) {
-          geom_new_object(p,
-                          end,
-                          state_shaded_smooth,
-                          state_group_name,
-                          state_material_index,
-                          curr_geom,
-                          r_all_geometries);
-        }
-        else {
-          geom_update_group(StringRef(p, end).trim(), state_group_name);
-          int new_index = curr_geom->group_indices_.size();
-          state_group_index = curr_geom->group_indices_.lookup_or_add(state_group_name, new_index);
-          if (new_index == state_group_index) {
-            curr_geom->group_order_.append(state_group_name);
+    });
+
+    /* Merge the parsed chunks in file order, applying the deferred lines in between faces. */
+    for (OBJChunk &chunk : chunks) {
+      auto &blocks = r_global_vertices.vertex_colors;
+      for (const int i : chunk.vertex_colors.index_range()) {
+        GlobalVertices::VertexColorsBlock &block = chunk.vertex_colors[i];
+        /* The first block might continue the last one of the previous chunk. Extend it the same
+         * way #geom_add_vertex and #geom_add_mrgb_colors would have, had they seen it: that
+         * includes moving its start back by the number of MRGB colors the block got. */
+        if (i == 0 && !blocks.is_empty()) {
+          GlobalVertices::VertexColorsBlock &last = blocks.last();
+          if (last.start_vertex_index + last.colors.size() == chunk.first_colors_vertex_count) {
+            last.start_vertex_index -= chunk.first_colors_vertex_count - block.start_vertex_index;
+            last.colors.extend(block.colors);
+            continue;
           }
         }
+        blocks.append(std::move(block));
       }
-      /* Smoothing groups. */
-      else if (parse_keyword(p, end, "s")) {
-        geom_update_smooth_group(p, end, state_shaded_smooth);
-      }
-      /* Materials and their libraries. */
-      else if (parse_keyword(p, end, "usemtl")) {
-        state_material_name = StringRef(p, end).trim();
-        int new_mat_index = curr_geom->material_indices_.size();
-        state_material_index = curr_geom->material_indices_.lookup_or_add(state_material_name,
-                                                                          new_mat_index);
-        if (new_mat_index == state_material_index) {
-          curr_geom->material_order_.append(state_material_name);
-        }
-      }
-      else if (parse_keyword(p, end, "mtllib")) {
-        add_mtl_library(StringRef(p, end).trim());
-      }
-      else if (parse_keyword(p, end, "#MRGB")) {
-        geom_add_mrgb_colors(p, end, r_global_vertices);
-      }
-      /* Comments. */
-      else if (*p == '#') {
-        /* Nothing to do. */
-      }
-      /* Curve related things. */
-      else if (parse_keyword(p, end, "cstype")) {
-        curr_geom = geom_set_curve_type(curr_geom, p, end, state_group_name, r_all_geometries);
-      }
-      else if (parse_keyword(p, end, "deg")) {
-        geom_set_curve_degree(curr_geom, p, end);
-      }
-      else if (parse_keyword(p, end, "curv")) {
-        geom_add_curve_vertex_indices(curr_geom, p, end, r_global_vertices);
-      }
-      else if (parse_keyword(p, end, "parm")) {
-        geom_add_curve_parameters(curr_geom, p, end);
-      }
-      else if (StringRef(p, end).startswith("end")) {
-        /* End of curve definition, nothing else to do. */
-      }
-      else {
-        std::cout << "OBJ element not recognized: '" << std::string(p, end) << "'" << std::endl;
+
+      int face_index = 0;
+      for (const DeferredLine &deferred : chunk.deferred_lines) {
+        geom_add_polygons(chunk, IndexRange(face_index, deferred.face_index - face_index), state);
+        face_index = deferred.face_index;
+        process_deferred_line(deferred);
       }
+      geom_add_polygons(chunk, IndexRange(face_index, chunk.faces.size() - face_index), state);
     }
+  }
 
-    /* We might have a line that was cut in the middle by the previous buffer;
-     * copy it over for next chunk reading. */
-    size_t left_size = buffer_end - last_nl;
-    memmove(buffer.data(), buffer.data() + last_nl, left_size);
-    buffer_offset = left_size;
+  if (obj_file_.has_io_error()) {
+    fprintf(stderr, "IO error while reading OBJ file:'%s'.\n", import_params_.filepath);
+    BKE_reportf(import_params_.reports,
+                RPT_ERROR,
+                "OBJ Import: Cannot read file '%s'",
+                import_params_.filepath);
   }
 
-  use_all_vertices_if_no_faces(curr_geom, r_all_geometries, r_global_vertices);
+  use_all_vertices_if_no_faces(state.curr_geom, r_all_geometries, r_global_vertices);
   add_default_mtl_library();
 }
 
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "BLI_fileops.hh"
+#include "IO_mapped_file.hh"
 #include "IO_wavefront_obj.hh"
 #include "obj_import_mtl.hh"
 #include "obj_import_objects.hh"
@@ -20,20 +21,23 @@ namespace blender::io::obj {
 class OBJParser {
  private:
   const OBJImportParams &import_params_;
-  FILE *obj_file_;
+  MappedFile obj_file_;
   Vector<std::string> mtl_libraries_;
   size_t read_buffer_size_;
 
  public:
   /**
    * Open OBJ file at the path given in import parameters.
+   * The file is parsed in batches of roughly `read_buffer_size` bytes.
    */
   OBJParser(const OBJImportParams &import_params, size_t read_buffer_size);
-  ~OBJParser();
 
   /**
-   * Read the OBJ file line by line and create OBJ Geometry instances. Also store all the vertex
+   * Read the OBJ file and create OBJ Geometry instances. Also store all the vertex
    * and UV vertex coordinates in a struct accessible by all objects.
+   *
+   * The memory-mapped file is split at line boundaries into chunks whose vertex data and faces
+   * are parsed in parallel; the results are then merged in file order.
    */
   void parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
              GlobalVertices &r_global_vertices);
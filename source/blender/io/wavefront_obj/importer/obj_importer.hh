@@ -20,6 +20,6 @@ void importer_main(Main *bmain,
                    Scene *scene,
                    ViewLayer *view_layer,
                    const OBJImportParams &import_params,
-                   size_t read_buffer_size = 256 * 1024);
+                   size_t read_buffer_size = 1024 * 1024);
 
 }  // namespace blender::io::obj
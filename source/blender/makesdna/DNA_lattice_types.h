@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include "BLI_implicit_sharing.h"
+
 #include "DNA_ID.h"
 #include "DNA_defs.h"
 
@@ -49,6 +51,11 @@ typedef struct Lattice {
   float fu, fv, fw, du, dv, dw;
 
   struct BPoint *def;
+  /**
+   * Allows sharing the points between copies of the lattice, including the evaluated copies.
+   * See #BKE_lattice_points_for_write. Is null in files.
+   */
+  const ImplicitSharingInfoHandle *def_sharing_info;
 
   /** Old animation system, deprecated for 2.5. */
   struct Ipo *ipo DNA_DEPRECATED;
@@ -8,8 +8,16 @@
 
 #pragma once
 
+#include "BLI_implicit_sharing.h"
+
 typedef struct PackedFile {
   int size;
   int seek;
+  /** The data is never modified after the packed file is created. */
   void *data;
+  /**
+   * Allows sharing the data between copies of the packed file, including the copies made for the
+   * evaluated IDs. Is null in files.
+   */
+  const ImplicitSharingInfoHandle *sharing_info;
 } PackedFile;
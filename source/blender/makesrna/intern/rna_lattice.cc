@@ -79,7 +79,8 @@ static void rna_Lattice_points_begin(CollectionPropertyIterator *iter, PointerRN
         iter, (void *)lt->editlatt->latt->def, sizeof(BPoint), tot, 0, nullptr);
   }
   else if (lt->def) {
-    rna_iterator_array_begin(iter, (void *)lt->def, sizeof(BPoint), tot, 0, nullptr);
+    rna_iterator_array_begin(
+        iter, BKE_lattice_points_for_write(lt), sizeof(BPoint), tot, 0, nullptr);
   }
   else {
     rna_iterator_array_begin(iter, nullptr, 0, 0, 0, nullptr);
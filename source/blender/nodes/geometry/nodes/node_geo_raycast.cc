@@ -2,6 +2,9 @@
  *
  * SPDX-License-Identifier: GPL-2.0-or-later */
 
+#include "BLI_array.hh"
+#include "BLI_math_geom.h"
+
 #include "DNA_mesh_types.h"
 
 #include "BKE_attribute_math.hh"
@@ -109,54 +112,80 @@ static void raycast_to_mesh(const IndexMask &mask,
   /* We shouldn't be rebuilding the BVH tree when calling this function in parallel. */
   BLI_assert(tree_data.cached);
 
-  mask.foreach_index([&](const int i) {
-    const float ray_length = ray_lengths[i];
-    const float3 ray_origin = ray_origins[i];
-    const float3 ray_direction = ray_directions[i];
-
-    BVHTreeRayHit hit;
-    hit.index = -1;
-    hit.dist = ray_length;
-    if (BLI_bvhtree_ray_cast(tree_data.tree,
-                             ray_origin,
-                             ray_direction,
-                             0.0f,
-                             &hit,
-                             tree_data.raycast_callback,
-                             &tree_data) != -1)
-    {
-      if (!r_hit.is_empty()) {
-        r_hit[i] = hit.index >= 0;
-      }
-      if (!r_hit_indices.is_empty()) {
-        /* The caller must be able to handle invalid indices anyway, so don't clamp this value. */
-        r_hit_indices[i] = hit.index;
-      }
-      if (!r_hit_positions.is_empty()) {
-        r_hit_positions[i] = hit.co;
-      }
-      if (!r_hit_normals.is_empty()) {
-        r_hit_normals[i] = hit.no;
-      }
-      if (!r_hit_distances.is_empty()) {
-        r_hit_distances[i] = hit.dist;
-      }
+  const Span<float3> positions = tree_data.vert_positions;
+  const Span<int> corner_verts = tree_data.corner_verts;
+  const Span<int3> corner_tris = tree_data.corner_tris;
+
+  /* Cast the rays of each segment together, consecutive rays are traversed in packets and the
+   * triangle intersection is inlined instead of going through the generic callback. */
+  mask.foreach_segment([&](const IndexMaskSegment segment) {
+    Array<BVHTreeRay> rays(segment.size());
+    Array<BVHTreeRayHit> hits(segment.size());
+    for (const int64_t i : segment.index_range()) {
+      const int64_t index = segment[i];
+      copy_v3_v3(rays[i].origin, ray_origins[index]);
+      copy_v3_v3(rays[i].direction, ray_directions[index]);
+      rays[i].radius = 0.0f;
+      hits[i].index = -1;
+      hits[i].dist = ray_lengths[index];
     }
-    else {
-      if (!r_hit.is_empty()) {
-        r_hit[i] = false;
-      }
-      if (!r_hit_indices.is_empty()) {
-        r_hit_indices[i] = -1;
-      }
-      if (!r_hit_positions.is_empty()) {
-        r_hit_positions[i] = float3(0.0f, 0.0f, 0.0f);
-      }
-      if (!r_hit_normals.is_empty()) {
-        r_hit_normals[i] = float3(0.0f, 0.0f, 0.0f);
+
+    BLI_bvhtree_ray_cast_batch_cpp(
+        *tree_data.tree,
+        rays,
+        hits,
+        [&](const int tri_i, const BVHTreeRay &ray, BVHTreeRayHit &hit) {
+          const int3 &tri = corner_tris[tri_i];
+          const float3 &v0 = positions[corner_verts[tri[0]]];
+          const float3 &v1 = positions[corner_verts[tri[1]]];
+          const float3 &v2 = positions[corner_verts[tri[2]]];
+          const float dist = bvhtree_ray_tri_intersection(&ray, hit.dist, v0, v1, v2);
+          if (dist >= 0 && dist < hit.dist) {
+            hit.index = tri_i;
+            hit.dist = dist;
+            madd_v3_v3v3fl(hit.co, ray.origin, ray.direction, dist);
+            normal_tri_v3(hit.no, v0, v1, v2);
+          }
+        });
+
+    for (const int64_t i : segment.index_range()) {
+      const int64_t index = segment[i];
+      const BVHTreeRayHit &hit = hits[i];
+      if (hit.index != -1) {
+        if (!r_hit.is_empty()) {
+          r_hit[index] = hit.index >= 0;
+        }
+        if (!r_hit_indices.is_empty()) {
+          /* The caller must be able to handle invalid indices anyway,
+           * so don't clamp this value. */
+          r_hit_indices[index] = hit.index;
+        }
+        if (!r_hit_positions.is_empty()) {
+          r_hit_positions[index] = hit.co;
+        }
+        if (!r_hit_normals.is_empty()) {
+          r_hit_normals[index] = hit.no;
+        }
+        if (!r_hit_distances.is_empty()) {
+          r_hit_distances[index] = hit.dist;
+        }
       }
-      if (!r_hit_distances.is_empty()) {
-        r_hit_distances[i] = ray_length;
+      else {
+        if (!r_hit.is_empty()) {
+          r_hit[index] = false;
+        }
+        if (!r_hit_indices.is_empty()) {
+          r_hit_indices[index] = -1;
+        }
+        if (!r_hit_positions.is_empty()) {
+          r_hit_positions[index] = float3(0.0f, 0.0f, 0.0f);
+        }
+        if (!r_hit_normals.is_empty()) {
+          r_hit_normals[index] = float3(0.0f, 0.0f, 0.0f);
+        }
+        if (!r_hit_distances.is_empty()) {
+          r_hit_distances[index] = ray_lengths[index];
+        }
       }
     }
   });
@@ -2,6 +2,7 @@
  *
  * SPDX-License-Identifier: GPL-2.0-or-later */
 
+#include "BLI_array.hh"
 #include "BLI_array_utils.hh"
 
 #include "DNA_pointcloud_types.h"
@@ -32,20 +33,30 @@ void get_closest_in_bvhtree(BVHTreeFromMesh &tree_data,
   BLI_assert(positions.size() >= r_distances_sq.size());
   BLI_assert(positions.size() >= r_positions.size());
 
-  mask.foreach_index([&](const int i) {
-    BVHTreeNearest nearest;
-    nearest.dist_sq = FLT_MAX;
-    const float3 position = positions[i];
-    BLI_bvhtree_find_nearest(
-        tree_data.tree, position, &nearest, tree_data.nearest_callback, &tree_data);
-    if (!r_indices.is_empty()) {
-      r_indices[i] = nearest.index;
+  /* Query the positions of each segment together, consecutive positions are traversed in
+   * packets. */
+  mask.foreach_segment([&](const IndexMaskSegment segment) {
+    Array<float3> segment_positions(segment.size());
+    Array<BVHTreeNearest> nearest(segment.size());
+    for (const int64_t i : segment.index_range()) {
+      segment_positions[i] = positions[segment[i]];
+      nearest[i].index = -1;
+      nearest[i].dist_sq = FLT_MAX;
     }
-    if (!r_distances_sq.is_empty()) {
-      r_distances_sq[i] = nearest.dist_sq;
-    }
-    if (!r_positions.is_empty()) {
-      r_positions[i] = nearest.co;
+
+    bvhtree_from_mesh_find_nearest_batch(tree_data, segment_positions, nearest);
+
+    for (const int64_t i : segment.index_range()) {
+      const int64_t index = segment[i];
+      if (!r_indices.is_empty()) {
+        r_indices[index] = nearest[i].index;
+      }
+      if (!r_distances_sq.is_empty()) {
+        r_distances_sq[index] = nearest[i].dist_sq;
+      }
+      if (!r_positions.is_empty()) {
+        r_positions[index] = nearest[i].co;
+      }
     }
   });
 }
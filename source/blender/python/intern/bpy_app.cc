@@ -579,6 +579,55 @@ static PyObject *bpy_app_help_text(PyObject * /*self*/, PyObject *args, PyObject
   return result;
 }
 
+PyDoc_STRVAR(
+    /* Wrap. */
+    bpy_app_memory_profile_doc,
+    ".. staticmethod:: memory_profile(enable=None, reset=False)\n"
+    "\n"
+    "   Return the allocation statistics per tag and thread as a JSON string.\n"
+    "   Profiling is only supported by the guarded allocator, "
+    "see the ``--debug-memory`` and ``--debug-memory-profile`` command line arguments.\n"
+    "\n"
+    "   :arg enable: Enable or disable profiling of new allocations.\n"
+    "   :type enable: bool | None\n"
+    "   :arg reset: Clear the collected statistics after getting them.\n"
+    "   :type reset: bool\n"
+    "   :return: The statistics collected so far.\n"
+    "   :rtype: str\n");
+static PyObject *bpy_app_memory_profile(PyObject * /*self*/, PyObject *args, PyObject *kwds)
+{
+  PyObject *enable = Py_None;
+  bool reset = false;
+  static const char *_keywords[] = {"enable", "reset", nullptr};
+  static _PyArg_Parser _parser = {
+      PY_ARG_PARSER_HEAD_COMPAT()
+      "|$" /* Optional keyword only arguments. */
+      "O"  /* `enable` */
+      "O&" /* `reset` */
+      ":memory_profile",
+      _keywords,
+      nullptr,
+  };
+  if (!_PyArg_ParseTupleAndKeywordsFast(args, kwds, &_parser, &enable, PyC_ParseBool, &reset)) {
+    return nullptr;
+  }
+  if (enable != Py_None) {
+    const int enable_value = PyC_Long_AsBool(enable);
+    if (enable_value == -1 && PyErr_Occurred()) {
+      return nullptr;
+    }
+    MEM_profile_enable(enable_value);
+  }
+
+  char *json = MEM_profile_json();
+  PyObject *result = PyUnicode_FromString(json);
+  MEM_freeN(json);
+  if (reset) {
+    MEM_profile_reset();
+  }
+  return result;
+}
+
 #if (defined(__GNUC__) && !defined(__clang__))
 #  pragma GCC diagnostic push
 #  pragma GCC diagnostic ignored "-Wcast-function-type"
@@ -593,6 +642,10 @@ static PyMethodDef bpy_app_methods[] = {
      (PyCFunction)bpy_app_help_text,
      METH_VARARGS | METH_KEYWORDS | METH_STATIC,
      bpy_app_help_text_doc},
+    {"memory_profile",
+     (PyCFunction)bpy_app_memory_profile,
+     METH_VARARGS | METH_KEYWORDS | METH_STATIC,
+     bpy_app_memory_profile_doc},
     {nullptr, nullptr, 0, nullptr},
 };
 
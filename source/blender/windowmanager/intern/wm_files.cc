@@ -1923,6 +1923,8 @@ static bool wm_file_write(bContext *C,
                           int fileflags,
                           eBLO_WritePathRemap remap_mode,
                           bool use_save_as_copy,
+                          int compression_level,
+                          int threads_num,
                           ReportList *reports)
 {
   Main *bmain = CTX_data_main(C);
@@ -2023,6 +2025,8 @@ static bool wm_file_write(bContext *C,
   blend_write_params.use_save_versions = true;
   blend_write_params.use_save_as_copy = use_save_as_copy;
   blend_write_params.thumb = thumb;
+  blend_write_params.compression_level = compression_level;
+  blend_write_params.threads_num = threads_num;
 
   const bool success = BLO_write_file(bmain, filepath, fileflags, &blend_write_params, reports);
 
@@ -3305,6 +3309,36 @@ static void save_set_filepath(bContext *C, wmOperator *op)
   }
 }
 
+/* Properties shared by #WM_OT_save_as_mainfile & #WM_OT_save_mainfile. */
+static void save_properties_write_settings(wmOperatorType *ot)
+{
+  PropertyRNA *prop;
+
+  prop = RNA_def_int(ot->srna,
+                     "compression_level",
+                     3,
+                     1,
+                     22,
+                     "Compression Level",
+                     "Zstandard compression level of compressed files, higher levels write "
+                     "smaller files but take longer to save",
+                     1,
+                     19);
+  RNA_def_property_flag(prop, PropertyFlag(PROP_HIDDEN | PROP_SKIP_SAVE));
+
+  prop = RNA_def_int(ot->srna,
+                     "threads",
+                     0,
+                     0,
+                     BLENDER_MAX_THREADS,
+                     "Threads",
+                     "Number of threads used to write and compress the file, "
+                     "0 to use all available threads",
+                     0,
+                     BLENDER_MAX_THREADS);
+  RNA_def_property_flag(prop, PropertyFlag(PROP_HIDDEN | PROP_SKIP_SAVE));
+}
+
 static int wm_save_as_mainfile_invoke(bContext *C, wmOperator *op, const wmEvent * /*event*/)
 {
 
@@ -3384,8 +3418,14 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
   /* set compression flag */
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "compress"), G_FILE_COMPRESS);
 
-  const bool success = wm_file_write(
-      C, filepath, fileflags, remap_mode, use_save_as_copy, op->reports);
+  const bool success = wm_file_write(C,
+                                     filepath,
+                                     fileflags,
+                                     remap_mode,
+                                     use_save_as_copy,
+                                     RNA_int_get(op->ptr, "compression_level"),
+                                     RNA_int_get(op->ptr, "threads"),
+                                     op->reports);
 
   if ((op->flag & OP_IS_INVOKE) == 0) {
     /* OP_IS_INVOKE is set when the operator is called from the GUI.
@@ -3476,6 +3516,7 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  save_properties_write_settings(ot);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   true,
@@ -3563,6 +3604,7 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  save_properties_write_settings(ot);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   false,
@@ -335,7 +335,9 @@ int main(int argc,
   {
     int i;
     for (i = 0; i < argc; i++) {
-      if (STR_ELEM(argv[i], "-d", "--debug", "--debug-memory", "--debug-all")) {
+      if (STR_ELEM(
+              argv[i], "-d", "--debug", "--debug-memory", "--debug-memory-profile", "--debug-all"))
+      {
         printf("Switching to fully guarded memory allocator.\n");
         MEM_use_guarded_allocator();
         break;
@@ -344,6 +346,12 @@ int main(int argc,
         break;
       }
     }
+    /* Only used by the lock-free allocator. Opt-in since every thread may keep 1-2 MB of
+     * freed blocks around, which only pays off for allocation heavy multi-threaded work. */
+    const char *use_thread_cache = getenv("BLENDER_MEM_THREAD_CACHE");
+    if (use_thread_cache && !STREQ(use_thread_cache, "0")) {
+      MEM_use_thread_cache(true);
+    }
     MEM_init_memleak_detection();
   }
 
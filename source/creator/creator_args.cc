@@ -33,6 +33,7 @@
 #  include "BLI_utildefines.h"
 
 #  include "BKE_appdir.hh"
+#  include "BKE_blender.h"
 #  include "BKE_blender_version.h"
 #  include "BKE_blendfile.hh"
 #  include "BKE_context.hh"
@@ -650,6 +651,7 @@ static void print_help(bArgs *ba, bool all)
     BLI_args_print_arg_doc(ba, "--debug-cycles");
   }
   BLI_args_print_arg_doc(ba, "--debug-memory");
+  BLI_args_print_arg_doc(ba, "--debug-memory-profile");
   BLI_args_print_arg_doc(ba, "--debug-jobs");
   BLI_args_print_arg_doc(ba, "--debug-python");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph");
@@ -766,6 +768,7 @@ static void print_help(bArgs *ba, bool all)
   PRINT("  $BLENDER_SYSTEM_SCRIPTS    Directory for system wide scripts.\n");
   PRINT("  $BLENDER_SYSTEM_DATAFILES  Directory for system wide data files.\n");
   PRINT("  $BLENDER_SYSTEM_PYTHON     Directory for system Python libraries.\n");
+  PRINT("  $BLENDER_MEM_THREAD_CACHE  Set to 1 to cache freed small memory blocks per thread.\n");
 
   if (defs.with_ocio) {
     PRINT("  $OCIO                     Path to override the OpenColorIO config file.\n");
@@ -1176,6 +1179,39 @@ static int arg_handle_debug_mode_memory_set(int /*argc*/, const char ** /*argv*/
   return 0;
 }
 
+static void memory_profile_write_atexit(void *user_data)
+{
+  FILE *fp = static_cast<FILE *>(user_data);
+  char *json = MEM_profile_json();
+  fputs(json, fp);
+  fclose(fp);
+  MEM_freeN(json);
+}
+
+static const char arg_handle_debug_mode_memory_profile_set_doc[] =
+    "<filepath>\n"
+    "\tEnable fully guarded memory allocation and collect allocation statistics\n"
+    "\tper tag and thread, written to <filepath> as JSON on exit.";
+static int arg_handle_debug_mode_memory_profile_set(int argc, const char **argv, void * /*data*/)
+{
+  const char *arg_id = "--debug-memory-profile";
+  if (argc > 1) {
+    errno = 0;
+    FILE *fp = BLI_fopen(argv[1], "w");
+    if (fp == nullptr) {
+      const char *err_msg = errno ? strerror(errno) : "unknown";
+      fprintf(stderr, "\nError: %s '%s %s'.\n", err_msg, arg_id, argv[1]);
+    }
+    else {
+      MEM_profile_enable(true);
+      BKE_blender_atexit_register(memory_profile_write_atexit, fp);
+    }
+    return 1;
+  }
+  fprintf(stderr, "\nError: '%s' no args given.\n", arg_id);
+  return 0;
+}
+
 static const char arg_handle_debug_value_set_doc[] =
     "<value>\n"
     "\tSet debug value of <value> on startup.";
@@ -2422,6 +2458,11 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
     BLI_args_add(ba, nullptr, "--debug-cycles", CB(arg_handle_debug_mode_cycles), nullptr);
   }
   BLI_args_add(ba, nullptr, "--debug-memory", CB(arg_handle_debug_mode_memory_set), nullptr);
+  BLI_args_add(ba,
+               nullptr,
+               "--debug-memory-profile",
+               CB(arg_handle_debug_mode_memory_profile_set),
+               nullptr);
 
   BLI_args_add(ba, nullptr, "--debug-value", CB(arg_handle_debug_value_set), nullptr);
   BLI_args_add(ba,
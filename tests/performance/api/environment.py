@@ -10,6 +10,7 @@ import os
 import pathlib
 import platform
 import pickle
+import shutil
 import subprocess
 import sys
 from typing import Callable, Dict, List
@@ -116,8 +117,10 @@ class TestEnvironment:
         cmake_options = list(self.cmake_options)
         cmake_options += [f"-DCMAKE_INSTALL_PREFIX={install_dir}"]
         try:
+            self._remove_performance_executables(self.build_dir / 'bin' / 'tests')
             self.call([self.cmake_executable, '.'] + cmake_options, self.build_dir)
             self.call([self.cmake_executable, '--build', '.', '-j', jobs, '--target', 'install'], self.build_dir)
+            self._install_performance_executables(install_dir)
             if complete_txt:
                 complete_txt.write_text(git_hash)
         except KeyboardInterrupt as e:
@@ -128,6 +131,29 @@ class TestEnvironment:
         self._init_default_blender_executable()
         return True
 
+    @staticmethod
+    def _performance_executables(tests_dir: pathlib.Path) -> List[pathlib.Path]:
+        return [filepath for filepath in tests_dir.glob('**/*_performance_test*') if filepath.is_file()]
+
+    def _remove_performance_executables(self, tests_dir: pathlib.Path) -> None:
+        # Executables of tests that don't exist in the revision would otherwise be left behind.
+        # The ones that do exist are linked again by the build.
+        for filepath in self._performance_executables(tests_dir):
+            filepath.unlink()
+
+    def _install_performance_executables(self, install_dir: pathlib.Path) -> None:
+        # Performance test executables are not part of the install target. Copy them next to the
+        # installed Blender, so that every build runs its own version of them. The build directory
+        # only contains the ones built for this revision, see `build`.
+        tests_dir = self.build_dir / 'bin' / 'tests'
+        install_tests_dir = install_dir / 'tests'
+        if tests_dir.resolve() == install_tests_dir.resolve():
+            return
+        self._remove_performance_executables(install_tests_dir)
+        for filepath in self._performance_executables(tests_dir):
+            install_tests_dir.mkdir(parents=True, exist_ok=True)
+            shutil.copy2(filepath, install_tests_dir / filepath.name)
+
     def set_blender_executable(self, executable_path: pathlib.Path, environment: Dict = {}) -> None:
         if executable_path.is_dir():
             executable_path = self._blender_executable_from_path(executable_path)
@@ -0,0 +1,70 @@
+# SPDX-FileCopyrightText: 2024 Blender Authors
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import api
+import json
+import pathlib
+import platform
+
+# Benchmarks of blenlib containers and algorithms. These run a test executable instead of Blender,
+# which is only available in builds with `WITH_GTESTS` enabled.
+
+EXECUTABLE_NAME = 'BLI_containers_performance_test'
+TEST_SUITE_NAME = 'BenchmarkTest'
+OUTPUT_PREFIX = 'BENCHMARK_RESULT: '
+
+
+def _find_executable(env):
+    # Performance test executables are copied into the install directory of every build, look for
+    # them next to the Blender executable, which may be inside an app bundle on macOS.
+    name = EXECUTABLE_NAME + ('.exe' if platform.system() == "Windows" else '')
+    if env.blender_executable:
+        for dirpath in list(pathlib.Path(env.blender_executable).parents)[:4]:
+            filepath = dirpath / 'tests' / name
+            if filepath.is_file():
+                return filepath
+
+    return None
+
+
+class BlenlibTest(api.Test):
+    def __init__(self, benchmark_name):
+        self.benchmark_name = benchmark_name
+
+    def name(self):
+        return self.benchmark_name
+
+    def category(self):
+        return "blenlib"
+
+    def run(self, env, device_id):
+        executable = _find_executable(env)
+        if not executable:
+            raise Exception("Executable " + EXECUTABLE_NAME + " not found, build with WITH_GTESTS")
+
+        gtest_filter = f'--gtest_filter={TEST_SUITE_NAME}.{self.benchmark_name}'
+        lines = env.call([str(executable), gtest_filter], env.base_dir)
+        for line in lines:
+            if line.startswith(OUTPUT_PREFIX):
+                return json.loads(line[len(OUTPUT_PREFIX):])
+
+        return {}
+
+
+def generate(env):
+    executable = _find_executable(env)
+    if not executable:
+        return []
+
+    # Output of `--gtest_list_tests` lists the suite name followed by indented test names.
+    lines = env.call([str(executable), '--gtest_list_tests'], env.base_dir, silent=True)
+    names = []
+    in_suite = False
+    for line in lines:
+        if not line.startswith(' '):
+            in_suite = line.strip() == TEST_SUITE_NAME + '.'
+        elif in_suite:
+            names.append(line.strip())
+
+    return [BlenlibTest(name) for name in names]